@@ -0,0 +1,3 @@
+#define PICOSAT_CC "gcc"
+#define PICOSAT_CFLAGS "-static -Wall -Wextra -DNDEBUG -O3 -fomit-frame-pointer -finline-limit=1000000"
+#define PICOSAT_VERSION "936"
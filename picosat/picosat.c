@@ -117,33 +117,33 @@ IN THE SOFTWARE.
     (end) = (start) + new_num; \
   } while (0)
 
-#define NOTLIT(l) (lits + (1 ^ ((l) - lits)))
+#define NOTLIT(l) (ps->lits + (1 ^ ((l) - ps->lits)))
 
-#define LIT2IDX(l) ((unsigned)((l) - lits) / 2)
-#define LIT2IMPLS(l) (impls + (unsigned)((l) - lits))
+#define LIT2IDX(l) ((unsigned)((l) - ps->lits) / 2)
+#define LIT2IMPLS(l) (ps->impls + (unsigned)((l) - ps->lits))
 #define LIT2INT(l) (LIT2SGN(l) * LIT2IDX(l))
-#define LIT2SGN(l) (((unsigned)((l) - lits) & 1) ? -1 : 1)
-#define LIT2VAR(l) (vars + LIT2IDX(l))
-#define LIT2HTPS(l) (htps + (unsigned)((l) - lits))
-#define LIT2JWH(l) (jwh + ((l) - lits))
+#define LIT2SGN(l) (((unsigned)((l) - ps->lits) & 1) ? -1 : 1)
+#define LIT2VAR(l) (ps->vars + LIT2IDX(l))
+#define LIT2HTPS(l) (ps->htps + (unsigned)((l) - ps->lits))
+#define LIT2JWH(l) (ps->jwh + ((l) - ps->lits))
 
 #ifndef NDSC
-#define LIT2DHTPS(l) (dhtps + (unsigned)((l) - lits))
+#define LIT2DHTPS(l) (ps->dhtps + (unsigned)((l) - ps->lits))
 #endif
 
 #ifdef NO_BINARY_CLAUSES
 typedef unsigned long Wrd;
 #define ISLITREASON(cls) (1&(Wrd)cls)
 #define LIT2REASON(lit) \
-  (assert (lit->val==TRUE), ((Cls*)(1 + (2*(lit - lits)))))
-#define REASON2LIT(cls) ((Lit*)(lits + ((Wrd)cls)/2))
+  (assert (lit->val==TRUE), ((Cls*)(1 + (2*(lit - ps->lits)))))
+#define REASON2LIT(cls) ((Lit*)(ps->lits + ((Wrd)cls)/2))
 #endif
 
 #define ENDOFCLS(c) ((void*)((c)->lits + (c)->size))
 
-#define SOC ((oclauses == ohead) ? lclauses : oclauses)
-#define EOC lhead
-#define NXC(p) (((p) + 1 == ohead) ? lclauses : (p) + 1)
+#define SOC ((ps->oclauses == ps->ohead) ? ps->lclauses : ps->oclauses)
+#define EOC ps->lhead
+#define NXC(p) (((p) + 1 == ps->ohead) ? ps->lclauses : (p) + 1)
 
 #define OIDX2IDX(idx) (2 * ((idx) + 1))
 #define LIDX2IDX(idx) (2 * (idx) + 1)
@@ -154,12 +154,12 @@ typedef unsigned long Wrd;
 #define IDX2LIDX(idx) (assert(ISLIDX(idx)), (idx)/2)
 
 #define EXPORTIDX(idx) \
-  ((ISLIDX(idx) ? (IDX2LIDX (idx) + (ohead - oclauses)) : IDX2OIDX(idx)) + 1)
+  ((ISLIDX(idx) ? (IDX2LIDX (idx) + (ps->ohead - ps->oclauses)) : IDX2OIDX(idx)) + 1)
 
 #define IDX2CLS(i) \
-  (assert(i), (ISLIDX(i) ? lclauses : oclauses)[(i)/2 - !ISLIDX(i)])
+  (assert(i), (ISLIDX(i) ? ps->lclauses : ps->oclauses)[(i)/2 - !ISLIDX(i)])
 
-#define IDX2ZHN(i) (assert(i), (ISLIDX(i) ? zhains[(i)/2] : 0))
+#define IDX2ZHN(i) (assert(i), (ISLIDX(i) ? ps->zhains[(i)/2] : 0))
 
 #define CLS2TRD(c) (((Trd*)(c)) - 1)
 #define CLS2IDX(c) ((((Trd*)(c)) - 1)->idx)
@@ -167,11 +167,11 @@ typedef unsigned long Wrd;
 #define CLS2ACT(c) \
   ((Act*)((assert((c)->learned)),assert((c)->size>2),ENDOFCLS(c)))
 
-#define VAR2LIT(v) (lits + 2 * ((v) - vars))
-#define VAR2RNK(v) (rnks + ((v) - vars))
+#define VAR2LIT(v) (ps->lits + 2 * ((v) - ps->vars))
+#define VAR2RNK(v) (ps->rnks + ((v) - ps->vars))
 
-#define RNK2LIT(r) (lits + 2 * ((r) - rnks))
-#define RNK2VAR(r) (vars + ((r) - rnks))
+#define RNK2LIT(r) (ps->lits + 2 * ((r) - ps->rnks))
+#define RNK2VAR(r) (ps->vars + ((r) - ps->rnks))
 
 #define BLK_FILL_BYTES 8
 #define SIZE_OF_BLK (sizeof (Blk) - BLK_FILL_BYTES)
@@ -264,7 +264,7 @@ do { \
 #define internal_quicksort(T,cmp,a,n) \
 do { \
   int l = 0, r = (n) - 1, m, ll, rr, i; \
-  assert (ihead == indices); \
+  assert (ps->ihead == ps->indices); \
   if (r - l <= INSERTION_SORT_LIMIT) \
     break; \
   for (;;) \
@@ -290,22 +290,22 @@ do { \
       if (r - l > INSERTION_SORT_LIMIT) \
 	{ \
 	  assert (rr - ll > INSERTION_SORT_LIMIT); \
-	  if (ihead == eoi) \
-	    ENLARGE (indices, ihead, eoi); \
-	  *ihead++ = ll; \
-	  if (ihead == eoi) \
-	    ENLARGE (indices, ihead, eoi); \
-	  *ihead++ = rr; \
+	  if (ps->ihead == ps->eoi) \
+	    ENLARGE (ps->indices, ps->ihead, ps->eoi); \
+	  *ps->ihead++ = ll; \
+	  if (ps->ihead == ps->eoi) \
+	    ENLARGE (ps->indices, ps->ihead, ps->eoi); \
+	  *ps->ihead++ = rr; \
 	} \
       else if (rr - ll > INSERTION_SORT_LIMIT) \
         { \
 	  l = ll; \
 	  r = rr; \
 	} \
-      else if (ihead > indices) \
+      else if (ps->ihead > ps->indices) \
 	{ \
-	  r = *--ihead; \
-	  l = *--ihead; \
+	  r = *--ps->ihead; \
+	  l = *--ps->ihead; \
 	} \
       else \
 	break; \
@@ -348,7 +348,7 @@ do { \
   int nn = (n); \
   internal_quicksort (T, cmp, aa, nn); \
   internal_insertion_sort (T, cmp, aa, nn); \
-  assert (ihead == indices); \
+  assert (ps->ihead == ps->indices); \
   check_sorted (cmp, aa, nn); \
 } while (0)
 
@@ -362,6 +362,7 @@ typedef struct Lit Lit;		/* literal */
 typedef struct Rnk Rnk;		/* variable to score mapping */
 typedef signed char Val;	/* TRUE, UNDEF, FALSE */
 typedef struct Var Var;		/* variable */
+typedef struct PicoSAT PicoSAT;	/* solver instance */
 #ifdef TRACE
 typedef struct Trd Trd;		/* trace data for clauses */
 typedef struct Zhn Zhn;		/* compressed chain (=zain) data */
@@ -460,204 +461,215 @@ struct Blk
   char data[BLK_FILL_BYTES];
 };
 
-static enum State
+enum State
 {
   RESET = 0,
   READY = 1,
   SAT = 2,
   UNSAT = 3,
   UNKNOWN = 4,
-} 
-state = RESET;
-
-static int last_sat_call_result;
-
-static FILE *out;
-static char * prefix;
-static int verbosity;
-static unsigned level;
-static unsigned max_var;
-static unsigned size_vars;
-
-static Lit * __attribute__((aligned(64))) lits;
-static Var *vars;
-static Rnk *rnks;
-static Flt *jwh;
-static Cls **htps;
+};
+
+/* All solver state lives in one instance so that several solvers can
+ * coexist.  The functions below always operate on the instance that is
+ * current for the calling thread, see 'picosat_set_context'.
+ */
+struct PicoSAT
+{
+  enum State state;
+
+  int last_sat_call_result;
+
+  FILE *out;
+  char * prefix;
+  int verbosity;
+  unsigned level;
+  unsigned max_var;
+  unsigned size_vars;
+
+  Lit * lits;
+  Var *vars;
+  Rnk *rnks;
+  Flt *jwh;
+  Cls **htps;
 #ifndef NDSC
-static Cls **dhtps;
+  Cls **dhtps;
 #endif
 #ifdef NO_BINARY_CLAUSES
-static Ltk *impls;
-static Cls impl, cimpl;
-static int implvalid, cimplvalid;
+  Ltk *impls;
+  Cls impl, cimpl;
+  int implvalid, cimplvalid;
 #else
-static Cls **impls;
+  Cls **impls;
 #endif
-static Lit **trail, **thead, **eot, **ttail, ** ttail2;
+  Lit **trail, **thead, **eot, **ttail, ** ttail2;
 #ifndef NADC
-static Lit **ttailado;
-#endif
-static unsigned adecidelevel;
-static Lit **als, **alshead, **alstail, **eoals;
-static int *fals, *falshead, *eofals;
-static int *mass, szmass;
-static Lit *failed_assumption;
-static int extracted_all_failed_assumptions;
-static Rnk **heap, **hhead, **eoh;
-static Cls **oclauses, **ohead, **eoo;	/* original clauses */
-static Cls **lclauses, **lhead, ** eol;	/* learned clauses */
+  Lit **ttailado;
+#endif
+  unsigned adecidelevel;
+  Lit **als, **alshead, **alstail, **eoals;
+  int *fals, *falshead, *eofals;
+  int *mass, szmass;
+  Lit *failed_assumption;
+  int extracted_all_failed_assumptions;
+  Rnk **heap, **hhead, **eoh;
+  Cls **oclauses, **ohead, **eoo;	/* original clauses */
+  Cls **lclauses, **lhead, ** eol;	/* learned clauses */
 #ifdef TRACE
-static int trace;
-static Zhn **zhains, **zhead, **eoz;
-static int ocore = -1;
-#endif
-static FILE * rup;
-static int rupstarted;
-static int rupvariables;
-static int rupclauses;
-static Cls *mtcls;
-static Cls *conflict;
-static Lit **added, **ahead, **eoa;
-static Var **marked, **mhead, **eom;
-static Var **dfs, **dhead, **eod;
-static Cls **resolved, **rhead, **eor;
-static unsigned char *buffer, *bhead, *eob;
-static Act vinc, lscore, ilvinc, ifvinc;
+  int trace;
+  Zhn **zhains, **zhead, **eoz;
+  int ocore;
+#endif
+  FILE * rup;
+  int rupstarted;
+  int rupvariables;
+  int rupclauses;
+  Cls *mtcls;
+  Cls *conflict;
+  Lit **added, **ahead, **eoa;
+  Var **marked, **mhead, **eom;
+  Var **dfs, **dhead, **eod;
+  Cls **resolved, **rhead, **eor;
+  unsigned char *buffer, *bhead, *eob;
+  Act vinc, lscore, ilvinc, ifvinc;
 #ifdef VISCORES
-static Act fvinc, nvinc;
-#endif
-static Act cinc, lcinc, ilcinc, fcinc;
-static unsigned srng;
-static size_t current_bytes;
-static size_t max_bytes;
-static size_t recycled;
-static double seconds;
-static double entered;
-static unsigned nentered;
-static int measurealltimeinlib;
-static char *rline[2];
-static int szrline, rcount;
-static double levelsum;
-static unsigned iterations;
-static int reports;
-static int lastrheader = -2;
-static unsigned calls;
-static unsigned decisions;
-static unsigned restarts;
-static unsigned simps;
-static unsigned fsimplify;
-static unsigned isimplify;
-static unsigned reductions;
-static unsigned lreduce;
-static unsigned lreduceadjustcnt;
-static unsigned lreduceadjustinc;
-static unsigned lastreduceconflicts;
-static unsigned llocked;	/* locked large learned clauses */
-static unsigned lrestart;
+  Act fvinc, nvinc;
+#endif
+  Act cinc, lcinc, ilcinc, fcinc;
+  unsigned srng;
+  size_t current_bytes;
+  size_t max_bytes;
+  size_t recycled;
+  double seconds;
+  double entered;
+  unsigned nentered;
+  int measurealltimeinlib;
+  char *rline[2];
+  int szrline, rcount;
+  double levelsum;
+  unsigned iterations;
+  int reports;
+  int lastrheader;
+  unsigned calls;
+  unsigned decisions;
+  unsigned restarts;
+  unsigned simps;
+  unsigned fsimplify;
+  unsigned isimplify;
+  unsigned reductions;
+  unsigned lreduce;
+  unsigned lreduceadjustcnt;
+  unsigned lreduceadjustinc;
+  unsigned lastreduceconflicts;
+  unsigned llocked;	/* locked large learned clauses */
+  unsigned lrestart;
 #ifdef NLUBY
-static unsigned drestart;
-static unsigned ddrestart;
+  unsigned drestart;
+  unsigned ddrestart;
 #else
-static unsigned lubycnt;
-static unsigned lubymaxdelta;
-static int waslubymaxdelta;
-#endif
-static unsigned long long lsimplify;
-static unsigned long long propagations;
-static unsigned long long lpropagations;
-static unsigned fixed;		/* top level assignments */
+  unsigned lubycnt;
+  unsigned lubymaxdelta;
+  int waslubymaxdelta;
+#endif
+  unsigned long long lsimplify;
+  unsigned long long propagations;
+  unsigned long long lpropagations;
+  unsigned fixed;	/* top level assignments */
 #ifndef NFL
-static unsigned failedlits;
-static unsigned ifailedlits;
-static unsigned efailedlits;
-static unsigned flcalls;
+  unsigned failedlits;
+  unsigned ifailedlits;
+  unsigned efailedlits;
+  unsigned flcalls;
 #ifdef STATS
-static unsigned flrounds;
-static unsigned long long flprops;
-static unsigned long long floopsed, fltried, flskipped;
-#endif
-static unsigned long long fllimit;
-static int simplifying;
-static Lit ** saved;
-static unsigned saved_size;
-#endif
-static unsigned conflicts;
-static unsigned noclauses;	/* current number large original clauses */
-static unsigned nlclauses;	/* current number large learned clauses */
-static unsigned olits;		/* current literals in large original clauses */
-static unsigned llits;		/* current literals in large learned clauses */
-static unsigned oadded;		/* added original clauses */
-static unsigned ladded;		/* added learned clauses */
-static unsigned loadded;	/* added original large clauses */
-static unsigned lladded;	/* added learned large clauses */
-static unsigned addedclauses;	/* oadded + ladded */
-static unsigned vused;		/* used variables */
-static unsigned llitsadded;	/* added learned literals */
+  unsigned flrounds;
+  unsigned long long flprops;
+  unsigned long long floopsed, fltried, flskipped;
+#endif
+  unsigned long long fllimit;
+  int simplifying;
+  Lit ** saved;
+  unsigned saved_size;
+#endif
+  unsigned conflicts;
+  unsigned noclauses;	/* current number large original clauses */
+  unsigned nlclauses;	/* current number large learned clauses */
+  unsigned olits;	/* current literals in large original clauses */
+  unsigned llits;	/* current literals in large learned clauses */
+  unsigned oadded;	/* added original clauses */
+  unsigned ladded;	/* added learned clauses */
+  unsigned loadded;	/* added original large clauses */
+  unsigned lladded;	/* added learned large clauses */
+  unsigned addedclauses;	/* oadded + ladded */
+  unsigned vused;	/* used variables */
+  unsigned llitsadded;	/* added learned literals */
 #ifdef STATS
-static unsigned loused;		/* used large original clauses */
-static unsigned llused;		/* used large learned clauses */
-static unsigned long long visits;
-static unsigned long long bvisits;
-static unsigned long long tvisits;
-static unsigned long long lvisits;
-static unsigned long long othertrue;
-static unsigned long long othertrue2;
-static unsigned long long othertruel;
-static unsigned long long othertrue2u;
-static unsigned long long othertruelu;
-static unsigned long long ltraversals;
-static unsigned long long traversals;
+  unsigned loused;	/* used large original clauses */
+  unsigned llused;	/* used large learned clauses */
+  unsigned long long visits;
+  unsigned long long bvisits;
+  unsigned long long tvisits;
+  unsigned long long lvisits;
+  unsigned long long othertrue;
+  unsigned long long othertrue2;
+  unsigned long long othertruel;
+  unsigned long long othertrue2u;
+  unsigned long long othertruelu;
+  unsigned long long ltraversals;
+  unsigned long long traversals;
 #ifdef TRACE
-static unsigned long long antecedents;
-#endif
-static unsigned uips;
-static unsigned znts;
-static unsigned assumptions;
-static unsigned rdecisions;
-static unsigned sdecisions;
-static size_t srecycled;
-static size_t rrecycled;
-static unsigned long long derefs;
-#endif
-static unsigned minimizedllits;
-static unsigned nonminimizedllits;
+  unsigned long long antecedents;
+#endif
+  unsigned uips;
+  unsigned znts;
+  unsigned assumptions;
+  unsigned rdecisions;
+  unsigned sdecisions;
+  size_t srecycled;
+  size_t rrecycled;
+  unsigned long long derefs;
+#endif
+  unsigned minimizedllits;
+  unsigned nonminimizedllits;
 #ifndef NADC
-static Lit *** ados, *** hados, *** eados;
-static Lit *** adotab;
-static unsigned nadotab;
-static unsigned szadotab;
-static Cls * adoconflict;
-static unsigned adoconflicts;
-static unsigned adoconflictlimit = UINT_MAX;
-static int addingtoado;
-static int adodisabled;
-#endif
-static unsigned long long flips;
+  Lit *** ados, *** hados, *** eados;
+  Lit *** adotab;
+  unsigned nadotab;
+  unsigned szadotab;
+  Cls * adoconflict;
+  unsigned adoconflicts;
+  unsigned adoconflictlimit;
+  int addingtoado;
+  int adodisabled;
+#endif
+  unsigned long long flips;
 #ifdef STATS
-static unsigned long long forced;
-static unsigned long long assignments;
-static unsigned inclreduces;
-static unsigned staticphasedecisions;
-static unsigned skippedrestarts;
+  unsigned long long forced;
+  unsigned long long assignments;
+  unsigned inclreduces;
+  unsigned staticphasedecisions;
+  unsigned skippedrestarts;
+#endif
+  int * indices, * ihead, *eoi;
+  unsigned sdflips;
+  int defaultphase;
+
+  unsigned long long saved_flips;
+  unsigned saved_max_var;
+  unsigned min_flipped;
+
+
+#ifdef VISCORES
+  FILE * fviscores;
 #endif
-static int * indices, * ihead, *eoi; 
-static unsigned sdflips;
-static int defaultphase;
+};
 
-static unsigned long long saved_flips;
-static unsigned saved_max_var;
-static unsigned min_flipped = UINT_MAX;
+static __thread PicoSAT * ps;
 
 static void * emgr;
 static void * (*enew)(void*,size_t);
 static void * (*eresize)(void*,void*,size_t,size_t);
 static void (*edelete)(void*,void*,size_t);
 
-#ifdef VISCORES
-static FILE * fviscores;
-#endif
-
 static Flt
 packflt (unsigned m, int e)
 {
@@ -914,9 +926,9 @@ new (size_t size)
 #ifndef NDEBUG
   b->header.size = size;
 #endif
-  current_bytes += size;
-  if (current_bytes > max_bytes)
-    max_bytes = current_bytes;
+  ps->current_bytes += size;
+  if (ps->current_bytes > ps->max_bytes)
+    ps->max_bytes = ps->current_bytes;
   return b->data;
 }
 
@@ -935,8 +947,8 @@ delete (void *void_ptr, size_t size)
   assert (size);
   b = PTR2BLK (void_ptr);
 
-  assert (size <= current_bytes);
-  current_bytes -= size;
+  assert (size <= ps->current_bytes);
+  ps->current_bytes -= size;
 
   assert (b->header.size == size);
 
@@ -955,8 +967,8 @@ resize (void *void_ptr, size_t old_size, size_t new_size)
 
   b = PTR2BLK (void_ptr);
 
-  assert (old_size <= current_bytes);
-  current_bytes -= old_size;
+  assert (old_size <= ps->current_bytes);
+  ps->current_bytes -= old_size;
 
   if ((old_bytes = old_size))
     {
@@ -985,9 +997,9 @@ resize (void *void_ptr, size_t old_size, size_t new_size)
   b->header.size = new_size;
 #endif
 
-  current_bytes += new_size;
-  if (current_bytes > max_bytes)
-    max_bytes = current_bytes;
+  ps->current_bytes += new_size;
+  if (ps->current_bytes > ps->max_bytes)
+    ps->max_bytes = ps->current_bytes;
 
   return b->data;
 }
@@ -1001,7 +1013,7 @@ int2unsigned (int l)
 static Lit *
 int2lit (int l)
 {
-  return lits + int2unsigned (l);
+  return ps->lits + int2unsigned (l);
 }
 
 static Lit **
@@ -1013,13 +1025,13 @@ end_of_lits (Cls * cls)
 static int
 lit2idx (Lit * lit)
 {
-  return (lit - lits) / 2;
+  return (lit - ps->lits) / 2;
 }
 
 static int
 lit2sign (Lit * lit)
 {
-  return ((lit - lits) & 1) ? -1 : 1;
+  return ((lit - ps->lits) & 1) ? -1 : 1;
 }
 
 
@@ -1043,19 +1055,19 @@ dumplits (Lit ** lits, Lit ** eol)
     }
   else if (lits + 1 == eol)
     {
-      fprintf (out, "%d ", lit2int (lits[0]));
+      fprintf (ps->out, "%d ", lit2int (lits[0]));
     }
   else
     { 
       assert (lits + 2 <= eol);
       first = (abs (lit2int (lits[0])) > abs (lit2int (lits[1])));
-      fprintf (out, "%d ", lit2int (lits[first]));
-      fprintf (out, "%d ", lit2int (lits[!first]));
+      fprintf (ps->out, "%d ", lit2int (lits[first]));
+      fprintf (ps->out, "%d ", lit2int (lits[!first]));
       for (p = lits + 2; p < eol; p++)
-	fprintf (out, "%d ", lit2int (*p));
+	fprintf (ps->out, "%d ", lit2int (*p));
     }
 
-  fputc ('0', out);
+  fputc ('0', ps->out);
 }
 
 static void
@@ -1068,19 +1080,19 @@ dumpcls (Cls * cls)
       eol = end_of_lits (cls);
       dumplits (cls->lits, eol);
 #ifdef TRACE
-      if (trace)
-	fprintf (out, " clause(%u)", CLS2IDX (cls));
+      if (ps->trace)
+	fprintf (ps->out, " clause(%u)", CLS2IDX (cls));
 #endif
     }
   else
-    fputs ("DECISION", out);
+    fputs ("DECISION", ps->out);
 }
 
 static void
 dumpclsnl (Cls * cls)
 {
   dumpcls (cls);
-  fputc ('\n', out);
+  fputc ('\n', ps->out);
 }
 
 void
@@ -1109,11 +1121,11 @@ dumpcnf (void)
 static void
 delete_prefix (void)
 {
-  if (!prefix)
+  if (!ps->prefix)
     return;
     
-  delete (prefix, strlen (prefix) + 1);
-  prefix = 0;
+  delete (ps->prefix, strlen (ps->prefix) + 1);
+  ps->prefix = 0;
 }
 
 static void
@@ -1121,95 +1133,95 @@ new_prefix (const char * str)
 {
   delete_prefix ();
   assert (str);
-  prefix = new (strlen (str) + 1);
-  strcpy (prefix, str);
+  ps->prefix = new (strlen (str) + 1);
+  strcpy (ps->prefix, str);
 }
 
 static void
 init (void)
 {
-  static int count;
+  int count;
 
-  ABORTIF (state != RESET, "API usage: multiple initializations");
+  ABORTIF (ps->state != RESET, "API usage: multiple initializations");
 
   count = 3 - !enew - !eresize - !edelete;
   ABORTIF (count && !enew, "API usage: missing 'picosat_set_new'");
   ABORTIF (count && !eresize, "API usage: missing 'picosat_set_resize'");
   ABORTIF (count && !edelete, "API usage: missing 'picosat_set_delete'");
 
-  assert (!max_var);		/* check for proper reset */
-  assert (!size_vars);		/* check for proper reset */
+  assert (!ps->max_var);		/* check for proper reset */
+  assert (!ps->size_vars);		/* check for proper reset */
 
-  size_vars = 1;
+  ps->size_vars = 1;
 
-  NEWN (lits, 2 * size_vars);
-  NEWN (jwh, 2 * size_vars);
-  NEWN (htps, 2 * size_vars);
+  NEWN (ps->lits, 2 * ps->size_vars);
+  NEWN (ps->jwh, 2 * ps->size_vars);
+  NEWN (ps->htps, 2 * ps->size_vars);
 #ifndef NDSC
-  NEWN (dhtps, 2 * size_vars);
+  NEWN (ps->dhtps, 2 * ps->size_vars);
 #endif
-  NEWN (impls, 2 * size_vars);
-  NEWN (vars, size_vars);
-  NEWN (rnks, size_vars);
+  NEWN (ps->impls, 2 * ps->size_vars);
+  NEWN (ps->vars, ps->size_vars);
+  NEWN (ps->rnks, ps->size_vars);
 
-  ENLARGE (heap, hhead, eoh);	/* because '0' pos denotes not on heap */
-  hhead = heap + 1;
+  ENLARGE (ps->heap, ps->hhead, ps->eoh);	/* because '0' pos denotes not on heap */
+  ps->hhead = ps->heap + 1;
 
-  vinc = base2flt (1, 0);	/* initial variable activity */
-  ifvinc = ascii2flt ("1.05");	/* variable score rescore factor */
+  ps->vinc = base2flt (1, 0);	/* initial variable activity */
+  ps->ifvinc = ascii2flt ("1.05");	/* variable score rescore factor */
 #ifdef VISCORES
-  fvinc = ascii2flt ("0.9523809");	/*     1/f =     1/1.1 */
-  nvinc = ascii2flt ("0.0476191");	/* 1 - 1/f = 1 - 1/1.1 */
+  ps->fvinc = ascii2flt ("0.9523809");	/*     1/f =     1/1.1 */
+  ps->nvinc = ascii2flt ("0.0476191");	/* 1 - 1/f = 1 - 1/1.1 */
 #endif
-  lscore = base2flt (1, 90);	/* variable activity rescore limit */
-  ilvinc = base2flt (1, -90);	/* inverse of 'lscore' */
+  ps->lscore = base2flt (1, 90);	/* variable activity rescore limit */
+  ps->ilvinc = base2flt (1, -90);	/* inverse of 'lscore' */
 
-  cinc = base2flt (1, 0);	/* initial clause activity */
-  fcinc = ascii2flt ("1.001");	/* clause activity rescore factor */
-  lcinc = base2flt (1, 90);	/* clause activity rescore limit */
-  ilcinc = base2flt (1, -90);	/* inverse of 'ilcinc' */
+  ps->cinc = base2flt (1, 0);	/* initial clause activity */
+  ps->fcinc = ascii2flt ("1.001");	/* clause activity rescore factor */
+  ps->lcinc = base2flt (1, 90);	/* clause activity rescore limit */
+  ps->ilcinc = base2flt (1, -90);	/* inverse of 'ilcinc' */
 
-  lreduceadjustcnt = lreduceadjustinc = 100;
-  lpropagations = ~0ull;
+  ps->lreduceadjustcnt = ps->lreduceadjustinc = 100;
+  ps->lpropagations = ~0ull;
 
-  out = stdout;
+  ps->out = stdout;
   new_prefix ("c ");
-  verbosity = 0;
+  ps->verbosity = 0;
 
 #ifdef NO_BINARY_CLAUSES
-  memset (&impl, 0, sizeof (impl));
-  impl.size = 2;
+  memset (&ps->impl, 0, sizeof (ps->impl));
+  ps->impl.size = 2;
 
-  memset (&cimpl, 0, sizeof (impl));
-  cimpl.size = 2;
+  memset (&ps->cimpl, 0, sizeof (ps->impl));
+  ps->cimpl.size = 2;
 #endif
 
 #ifdef VISCORES
-  fviscores = popen (
+  ps->fviscores = popen (
     "/usr/bin/gnuplot -background black"
     " -xrm 'gnuplot*textColor:white'"
     " -xrm 'gnuplot*borderColor:white'"
     " -xrm 'gnuplot*axisColor:white'"
     , "w");
-  fprintf (fviscores, "unset key\n");
+  fprintf (ps->fviscores, "unset key\n");
   // fprintf (fviscores, "set log y\n");
-  fflush (fviscores);
+  fflush (ps->fviscores);
   system ("rm -rf /tmp/picosat-viscores");
   system ("mkdir /tmp/picosat-viscores");
   system ("mkdir /tmp/picosat-viscores/data");
 #ifdef WRITEGIF
   system ("mkdir /tmp/picosat-viscores/gif");
-  fprintf (fviscores,
+  fprintf (ps->fviscores,
            "set terminal gif giant animate opt size 1024,768 x000000 xffffff"
 	   "\n");
 
-  fprintf (fviscores, 
+  fprintf (ps->fviscores, 
            "set output \"/tmp/picosat-viscores/gif/animated.gif\"\n");
 #endif
 #endif
-  defaultphase = 2;
-  state = READY;
-  last_sat_call_result = 0;
+  ps->defaultphase = 2;
+  ps->state = READY;
+  ps->last_sat_call_result = 0;
 }
 
 static size_t
@@ -1225,7 +1237,7 @@ bytes_clause (unsigned size, unsigned learned)
     res += sizeof (Act);	/* add activity */
 
 #ifdef TRACE
-  if (trace)
+  if (ps->trace)
     res += sizeof (Trd);	/* add trace data */
 #endif
 
@@ -1246,14 +1258,14 @@ new_clause (unsigned size, unsigned learned)
   tmp = new (bytes);
 
 #ifdef TRACE
-  if (trace)
+  if (ps->trace)
     {
       trd = tmp;
 
       if (learned)
-	trd->idx = LIDX2IDX (lhead - lclauses);
+	trd->idx = LIDX2IDX (ps->lhead - ps->lclauses);
       else
-	trd->idx = OIDX2IDX (ohead - oclauses);
+	trd->idx = OIDX2IDX (ps->ohead - ps->oclauses);
 
       res = trd->cls;
     }
@@ -1279,7 +1291,7 @@ new_clause (unsigned size, unsigned learned)
 #endif
 
   if (learned && size > 2)
-    *CLS2ACT (res) = cinc;
+    *CLS2ACT (res) = ps->cinc;
 
   return res;
 }
@@ -1295,7 +1307,7 @@ delete_clause (Cls * cls)
   bytes = bytes_clause (cls->size, cls->learned);
 
 #ifdef TRACE
-  if (trace)
+  if (ps->trace)
     {
       trd = CLS2TRD (cls);
       delete (trd, bytes);
@@ -1313,10 +1325,10 @@ delete_clauses (void)
     if (*p)
       delete_clause (*p);
 
-  DELETEN (oclauses, eoo - oclauses);
-  DELETEN (lclauses, eol - lclauses);
+  DELETEN (ps->oclauses, ps->eoo - ps->oclauses);
+  DELETEN (ps->lclauses, ps->eol - ps->lclauses);
 
-  ohead = eoo = lhead = eol = 0;
+  ps->ohead = ps->eoo = ps->lhead = ps->eol = 0;
 }
 
 #ifdef TRACE
@@ -1339,12 +1351,12 @@ static void
 delete_zhains (void)
 {
   Zhn **p, *z;
-  for (p = zhains; p < zhead; p++)
+  for (p = ps->zhains; p < ps->zhead; p++)
     if ((z = *p))
       delete_zhain (z);
 
-  DELETEN (zhains, eoz - zhains);
-  eoz = zhead = 0;
+  DELETEN (ps->zhains, ps->eoz - ps->zhains);
+  ps->eoz = ps->zhead = 0;
 }
 
 #endif
@@ -1373,9 +1385,9 @@ llength (Lit ** a)
 static void
 resetadoconflict (void)
 {
-  assert (adoconflict);
-  delete_clause (adoconflict);
-  adoconflict = 0;
+  assert (ps->adoconflict);
+  delete_clause (ps->adoconflict);
+  ps->adoconflict = 0;
 }
 
 static void
@@ -1383,21 +1395,21 @@ reset_ados (void)
 {
   Lit *** p;
 
-  for (p = ados; p < hados; p++)
+  for (p = ps->ados; p < ps->hados; p++)
     DELETEN (*p, llength (*p) + 1);
 
-  DELETEN (ados, eados - ados);
-  hados = eados = 0;
+  DELETEN (ps->ados, ps->eados - ps->ados);
+  ps->hados = ps->eados = 0;
 
-  DELETEN (adotab, szadotab);
-  szadotab = nadotab = 0;
+  DELETEN (ps->adotab, ps->szadotab);
+  ps->szadotab = ps->nadotab = 0;
 
-  if (adoconflict)
+  if (ps->adoconflict)
     resetadoconflict ();
 
-  adoconflicts = 0;
-  adoconflictlimit = UINT_MAX;
-  adodisabled = 0;
+  ps->adoconflicts = 0;
+  ps->adoconflictlimit = UINT_MAX;
+  ps->adodisabled = 0;
 }
 
 #endif
@@ -1405,239 +1417,235 @@ reset_ados (void)
 static void
 reset (void)
 {
-  ABORTIF (state == RESET, "API usage: reset without initialization");
+  ABORTIF (ps->state == RESET, "API usage: reset without initialization");
 
   delete_clauses ();
 #ifdef TRACE
   delete_zhains ();
 #endif
 #ifdef NO_BINARY_CLAUSES
-  implvalid = 0;
-  cimplvalid = 0;
+  ps->implvalid = 0;
+  ps->cimplvalid = 0;
   {
     unsigned i;
-    for (i = 2; i <= 2 * max_var + 1; i++)
-      lrelease (impls + i);
+    for (i = 2; i <= 2 * ps->max_var + 1; i++)
+      lrelease (ps->impls + i);
   }
 #endif
 #ifndef NADC
   reset_ados ();
 #endif
 #ifndef NFL
-  DELETEN (saved, saved_size);
-  saved_size = 0;
+  DELETEN (ps->saved, ps->saved_size);
+  ps->saved_size = 0;
 #endif
-  DELETEN (htps, 2 * size_vars);
+  DELETEN (ps->htps, 2 * ps->size_vars);
 #ifndef NDSC
-  DELETEN (dhtps, 2 * size_vars);
+  DELETEN (ps->dhtps, 2 * ps->size_vars);
 #endif
-  DELETEN (impls, 2 * size_vars);
-  DELETEN (lits, 2 * size_vars);
-  DELETEN (jwh, 2 * size_vars);
-  DELETEN (vars, size_vars);
-  DELETEN (rnks, size_vars);
+  DELETEN (ps->impls, 2 * ps->size_vars);
+  DELETEN (ps->lits, 2 * ps->size_vars);
+  DELETEN (ps->jwh, 2 * ps->size_vars);
+  DELETEN (ps->vars, ps->size_vars);
+  DELETEN (ps->rnks, ps->size_vars);
 
-  DELETEN (trail, eot - trail);
-  trail = ttail = ttail2 = thead = eot = 0;
+  DELETEN (ps->trail, ps->eot - ps->trail);
+  ps->trail = ps->ttail = ps->ttail2 = ps->thead = ps->eot = 0;
 #ifndef NADC
-  ttailado = 0;
+  ps->ttailado = 0;
 #endif
 
-  DELETEN (heap, eoh - heap);
-  heap = hhead = eoh = 0;
+  DELETEN (ps->heap, ps->eoh - ps->heap);
+  ps->heap = ps->hhead = ps->eoh = 0;
 
-  DELETEN (als, eoals - als);
-  als = eoals = alshead = alstail = 0;
-  extracted_all_failed_assumptions = 0;
-  failed_assumption = 0;
-  adecidelevel = 0;
-  DELETEN (fals, eofals - fals);
-  fals = eofals = falshead = 0;
-  DELETEN (mass, szmass);
-  szmass = 0;
-  mass = 0;
+  DELETEN (ps->als, ps->eoals - ps->als);
+  ps->als = ps->eoals = ps->alshead = ps->alstail = 0;
+  ps->extracted_all_failed_assumptions = 0;
+  ps->failed_assumption = 0;
+  ps->adecidelevel = 0;
+  DELETEN (ps->fals, ps->eofals - ps->fals);
+  ps->fals = ps->eofals = ps->falshead = 0;
+  DELETEN (ps->mass, ps->szmass);
+  ps->szmass = 0;
+  ps->mass = 0;
 
-  size_vars = 0;
-  max_var = 0;
+  ps->size_vars = 0;
+  ps->max_var = 0;
 
-  mtcls = 0;
+  ps->mtcls = 0;
 #ifdef TRACE
-  ocore = -1;
+  ps->ocore = -1;
 #endif
-  conflict = 0;
+  ps->conflict = 0;
 
-  DELETEN (added, eoa - added);
-  eoa = ahead = 0;
+  DELETEN (ps->added, ps->eoa - ps->added);
+  ps->eoa = ps->ahead = 0;
 
-  DELETEN (marked, eom - marked);
-  eom = mhead = 0;
+  DELETEN (ps->marked, ps->eom - ps->marked);
+  ps->eom = ps->mhead = 0;
 
-  DELETEN (dfs, eod - dfs);
-  eod = dhead = 0;
+  DELETEN (ps->dfs, ps->eod - ps->dfs);
+  ps->eod = ps->dhead = 0;
 
-  DELETEN (resolved, eor - resolved);
-  eor = rhead = 0;
+  DELETEN (ps->resolved, ps->eor - ps->resolved);
+  ps->eor = ps->rhead = 0;
 
-  DELETEN (buffer, eob - buffer);
-  eob = bhead = 0;
+  DELETEN (ps->buffer, ps->eob - ps->buffer);
+  ps->eob = ps->bhead = 0;
 
-  DELETEN (indices, eoi - indices);
-  eoi = ihead = 0;
+  DELETEN (ps->indices, ps->eoi - ps->indices);
+  ps->eoi = ps->ihead = 0;
 
   delete_prefix ();
 
-  delete (rline[0], szrline);
-  delete (rline[1], szrline);
-  rline[0] = rline[1] = 0;
-  szrline = rcount = 0;
-  assert (getenv ("LEAK") || !current_bytes);	/* found leak if failing */
-  max_bytes = 0;
-  recycled = 0;
-  current_bytes = 0;
-
-  lrestart = 0;
-  lreduce = 0;
-  lastreduceconflicts = 0;
-  llocked = 0;
-  lsimplify = 0;
-  fsimplify = 0;
-
-  seconds = 0;
-  entered = 0;
-  nentered = 0;
-  measurealltimeinlib = 0;
-
-  levelsum = 0.0;
-  calls = 0;
-  decisions = 0;
-  restarts = 0;
-  simps = 0;
-  iterations = 0;
-  reports = 0;
-  lastrheader = -2;
-  fixed = 0;
+  delete (ps->rline[0], ps->szrline);
+  delete (ps->rline[1], ps->szrline);
+  ps->rline[0] = ps->rline[1] = 0;
+  ps->szrline = ps->rcount = 0;
+  assert (getenv ("LEAK") || !ps->current_bytes);	/* found leak if failing */
+  ps->max_bytes = 0;
+  ps->recycled = 0;
+  ps->current_bytes = 0;
+
+  ps->lrestart = 0;
+  ps->lreduce = 0;
+  ps->lastreduceconflicts = 0;
+  ps->llocked = 0;
+  ps->lsimplify = 0;
+  ps->fsimplify = 0;
+
+  ps->seconds = 0;
+  ps->entered = 0;
+  ps->nentered = 0;
+  ps->measurealltimeinlib = 0;
+
+  ps->levelsum = 0.0;
+  ps->calls = 0;
+  ps->decisions = 0;
+  ps->restarts = 0;
+  ps->simps = 0;
+  ps->iterations = 0;
+  ps->reports = 0;
+  ps->lastrheader = -2;
+  ps->fixed = 0;
 #ifndef NFL
-  failedlits = 0;
-  simplifying = 0;
-  fllimit = 0;
+  ps->failedlits = 0;
+  ps->simplifying = 0;
+  ps->fllimit = 0;
 #ifdef STATS
-  efailedlits = ifailedlits = 0;
-  fltried = flskipped = floopsed = 0;
-  flcalls = flrounds = 0;
-  flprops = 0;
-#endif
-#endif
-  propagations = 0;
-  conflicts = 0;
-  noclauses = 0;
-  oadded = 0;
-  lladded = 0;
-  loadded = 0;
-  olits = 0;
-  nlclauses = 0;
-  ladded = 0;
-  addedclauses = 0;
-  llits = 0;
-  out = 0;
+  ps->efailedlits = ps->ifailedlits = 0;
+  ps->fltried = ps->flskipped = ps->floopsed = 0;
+  ps->flcalls = ps->flrounds = 0;
+  ps->flprops = 0;
+#endif
+#endif
+  ps->propagations = 0;
+  ps->conflicts = 0;
+  ps->noclauses = 0;
+  ps->oadded = 0;
+  ps->lladded = 0;
+  ps->loadded = 0;
+  ps->olits = 0;
+  ps->nlclauses = 0;
+  ps->ladded = 0;
+  ps->addedclauses = 0;
+  ps->llits = 0;
+  ps->out = 0;
 #ifdef TRACE
-  trace = 0;
+  ps->trace = 0;
 #endif
-  rup = 0;
-  rupstarted = 0;
-  rupclauses = 0;
-  rupvariables = 0;
-  level = 0;
+  ps->rup = 0;
+  ps->rupstarted = 0;
+  ps->rupclauses = 0;
+  ps->rupvariables = 0;
+  ps->level = 0;
 
-  reductions = 0;
+  ps->reductions = 0;
 
-  vused = 0;
-  llitsadded = 0;
+  ps->vused = 0;
+  ps->llitsadded = 0;
 #ifdef STATS
-  loused = 0;
-  llused = 0;
-  visits = 0;
-  bvisits = 0;
-  tvisits = 0;
-  lvisits = 0;
-  othertrue = 0;
-  othertrue2 = 0;
-  othertruel = 0;
-  othertrue2u = 0;
-  othertruelu = 0;
-  ltraversals = 0;
-  traversals = 0;
+  ps->loused = 0;
+  ps->llused = 0;
+  ps->visits = 0;
+  ps->bvisits = 0;
+  ps->tvisits = 0;
+  ps->lvisits = 0;
+  ps->othertrue = 0;
+  ps->othertrue2 = 0;
+  ps->othertruel = 0;
+  ps->othertrue2u = 0;
+  ps->othertruelu = 0;
+  ps->ltraversals = 0;
+  ps->traversals = 0;
 #ifndef NO_BINARY_CLAUSES
-  antecedents = 0;
-#endif
-  znts = 0;
-  uips = 0;
-  assumptions = 0;
-  rdecisions = 0;
-  sdecisions = 0;
-  srecycled = 0;
-  rrecycled = 0;
-#endif
-  minimizedllits = 0;
-  nonminimizedllits = 0;
-  state = RESET;
-  srng = 0;
-
-  saved_flips = 0;
-  saved_max_var = 0;
-  min_flipped = UINT_MAX;
-
-  flips = 0;
+  ps->antecedents = 0;
+#endif
+  ps->znts = 0;
+  ps->uips = 0;
+  ps->assumptions = 0;
+  ps->rdecisions = 0;
+  ps->sdecisions = 0;
+  ps->srecycled = 0;
+  ps->rrecycled = 0;
+#endif
+  ps->minimizedllits = 0;
+  ps->nonminimizedllits = 0;
+  ps->state = RESET;
+  ps->srng = 0;
+
+  ps->saved_flips = 0;
+  ps->saved_max_var = 0;
+  ps->min_flipped = UINT_MAX;
+
+  ps->flips = 0;
 #ifdef STATS
-  forced = 0;
-  assignments = 0;
+  ps->forced = 0;
+  ps->assignments = 0;
 #endif
 
-  sdflips = 0;
-  defaultphase = 2;
+  ps->sdflips = 0;
+  ps->defaultphase = 2;
 
 #ifdef STATS
-  staticphasedecisions = 0;
-  inclreduces = 0;
-  skippedrestarts = 0;
+  ps->staticphasedecisions = 0;
+  ps->inclreduces = 0;
+  ps->skippedrestarts = 0;
 #endif
 
-  emgr = 0;
-  enew = 0;
-  eresize = 0;
-  edelete = 0;
 #ifdef VISCORES
-  pclose (fviscores);
-  fviscores = 0;
+  pclose (ps->fviscores);
+  ps->fviscores = 0;
 #endif
 }
 
 inline static void
 tpush (Lit * lit)
 {
-  assert (lits < lit && lit <= lits + 2* max_var + 1);
-  if (thead == eot)
+  assert (ps->lits < lit && lit <= ps->lits + 2* ps->max_var + 1);
+  if (ps->thead == ps->eot)
     {
-      unsigned ttail2count = ttail2 - trail;
-      unsigned ttailcount = ttail - trail;
+      unsigned ttail2count = ps->ttail2 - ps->trail;
+      unsigned ttailcount = ps->ttail - ps->trail;
 #ifndef NADC
-      unsigned ttailadocount = ttailado - trail;
+      unsigned ttailadocount = ps->ttailado - ps->trail;
 #endif
-      ENLARGE (trail, thead, eot);
-      ttail = trail + ttailcount;
-      ttail2 = trail + ttail2count;
+      ENLARGE (ps->trail, ps->thead, ps->eot);
+      ps->ttail = ps->trail + ttailcount;
+      ps->ttail2 = ps->trail + ttail2count;
 #ifndef NADC
-      ttailado = trail + ttailadocount;
+      ps->ttailado = ps->trail + ttailadocount;
 #endif
     }
 
-  *thead++ = lit;
+  *ps->thead++ = lit;
 }
 
 static void
 assign_reason (Var * v, Cls * reason)
 {
 #ifdef NO_BINARY_CLAUSES
-  assert (reason != &impl);
+  assert (reason != &ps->impl);
 #endif
   v->reason = reason;
 }
@@ -1653,26 +1661,26 @@ assign_phase (Lit * lit)
    * we force assignments on the top level.   The other assignments will be
    * undone and thus we can keep the old saved value of the phase.
    */
-  if (!level || !simplifying)
+  if (!ps->level || !ps->simplifying)
 #endif
     {
       new_phase = (LIT2SGN (lit) > 0);
 
       if (v->assigned)
 	{
-	  sdflips -= sdflips/FFLIPPED;
+	  ps->sdflips -= ps->sdflips/FFLIPPED;
 
 	  if (new_phase != v->phase)
 	    {
 	      assert (FFLIPPEDPREC >= FFLIPPED);
-	      sdflips += FFLIPPEDPREC / FFLIPPED;
-	      flips++;
+	      ps->sdflips += FFLIPPEDPREC / FFLIPPED;
+	      ps->flips++;
 
 	      idx = lit2idx (lit);
-	      if (idx < min_flipped)
-		min_flipped = idx;
+	      if (idx < ps->min_flipped)
+		ps->min_flipped = idx;
 
-	      NOLOG (fprintf (out, "%sflipped %d\n", prefix, lit2int (lit)));
+	      NOLOG (fprintf (ps->out, "%sflipped %d\n", ps->prefix, lit2int (lit)));
 	    }
 	}
 
@@ -1690,9 +1698,9 @@ assign (Lit * lit, Cls * reason)
   Var * v = LIT2VAR (lit);
   assert (lit->val == UNDEF);
 #ifdef STATS
-  assignments++;
+  ps->assignments++;
 #endif
-  v->level = level;
+  v->level = ps->level;
   assign_phase (lit);
   assign_reason (v, reason);
   tpush (lit);
@@ -1756,45 +1764,45 @@ sortlits (Lit ** v, unsigned size)
 static Cls *
 setimpl (Lit * a, Lit * b)
 {
-  assert (!implvalid);
-  assert (impl.size == 2);
+  assert (!ps->implvalid);
+  assert (ps->impl.size == 2);
 
-  impl.lits[0] = a;
-  impl.lits[1] = b;
+  ps->impl.lits[0] = a;
+  ps->impl.lits[1] = b;
 
-  sorttwolits (impl.lits);
-  implvalid = 1;
+  sorttwolits (ps->impl.lits);
+  ps->implvalid = 1;
 
-  return &impl;
+  return &ps->impl;
 }
 
 static void
 resetimpl (void)
 {
-  assert (implvalid);
-  implvalid = 0;
+  assert (ps->implvalid);
+  ps->implvalid = 0;
 }
 
 static Cls *
 setcimpl (Lit * a, Lit * b)
 {
-  assert (!cimplvalid);
-  assert (cimpl.size == 2);
+  assert (!ps->cimplvalid);
+  assert (ps->cimpl.size == 2);
 
-  cimpl.lits[0] = a;
-  cimpl.lits[1] = b;
+  ps->cimpl.lits[0] = a;
+  ps->cimpl.lits[1] = b;
 
-  sorttwolits (cimpl.lits);
-  cimplvalid = 1;
+  sorttwolits (ps->cimpl.lits);
+  ps->cimplvalid = 1;
 
-  return &cimpl;
+  return &ps->cimpl;
 }
 
 static void
 resetcimpl (void)
 {
-  assert (cimplvalid);
-  cimplvalid = 0;
+  assert (ps->cimplvalid);
+  ps->cimplvalid = 0;
 }
 
 #endif
@@ -1836,31 +1844,31 @@ hup (Rnk * v)
   Rnk *u;
 
 #ifndef NFL
-  assert (!simplifying);
+  assert (!ps->simplifying);
 #endif
 
   vpos = v->pos;
 
   assert (0 < vpos);
-  assert (vpos < hhead - heap);
-  assert (heap[vpos] == v);
+  assert (vpos < ps->hhead - ps->heap);
+  assert (ps->heap[vpos] == v);
 
   while (vpos > 1)
     {
       upos = vpos / 2;
 
-      u = heap[upos];
+      u = ps->heap[upos];
 
       if (cmp_rnk (u, v) > 0)
 	break;
 
-      heap[vpos] = u;
+      ps->heap[vpos] = u;
       u->pos = vpos;
 
       vpos = upos;
     }
 
-  heap[vpos] = v;
+  ps->heap[vpos] = v;
   v->pos = vpos;
 }
 
@@ -1875,18 +1883,18 @@ add_antecedent (Cls * c)
   if (ISLITREASON (c))
     return;
 
-  if (c == &impl)
+  if (c == &ps->impl)
     return;
 #else
 #ifdef STATS
-  antecedents++;
+  ps->antecedents++;
 #endif
 #endif
-  if (rhead == eor)
-    ENLARGE (resolved, rhead, eor);
+  if (ps->rhead == ps->eor)
+    ENLARGE (ps->resolved, ps->rhead, ps->eor);
 
-  assert (rhead < eor);
-  *rhead++ = c;
+  assert (ps->rhead < ps->eor);
+  *ps->rhead++ = c;
 }
 
 #ifdef TRACE
@@ -1902,19 +1910,19 @@ add_lit (Lit * lit)
 {
   assert (lit);
 
-  if (ahead == eoa)
-    ENLARGE (added, ahead, eoa);
+  if (ps->ahead == ps->eoa)
+    ENLARGE (ps->added, ps->ahead, ps->eoa);
 
-  *ahead++ = lit;
+  *ps->ahead++ = lit;
 }
 
 static void
 push_var_as_marked (Var * v)
 {
-  if (mhead == eom)
-    ENLARGE (marked, mhead, eom);
+  if (ps->mhead == ps->eom)
+    ENLARGE (ps->marked, ps->mhead, ps->eom);
 
-  *mhead++ = v;
+  *ps->mhead++ = v;
 }
 
 static void
@@ -1936,8 +1944,8 @@ resolve_top_level_unit (Lit * lit, Cls * reason)
   Lit **p, **eol, *other;
   Var *u, *v;
 
-  assert (rhead == resolved);
-  assert (ahead == added);
+  assert (ps->rhead == ps->resolved);
+  assert (ps->ahead == ps->added);
 
   add_lit (lit);
   add_antecedent (reason);
@@ -1962,14 +1970,14 @@ resolve_top_level_unit (Lit * lit, Cls * reason)
   if (count_resolved >= 2)
     {
 #ifdef NO_BINARY_CLAUSES
-      if (reason == &impl)
+      if (reason == &ps->impl)
 	resetimpl ();
 #endif
       reason = add_simplified_clause (1);
 #ifdef NO_BINARY_CLAUSES
       if (reason->size == 2)
 	{
-	  assert (reason == &impl);
+	  assert (reason == &ps->impl);
 	  other = reason->lits[0];
 	  if (lit == other)
 	    other = reason->lits[1];
@@ -1982,8 +1990,8 @@ resolve_top_level_unit (Lit * lit, Cls * reason)
     }
   else
     {
-      ahead = added;
-      rhead = resolved;
+      ps->ahead = ps->added;
+      ps->rhead = ps->resolved;
     }
 
   return reason;
@@ -1997,13 +2005,13 @@ fixvar (Var * v)
   assert (VAR2LIT (v) != UNDEF);
   assert (!v->level);
 
-  fixed++;
+  ps->fixed++;
 
   r = VAR2RNK (v);
   r->score = INFFLT;
 
 #ifndef NFL
-  if (simplifying)
+  if (ps->simplifying)
     return;
 #endif
 
@@ -2020,7 +2028,7 @@ use_var (Var * v)
     return;
 
   v->used = 1;
-  vused++;
+  ps->vused++;
 }
 
 static void
@@ -2032,29 +2040,29 @@ assign_forced (Lit * lit, Cls * reason)
   assert (lit->val == UNDEF);
 
 #ifdef STATS
-  forced++;
+  ps->forced++;
 #endif
   assign (lit, reason);
 
 #ifdef NO_BINARY_CLAUSES
-  assert (reason != &impl);
+  assert (reason != &ps->impl);
   if (ISLITREASON (reason))
     reason = setimpl (lit, NOTLIT (REASON2LIT (reason)));
 #endif
-  LOG (fprintf (out,
+  LOG (fprintf (ps->out,
                 "%sassign %d at level %d by ",
-                prefix, lit2int (lit), level);
+                ps->prefix, lit2int (lit), ps->level);
        dumpclsnl (reason));
 
   v = LIT2VAR (lit);
-  if (!level)
+  if (!ps->level)
     use_var (v);
 
-  if (reason && !level && reason->size > 1)
+  if (reason && !ps->level && reason->size > 1)
     reason = resolve_top_level_unit (lit, reason);
 
 #ifdef NO_BINARY_CLAUSES
-  if (ISLITREASON (reason) || reason == &impl)
+  if (ISLITREASON (reason) || reason == &ps->impl)
     {
       /* DO NOTHING */
     }
@@ -2065,15 +2073,15 @@ assign_forced (Lit * lit, Cls * reason)
       assert (!reason->locked);
       reason->locked = 1;
       if (reason->learned && reason->size > 2)
-	llocked++;
+	ps->llocked++;
     }
 
 #ifdef NO_BINARY_CLAUSES
-  if (reason == &impl)
+  if (reason == &ps->impl)
     resetimpl ();
 #endif
 
-  if (!level)
+  if (!ps->level)
     fixvar (v);
 }
 
@@ -2144,18 +2152,18 @@ connect_head_tail (Lit * lit, Cls * cls)
 static void
 zpush (Zhn * zhain)
 {
-  assert (trace);
+  assert (ps->trace);
 
-  if (zhead == eoz)
-    ENLARGE (zhains, zhead, eoz);
+  if (ps->zhead == ps->eoz)
+    ENLARGE (ps->zhains, ps->zhead, ps->eoz);
 
-  *zhead++ = zhain;
+  *ps->zhead++ = zhain;
 }
 
 static int
 cmp_resolved (Cls * c, Cls * d)
 {
-  assert (trace);
+  assert (ps->trace);
 
   return CLS2IDX (c) - CLS2IDX (d);
 }
@@ -2163,10 +2171,10 @@ cmp_resolved (Cls * c, Cls * d)
 static void
 bpushc (unsigned char ch)
 {
-  if (bhead == eob)
-    ENLARGE (buffer, bhead, eob);
+  if (ps->bhead == ps->eob)
+    ENLARGE (ps->buffer, ps->bhead, ps->eob);
 
-  *bhead++ = ch;
+  *ps->bhead++ = ch;
 }
 
 static void
@@ -2193,19 +2201,19 @@ bpushd (unsigned prev, unsigned this)
 static void
 add_zhain (void)
 {
-  unsigned prev, this, count, rcount;
+  unsigned prev, this, count, ps->rcount;
   Cls **p, *c;
   Zhn *res;
 
-  assert (trace);
-  assert (bhead == buffer);
-  assert (rhead > resolved);
+  assert (ps->trace);
+  assert (ps->bhead == ps->buffer);
+  assert (ps->rhead > ps->resolved);
 
-  rcount = rhead - resolved;
-  sort (Cls *, cmp_resolved, resolved, rcount);
+  ps->rcount = ps->rhead - ps->resolved;
+  sort (Cls *, cmp_resolved, ps->resolved, ps->rcount);
 
   prev = 0;
-  for (p = resolved; p < rhead; p++)
+  for (p = ps->resolved; p < ps->rhead; p++)
     {
       c = *p;
       this = CLS2TRD (c)->idx;
@@ -2214,16 +2222,16 @@ add_zhain (void)
     }
   bpushc (0);
 
-  count = bhead - buffer;
+  count = ps->bhead - ps->buffer;
 
   res = new (sizeof (Zhn) + count);
   res->core = 0;
   res->ref = 0;
-  memcpy (res->znt, buffer, count);
+  memcpy (res->znt, ps->buffer, count);
 
-  bhead = buffer;
+  ps->bhead = ps->buffer;
 #ifdef STATS
-  znts += count - 1;
+  ps->znts += count - 1;
 #endif
   zpush (res);
 }
@@ -2236,7 +2244,7 @@ add_resolved (int learned)
 #if defined(STATS) || defined(TRACE)
   Cls **p, *c;
 
-  for (p = resolved; p < rhead; p++)
+  for (p = ps->resolved; p < ps->rhead; p++)
     {
       c = *p;
       if (c->used)
@@ -2249,20 +2257,20 @@ add_resolved (int learned)
 
 #ifdef STATS
       if (c->learned)
-	llused++;
+	ps->llused++;
       else
-	loused++;
+	ps->loused++;
 #endif
     }
 #endif
 
 #ifdef TRACE
-  if (learned && trace)
+  if (learned && ps->trace)
     add_zhain ();
 #else
   (void) learned;
 #endif
-  rhead = resolved;
+  ps->rhead = ps->resolved;
 }
 
 static void
@@ -2281,7 +2289,7 @@ incjwh (Cls * cls)
       lit = *p;
       val = lit->val;
 
-      if (val && level > 0)
+      if (val && ps->level > 0)
 	{
 	  v = LIT2VAR (lit);
 	  if (v->level > 0)
@@ -2312,7 +2320,7 @@ write_rup_header (FILE * file)
   char line[80];
   int i;
 
-  sprintf (line, "%%RUPD32 %u %u", rupvariables, rupclauses);
+  sprintf (line, "%%RUPD32 %u %u", ps->rupvariables, ps->rupclauses);
 
   fputs (line, file);
   for (i = 255 - strlen (line); i >= 0; i--)
@@ -2368,48 +2376,48 @@ add_simplified_clause (int learned)
 
 REENTER:
 
-  size = ahead - added;
+  size = ps->ahead - ps->added;
 
   add_resolved (learned);
 
   if (learned)
     {
-      ladded++;
-      llitsadded += size;
+      ps->ladded++;
+      ps->llitsadded += size;
       if (size > 2)
 	{
-	  lladded++;
-	  nlclauses++;
-	  llits += size;
+	  ps->lladded++;
+	  ps->nlclauses++;
+	  ps->llits += size;
 	}
     }
   else
     {
-      oadded++;
+      ps->oadded++;
       if (size > 2)
 	{
-	  loadded++;
-	  noclauses++;
-	  olits += size;
+	  ps->loadded++;
+	  ps->noclauses++;
+	  ps->olits += size;
 	}
     }
 
-  addedclauses++;
-  assert (addedclauses == ladded + oadded);
+  ps->addedclauses++;
+  assert (ps->addedclauses == ps->ladded + ps->oadded);
 
 #ifdef NO_BINARY_CLAUSES
   if (size == 2)
-    res = setimpl (added[0], added[1]);
+    res = setimpl (ps->added[0], ps->added[1]);
   else
 #endif
     {
-      sortlits (added, size); 
+      sortlits (ps->added, size); 
 
       if (learned)
 	{
-	  if (lhead == eol)
+	  if (ps->lhead == ps->eol)
 	    {
-	      ENLARGE (lclauses, lhead, eol);
+	      ENLARGE (ps->lclauses, ps->lhead, ps->eol);
 
 	      /* A very difficult to find bug, which only occurs if the
 	       * learned clauses stack is immediately allocated before the
@@ -2421,65 +2429,65 @@ REENTER:
 	       * perftools in the context of one large benchmark for 
 	       * 'boolector'.
 	       */
-	      if (eol == oclauses)
-		ENLARGE (lclauses, lhead, eol);
+	      if (ps->eol == ps->oclauses)
+		ENLARGE (ps->lclauses, ps->lhead, ps->eol);
 	    }
 
-	  idx = LIDX2IDX (lhead - lclauses);
+	  idx = LIDX2IDX (ps->lhead - ps->lclauses);
 	}
       else
 	{
-	  if (ohead == eoo)
+	  if (ps->ohead == ps->eoo)
 	    {
-	      ENLARGE (oclauses, ohead, eoo);
-	      if (eol == oclauses)
-		ENLARGE (oclauses, ohead, eoo);	/* dito */
+	      ENLARGE (ps->oclauses, ps->ohead, ps->eoo);
+	      if (ps->eol == ps->oclauses)
+		ENLARGE (ps->oclauses, ps->ohead, ps->eoo);	/* dito */
 	    }
 
-	  idx = OIDX2IDX (ohead - oclauses);
+	  idx = OIDX2IDX (ps->ohead - ps->oclauses);
 	}
 
-      assert (eol != oclauses);			/* dito */
+      assert (ps->eol != ps->oclauses);			/* dito */
 
       res = new_clause (size, learned);
 
 #if !defined(NDEBUG) && defined(TRACE)
-      if (trace)
+      if (ps->trace)
 	assert (CLS2IDX (res) == idx);
 #endif
       if (learned)
-	*lhead++ = res;
+	*ps->lhead++ = res;
       else
-	*ohead++ = res;
+	*ps->ohead++ = res;
 
 #if !defined(NDEBUG) && defined(TRACE)
-      if (trace && learned)
-	assert (zhead - zhains == lhead - lclauses);
+      if (ps->trace && learned)
+	assert (ps->zhead - ps->zhains == ps->lhead - ps->lclauses);
 #endif
-      assert (lhead != oclauses);		/* dito */
+      assert (ps->lhead != ps->oclauses);		/* dito */
     }
 
-  if (learned && rup)
+  if (learned && ps->rup)
     {
-      if (!rupstarted)
+      if (!ps->rupstarted)
 	{
-	  write_rup_header (rup);
-	  rupstarted = 1;
+	  write_rup_header (ps->rup);
+	  ps->rupstarted = 1;
 	}
     }
 
   num_true = num_undef = num_false = 0;
 
   q = res->lits;
-  for (p = added; p < ahead; p++)
+  for (p = ps->added; p < ps->ahead; p++)
     {
       lit = *p;
       *q++ = lit;
 
-      if (learned && rup)
+      if (learned && ps->rup)
 	{
-	  write_int (lit2int (lit), rup);
-	  fputc (' ', rup);
+	  write_int (lit2int (lit), ps->rup);
+	  fputc (' ', ps->rup);
 	}
 
       val = lit->val;
@@ -2492,10 +2500,10 @@ REENTER:
     }
   assert (num_false + num_true + num_undef == size);
 
-  if (learned && rup)
-    fputs ("0\n", rup);
+  if (learned && ps->rup)
+    fputs ("0\n", ps->rup);
 
-  ahead = added;		/* reset */
+  ps->ahead = ps->added;		/* reset */
 
   if (size > 0)
     {
@@ -2506,8 +2514,8 @@ REENTER:
 
   if (size == 0)
     {
-      if (!mtcls)
-	mtcls = res;
+      if (!ps->mtcls)
+	ps->mtcls = res;
     }
 
 #ifdef NO_BINARY_CLAUSES
@@ -2517,15 +2525,15 @@ REENTER:
     res->connected = 1;
 #endif
 
-  LOG (fprintf (out, "%s%s ", prefix, learned ? "learned" : "original");
+  LOG (fprintf (ps->out, "%s%s ", ps->prefix, learned ? "learned" : "original");
        dumpclsnl (res));
 
   /* Shrink clause by resolving it against top level assignments.
    */
-  if (!level && num_false > 0)
+  if (!ps->level && num_false > 0)
     {
-      assert (ahead == added);
-      assert (rhead == resolved);
+      assert (ps->ahead == ps->added);
+      assert (ps->rhead == ps->resolved);
 
       count_resolved = 1;
       add_antecedent (res);
@@ -2550,7 +2558,7 @@ REENTER:
 
       learned = 1;
 #ifdef NO_BINARY_CLAUSES
-      if (res == &impl)
+      if (res == &ps->impl)
 	resetimpl ();
 #endif
       goto REENTER;		/* and return simplified clause */
@@ -2585,21 +2593,21 @@ REENTER:
       num_true++;
     }
 
-  if (num_false == size && !conflict)
+  if (num_false == size && !ps->conflict)
     {
 #ifdef NO_BINARY_CLAUSES
-      if (res == &impl)
-	conflict = setcimpl (res->lits[0], res->lits[1]);
+      if (res == &ps->impl)
+	ps->conflict = setcimpl (res->lits[0], res->lits[1]);
       else
 #endif
-      conflict = res;
+      ps->conflict = res;
     }
 
   if (!learned && !num_true && num_undef)
     incjwh (res);
 
 #ifdef NO_BINARY_CLAUSES
-  if (res == &impl)
+  if (res == &ps->impl)
     resetimpl ();
 #endif
   return res;
@@ -2611,11 +2619,11 @@ trivial_clause (void)
   Lit **p, **q, *prev;
   Var *v;
 
-  sort (Lit *, cmp_ptr, added,  ahead - added);
+  sort (Lit *, cmp_ptr, ps->added,  ps->ahead - ps->added);
 
   prev = 0;
-  q = added;
-  for (p = q; p < ahead; p++)
+  q = ps->added;
+  for (p = q; p < ps->ahead; p++)
     {
       Lit *this = *p;
 
@@ -2635,7 +2643,7 @@ trivial_clause (void)
       *q++ = prev = this;
     }
 
-  ahead = q;			/* shrink */
+  ps->ahead = q;			/* shrink */
 
   return 0;
 }
@@ -2647,21 +2655,21 @@ simplify_and_add_original_clause (void)
 
   if (trivial_clause ())
     {
-      ahead = added;
+      ps->ahead = ps->added;
 
-      if (ohead == eoo)
-	ENLARGE (oclauses, ohead, eoo);
+      if (ps->ohead == ps->eoo)
+	ENLARGE (ps->oclauses, ps->ohead, ps->eoo);
 
-      *ohead++ = 0;
+      *ps->ohead++ = 0;
 
-      addedclauses++;
-      oadded++;
+      ps->addedclauses++;
+      ps->oadded++;
     }
   else
     {
       cls = add_simplified_clause (0);
 #ifdef NO_BINARY_CLAUSES
-      if (cls == &impl)
+      if (cls == &ps->impl)
 	resetimpl ();
 #endif
     }
@@ -2672,27 +2680,27 @@ simplify_and_add_original_clause (void)
 static void
 add_ado (void)
 {
-  unsigned len = ahead - added;
+  unsigned len = ps->ahead - ps->added;
   Lit ** ado, ** p, ** q, *lit;
   Var * v, * u;
 
 #ifdef TRACE
-  assert (!trace);
+  assert (!ps->trace);
 #endif
 
-  ABORTIF (ados < hados && llength (ados[0]) != len,
+  ABORTIF (ps->ados < ps->hados && llength (ps->ados[0]) != len,
            "internal: non matching all different constraint object lengths");
 
-  if (hados == eados)
-    ENLARGE (ados, hados, eados);
+  if (ps->hados == ps->eados)
+    ENLARGE (ps->ados, ps->hados, ps->eados);
 
   NEWN (ado, len + 1);
-  *hados++ = ado;
+  *ps->hados++ = ado;
 
-  p = added;
+  p = ps->added;
   q = ado;
   u = 0;
-  while (p < ahead)
+  while (p < ps->ahead)
     {
       lit = *p++;
       v = LIT2VAR (lit);
@@ -2718,7 +2726,7 @@ add_ado (void)
   assert (!u->ado);
   u->ado = ado;
 
-  ahead = added;
+  ps->ahead = ps->added;
 }
 
 #endif
@@ -2730,9 +2738,9 @@ hdown (Rnk * r)
   Rnk *child, *other;
 
   assert (r->pos > 0);
-  assert (heap[r->pos] == r);
+  assert (ps->heap[r->pos] == r);
 
-  end = hhead - heap;
+  end = ps->hhead - ps->heap;
   rpos = r->pos;
 
   for (;;)
@@ -2742,13 +2750,13 @@ hdown (Rnk * r)
 	break;
 
       opos = cpos + 1;
-      child = heap[cpos];
+      child = ps->heap[cpos];
 
       if (cmp_rnk (r, child) < 0)
 	{
 	  if (opos < end)
 	    {
-	      other = heap[opos];
+	      other = ps->heap[opos];
 
 	      if (cmp_rnk (child, other) < 0)
 		{
@@ -2759,7 +2767,7 @@ hdown (Rnk * r)
 	}
       else if (opos < end)
 	{
-	  child = heap[opos];
+	  child = ps->heap[opos];
 
 	  if (cmp_rnk (r, child) >= 0)
 	    break;
@@ -2769,20 +2777,20 @@ hdown (Rnk * r)
       else
 	break;
 
-      heap[rpos] = child;
+      ps->heap[rpos] = child;
       child->pos = rpos;
       rpos = cpos;
     }
 
   r->pos = rpos;
-  heap[rpos] = r;
+  ps->heap[rpos] = r;
 }
 
 static Rnk *
 htop (void)
 {
-  assert (hhead > heap);
-  return heap[1];
+  assert (ps->hhead > ps->heap);
+  return ps->heap[1];
 }
 
 static Rnk *
@@ -2791,18 +2799,18 @@ hpop (void)
   Rnk *res, *last;
   unsigned end;
 
-  assert (hhead > heap);
+  assert (ps->hhead > ps->heap);
 
-  res = heap[1];
+  res = ps->heap[1];
   res->pos = 0;
 
-  end = --hhead - heap;
+  end = --ps->hhead - ps->heap;
   if (end == 1)
     return res;
 
-  last = heap[end];
+  last = ps->heap[end];
 
-  heap[last->pos = 1] = last;
+  ps->heap[last->pos = 1] = last;
   hdown (last);
 
   return res;
@@ -2813,11 +2821,11 @@ hpush (Rnk * r)
 {
   assert (!r->pos);
 
-  if (hhead == eoh)
-    ENLARGE (heap, hhead, eoh);
+  if (ps->hhead == ps->eoh)
+    ENLARGE (ps->heap, ps->hhead, ps->eoh);
 
-  r->pos = hhead++ - heap;
-  heap[r->pos] = r;
+  r->pos = ps->hhead++ - ps->heap;
+  ps->heap[r->pos] = r;
   hup (r);
 }
 
@@ -2825,7 +2833,7 @@ static void
 fix_trail_lits (long delta)
 {
   Lit **p;
-  for (p = trail; p < thead; p++)
+  for (p = ps->trail; p < ps->thead; p++)
     *p += delta;
 }
 
@@ -2836,7 +2844,7 @@ fix_impl_lits (long delta)
   Ltk * s;
   Lit ** p;
 
-  for (s = impls + 2; s < impls + 2 * max_var; s++)
+  for (s = ps->impls + 2; s <= ps->impls + 2 * ps->max_var + 1; s++)
     for (p = s->start; p < s->start + s->count; p++)
       *p += delta;
 }
@@ -2870,7 +2878,7 @@ static void
 fix_added_lits (long delta)
 {
   Lit **p;
-  for (p = added; p < ahead; p++)
+  for (p = ps->added; p < ps->ahead; p++)
     *p += delta;
 }
 
@@ -2878,7 +2886,7 @@ static void
 fix_assumed_lits (long delta)
 {
   Lit **p;
-  for (p = als; p < alshead; p++)
+  for (p = ps->als; p < ps->alshead; p++)
     *p += delta;
 }
 
@@ -2887,7 +2895,7 @@ fix_heap_rnks (long delta)
 {
   Rnk **p;
 
-  for (p = heap + 1; p < hhead; p++)
+  for (p = ps->heap + 1; p < ps->hhead; p++)
     *p += delta;
 }
 
@@ -2906,7 +2914,7 @@ fix_ados (long delta)
 {
   Lit *** p;
 
-  for (p = ados; p < hados; p++)
+  for (p = ps->ados; p < ps->hados; p++)
     fix_ado (delta, *p);
 }
 
@@ -2916,23 +2924,23 @@ static void
 enlarge (unsigned new_size_vars)
 {
   long rnks_delta, lits_delta, vars_delta;
-  Lit *old_lits = lits;
-  Rnk *old_rnks = rnks;
-  Var *old_vars = vars;
+  Lit *old_lits = ps->lits;
+  Rnk *old_rnks = ps->rnks;
+  Var *old_vars = ps->vars;
 
-  RESIZEN (lits, 2 * size_vars, 2 * new_size_vars);
-  RESIZEN (jwh, 2 * size_vars, 2 * new_size_vars);
-  RESIZEN (htps, 2 * size_vars, 2 * new_size_vars);
+  RESIZEN (ps->lits, 2 * ps->size_vars, 2 * new_size_vars);
+  RESIZEN (ps->jwh, 2 * ps->size_vars, 2 * new_size_vars);
+  RESIZEN (ps->htps, 2 * ps->size_vars, 2 * new_size_vars);
 #ifndef NDSC
-  RESIZEN (dhtps, 2 * size_vars, 2 * new_size_vars);
+  RESIZEN (ps->dhtps, 2 * ps->size_vars, 2 * new_size_vars);
 #endif
-  RESIZEN (impls, 2 * size_vars, 2 * new_size_vars);
-  RESIZEN (vars, size_vars, new_size_vars);
-  RESIZEN (rnks, size_vars, new_size_vars);
+  RESIZEN (ps->impls, 2 * ps->size_vars, 2 * new_size_vars);
+  RESIZEN (ps->vars, ps->size_vars, new_size_vars);
+  RESIZEN (ps->rnks, ps->size_vars, new_size_vars);
 
-  lits_delta = lits - old_lits;
-  rnks_delta = rnks - old_rnks;
-  vars_delta = vars - old_vars;
+  lits_delta = ps->lits - old_lits;
+  rnks_delta = ps->rnks - old_rnks;
+  vars_delta = ps->vars - old_vars;
 
   fix_trail_lits (lits_delta);
   fix_clause_lits (lits_delta);
@@ -2945,9 +2953,9 @@ enlarge (unsigned new_size_vars)
   fix_ados (lits_delta);
 #endif
   fix_heap_rnks (rnks_delta);
-  assert (mhead == marked);
+  assert (ps->mhead == ps->marked);
 
-  size_vars = new_size_vars;
+  ps->size_vars = new_size_vars;
 }
 
 static void
@@ -2959,13 +2967,13 @@ unassign (Lit * lit)
 
   assert (lit->val == TRUE);
 
-  LOG (fprintf (out, "%sunassign %d\n", prefix, lit2int (lit)));
+  LOG (fprintf (ps->out, "%sunassign %d\n", ps->prefix, lit2int (lit)));
 
   v = LIT2VAR (lit);
   reason = v->reason;
 
 #ifdef NO_BINARY_CLAUSES
-  assert (reason != &impl);
+  assert (reason != &ps->impl);
   if (ISLITREASON (reason))
     {
       /* DO NOTHING */
@@ -2978,8 +2986,8 @@ unassign (Lit * lit)
       reason->locked = 0;
       if (reason->learned && reason->size > 2)
 	{
-	  assert (llocked > 0);
-	  llocked--;
+	  assert (ps->llocked > 0);
+	  ps->llocked--;
 	}
     }
 
@@ -3024,13 +3032,13 @@ unassign (Lit * lit)
 #ifndef NADC
   if (v->adotabpos)
     {
-      assert (nadotab);
+      assert (ps->nadotab);
       assert (*v->adotabpos == v->ado);
 
       *v->adotabpos = 0;
       v->adotabpos = 0;
 
-      nadotab--;
+      ps->nadotab--;
     }
 #endif
 }
@@ -3069,42 +3077,42 @@ undo (unsigned new_level)
   Lit *lit;
   Var *v;
 
-  while (thead > trail)
+  while (ps->thead > ps->trail)
     {
-      lit = *--thead;
+      lit = *--ps->thead;
       v = LIT2VAR (lit);
       if (v->level == new_level)
 	{
-	  thead++;		/* fix pre decrement */
+	  ps->thead++;		/* fix pre decrement */
 	  break;
 	}
 
       unassign (lit);
     }
 
-  level = new_level;
-  ttail = thead;
-  ttail2 = thead;
+  ps->level = new_level;
+  ps->ttail = ps->thead;
+  ps->ttail2 = ps->thead;
 #ifndef NADC
-  ttailado = thead;
+  ps->ttailado = ps->thead;
 #endif
 
 #ifdef NO_BINARY_CLAUSES
-  if (conflict == &cimpl)
+  if (ps->conflict == &ps->cimpl)
     resetcimpl ();
 #endif
 #ifndef NADC
-  if (conflict && conflict == adoconflict)
+  if (ps->conflict && ps->conflict == ps->adoconflict)
     resetadoconflict ();
 #endif
-  conflict = mtcls;
-  if (level < adecidelevel)
+  ps->conflict = ps->mtcls;
+  if (ps->level < ps->adecidelevel)
     {
-      assert (als < alshead);
-      adecidelevel = 0;
-      alstail = als;
+      assert (ps->als < ps->alshead);
+      ps->adecidelevel = 0;
+      ps->alstail = ps->als;
     }
-  LOG (fprintf (out, "%sback to level %u\n", prefix, level));
+  LOG (fprintf (ps->out, "%sback to level %u\n", ps->prefix, ps->level));
 }
 
 #ifndef NDEBUG
@@ -3130,7 +3138,7 @@ original_clauses_satisfied (void)
 {
   Cls **p, *cls;
 
-  for (p = oclauses; p < ohead; p++)
+  for (p = ps->oclauses; p < ps->ohead; p++)
     {
       cls = *p;
 
@@ -3149,7 +3157,7 @@ assumptions_satisfied (void)
 {
   Lit *lit, ** p;
 
-  for (p = als; p < alshead; p++)
+  for (p = ps->als; p < ps->alshead; p++)
     {
       lit = *p;
       assert (lit->val == TRUE);
@@ -3162,45 +3170,45 @@ static void
 sflush (void)
 {
   double now = picosat_time_stamp ();
-  double delta = now - entered;
+  double delta = now - ps->entered;
   delta = (delta < 0) ? 0 : delta;
-  seconds += delta;
-  entered = now;
+  ps->seconds += delta;
+  ps->entered = now;
 }
 
 static double
 mb (void)
 {
-  return current_bytes / (double) (1 << 20);
+  return ps->current_bytes / (double) (1 << 20);
 }
 
 static double
 avglevel (void)
 {
-  return decisions ? levelsum / decisions : 0.0;
+  return ps->decisions ? ps->levelsum / ps->decisions : 0.0;
 }
 
 static void
 rheader (void)
 {
-  assert (lastrheader <= reports);
+  assert (ps->lastrheader <= ps->reports);
 
-  if (lastrheader == reports)
+  if (ps->lastrheader == ps->reports)
     return;
 
-  lastrheader = reports;
+  ps->lastrheader = ps->reports;
 
-  fprintf (out, "%s\n", prefix);
-  fprintf (out, "%s %s\n", prefix, rline[0]);
-  fprintf (out, "%s %s\n", prefix, rline[1]);
-  fprintf (out, "%s\n", prefix);
+  fprintf (ps->out, "%s\n", ps->prefix);
+  fprintf (ps->out, "%s %s\n", ps->prefix, ps->rline[0]);
+  fprintf (ps->out, "%s %s\n", ps->prefix, ps->rline[1]);
+  fprintf (ps->out, "%s\n", ps->prefix);
 }
 
 static unsigned
 dynamic_flips_per_assignment_per_mille (void)
 {
   assert (FFLIPPEDPREC >= 1000);
-  return sdflips / (FFLIPPEDPREC / 1000);
+  return ps->sdflips / (FFLIPPEDPREC / 1000);
 }
 
 #ifdef NLUBY
@@ -3233,14 +3241,14 @@ relemdata (void)
   char *p;
   int x;
 
-  if (reports < 0)
+  if (ps->reports < 0)
     {
       /* strip trailing white space 
        */
       for (x = 0; x <= 1; x++)
 	{
-	  p = rline[x] + strlen (rline[x]);
-	  while (p-- > rline[x])
+	  p = ps->rline[x] + strlen (ps->rline[x]);
+	  while (p-- > ps->rline[x])
 	    {
 	      if (*p != ' ')
 		break;
@@ -3252,9 +3260,9 @@ relemdata (void)
       rheader ();
     }
   else
-    fputc ('\n', out);
+    fputc ('\n', ps->out);
 
-  rcount = 0;
+  ps->rcount = 0;
 }
 
 static void
@@ -3264,25 +3272,25 @@ relemhead (const char * name, int fp, double val)
   const char *fmt;
   unsigned tmp, e;
 
-  if (reports < 0)
+  if (ps->reports < 0)
     {
-      x = rcount & 1;
-      y = (rcount / 2) * 12 + x * 6;
+      x = ps->rcount & 1;
+      y = (ps->rcount / 2) * 12 + x * 6;
 
-      if (rcount == 1)
-	sprintf (rline[1], "%6s", "");
+      if (ps->rcount == 1)
+	sprintf (ps->rline[1], "%6s", "");
 
       len = strlen (name);
-      while (szrline <= len + y + 1)
+      while (ps->szrline <= len + y + 1)
 	{
-	  size = szrline ? 2 * szrline : 128;
-	  rline[0] = resize (rline[0], szrline, size);
-	  rline[1] = resize (rline[1], szrline, size);
-	  szrline = size;
+	  size = ps->szrline ? 2 * ps->szrline : 128;
+	  ps->rline[0] = resize (ps->rline[0], ps->szrline, size);
+	  ps->rline[1] = resize (ps->rline[1], ps->szrline, size);
+	  ps->szrline = size;
 	}
 
       fmt = (len <= 6) ? "%6s%10s" : "%-10s%4s";
-      sprintf (rline[x] + y, fmt, name, "");
+      sprintf (ps->rline[x] + y, fmt, name, "");
     }
   else if (val < 0)
     {
@@ -3290,7 +3298,7 @@ relemhead (const char * name, int fp, double val)
 
       if (val > -100 && (tmp = val * 10.0 - 0.5) > -1000.0)
 	{
-	  fprintf (out, "-%4.1f ", -tmp / 10.0);
+	  fprintf (ps->out, "-%4.1f ", -tmp / 10.0);
 	}
       else
 	{
@@ -3302,18 +3310,18 @@ relemhead (const char * name, int fp, double val)
 	      e++;
 	    }
 
-	  fprintf (out, "-%2ue%u ", tmp, e);
+	  fprintf (ps->out, "-%2ue%u ", tmp, e);
 	}
     }
   else
     {
       if (fp && val < 1000 && (tmp = val * 10.0 + 0.5) < 10000)
 	{
-	  fprintf (out, "%5.1f ", tmp / 10.0);
+	  fprintf (ps->out, "%5.1f ", tmp / 10.0);
 	}
       else if (!fp && (tmp = val) < 100000)
 	{
-	  fprintf (out, "%5u ", tmp);
+	  fprintf (ps->out, "%5u ", tmp);
 	}
       else
 	{
@@ -3326,11 +3334,11 @@ relemhead (const char * name, int fp, double val)
 	      e++;
 	    }
 
-	  fprintf (out, "%3ue%u ", tmp, e);
+	  fprintf (ps->out, "%3ue%u ", tmp, e);
 	}
     }
 
-  rcount++;
+  ps->rcount++;
 }
 
 inline static void
@@ -3345,8 +3353,8 @@ relem (const char *name, int fp, double val)
 static unsigned
 reduce_limit_on_lclauses (void)
 {
-  unsigned res = lreduce;
-  res += llocked;
+  unsigned res = ps->lreduce;
+  res += ps->llocked;
   return res;
 }
 
@@ -3355,34 +3363,34 @@ report (int level, char type)
 {
   int rounds;
 
-  if (verbosity < level)
+  if (ps->verbosity < level)
     return;
 
   sflush ();
 
-  if (!reports)
-    reports = -1;
+  if (!ps->reports)
+    ps->reports = -1;
 
-  for (rounds = (reports < 0) ? 2 : 1; rounds; rounds--)
+  for (rounds = (ps->reports < 0) ? 2 : 1; rounds; rounds--)
     {
-      if (reports >= 0)
-	fprintf (out, "%s%c ", prefix, type);
+      if (ps->reports >= 0)
+	fprintf (ps->out, "%s%c ", ps->prefix, type);
 
-      relem ("seconds", 1, seconds);
+      relem ("seconds", 1, ps->seconds);
       relem ("level", 1, avglevel ());
-      assert (fixed <=  max_var);
-      relem ("variables", 0, max_var - fixed);
-      relem ("used", 1, PERCENT (vused, max_var));
-      relem ("original", 0, noclauses);
-      relem ("conflicts", 0, conflicts);
+      assert (ps->fixed <=  ps->max_var);
+      relem ("variables", 0, ps->max_var - ps->fixed);
+      relem ("used", 1, PERCENT (ps->vused, ps->max_var));
+      relem ("original", 0, ps->noclauses);
+      relem ("conflicts", 0, ps->conflicts);
       //relem ("decisions", 0, decisions);
       // relem ("conf/dec", 1, PERCENT(conflicts,decisions));
       // relem ("limit", 0, reduce_limit_on_lclauses ());
-      relem ("learned", 0, nlclauses);
+      relem ("learned", 0, ps->nlclauses);
       // relem ("limit", 1, PERCENT (nlclauses, reduce_limit_on_lclauses ()));
-      relem ("limit", 0, lreduce);
+      relem ("limit", 0, ps->lreduce);
 #ifdef STATS
-      relem ("learning", 1, PERCENT (llused, lladded));
+      relem ("learning", 1, PERCENT (ps->llused, ps->lladded));
 #endif
       relem ("agility", 1, dynamic_flips_per_assignment_per_mille () / 10.0);
       // relem ("original", 0, noclauses);
@@ -3392,30 +3400,30 @@ report (int level, char type)
 
       relem (0, 0, 0);
 
-      reports++;
+      ps->reports++;
     }
 
   /* Adapt this to the number of rows in your terminal.
    */
   #define ROWS 25
 
-  if (reports % (ROWS - 3) == (ROWS - 4))
+  if (ps->reports % (ROWS - 3) == (ROWS - 4))
     rheader ();
 
-  fflush (out);
+  fflush (ps->out);
 }
 
 static int
 bcp_queue_is_empty (void)
 {
-  if (ttail != thead)
+  if (ps->ttail != ps->thead)
     return 0;
 
-  if (ttail2 != thead)
+  if (ps->ttail2 != ps->thead)
     return 0;
 
 #ifndef NADC
-  if (ttailado != thead)
+  if (ps->ttailado != ps->thead)
     return 0;
 #endif
 
@@ -3425,25 +3433,25 @@ bcp_queue_is_empty (void)
 static int
 satisfied (void)
 {
-  assert (!mtcls);
-  assert (!failed_assumption);
-  if (alstail < alshead)
+  assert (!ps->mtcls);
+  assert (!ps->failed_assumption);
+  if (ps->alstail < ps->alshead)
     return 0;
-  assert (!conflict);
+  assert (!ps->conflict);
   assert (bcp_queue_is_empty ());
-  return thead == trail + max_var;	/* all assigned */
+  return ps->thead == ps->trail + ps->max_var;	/* all assigned */
 }
 
 static void
 vrescore (void)
 {
-  Rnk *p, *eor = rnks + max_var;
-  for (p = rnks + 1; p <= eor; p++)
+  Rnk *p, *eor = ps->rnks + ps->max_var;
+  for (p = ps->rnks + 1; p <= eor; p++)
     if (p->score != INFFLT)
-      p->score = mulflt (p->score, ilvinc);
-  vinc = mulflt (vinc, ilvinc);;
+      p->score = mulflt (p->score, ps->ilvinc);
+  ps->vinc = mulflt (ps->vinc, ps->ilvinc);;
 #ifdef VISCORES
-  nvinc = mulflt (nvinc, lscore);;
+  ps->nvinc = mulflt (ps->nvinc, ps->lscore);;
 #endif
 }
 
@@ -3454,7 +3462,7 @@ inc_score (Var * v)
   Rnk *r;
 
 #ifndef NFL
-  if (simplifying)
+  if (ps->simplifying)
     return;
 #endif
 
@@ -3466,13 +3474,13 @@ inc_score (Var * v)
 
   assert (score != INFFLT);
 
-  score = addflt (score, vinc);
+  score = addflt (score, ps->vinc);
   assert (score < INFFLT);
   r->score = score;
   if (r->pos > 0)
     hup (r);
 
-  if (score > lscore)
+  if (score > ps->lscore)
     vrescore ();
 }
 
@@ -3488,7 +3496,7 @@ inc_activity (Cls * cls)
     return;
 
   p = CLS2ACT (cls);
-  *p = addflt (*p, cinc);
+  *p = addflt (*p, ps->cinc);
 }
 
 static unsigned
@@ -3500,17 +3508,17 @@ hashlevel (unsigned l)
 static void
 push (Var * v)
 {
-  if (dhead == eod)
-    ENLARGE (dfs, dhead, eod);
+  if (ps->dhead == ps->eod)
+    ENLARGE (ps->dfs, ps->dhead, ps->eod);
 
-  *dhead++ = v;
+  *ps->dhead++ = v;
 }
 
 static Var * 
 pop (void)
 {
-  assert (dfs < dhead);
-  return *--dhead;
+  assert (ps->dfs < ps->dhead);
+  return *--ps->dhead;
 }
 
 static void
@@ -3521,23 +3529,23 @@ analyze (void)
   Var *v, *u, **m, *start, *uip;
   Cls *c;
 
-  assert (conflict);
+  assert (ps->conflict);
 
-  assert (ahead == added);
-  assert (mhead == marked);
-  assert (rhead == resolved);
+  assert (ps->ahead == ps->added);
+  assert (ps->mhead == ps->marked);
+  assert (ps->rhead == ps->resolved);
 
   /* 2. Search for First UIP variable and mark all resolved variables.  At
    * the same time determine the minimum decision level involved.  Increase
    * activities of resolved variables.
    */
-  q = thead;
+  q = ps->thead;
   open = 0;
-  minlevel = level;
+  minlevel = ps->level;
   siglevels = 0;
   uip = 0;
 
-  c = conflict;
+  c = ps->conflict;
 
   for (;;)
     {
@@ -3561,7 +3569,7 @@ analyze (void)
 	  inc_score (u);
 	  use_var (u);
 
-	  if (u->level == level)
+	  if (u->level == ps->level)
 	    {
 	      open++;
 	    }
@@ -3576,7 +3584,7 @@ analyze (void)
 		   * 'first UIP' scheme for learned clauses would be used
 		   * and no clause minimization.
 		   */
-		  nonminimizedllits++;
+		  ps->nonminimizedllits++;
 
 		  if (u->level < minlevel)
 		    minlevel = u->level;
@@ -3593,7 +3601,7 @@ analyze (void)
 
       do
 	{
-	  if (q == trail)
+	  if (q == ps->trail)
 	    {
 	      uip = 0;
 	      goto DONE_FIRST_UIP;
@@ -3608,11 +3616,11 @@ analyze (void)
 
       c = var2reason (uip);
 #ifdef NO_BINARY_CLAUSES
-      if (c == &impl)
+      if (c == &ps->impl)
 	resetimpl ();
 #endif
      open--;
-     if ((!open && level) || !c)
+     if ((!open && ps->level) || !c)
 	break;
 
      assert (c);
@@ -3622,19 +3630,19 @@ DONE_FIRST_UIP:
 
   if (uip)
     {
-      assert (level);
+      assert (ps->level);
       this = VAR2LIT (uip);
       this += (this->val == TRUE);
-      nonminimizedllits++;
-      minimizedllits++;
+      ps->nonminimizedllits++;
+      ps->minimizedllits++;
       add_lit (this);
 #ifdef STATS
       if (uip->reason)
-	uips++;
+	ps->uips++;
 #endif
     }
   else
-    assert (!level);
+    assert (!ps->level);
 
   /* 3. Try to mark more intermediate variables, with the goal to minimize
    * the conflict clause.  This is a DFS from already marked variables
@@ -3649,40 +3657,40 @@ DONE_FIRST_UIP:
    * incremental applications.  After switching to DFS this hot spot went
    * away.
    */
-  orig = mhead - marked;
+  orig = ps->mhead - ps->marked;
   for (i = 0; i < orig; i++)
     {
-      start = marked[i];
+      start = ps->marked[i];
 
       assert (start->mark);
       assert (start != uip);
-      assert (start->level < level);
+      assert (start->level < ps->level);
 
       if (!start->reason)
 	continue;
 
-      old = mhead - marked;
-      assert (dhead == dfs);
+      old = ps->mhead - ps->marked;
+      assert (ps->dhead == ps->dfs);
       push (start);
 
-      while (dhead > dfs)
+      while (ps->dhead > ps->dfs)
 	{
 	  u = pop ();
 	  assert (u->mark);
 
 	  c = var2reason (u);
 #ifdef NO_BINARY_CLAUSES
-	  if (c == &impl)
+	  if (c == &ps->impl)
 	    resetimpl ();
 #endif
 	  if (!c || 
 	      ((l = u->level) && 
 	       (l < minlevel || ((hashlevel (l) & ~siglevels)))))
 	    {
-	      while (mhead > marked + old)	/* reset all marked */
-		(*--mhead)->mark = 0;
+	      while (ps->mhead > ps->marked + old)	/* reset all marked */
+		(*--ps->mhead)->mark = 0;
 
-	      dhead = dfs;		/* and DFS stack */
+	      ps->dhead = ps->dfs;		/* and DFS stack */
 	      break;
 	    }
 
@@ -3699,7 +3707,7 @@ DONE_FIRST_UIP:
 	}
     }
 
-  for (m = marked; m < mhead; m++)
+  for (m = ps->marked; m < ps->mhead; m++)
     {
       v = *m;
 
@@ -3713,7 +3721,7 @@ DONE_FIRST_UIP:
 	continue;
 
 #ifdef NO_BINARY_CLAUSES
-      if (c == &impl)
+      if (c == &ps->impl)
 	resetimpl ();
 #endif
       eol = end_of_lits (c);
@@ -3736,7 +3744,7 @@ DONE_FIRST_UIP:
       v->resolved = 1;
     }
 
-  for (m = marked; m < mhead; m++)
+  for (m = ps->marked; m < ps->mhead; m++)
     {
       v = *m;
 
@@ -3754,13 +3762,13 @@ DONE_FIRST_UIP:
 	this++;			/* actually NOTLIT */
 
       add_lit (this);
-      minimizedllits++;
+      ps->minimizedllits++;
     }
 
-  assert (ahead <= eoa);
-  assert (rhead <= eor);
+  assert (ps->ahead <= ps->eoa);
+  assert (ps->rhead <= ps->eor);
 
-  mhead = marked;
+  ps->mhead = ps->marked;
 }
 
 static void
@@ -3773,14 +3781,14 @@ fanalyze (void)
 
   double start = picosat_time_stamp ();
 
-  assert (failed_assumption);
-  assert (failed_assumption->val == FALSE);
+  assert (ps->failed_assumption);
+  assert (ps->failed_assumption->val == FALSE);
 
-  v = LIT2VAR (failed_assumption);
+  v = LIT2VAR (ps->failed_assumption);
   reason = var2reason (v);
   if (!reason) return;
 #ifdef NO_BINARY_CLAUSES
-  if (reason == &impl)
+  if (reason == &ps->impl)
     resetimpl ();
 #endif
 
@@ -3794,23 +3802,23 @@ fanalyze (void)
     }
   if (p == eol) return;
 
-  assert (ahead == added);
-  assert (mhead == marked);
-  assert (rhead == resolved);
+  assert (ps->ahead == ps->added);
+  assert (ps->mhead == ps->marked);
+  assert (ps->rhead == ps->resolved);
 
   next = 0;
   mark_var (v);
-  add_lit (NOTLIT (failed_assumption));
+  add_lit (NOTLIT (ps->failed_assumption));
 
   do
     {
-      v = marked[next++];
+      v = ps->marked[next++];
       use_var (v);
       if (v->reason)
 	{
 	  reason = var2reason (v);
 #ifdef NO_BINARY_CLAUSES
-	  if (reason == &impl)
+	  if (reason == &ps->impl)
 	    resetimpl ();
 #endif
 	  add_antecedent (reason);
@@ -3831,13 +3839,13 @@ fanalyze (void)
 	  add_lit (lit);
 	}
     } 
-  while (marked + next < mhead);
+  while (ps->marked + next < ps->mhead);
 
   cls = add_simplified_clause (1);
-  v = LIT2VAR (failed_assumption);
+  v = LIT2VAR (ps->failed_assumption);
   reason = var2reason (v);
 #ifdef NO_BINARY_CLAUSES
-  if (reason == &impl)
+  if (reason == &ps->impl)
     resetimpl ();
   else
 #endif
@@ -3847,8 +3855,8 @@ fanalyze (void)
   }
   if (reason->learned && reason->size > 2)
     {
-      assert (llocked > 0);
-      llocked--;
+      assert (ps->llocked > 0);
+      ps->llocked--;
     }
   v->reason = cls;
   assert (cls->learned);
@@ -3856,16 +3864,16 @@ fanalyze (void)
   cls->locked = 1;
   if (cls->size > 2)
     {
-      llocked++;
-      assert (llocked > 0);
+      ps->llocked++;
+      assert (ps->llocked > 0);
     }
 
-  while (mhead > marked)
-    (*--mhead)->mark = 0;
+  while (ps->mhead > ps->marked)
+    (*--ps->mhead)->mark = 0;
 
-  if (verbosity)
-    fprintf (out, "%sfanalyze took %.1f seconds\n", 
-	     prefix, picosat_time_stamp () - start);
+  if (ps->verbosity)
+    fprintf (ps->out, "%sfanalyze took %.1f seconds\n", 
+	     ps->prefix, picosat_time_stamp () - start);
 }
 
 /* Propagate assignment of 'this' to 'FALSE' by visiting all binary clauses in
@@ -3896,8 +3904,8 @@ prop2 (Lit * this)
       /* The counter 'visits' is the number of clauses that are
        * visited during propagations of assignments.
        */
-      visits++;
-      bvisits++;
+      ps->visits++;
+      ps->bvisits++;
 #endif
       other = *--l;
       tmp = other->val;
@@ -3905,10 +3913,10 @@ prop2 (Lit * this)
       if (tmp == TRUE)
 	{
 #ifdef STATS
-	  othertrue++;
-	  othertrue2++;
-	  if (LIT2VAR (other)->level < level)
-	    othertrue2u++;
+	  ps->othertrue++;
+	  ps->othertrue2++;
+	  if (LIT2VAR (other)->level < ps->level)
+	    ps->othertrue2u++;
 #endif
 	  continue;
 	}
@@ -3919,9 +3927,9 @@ prop2 (Lit * this)
 	  continue;
 	}
 
-      if (conflict == &cimpl)
+      if (ps->conflict == &ps->cimpl)
 	resetcimpl ();
-      conflict = setcimpl (this, other);
+      ps->conflict = setcimpl (this, other);
     }
 #else
   /* Traverse all binary clauses with 'this'.  Head/Tail pointers for binary
@@ -3931,8 +3939,8 @@ prop2 (Lit * this)
   for (cls = *p; cls; cls = next)
     {
 #ifdef STATS
-      visits++;
-      bvisits++;
+      ps->visits++;
+      ps->bvisits++;
 #endif
       assert (!cls->collect);
 #ifdef TRACE
@@ -3956,16 +3964,16 @@ prop2 (Lit * this)
       if (tmp == TRUE)
 	{
 #ifdef STATS
-	  othertrue++;
-	  othertrue2++;
-	  if (LIT2VAR (other)->level < level)
-	    othertrue2u++;
+	  ps->othertrue++;
+	  ps->othertrue2++;
+	  if (LIT2VAR (other)->level < ps->level)
+	    ps->othertrue2u++;
 #endif
 	  continue;
 	}
 
       if (tmp == FALSE)
-	conflict = cls;
+	ps->conflict = cls;
       else
 	assign_forced (other, cls);	/* unit clause */
     }
@@ -3988,11 +3996,11 @@ should_disconnect_head_tail (Lit * lit)
     return 1;
 
 #ifndef NFL
-  if (simplifying)
+  if (ps->simplifying)
     return 0;
 #endif
 
-  return lit_level < level;
+  return lit_level < ps->level;
 }
 #endif
 
@@ -4015,20 +4023,20 @@ propl (Lit * this)
   for (cls = *htp_ptr; cls; cls = next)
     {
 #ifdef STATS
-      visits++;
+      ps->visits++;
       size = cls->size;
       if (size == 2)
-	bvisits++;
+	ps->bvisits++;
       else if (size >= 3)
 	{
-	  traversals++;	/* other is dereferenced at least */
+	  ps->traversals++;	/* other is dereferenced at least */
 
 	  if (size == 3)
-	    tvisits++;
+	    ps->tvisits++;
 	  else if (size >= 4)
 	    {
-	      lvisits++;
-	      ltraversals++;
+	      ps->lvisits++;
+	      ps->ltraversals++;
 	    }
 	}
 #endif
@@ -4041,8 +4049,8 @@ propl (Lit * this)
        */
       if (cls->size == 1)
 	{
-	  assert (!conflict);
-	  conflict = cls;
+	  assert (!ps->conflict);
+	  ps->conflict = cls;
 	  break;
 	}
 
@@ -4068,8 +4076,8 @@ propl (Lit * this)
       if (other->val == TRUE)
 	{
 #ifdef STATS
-	  othertrue++;
-	  othertruel++;
+	  ps->othertrue++;
+	  ps->othertruel++;
 #endif
 #ifndef NDSC
 	  if (should_disconnect_head_tail (other))
@@ -4078,7 +4086,7 @@ propl (Lit * this)
 	      cls->next[0] = *new_htp_ptr;
 	      *new_htp_ptr = cls;
 #ifdef STATS
-	      othertruelu++;
+	      ps->othertruelu++;
 #endif
 	      *htp_ptr = next;
 	      continue;
@@ -4097,9 +4105,9 @@ propl (Lit * this)
 #ifdef STATS
 	  if (size >= 3)
 	    {
-	      traversals++;
+	      ps->traversals++;
 	      if (size > 3)
-		ltraversals++;
+		ps->ltraversals++;
 	    }
 #endif
 	  new_lit = *l;
@@ -4121,8 +4129,8 @@ propl (Lit * this)
 	  assert (other == cls->lits[1]);
 	  if (other->val == FALSE)	/* found conflict */
 	    {
-	      assert (!conflict);
-	      conflict = cls;
+	      assert (!ps->conflict);
+	      ps->conflict = cls;
 	      return;
 	    }
 
@@ -4177,7 +4185,7 @@ hash_ado (Lit ** ado, unsigned salt)
       res += tmp;
     }
 
-  return res & (szadotab - 1);
+  return res & (ps->szadotab - 1);
 }
 
 static unsigned
@@ -4206,8 +4214,8 @@ find_ado (Lit ** ado)
   unsigned pos, delta;
 
   pos = hash_ado (ado, 0);
-  assert (pos < szadotab);
-  res = adotab + pos;
+  assert (pos < ps->szadotab);
+  res = ps->adotab + pos;
 
   other = *res;
   if (!other || !cmp_ado (other, ado))
@@ -4218,16 +4226,16 @@ find_ado (Lit ** ado)
     delta++;
 
   assert (delta & 1);
-  assert (delta < szadotab);
+  assert (delta < ps->szadotab);
 
   for (;;)
     {
       pos += delta;
-      if (pos >= szadotab)
-	pos -= szadotab;
+      if (pos >= ps->szadotab)
+	pos -= ps->szadotab;
 
-      assert (pos < szadotab);
-      res = adotab + pos;
+      assert (pos < ps->szadotab);
+      res = ps->adotab + pos;
       other = *res;
       if (!other || !cmp_ado (other, ado))
 	return res;
@@ -4239,12 +4247,12 @@ enlarge_adotab (void)
 {
   /* TODO make this generic */
 
-  ABORTIF (szadotab, 
+  ABORTIF (ps->szadotab, 
            "internal: all different objects table needs larger initial size");
-  assert (!nadotab);
-  szadotab = 10000;
-  NEWN (adotab, szadotab);
-  CLRN (adotab, szadotab);
+  assert (!ps->nadotab);
+  ps->szadotab = 10000;
+  NEWN (ps->adotab, ps->szadotab);
+  CLRN (ps->adotab, ps->szadotab);
 }
 
 static int
@@ -4253,11 +4261,11 @@ propado (Var * v)
   Lit ** p, ** q, *** adotabpos, **ado, * lit;
   Var * u;
 
-  if (level && adodisabled)
+  if (ps->level && ps->adodisabled)
     return 1;
 
-  assert (!conflict);
-  assert (!adoconflict);
+  assert (!ps->conflict);
+  assert (!ps->adoconflict);
   assert (VAR2LIT (v)->val != UNDEF);
   assert (!v->adotabpos);
 
@@ -4277,7 +4285,7 @@ propado (Var * v)
 	return 1;
       }
 
-  if (4 * nadotab >= 3 * szadotab)	/* at least 75% filled */
+  if (4 * ps->nadotab >= 3 * ps->szadotab)	/* at least 75% filled */
     enlarge_adotab ();
 
   adotabpos = find_ado (v->ado);
@@ -4285,7 +4293,7 @@ propado (Var * v)
 
   if (!ado)
     {
-      nadotab++;
+      ps->nadotab++;
       v->adotabpos = adotabpos;
       *adotabpos = v->ado;
       return 1;
@@ -4293,8 +4301,8 @@ propado (Var * v)
 
   assert (ado != v->ado);
 
-  adoconflict = new_clause (2 * llength (ado), 1);
-  q = adoconflict->lits;
+  ps->adoconflict = new_clause (2 * llength (ado), 1);
+  q = ps->adoconflict->lits;
 
   for (p = ado; (lit = *p); p++)
     *q++ = lit->val == FALSE ? lit : NOTLIT (lit);
@@ -4302,9 +4310,9 @@ propado (Var * v)
   for (p = v->ado; (lit = *p); p++)
     *q++ = lit->val == FALSE ? lit : NOTLIT (lit);
 
-  assert (q == ENDOFCLS (adoconflict));
-  conflict = adoconflict;
-  adoconflicts++;
+  assert (q == ENDOFCLS (ps->adoconflict));
+  ps->conflict = ps->adoconflict;
+  ps->adoconflicts++;
   return 0;
 }
 
@@ -4314,37 +4322,37 @@ static void
 bcp (void)
 {
   int props = 0;
-  assert (!conflict);
+  assert (!ps->conflict);
 
-  if (mtcls || conflict)
+  if (ps->mtcls || ps->conflict)
     return;
 
   for (;;)
     {
-      if (ttail2 < thead)	/* prioritize implications */
+      if (ps->ttail2 < ps->thead)	/* prioritize implications */
 	{
 	  props++;
-	  prop2 (NOTLIT (*ttail2++));
+	  prop2 (NOTLIT (*ps->ttail2++));
 	}
-      else if (ttail < thead)	/* unit clauses or clauses with length > 2 */
+      else if (ps->ttail < ps->thead)	/* unit clauses or clauses with length > 2 */
 	{
-	  if (conflict) break;
-	  propl (NOTLIT (*ttail++));
-	  if (conflict) break;
+	  if (ps->conflict) break;
+	  propl (NOTLIT (*ps->ttail++));
+	  if (ps->conflict) break;
 	}
 #ifndef NADC
-      else if (ttailado < thead)
+      else if (ps->ttailado < ps->thead)
 	{
-	  if (conflict) break;
-	  propado (LIT2VAR (*ttailado++));
-	  if (conflict) break;
+	  if (ps->conflict) break;
+	  propado (LIT2VAR (*ps->ttailado++));
+	  if (ps->conflict) break;
 	}
 #endif
       else
 	break;		/* all assignments propagated, so break */
     }
 
-  propagations += props;
+  ps->propagations += props;
 }
 
 /* This version of 'drive' is independent of the global variable 'level' and
@@ -4357,7 +4365,7 @@ drive (void)
   Lit **p;
 
   first = 0;
-  for (p = added; p < ahead; p++)
+  for (p = ps->added; p < ps->ahead; p++)
     {
       v = LIT2VAR (*p);
       if (!first || v->level > first->level)
@@ -4368,7 +4376,7 @@ drive (void)
     return 0;
 
   second = 0;
-  for (p = added; p < ahead; p++)
+  for (p = ps->added; p < ps->ahead; p++)
     {
       v = LIT2VAR (*p);
 
@@ -4390,32 +4398,32 @@ drive (void)
 static void
 viscores (void)
 {
-  Rnk *p, *eor = rnks + max_var;
+  Rnk *p, *ps->eor = ps->rnks + ps->max_var;
   char name[100], cmd[200];
   FILE * data;
   Flt s;
   int i;
 
-  for (p = rnks + 1; p <= eor; p++)
+  for (p = ps->rnks + 1; p <= ps->eor; p++)
     {
       s = p->score;
       if (s == INFFLT)
 	continue;
-      s = mulflt (s, nvinc);
+      s = mulflt (s, ps->nvinc);
       assert (flt2double (s) <= 1.0);
     }
 
-  sprintf (name, "/tmp/picosat-viscores/data/%08u", conflicts);
+  sprintf (name, "/tmp/picosat-viscores/data/%08u", ps->conflicts);
   sprintf (cmd, "sort -n|nl>%s", name);
 
   data = popen (cmd, "w");
-  for (p = rnks + 1; p <= eor; p++)
+  for (p = ps->rnks + 1; p <= ps->eor; p++)
     {
       s = p->score;
       if (s == INFFLT)
 	continue;
-      s = mulflt (s, nvinc);
-      fprintf (data, "%lf %d\n", 100.0 * flt2double (s), (int)(p - rnks));
+      s = mulflt (s, ps->nvinc);
+      fprintf (data, "%lf %d\n", 100.0 * flt2double (s), (int)(p - ps->rnks));
     }
   fflush (data);
   pclose (data);
@@ -4426,16 +4434,16 @@ viscores (void)
       system (cmd);
     }
 
-  fprintf (fviscores, "set title \"%u\"\n", conflicts);
-  fprintf (fviscores, "plot [0:%u] 0, 100 * (1 - 1/1.1), 100", max_var);
+  fprintf (ps->fviscores, "set title \"%u\"\n", ps->conflicts);
+  fprintf (ps->fviscores, "plot [0:%u] 0, 100 * (1 - 1/1.1), 100", ps->max_var);
 
   for (i = 0; i < 8; i++)
-    fprintf (fviscores, 
+    fprintf (ps->fviscores, 
              ", \"%s.%d\" using 1:2:3 with labels tc lt %d", 
 	     name, i, i + 1);
 
-  fputc ('\n', fviscores);
-  fflush (fviscores);
+  fputc ('\n', ps->fviscores);
+  fflush (ps->fviscores);
 #ifndef WRITEGIF
   usleep (50000);		/* refresh rate of 20 Hz */
 #endif
@@ -4449,11 +4457,11 @@ crescore (void)
   Cls **p, *cls;
   Act *a;
   Flt factor;
-  int l = log2flt (cinc);
+  int l = log2flt (ps->cinc);
   assert (l > 0);
   factor = base2flt (1, -l);
 
-  for (p = lclauses; p != lhead; p++)
+  for (p = ps->lclauses; p != ps->lhead; p++)
     {
       cls = *p;
 
@@ -4473,16 +4481,16 @@ crescore (void)
       *a = mulflt (*a, factor);
     }
 
-  cinc = mulflt (cinc, factor);
+  ps->cinc = mulflt (ps->cinc, factor);
 }
 
 static void
 inc_vinc (void)
 {
 #ifdef VISCORES
-  nvinc = mulflt (nvinc, fvinc);
+  ps->nvinc = mulflt (ps->nvinc, ps->fvinc);
 #endif
-  vinc = mulflt (vinc, ifvinc);
+  ps->vinc = mulflt (ps->vinc, ps->ifvinc);
 }
 
 inline static void
@@ -4492,30 +4500,30 @@ inc_max_var (void)
   Rnk *r;
   Var *v;
 
-  assert (max_var < size_vars);
+  assert (ps->max_var < ps->size_vars);
 
-  max_var++;			/* new index of variable */
-  assert (max_var);		/* no unsigned overflow */
+  ps->max_var++;			/* new index of variable */
+  assert (ps->max_var);		/* no unsigned overflow */
 
-  if (max_var == size_vars)
-    enlarge (size_vars + (size_vars + 3) / 4);	/* increase by 25% */
+  if (ps->max_var == ps->size_vars)
+    enlarge (ps->size_vars + (ps->size_vars + 3) / 4);	/* increase by 25% */
 
-  assert (max_var < size_vars);
+  assert (ps->max_var < ps->size_vars);
 
-  lit = lits + 2 * max_var;
+  lit = ps->lits + 2 * ps->max_var;
   lit[0].val = lit[1].val = UNDEF;
 
-  memset (htps + 2 * max_var, 0, 2 * sizeof *htps);
+  memset (ps->htps + 2 * ps->max_var, 0, 2 * sizeof *ps->htps);
 #ifndef NDSC
-  memset (dhtps + 2 * max_var, 0, 2 * sizeof *dhtps);
+  memset (ps->dhtps + 2 * ps->max_var, 0, 2 * sizeof *ps->dhtps);
 #endif
-  memset (impls + 2 * max_var, 0, 2 * sizeof *impls);
-  memset (jwh + 2 * max_var, 0, 2 * sizeof *jwh);
+  memset (ps->impls + 2 * ps->max_var, 0, 2 * sizeof *ps->impls);
+  memset (ps->jwh + 2 * ps->max_var, 0, 2 * sizeof *ps->jwh);
 
-  v = vars + max_var;		/* initialize variable components */
+  v = ps->vars + ps->max_var;		/* initialize variable components */
   CLR (v);
 
-  r = rnks + max_var;		/* initialize rank */
+  r = ps->rnks + ps->max_var;		/* initialize rank */
   CLR (r);
 
   hpush (r);
@@ -4540,7 +4548,7 @@ force (Cls * cls)
 	  assert (!forced);
 	  forced = lit;
 #ifdef NO_BINARY_CLAUSES
-	  if (cls == &impl)
+	  if (cls == &ps->impl)
 	    reason = LIT2REASON (NOTLIT (p[p == cls->lits ? 1 : -1]));
 #endif
 	}
@@ -4549,7 +4557,7 @@ force (Cls * cls)
     }
 
 #ifdef NO_BINARY_CLAUSES
-  if (cls == &impl)
+  if (cls == &ps->impl)
     resetimpl ();
 #endif
   if (!forced)
@@ -4563,10 +4571,10 @@ static void
 inc_lreduce (void)
 {
 #ifdef STATS
-  inclreduces++;
+  ps->inclreduces++;
 #endif
-  lreduce *= FREDUCE;
-  lreduce /= 100;
+  ps->lreduce *= FREDUCE;
+  ps->lreduce /= 100;
   report (1, '+');
 }
 
@@ -4576,8 +4584,8 @@ backtrack (void)
   unsigned new_level;
   Cls * cls;
 
-  conflicts++;
-  LOG (fprintf (out, "%sconflict ", prefix); dumpclsnl (conflict));
+  ps->conflicts++;
+  LOG (fprintf (ps->out, "%sconflict ", ps->prefix); dumpclsnl (ps->conflict));
 
   analyze ();
   new_level = drive ();
@@ -4588,25 +4596,25 @@ backtrack (void)
 
   if (
 #ifndef NFL
-    !simplifying && 
+    !ps->simplifying && 
 #endif
-    !--lreduceadjustcnt)
+    !--ps->lreduceadjustcnt)
     {
-      lreduceadjustinc *= 15;
-      lreduceadjustinc /= 10;
-      lreduceadjustcnt = lreduceadjustinc;
+      ps->lreduceadjustinc *= 15;
+      ps->lreduceadjustinc /= 10;
+      ps->lreduceadjustcnt = ps->lreduceadjustinc;
       inc_lreduce ();
     }
 
-  if (verbosity >= 4 && !(conflicts % 1000))
+  if (ps->verbosity >= 4 && !(ps->conflicts % 1000))
     report (4, 'C');
 }
 
 static void
 inc_cinc (void)
 {
-  cinc = mulflt (cinc, fcinc);
-  if (lcinc < cinc)
+  ps->cinc = mulflt (ps->cinc, ps->fcinc);
+  if (ps->lcinc < ps->cinc)
     crescore ();
 }
 
@@ -4629,19 +4637,19 @@ disconnect_clause (Cls * cls)
     {
       if (cls->learned)
 	{
-	  assert (nlclauses > 0);
-	  nlclauses--;
+	  assert (ps->nlclauses > 0);
+	  ps->nlclauses--;
 
-	  assert (llits >= cls->size);
-	  llits -= cls->size;
+	  assert (ps->llits >= cls->size);
+	  ps->llits -= cls->size;
 	}
       else
 	{
-	  assert (noclauses > 0);
-	  noclauses--;
+	  assert (ps->noclauses > 0);
+	  ps->noclauses--;
 
-	  assert (olits >= cls->size);
-	  olits -= cls->size;
+	  assert (ps->olits >= cls->size);
+	  ps->olits -= cls->size;
 	}
     }
 
@@ -4683,7 +4691,7 @@ collect_clause (Cls * cls)
   disconnect_clause (cls);
 
 #ifdef TRACE
-  if (trace && (!cls->learned || cls->used))
+  if (ps->trace && (!cls->learned || cls->used))
     return 0;
 #endif
   delete_clause (cls);
@@ -4700,10 +4708,10 @@ collect_clauses (void)
   Var * v;
   int i;
 
-  res = current_bytes;
+  res = ps->current_bytes;
 
-  eol = lits + 2 * max_var + 1;
-  for (lit = lits + 2; lit <= eol; lit++)
+  eol = ps->lits + 2 * ps->max_var + 1;
+  for (lit = ps->lits + 2; lit <= eol; lit++)
     {
       for (i = 0; i <= 1; i++)
 	{
@@ -4745,7 +4753,7 @@ collect_clauses (void)
     }
 
 #ifndef NDSC
-  for (lit = lits + 2; lit <= eol; lit++)
+  for (lit = ps->lits + 2; lit <= eol; lit++)
     {
       p = LIT2DHTPS (lit); 
       while ((cls = *p))
@@ -4769,7 +4777,7 @@ collect_clauses (void)
     }
 #endif
 
-  for (v = vars + 1; v <= vars + max_var; v++)
+  for (v = ps->vars + 1; v <= ps->vars + ps->max_var; v++)
     {
       cls = v->reason;
       if (!cls)
@@ -4798,27 +4806,27 @@ collect_clauses (void)
     }
 
 #ifdef TRACE
-  if (!trace)
+  if (!ps->trace)
 #endif
     {
-      q = oclauses;
-      for (p = q; p < ohead; p++)
+      q = ps->oclauses;
+      for (p = q; p < ps->ohead; p++)
 	if ((cls = *p))
 	  *q++ = cls;
-      ohead = q;
+      ps->ohead = q;
 
-      q = lclauses;
-      for (p = q; p < lhead; p++)
+      q = ps->lclauses;
+      for (p = q; p < ps->lhead; p++)
 	if ((cls = *p))
 	  *q++ = cls;
-      lhead = q;
+      ps->lhead = q;
     }
 
-  assert (current_bytes <= res);
-  res -= current_bytes;
-  recycled += res;
+  assert (ps->current_bytes <= res);
+  res -= ps->current_bytes;
+  ps->recycled += res;
 
-  LOG (fprintf (out, "%scollected %ld bytes\n", prefix, res));
+  LOG (fprintf (ps->out, "%scollected %ld bytes\n", ps->prefix, res));
 
   return res;
 }
@@ -4826,7 +4834,7 @@ collect_clauses (void)
 static int
 need_to_reduce (void)
 {
-  return nlclauses >= reduce_limit_on_lclauses ();
+  return ps->nlclauses >= reduce_limit_on_lclauses ();
 }
 
 #ifdef NLUBY
@@ -4834,21 +4842,21 @@ need_to_reduce (void)
 static void
 inc_drestart (void)
 {
-  drestart *= FRESTART;
-  drestart /= 100;
+  ps->drestart *= FRESTART;
+  ps->drestart /= 100;
 
-  if (drestart >= MAXRESTART)
-    drestart = MAXRESTART;
+  if (ps->drestart >= MAXRESTART)
+    ps->drestart = MAXRESTART;
 }
 
 static void
 inc_ddrestart (void)
 {
-  ddrestart *= FRESTART;
-  ddrestart /= 100;
+  ps->ddrestart *= FRESTART;
+  ps->ddrestart /= 100;
 
-  if (ddrestart >= MAXRESTART)
-    ddrestart = MAXRESTART;
+  if (ps->ddrestart >= MAXRESTART)
+    ps->ddrestart = MAXRESTART;
 }
 
 #else
@@ -4874,21 +4882,21 @@ inc_lrestart (int skip)
 {
   unsigned delta;
 
-  delta = 100 * luby (++lubycnt);
-  lrestart = conflicts + delta;
+  delta = 100 * luby (++ps->lubycnt);
+  ps->lrestart = ps->conflicts + delta;
 
-  if (waslubymaxdelta)
+  if (ps->waslubymaxdelta)
     report (1, skip ? 'N' : 'R');
   else
     report (2, skip ? 'n' : 'r');
 
-  if (delta > lubymaxdelta)
+  if (delta > ps->lubymaxdelta)
     {
-      lubymaxdelta = delta;
-      waslubymaxdelta = 1;
+      ps->lubymaxdelta = delta;
+      ps->waslubymaxdelta = 1;
     }
   else
-    waslubymaxdelta = 0;
+    ps->waslubymaxdelta = 0;
 }
 #endif
 
@@ -4899,13 +4907,13 @@ init_restart (void)
   /* TODO: why is it better in incremental usage to have smaller initial
    * outer restart interval?
    */
-  ddrestart = calls > 1 ? MINRESTART : 1000;
-  drestart = MINRESTART;
-  lrestart = conflicts + drestart;
+  ps->ddrestart = ps->calls > 1 ? MINRESTART : 1000;
+  ps->drestart = MINRESTART;
+  ps->lrestart = ps->conflicts + ps->drestart;
 #else
-  lubycnt = 0;
-  lubymaxdelta = 0;
-  waslubymaxdelta = 0;
+  ps->lubycnt = 0;
+  ps->lubymaxdelta = 0;
+  ps->waslubymaxdelta = 0;
   inc_lrestart (0);
 #endif
 }
@@ -4919,7 +4927,7 @@ restart (void)
   int outer;
  
   inc_drestart ();
-  outer = (drestart >= ddrestart);
+  outer = (ps->drestart >= ps->ddrestart);
 
   if (outer)
     skip = very_high_agility ();
@@ -4931,16 +4939,16 @@ restart (void)
 
 #ifdef STATS
   if (skip)
-    skippedrestarts++;
+    ps->skippedrestarts++;
 #endif
 
-  assert (conflicts >= lrestart);
+  assert (ps->conflicts >= ps->lrestart);
 
   if (!skip)
     {
-      restarts++;
-      assert (level > 1);
-      LOG (fprintf (out, "%srestart %u\n", prefix, restarts));
+      ps->restarts++;
+      assert (ps->level > 1);
+      LOG (fprintf (ps->out, "%srestart %u\n", ps->prefix, ps->restarts));
       undo (0);
     }
 
@@ -4949,7 +4957,7 @@ restart (void)
     {
       kind = skip ? 'N' : 'R';
       inc_ddrestart ();
-      drestart = MINRESTART;
+      ps->drestart = MINRESTART;
     }
   else  if (skip)
     {
@@ -4960,9 +4968,9 @@ restart (void)
       kind = 'r';
     }
 
-  assert (drestart <= MAXRESTART);
-  lrestart = conflicts + drestart;
-  assert (lrestart > conflicts);
+  assert (ps->drestart <= MAXRESTART);
+  ps->lrestart = ps->conflicts + ps->drestart;
+  assert (ps->lrestart > ps->conflicts);
 
   report (outer ? 1 : 2, kind);
 #else
@@ -4973,14 +4981,14 @@ restart (void)
 inline static void
 assign_decision (Lit * lit)
 {
-  assert (!conflict);
+  assert (!ps->conflict);
 
-  level++;
+  ps->level++;
 
-  LOG (fprintf (out, "%snew level %u\n", prefix, level));
-  LOG (fprintf (out,
+  LOG (fprintf (ps->out, "%snew level %u\n", ps->prefix, ps->level));
+  LOG (fprintf (ps->out,
 		"%sassign %d at level %d <= DECISION\n",
-		prefix, lit2int (lit), level));
+		ps->prefix, lit2int (lit), ps->level));
 
   assign (lit, 0);
 }
@@ -5002,11 +5010,11 @@ static void
 flbcp (void)
 {
 #ifdef STATS
-  unsigned long long propagaions_before_bcp = propagations;
+  unsigned long long propagaions_before_bcp = ps->propagations;
 #endif
   bcp ();
 #ifdef STATS
-  flprops += propagations - propagaions_before_bcp;
+  ps->flprops += ps->propagations - propagaions_before_bcp;
 #endif
 }
 
@@ -5054,57 +5062,57 @@ static void
 faillits (void)
 {
   unsigned i, j, old_trail_count, common, saved_count;
-  unsigned new_saved_size, oldladded = ladded;
+  unsigned new_saved_size, oldladded = ps->ladded;
   unsigned long long limit, delta;
   Lit * lit, * other, * pivot;
   int new_trail_count;
   Rnk * r, ** p, ** q;
   Var * v;
 
-  if (heap + 1 >= hhead)
+  if (ps->heap + 1 >= ps->hhead)
     return;
 
-  if (propagations < fllimit)
+  if (ps->propagations < ps->fllimit)
     return;
 
-  flcalls++;
+  ps->flcalls++;
 #ifdef STATSA
-  flrounds++;
+  ps->flrounds++;
 #endif
-  delta = propagations/10;
+  delta = ps->propagations/10;
   if (delta >= 100*1000*1000) delta = 100*1000*1000;
   else if (delta <= 100*1000) delta = 100*1000;
 
-  limit = propagations + delta;
-  fllimit = propagations;
+  limit = ps->propagations + delta;
+  ps->fllimit = ps->propagations;
 
-  assert (!level);
-  assert (simplifying);
+  assert (!ps->level);
+  assert (ps->simplifying);
 
-  if (flcalls <= 1)
-    sort (Rnk *, cmp_inverse_jwh_rnk, heap + 1, hhead - (heap + 1));
+  if (ps->flcalls <= 1)
+    sort (Rnk *, cmp_inverse_jwh_rnk, ps->heap + 1, ps->hhead - (ps->heap + 1));
   else
-    sort (Rnk *, cmp_inverse_rnk, heap + 1, hhead - (heap + 1));
+    sort (Rnk *, cmp_inverse_rnk, ps->heap + 1, ps->hhead - (ps->heap + 1));
 
   i = 1;		/* NOTE: heap starts at position '1' */
 
-  while (propagations < limit)
+  while (ps->propagations < limit)
     {
-      if (heap + i == hhead)
+      if (ps->heap + i == ps->hhead)
 	{
-	  if (ladded == oldladded)
+	  if (ps->ladded == oldladded)
 	    break;
 
 	  i = 1;
 #ifdef STATS
-	  flrounds++;
+	  ps->flrounds++;
 #endif
-	  oldladded = ladded;
+	  oldladded = ps->ladded;
 	}
 
-      assert (heap + i < hhead);
+      assert (ps->heap + i < ps->hhead);
 
-      r = heap[i++];
+      r = ps->heap[i++];
       lit = RNK2LIT (r);
 
       if (lit->val)
@@ -5113,45 +5121,45 @@ faillits (void)
       if (!lit_has_binary_clauses (NOTLIT (lit)))
 	{
 #ifdef STATS
-	  flskipped++;
+	  ps->flskipped++;
 #endif
 	  continue;
 	}
 
 #ifdef STATS
-      fltried++;
+      ps->fltried++;
 #endif
-      LOG (fprintf (out, "%strying %d as failed literal\n",
-	    prefix, lit2int (lit)));
+      LOG (fprintf (ps->out, "%strying %d as failed literal\n",
+	    ps->prefix, lit2int (lit)));
 
       assign_decision (lit);
-      old_trail_count = thead - trail;
+      old_trail_count = ps->thead - ps->trail;
       flbcp ();
 
-      if (conflict)
+      if (ps->conflict)
 	{
 EXPLICITLY_FAILED_LITERAL:
-	  LOG (fprintf (out, "%sfound explicitly failed literal %d\n",
-		prefix, lit2int (lit)));
+	  LOG (fprintf (ps->out, "%sfound explicitly failed literal %d\n",
+		ps->prefix, lit2int (lit)));
 
-	  failedlits++;
-	  efailedlits++;
+	  ps->failedlits++;
+	  ps->efailedlits++;
 
 	  backtrack ();
 	  flbcp ();
 
-	  if (!conflict)
+	  if (!ps->conflict)
 	    continue;
 
 CONTRADICTION:
-	  assert (!level);
+	  assert (!ps->level);
 	  backtrack ();
-	  assert (mtcls);
+	  assert (ps->mtcls);
 
 	  goto RETURN;
 	}
 
-      if (propagations >= limit)
+      if (ps->propagations >= limit)
 	{
 	  undo (0);
 	  break;
@@ -5162,35 +5170,35 @@ CONTRADICTION:
       if (!lit_has_binary_clauses (NOTLIT (lit)))
 	{
 #ifdef STATS
-	  flskipped++;
+	  ps->flskipped++;
 #endif
 	  undo (0);
 	  continue;
 	}
 
 #ifdef STATS
-      fltried++;
+      ps->fltried++;
 #endif
-      LOG (fprintf (out, "%strying %d as failed literals\n",
-	    prefix, lit2int (lit)));
+      LOG (fprintf (ps->out, "%strying %d as failed literals\n",
+	    ps->prefix, lit2int (lit)));
 
-      new_trail_count = thead - trail;
+      new_trail_count = ps->thead - ps->trail;
       saved_count = new_trail_count - old_trail_count;
 
-      if (saved_count > saved_size)
+      if (saved_count > ps->saved_size)
 	{
-	  new_saved_size = saved_size ? 2 * saved_size : 1;
+	  new_saved_size = ps->saved_size ? 2 * ps->saved_size : 1;
 	  while (saved_count > new_saved_size)
 	    new_saved_size *= 2;
 
-	  RESIZEN (saved, saved_size, new_saved_size);
-	  saved_size = new_saved_size;
+	  RESIZEN (ps->saved, ps->saved_size, new_saved_size);
+	  ps->saved_size = new_saved_size;
 	}
 
       for (j = 0; j < saved_count; j++)
 	{
-	  other = trail[old_trail_count + j];
-	  saved[j] = trail[old_trail_count + j];
+	  other = ps->trail[old_trail_count + j];
+	  ps->saved[j] = ps->trail[old_trail_count + j];
 	}
 
       undo (0);
@@ -5198,22 +5206,22 @@ CONTRADICTION:
       assign_decision (lit);
       flbcp ();
 
-      if (conflict)
+      if (ps->conflict)
 	goto EXPLICITLY_FAILED_LITERAL;
 
-      pivot = (thead - trail <= new_trail_count) ? lit : NOTLIT (lit);
+      pivot = (ps->thead - ps->trail <= new_trail_count) ? lit : NOTLIT (lit);
 
       common = 0;
       for (j = 0; j < saved_count; j++)
-	if ((other = saved[j])->val == TRUE)
-	  saved[common++] = other;
+	if ((other = ps->saved[j])->val == TRUE)
+	  ps->saved[common++] = other;
 
       undo (0);
 
       LOG (if (common)
-	    fprintf (out, 
+	    fprintf (ps->out, 
 		      "%sfound %d literals implied by %d and %d\n",
-		      prefix, common, 
+		      ps->prefix, common, 
 		      lit2int (NOTLIT (lit)), lit2int (lit)));
 
       for (j = 0; 
@@ -5223,19 +5231,19 @@ CONTRADICTION:
 	   * a dedicated analyzer.  Up to then we bound the number of
 	   * propagations in this loop as well.
 	   */
-	   && propagations < limit + delta
+	   && ps->propagations < limit + delta
 	   ; j++)
 	{
-	  other = saved[j];
+	  other = ps->saved[j];
 
 	  if (other->val == TRUE)
 	    continue;
 
 	  assert (!other->val);
 
-	  LOG (fprintf (out, 
+	  LOG (fprintf (ps->out, 
 			"%sforcing %d as forced implicitly failed literal\n",
-			prefix, lit2int (other)));
+			ps->prefix, lit2int (other)));
 
 	  assert (pivot != NOTLIT (other));
 	  assert (pivot != other);
@@ -5243,12 +5251,12 @@ CONTRADICTION:
 	  assign_decision (NOTLIT (other));
 	  flbcp ();
 
-	  assert (level == 1);
+	  assert (ps->level == 1);
 
-	  if (conflict)
+	  if (ps->conflict)
 	    {
 	      backtrack ();
-	      assert (!level);
+	      assert (!ps->level);
 	    }
 	  else
 	    {
@@ -5257,16 +5265,16 @@ CONTRADICTION:
 
 	      backtrack ();
 
-	      if (level)
+	      if (ps->level)
 		{
-		  assert (level == 1);
+		  assert (ps->level == 1);
 
 		  flbcp ();
 
-		  if (conflict)
+		  if (ps->conflict)
 		    {
 		      backtrack ();
-		      assert (!level);
+		      assert (!ps->level);
 		    }
 		  else
 		    {
@@ -5274,15 +5282,15 @@ CONTRADICTION:
 		      flbcp ();
 		      backtrack ();
 
-		      if (level)
+		      if (ps->level)
 			{
-			  assert (level == 1);
+			  assert (ps->level == 1);
 			  flbcp ();
 
-			  if (!conflict)
+			  if (!ps->conflict)
 			    {
 #ifdef STATS
-			      floopsed++;
+			      ps->floopsed++;
 #endif
 			      undo (0);
 			      continue;
@@ -5291,35 +5299,35 @@ CONTRADICTION:
 			  backtrack ();
 			}
 
-		      assert (!level);
+		      assert (!ps->level);
 		    }
 
-		  assert (!level);
+		  assert (!ps->level);
 		}
 	    }
-	  assert (!level);
+	  assert (!ps->level);
 	  flbcp ();
 
-	  failedlits++;
-	  ifailedlits++;
+	  ps->failedlits++;
+	  ps->ifailedlits++;
 
-	  if (conflict)
+	  if (ps->conflict)
 	    goto CONTRADICTION;
 	}
     }
 
-  fllimit += 9 * (propagations - fllimit);	/* 10% for failed literals */
+  ps->fllimit += 9 * (ps->propagations - ps->fllimit);	/* 10% for failed literals */
 
 RETURN:
 
   /* First flush top level assigned literals.  Those are prohibited from
    * being pushed up the heap during 'faillits' since 'simplifying' is set.
    */
-  assert (heap < hhead);
-  for (p = q = heap + 1; p < hhead; p++)
+  assert (ps->heap < ps->hhead);
+  for (p = q = ps->heap + 1; p < ps->hhead; p++)
     {
       r = *p;
-      v = vars + (r - rnks);
+      v = ps->vars + (r - ps->rnks);
       lit = RNK2LIT (r);
       if (lit->val)
        	r->pos = 0;
@@ -5329,9 +5337,9 @@ RETURN:
 
   /* Then resort with respect to EVSIDS score and fix positions.
    */
-  sort (Rnk *, cmp_inverse_rnk, heap + 1, hhead - (heap + 1));
-  for (p = heap + 1; p < hhead; p++)
-    (*p)->pos = p - heap;
+  sort (Rnk *, cmp_inverse_rnk, ps->heap + 1, ps->hhead - (ps->heap + 1));
+  for (p = ps->heap + 1; p < ps->hhead; p++)
+    (*p)->pos = p - ps->heap;
 }
 
 #endif
@@ -5343,20 +5351,20 @@ simplify (void)
   size_t bytes_collected;
   Cls **p, *cls;
 
-  assert (!mtcls);
+  assert (!ps->mtcls);
   assert (!satisfied ());
-  assert (lsimplify <= propagations);
-  assert (fsimplify <= fixed);
+  assert (ps->lsimplify <= ps->propagations);
+  assert (ps->fsimplify <= ps->fixed);
 
 #ifndef NFL
-  if (level)
+  if (ps->level)
     undo (0);
 
-  simplifying = 1;
+  ps->simplifying = 1;
   faillits ();
-  simplifying = 0;
+  ps->simplifying = 0;
 
-  if (mtcls)
+  if (ps->mtcls)
     return;
 #endif
 
@@ -5387,16 +5395,16 @@ simplify (void)
     {
       bytes_collected = collect_clauses ();
 #ifdef STATS
-      srecycled += bytes_collected;
+      ps->srecycled += bytes_collected;
 #endif
     }
 
-  delta = 10 * (olits + llits) + 100000;
+  delta = 10 * (ps->olits + ps->llits) + 100000;
   if (delta > 2000000)
     delta = 2000000;
-  lsimplify = propagations + delta;
-  fsimplify = fixed;
-  simps++;
+  ps->lsimplify = ps->propagations + delta;
+  ps->fsimplify = ps->fixed;
+  ps->simps++;
 
   report (1, 's');
 }
@@ -5404,19 +5412,19 @@ simplify (void)
 static void
 iteration (void)
 {
-  assert (!level);
+  assert (!ps->level);
   assert (bcp_queue_is_empty ());
-  assert (isimplify < fixed);
+  assert (ps->isimplify < ps->fixed);
 
-  iterations++;
+  ps->iterations++;
   report (2, 'i');
 #ifdef NLUBY
-  drestart = MINRESTART;
-  lrestart = conflicts + drestart;
+  ps->drestart = MINRESTART;
+  ps->lrestart = ps->conflicts + ps->drestart;
 #else
   init_restart ();
 #endif
-  isimplify = fixed;
+  ps->isimplify = ps->fixed;
 }
 
 static int
@@ -5456,20 +5464,20 @@ reduce (unsigned percentage)
   Cls **p, *cls;
   Act minact;
 
-  lastreduceconflicts = conflicts;
+  ps->lastreduceconflicts = ps->conflicts;
 
   assert (percentage <= 100);
-  LOG (fprintf (out, 
+  LOG (fprintf (ps->out, 
                 "%sreducing %u%% learned clauses\n",
-		prefix, percentage));
+		ps->prefix, percentage));
 
-  while (nlclauses - llocked > (unsigned)(eor - resolved))
-    ENLARGE (resolved, rhead, eor);
+  while (ps->nlclauses - ps->llocked > (unsigned)(ps->eor - ps->resolved))
+    ENLARGE (ps->resolved, ps->rhead, ps->eor);
 
   collect = 0;
   lcollect = 0;
 
-  for (p = ((fsimplify < fixed) ? SOC : lclauses); p != EOC; p = NXC (p))
+  for (p = ((ps->fsimplify < ps->fixed) ? SOC : ps->lclauses); p != EOC; p = NXC (p))
     {
       cls = *p;
       if (!cls)
@@ -5484,7 +5492,7 @@ reduce (unsigned percentage)
 	continue;
 
       assert (!cls->collect);
-      if (fsimplify < fixed && clause_is_toplevel_satisfied (cls))
+      if (ps->fsimplify < ps->fixed && clause_is_toplevel_satisfied (cls))
 	{
 	  mark_clause_to_be_collected (cls);
 	  collect++;
@@ -5504,22 +5512,22 @@ reduce (unsigned percentage)
       if (cls->size <= 2)
 	continue;
 
-      assert (rhead < eor);
-      *rhead++ = cls;
+      assert (ps->rhead < ps->eor);
+      *ps->rhead++ = cls;
     }
-  assert (rhead <= eor);
+  assert (ps->rhead <= ps->eor);
 
-  fsimplify = fixed;
+  ps->fsimplify = ps->fixed;
 
-  rcount = rhead - resolved;
-  sort (Cls *, cmp_activity, resolved, rcount);
+  rcount = ps->rhead - ps->resolved;
+  sort (Cls *, cmp_activity, ps->resolved, rcount);
 
-  assert (nlclauses >= lcollect);
-  target = nlclauses - lcollect + 1;
+  assert (ps->nlclauses >= lcollect);
+  target = ps->nlclauses - lcollect + 1;
 
   for (ld = 1; ld < 32 && ((unsigned) (1 << ld)) < target; ld++)
     ;
-  minact = mulflt (cinc, base2flt (1, -ld));
+  minact = mulflt (ps->cinc, base2flt (1, -ld));
 
   target = (percentage * target + 99) / 100;
 
@@ -5527,26 +5535,26 @@ reduce (unsigned percentage)
     {
       target = rcount;
     }
-  else if (*CLS2ACT (resolved[target]) < minact)
+  else if (*CLS2ACT (ps->resolved[target]) < minact)
     {
       /* If the distribution of clause activities is skewed and the median
        * is actually below the maximum average activity, then we collect all
        * clauses below this activity.
        */
-      while (++target < rcount && *CLS2ACT (resolved[target]) < minact)
+      while (++target < rcount && *CLS2ACT (ps->resolved[target]) < minact)
         ;
     }
   else
     {
       while (target > 0 && 
-	     !cmp_activity (resolved[target - 1], resolved[target]))
+	     !cmp_activity (ps->resolved[target - 1], ps->resolved[target]))
 	target--;
     }
 
-  rhead = resolved + target;
-  while (rhead > resolved)
+  ps->rhead = ps->resolved + target;
+  while (ps->rhead > ps->resolved)
     {
-      cls = *--rhead;
+      cls = *--ps->rhead;
       mark_clause_to_be_collected (cls);
 
       collect++;
@@ -5556,10 +5564,10 @@ reduce (unsigned percentage)
 
   if (collect)
     {
-      reductions++;
+      ps->reductions++;
       bytes_collected = collect_clauses ();
 #ifdef STATS
-      rrecycled += bytes_collected;
+      ps->rrecycled += bytes_collected;
 #endif
       report (2, '-');
     }
@@ -5567,35 +5575,35 @@ reduce (unsigned percentage)
   if (!lcollect)
     inc_lreduce ();		/* avoid dead lock */
 
-  assert (rhead == resolved);
+  assert (ps->rhead == ps->resolved);
 }
 
 static void
 init_reduce (void)
 {
-  lreduce = loadded / 2;
+  ps->lreduce = ps->loadded / 2;
 
-  if (lreduce < 100)
-    lreduce = 100;
+  if (ps->lreduce < 100)
+    ps->lreduce = 100;
 
 #if 0
-  if (lreduce > 10000)
-    lreduce = 10000;
+  if (ps->lreduce > 10000)
+    ps->lreduce = 10000;
 #endif
 
-  if (verbosity)
-    fprintf (out, 
+  if (ps->verbosity)
+    fprintf (ps->out, 
              "%s\n%sinitial reduction limit %u clauses\n%s\n",
-	     prefix, prefix, lreduce, prefix);
+	     ps->prefix, ps->prefix, ps->lreduce, ps->prefix);
 }
 
 static unsigned
 rng (void)
 {
-  unsigned res = srng;
-  srng *= 1664525u;
-  srng += 1013904223u;
-  NOLOG (fprintf (out, "%srng () = %u\n", prefix, res));
+  unsigned res = ps->srng;
+  ps->srng *= 1664525u;
+  ps->srng += 1013904223u;
+  NOLOG (fprintf (ps->out, "%srng () = %u\n", ps->prefix, res));
   return res;
 }
 
@@ -5611,7 +5619,7 @@ rrng (unsigned low, unsigned high)
   tmp >>= 32;
   tmp += low;
   res = tmp;
-  NOLOG (fprintf (out, "%srrng (%u, %u) = %u\n", prefix, low, high, res));
+  NOLOG (fprintf (ps->out, "%srrng (%u, %u) = %u\n", ps->prefix, low, high, res));
   assert (low <= res);
   assert (res <= high);
   return res;
@@ -5627,18 +5635,18 @@ decide_phase (Lit * lit)
   if (!v->assigned)
     {
 #ifdef STATS
-      staticphasedecisions++;
+      ps->staticphasedecisions++;
 #endif
-      if (defaultphase == 1)
+      if (ps->defaultphase == 1)
 	{
 	  /* assign to TRUE */
 	}
-      else if (defaultphase == 0)
+      else if (ps->defaultphase == 0)
 	{
 	  /* assign to FALSE */
 	  lit = not_lit;
 	}
-      else if (defaultphase == 3)
+      else if (ps->defaultphase == 3)
 	{
 	  /* randomly assign default phase */
 	  if (rrng (1, 2) != 2)
@@ -5711,32 +5719,32 @@ rdecide (void)
   if (rrng (1, spread) != 2)
     return 0;
 
-  assert (1 <= max_var);
-  idx = rrng (1, max_var);
+  assert (1 <= ps->max_var);
+  idx = rrng (1, ps->max_var);
   res = int2lit (idx);
 
   if (res->val != UNDEF)
     {
-      delta = rrng (1, max_var);
-      while (gcd (delta, max_var) != 1)
+      delta = rrng (1, ps->max_var);
+      while (gcd (delta, ps->max_var) != 1)
 	delta--;
 
       assert (1 <= delta);
-      assert (delta <= max_var);
+      assert (delta <= ps->max_var);
 
       do {
 	idx += delta;
-	if (idx > max_var)
-	  idx -= max_var;
+	if (idx > ps->max_var)
+	  idx -= ps->max_var;
 	res = int2lit (idx);
       } while (res->val != UNDEF);
     }
 
 #ifdef STATS
-  rdecisions++;
+  ps->rdecisions++;
 #endif
   res = decide_phase (res);
-  LOG (fprintf (out, "%srdecide %d\n", prefix, lit2int (res)));
+  LOG (fprintf (ps->out, "%srdecide %d\n", ps->prefix, lit2int (res)));
 
   return res;
 }
@@ -5754,19 +5762,19 @@ sdecide (void)
       if (res->val == UNDEF) break;
       tmp = hpop ();
       assert (tmp == r);
-      NOLOG (fprintf (out, 
+      NOLOG (fprintf (ps->out, 
                       "%shpop %u %u %u\n",
-		      prefix, r - rnks,
+		      ps->prefix, r - ps->rnks,
 		      FLTMANTISSA(r->score),
 		      FLTEXPONENT(r->score)));
     }
 
 #ifdef STATS
-  sdecisions++;
+  ps->sdecisions++;
 #endif
   res = decide_phase (res);
 
-  LOG (fprintf (out, "%ssdecide %d\n", prefix, lit2int (res)));
+  LOG (fprintf (ps->out, "%ssdecide %d\n", ps->prefix, lit2int (res)));
 
   return res;
 }
@@ -5777,22 +5785,22 @@ adecide (void)
   Lit *lit;
   Var * v;
 
-  assert (als < alshead);
-  assert (!failed_assumption);
+  assert (ps->als < ps->alshead);
+  assert (!ps->failed_assumption);
 
-  while (alstail < alshead)
+  while (ps->alstail < ps->alshead)
     {
-      lit = *alstail++;
+      lit = *ps->alstail++;
 
       if (lit->val == FALSE)
 	{
-	  failed_assumption = lit;
+	  ps->failed_assumption = lit;
 	  v = LIT2VAR (lit);
 
 	  use_var (v);
 
-	  LOG (fprintf (out, "%sfirst failed assumption %d\n",
-			prefix, lit2int (failed_assumption)));
+	  LOG (fprintf (ps->out, "%sfirst failed assumption %d\n",
+			ps->prefix, lit2int (ps->failed_assumption)));
 	  fanalyze ();
 	  return 0;
 	}
@@ -5800,16 +5808,16 @@ adecide (void)
       if (lit->val == TRUE)
 	{
 	  v = LIT2VAR (lit);
-	  if (v->level > adecidelevel)
-	    adecidelevel = v->level;
+	  if (v->level > ps->adecidelevel)
+	    ps->adecidelevel = v->level;
 	  continue;
 	}
 
 #ifdef STATS
-      assumptions++;
+      ps->assumptions++;
 #endif
-      LOG (fprintf (out, "%sadecide %d\n", prefix, lit2int (lit)));
-      adecidelevel = level + 1;
+      LOG (fprintf (ps->out, "%sadecide %d\n", ps->prefix, lit2int (lit)));
+      ps->adecidelevel = ps->level + 1;
 
       return lit;
     }
@@ -5823,11 +5831,11 @@ decide (void)
   Lit * lit;
 
   assert (!satisfied ());
-  assert (!conflict);
+  assert (!ps->conflict);
 
-  if (alstail < alshead && (lit = adecide ()))
+  if (ps->alstail < ps->alshead && (lit = adecide ()))
     ;
-  else if (failed_assumption)
+  else if (ps->failed_assumption)
     return;
   else if (satisfied ())
     return;
@@ -5837,8 +5845,8 @@ decide (void)
   assert (lit);
   assign_decision (lit);
 
-  levelsum += level;
-  decisions++;
+  ps->levelsum += ps->level;
+  ps->decisions++;
 }
 
 static int
@@ -5846,22 +5854,22 @@ sat (int l)
 {
   int count = 0, backtracked;
 
-  if (!conflict)
+  if (!ps->conflict)
     bcp ();
 
-  if (conflict)
+  if (ps->conflict)
     backtrack ();
 
-  if (mtcls)
+  if (ps->mtcls)
     return PICOSAT_UNSATISFIABLE;
 
   if (satisfied ())
     goto SATISFIED;
 
-  if (lsimplify <= propagations)
+  if (ps->lsimplify <= ps->propagations)
     simplify ();
 
-  if (mtcls)
+  if (ps->mtcls)
     return PICOSAT_UNSATISFIABLE;
 
   if (satisfied ())
@@ -5869,20 +5877,20 @@ sat (int l)
 
   init_restart ();
 
-  isimplify = fixed;
+  ps->isimplify = ps->fixed;
   backtracked = 0;
 
   for (;;)
     {
-      if (!conflict)
+      if (!ps->conflict)
 	bcp ();
 
-      if (conflict)
+      if (ps->conflict)
 	{
 	  incincs ();
 	  backtrack ();
 
-	  if (mtcls)
+	  if (ps->mtcls)
 	    return PICOSAT_UNSATISFIABLE;
 	  backtracked = 1;
 	  continue;
@@ -5901,51 +5909,51 @@ SATISFIED:
       if (backtracked)
 	{
 	  backtracked = 0;
-	  if (!level && isimplify < fixed)
+	  if (!ps->level && ps->isimplify < ps->fixed)
 	    iteration ();
 	}
 
       if (l >= 0 && count >= l)		/* decision limit reached ? */
 	return PICOSAT_UNKNOWN;
 
-      if (propagations >= lpropagations)/* propagation limit reached ? */
+      if (ps->propagations >= ps->lpropagations)/* propagation limit reached ? */
 	return PICOSAT_UNKNOWN;
 
 #ifndef NADC
-      if (!adodisabled && adoconflicts >= adoconflictlimit)
+      if (!ps->adodisabled && ps->adoconflicts >= ps->adoconflictlimit)
 	{
 	  assert (bcp_queue_is_empty ());
 	  return PICOSAT_UNKNOWN;
 	}
 #endif
 
-      if (fsimplify < fixed && lsimplify <= propagations)
+      if (ps->fsimplify < ps->fixed && ps->lsimplify <= ps->propagations)
 	{
 	  simplify ();
 	  if (!bcp_queue_is_empty ())
 	    continue;
 #ifndef NFL
-	  if (mtcls)
+	  if (ps->mtcls)
 	    return PICOSAT_UNSATISFIABLE;
 
 	  if (satisfied ())
 	    return PICOSAT_SATISFIABLE;
 
-	  assert (!level);
+	  assert (!ps->level);
 #endif
 	}
 
-      if (!lreduce)
+      if (!ps->lreduce)
 	init_reduce ();
 
       if (need_to_reduce ())
 	reduce (50);
 
-      if (conflicts >= lrestart && level > 2)
+      if (ps->conflicts >= ps->lrestart && ps->level > 2)
 	restart ();
 
       decide ();
-      if (failed_assumption)
+      if (ps->failed_assumption)
 	return PICOSAT_UNSATISFIABLE;
       count++;
     }
@@ -5957,12 +5965,12 @@ rebias (void)
   Cls ** p, * c;
   Var * v;
 
-  for (v = vars + 1; v <= vars + max_var; v++)
+  for (v = ps->vars + 1; v <= ps->vars + ps->max_var; v++)
     v->assigned = 0;
 
-  memset (jwh, 0, 2 * (max_var + 1) * sizeof *jwh);
+  memset (ps->jwh, 0, 2 * (ps->max_var + 1) * sizeof *ps->jwh);
 
-  for (p = oclauses; p < ohead; p++) 
+  for (p = ps->oclauses; p < ps->ohead; p++) 
     {
       c = *p;
 
@@ -5983,32 +5991,32 @@ core (void)
 {
   unsigned idx, prev, this, delta, i, lcore, vcore;
   unsigned *stack, *shead, *eos;
-  Lit **q, **eol, *lit;
+  Lit **q, **ps->eol, *lit;
   Cls *cls, *reason;
   Znt *p, byte;
   Zhn *zhain;
   Var *v;
 
-  assert (trace);
+  assert (ps->trace);
 
-  assert (mtcls || failed_assumption);
-  if (ocore >= 0)
-    return ocore;
+  assert (ps->mtcls || ps->failed_assumption);
+  if (ps->ocore >= 0)
+    return ps->ocore;
 
-  lcore = ocore = vcore = 0;
+  lcore = ps->ocore = vcore = 0;
 
   stack = shead = eos = 0;
   ENLARGE (stack, shead, eos);
 
-  if (mtcls)
+  if (ps->mtcls)
     {
-      idx = CLS2IDX (mtcls);
+      idx = CLS2IDX (ps->mtcls);
       *shead++ = idx;
     }
   else
     {
-      assert (failed_assumption);
-      v = LIT2VAR (failed_assumption);
+      assert (ps->failed_assumption);
+      v = LIT2VAR (ps->failed_assumption);
       reason = v->reason;
       assert (reason);
       idx = CLS2IDX (reason);
@@ -6067,10 +6075,10 @@ core (void)
 	    continue;
 
 	  cls->core = 1;
-	  ocore++;
+	  ps->ocore++;
 
-	  eol = end_of_lits (cls);
-	  for (q = cls->lits; q < eol; q++)
+	  ps->eol = end_of_lits (cls);
+	  for (q = cls->lits; q < ps->eol; q++)
 	    {
 	      lit = *q;
 	      v = LIT2VAR (lit);
@@ -6080,8 +6088,8 @@ core (void)
 	      v->core = 1;
 	      vcore++;
 
-	      if (!failed_assumption) continue;
-	      if (lit != failed_assumption) continue;
+	      if (!ps->failed_assumption) continue;
+	      if (lit != ps->failed_assumption) continue;
 
 	      reason = v->reason;
 	      if (!reason) continue;
@@ -6097,16 +6105,16 @@ core (void)
 
   DELETEN (stack, eos - stack);
 
-  if (verbosity)
-    fprintf (out,
+  if (ps->verbosity)
+    fprintf (ps->out,
 	     "%s%u core variables out of %u (%.1f%%)\n"
 	     "%s%u core original clauses out of %u (%.1f%%)\n"
 	     "%s%u core learned clauses out of %u (%.1f%%)\n",
-	     prefix, vcore, max_var, PERCENT (vcore, max_var),
-	     prefix, ocore, oadded, PERCENT (ocore, oadded),
-	     prefix, lcore, ladded, PERCENT (lcore, ladded));
+	     ps->prefix, vcore, ps->max_var, PERCENT (vcore, ps->max_var),
+	     ps->prefix, ps->ocore, ps->oadded, PERCENT (ps->ocore, ps->oadded),
+	     ps->prefix, lcore, ps->ladded, PERCENT (lcore, ps->ladded));
 
-  return ocore;
+  return ps->ocore;
 }
 
 static void
@@ -6133,12 +6141,12 @@ write_unsigned (unsigned d, FILE * file)
 static void
 trace_lits (Cls * cls, FILE * file)
 {
-  Lit **p, **eol = end_of_lits (cls);
+  Lit **p, **ps->eol = end_of_lits (cls);
 
   assert (cls);
   assert (cls->core);
 
-  for (p = cls->lits; p < eol; p++)
+  for (p = cls->lits; p < ps->eol; p++)
     {
       write_int (LIT2INT (*p), file);
       fputc (' ', file);
@@ -6226,10 +6234,10 @@ trace_zhain (unsigned idx, Zhn * zhain, FILE * file, int fmt)
 static void
 write_core (FILE * file)
 {
-  Lit **q, **eol;
+  Lit **q, **ps->eol;
   Cls **p, *cls;
 
-  fprintf (file, "p cnf %u %u\n", max_var, core ());
+  fprintf (file, "p cnf %u %u\n", ps->max_var, core ());
 
   for (p = SOC; p != EOC; p = NXC (p))
     {
@@ -6238,8 +6246,8 @@ write_core (FILE * file)
       if (!cls || cls->learned || !cls->core)
 	continue;
 
-      eol = end_of_lits (cls);
-      for (q = cls->lits; q < eol; q++)
+      ps->eol = end_of_lits (cls);
+      for (q = cls->lits; q < ps->eol; q++)
 	{
 	  write_int (LIT2INT (*q), file);
 	  fputc (' ', file);
@@ -6263,8 +6271,8 @@ write_trace (FILE * file, int fmt)
 
   if (fmt == RUP_TRACE_FMT)
     {
-      rupvariables = picosat_variables (),
-      rupclauses = picosat_added_original_clauses ();
+      ps->rupvariables = picosat_variables (),
+      ps->rupclauses = picosat_added_original_clauses ();
       write_rup_header (file);
     }
 
@@ -6272,15 +6280,15 @@ write_trace (FILE * file, int fmt)
     {
       cls = *p;
 
-      if (oclauses <= p && p < eoo)
+      if (ps->oclauses <= p && p < ps->eoo)
 	{
-	  i = OIDX2IDX (p - oclauses);
+	  i = OIDX2IDX (p - ps->oclauses);
 	  assert (!cls || CLS2IDX (cls) == i);
 	}
       else
 	{
-          assert (lclauses <= p && p < eol);
-	  i = LIDX2IDX (p - lclauses);
+          assert (ps->lclauses <= p && p < ps->eol);
+	  i = LIDX2IDX (p - ps->lclauses);
 	}
 
       zhain = IDX2ZHN (i);
@@ -6326,7 +6334,7 @@ import_lit (int lit)
 {
   ABORTIF (lit == INT_MIN, "API usage: INT_MIN literal");
 
-  while (abs (lit) > (int) max_var)
+  while (abs (lit) > (int) ps->max_var)
     inc_max_var ();
 
   return int2lit (lit);
@@ -6340,18 +6348,18 @@ reset_core (void)
   Zhn ** q, * z;
   unsigned i;
 
-  for (i = 1; i <= max_var; i++)
-    vars[i].core = 0;
+  for (i = 1; i <= ps->max_var; i++)
+    ps->vars[i].core = 0;
 
   for (p = SOC; p != EOC; p = NXC (p))
     if ((c = *p))
       c->core = 0;
 
-  for (q = zhains; q != zhead; q++)
+  for (q = ps->zhains; q != ps->zhead; q++)
     if ((z = *q))
       z->core = 0;
 
-  ocore = -1;
+  ps->ocore = -1;
 }
 #endif
 
@@ -6360,42 +6368,42 @@ reset_assumptions (void)
 {
   Lit ** p;
 
-  failed_assumption = 0;
+  ps->failed_assumption = 0;
 
-  if (extracted_all_failed_assumptions)
+  if (ps->extracted_all_failed_assumptions)
     {
-      for (p = als; p < alshead; p++)
+      for (p = ps->als; p < ps->alshead; p++)
 	LIT2VAR (*p)->failed = 0;
 
-      extracted_all_failed_assumptions = 0;
+      ps->extracted_all_failed_assumptions = 0;
     }
 
-  alstail = alshead = als;
-  adecidelevel = 0;
+  ps->alstail = ps->alshead = ps->als;
+  ps->adecidelevel = 0;
 }
 
 static void
 check_ready (void)
 {
-  ABORTIF (state == RESET, "API usage: uninitialized");
+  ABORTIF (!ps || ps->state == RESET, "API usage: uninitialized");
 }
 
 static void
 check_sat_state (void)
 {
-  ABORTIF (state != SAT, "API usage: expected to be in SAT state");
+  ABORTIF (ps->state != SAT, "API usage: expected to be in SAT state");
 }
 
 static void
 check_unsat_state (void)
 {
-  ABORTIF (state != UNSAT, "API usage: expected to be in UNSAT state");
+  ABORTIF (ps->state != UNSAT, "API usage: expected to be in UNSAT state");
 }
 
 static void
 check_sat_or_unsat_or_unknown_state (void)
 {
-  ABORTIF (state != SAT && state != UNSAT && state != UNKNOWN,
+  ABORTIF (ps->state != SAT && ps->state != UNSAT && ps->state != UNKNOWN,
            "API usage: expected to be in SAT, UNSAT, or UNKNOWN state");
 }
 
@@ -6407,17 +6415,17 @@ reset_incremental_usage (void)
 
   check_sat_or_unsat_or_unknown_state ();
 
-  LOG (fprintf (out, "%sRESET incremental usage\n", prefix));
+  LOG (fprintf (ps->out, "%sRESET incremental usage\n", ps->prefix));
 
-  if (level)
+  if (ps->level)
     undo (0);
 
   reset_assumptions ();
 
-  if (conflict)
+  if (ps->conflict)
     { 
       num_non_false = 0;
-      for (q = conflict->lits; q < end_of_lits (conflict); q++)
+      for (q = ps->conflict->lits; q < end_of_lits (ps->conflict); q++)
 	{
 	  lit = *q;
 	  if (lit->val != FALSE)
@@ -6426,42 +6434,42 @@ reset_incremental_usage (void)
 
       // assert (num_non_false >= 2); // TODO: why this assertion?
 #ifdef NO_BINARY_CLAUSES
-      if (conflict == &cimpl)
+      if (ps->conflict == &ps->cimpl)
 	resetcimpl ();
 #endif
 #ifndef NADC
-      if (conflict == adoconflict)
+      if (ps->conflict == ps->adoconflict)
 	resetadoconflict ();
 #endif
-      conflict = 0;
+      ps->conflict = 0;
     }
 
 #ifdef TRACE
   reset_core ();
 #endif
 
-  saved_flips = flips;
-  min_flipped = UINT_MAX;
-  saved_max_var = max_var;
+  ps->saved_flips = ps->flips;
+  ps->min_flipped = UINT_MAX;
+  ps->saved_max_var = ps->max_var;
 
-  state = READY;
+  ps->state = READY;
 }
 
 static void
 enter (void)
 {
-  if (nentered++)
+  if (ps->nentered++)
     return;
 
   check_ready ();
-  entered = picosat_time_stamp ();
+  ps->entered = picosat_time_stamp ();
 }
 
 static void
 leave (void)
 {
-  assert (nentered);
-  if (--nentered)
+  assert (ps->nentered);
+  if (--ps->nentered)
     return;
 
   sflush ();
@@ -6473,7 +6481,7 @@ check_trace_support_and_execute (FILE * file, void (*f)(FILE*,int), int fmt)
   check_ready ();
   check_unsat_state ();
 #ifdef TRACE
-  ABORTIF (!trace, "API usage: tracing disabled");
+  ABORTIF (!ps->trace, "API usage: tracing disabled");
   enter ();
   f (file, fmt);
   leave ();
@@ -6493,21 +6501,21 @@ extract_all_failed_assumptions (void)
   int pos;
   Cls * c;
 
-  assert (!extracted_all_failed_assumptions);
+  assert (!ps->extracted_all_failed_assumptions);
 
-  assert (failed_assumption);
-  assert (mhead == marked);
+  assert (ps->failed_assumption);
+  assert (ps->mhead == ps->marked);
 
-  if (marked == eom)
-    ENLARGE (marked, mhead, eom);
+  if (ps->marked == ps->eom)
+    ENLARGE (ps->marked, ps->mhead, ps->eom);
 
-  v = LIT2VAR (failed_assumption);
+  v = LIT2VAR (ps->failed_assumption);
   mark_var (v);
   pos = 0;
 
-  while (pos < mhead - marked)
+  while (pos < ps->mhead - ps->marked)
     {
-      v = marked[pos++];
+      v = ps->marked[pos++];
       assert (v->mark);
       c = var2reason (v);
       if (!c)
@@ -6521,18 +6529,18 @@ extract_all_failed_assumptions (void)
 	}
     }
 
-  for (p = als; p < alshead; p++)
+  for (p = ps->als; p < ps->alshead; p++)
     {
       u = LIT2VAR (*p);
       if (!u->mark) continue;
       u->failed = 1;
-      LOG (fprintf (out, "%sfailed assumption %d\n", prefix, lit2int (*p)));
+      LOG (fprintf (ps->out, "%sfailed assumption %d\n", ps->prefix, lit2int (*p)));
     }
 
-  while (mhead > marked)
-    (*--mhead)->mark = 0;
+  while (ps->mhead > ps->marked)
+    (*--ps->mhead)->mark = 0;
 
-  extracted_all_failed_assumptions = 1;
+  ps->extracted_all_failed_assumptions = 1;
 }
 
 const char *
@@ -6541,12 +6549,41 @@ picosat_copyright (void)
   return "Copyright (c) 2006 - 2010 Armin Biere JKU Linz";
 }
 
+static PicoSAT *
+new_instance (void)
+{
+  PicoSAT * res = calloc (1, sizeof *res);
+  ABORTIF (!res, "out of memory in 'picosat_init'");
+#ifdef TRACE
+  res->ocore = -1;
+#endif
+  res->lastrheader = -2;
+#ifndef NADC
+  res->adoconflictlimit = UINT_MAX;
+#endif
+  res->min_flipped = UINT_MAX;
+  return res;
+}
+
 void
 picosat_init (void)
 {
+  ps = new_instance ();
   init ();
 }
 
+void *
+picosat_context (void)
+{
+  return ps;
+}
+
+void
+picosat_set_context (void * context)
+{
+  ps = context;
+}
+
 void
 picosat_adjust (int new_max_var)
 {
@@ -6557,10 +6594,10 @@ picosat_adjust (int new_max_var)
   new_max_var = abs (new_max_var);
   new_size_vars = new_max_var + 1;
 
-  if (size_vars < new_size_vars)
+  if (ps->size_vars < new_size_vars)
     enlarge (new_size_vars);
 
-  while (max_var < (unsigned) new_max_var)
+  while (ps->max_var < (unsigned) new_max_var)
     inc_max_var ();
 
   leave ();
@@ -6569,24 +6606,24 @@ picosat_adjust (int new_max_var)
 int
 picosat_inc_max_var (void)
 {
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     enter ();
   else
     check_ready ();
 
   inc_max_var ();
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     leave ();
 
-  return max_var;
+  return ps->max_var;
 }
 
 void
 picosat_set_verbosity (int new_verbosity_level)
 {
   check_ready ();
-  verbosity = new_verbosity_level;
+  ps->verbosity = new_verbosity_level;
 }
 
 int
@@ -6595,9 +6632,9 @@ picosat_enable_trace_generation (void)
   int res = 0;
   check_ready ();
 #ifdef TRACE
-  ABORTIF (addedclauses, 
+  ABORTIF (ps->addedclauses, 
            "API usage: trace generation enabled after adding clauses");
-  res = trace = 1;
+  res = ps->trace = 1;
 #endif
   return res;
 }
@@ -6606,24 +6643,24 @@ void
 picosat_set_incremental_rup_file (FILE * rup_file, int m, int n)
 {
   check_ready ();
-  assert (!rupstarted);
-  rup = rup_file;
-  rupvariables = m;
-  rupclauses = n;
+  assert (!ps->rupstarted);
+  ps->rup = rup_file;
+  ps->rupvariables = m;
+  ps->rupclauses = n;
 }
 
 void
 picosat_set_output (FILE * output_file)
 {
   check_ready ();
-  out = output_file;
+  ps->out = output_file;
 }
 
 void
 picosat_measure_all_calls (void)
 {
   check_ready ();
-  measurealltimeinlib = 1;
+  ps->measurealltimeinlib = 1;
 }
 
 void
@@ -6637,7 +6674,7 @@ void
 picosat_set_seed (unsigned s)
 {
   check_ready ();
-  srng = s;
+  ps->srng = s;
 }
 
 void
@@ -6645,26 +6682,28 @@ picosat_reset (void)
 {
   check_ready ();
   reset ();
+  free (ps);
+  ps = 0;
 }
 
 int
 picosat_add (int int_lit)
 {
-  int res = oadded;
+  int res = ps->oadded;
   Lit *lit;
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     enter ();
   else
     check_ready ();
 
-  ABORTIF (rup && rupstarted && oadded >= (unsigned)rupclauses,
+  ABORTIF (ps->rup && ps->rupstarted && ps->oadded >= (unsigned)ps->rupclauses,
            "API usage: adding too many clauses after RUP header written");
 #ifndef NADC
-  ABORTIF (addingtoado, 
+  ABORTIF (ps->addingtoado, 
            "API usage: 'picosat_add' and 'picosat_add_ado_lit' mixed");
 #endif
-  if (state != READY)
+  if (ps->state != READY)
     reset_incremental_usage ();
 
   lit = import_lit (int_lit);
@@ -6674,7 +6713,7 @@ picosat_add (int int_lit)
   else
     simplify_and_add_original_clause ();
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     leave ();
 
   return res;
@@ -6686,29 +6725,29 @@ picosat_add_ado_lit (int external_lit)
 #ifndef NADC
   Lit * internal_lit;
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     enter ();
   else
     check_ready ();
 
-  if (state != READY)
+  if (ps->state != READY)
     reset_incremental_usage ();
 
-  ABORTIF (!addingtoado && ahead > added,
+  ABORTIF (!ps->addingtoado && ps->ahead > ps->added,
            "API usage: 'picosat_add' and 'picosat_add_ado_lit' mixed");
 
   if (external_lit)
     {
-      addingtoado = 1;
+      ps->addingtoado = 1;
       internal_lit = import_lit (external_lit);
       add_lit (internal_lit);
     }
   else
     {
-      addingtoado = 0;
+      ps->addingtoado = 0;
       add_ado ();
     }
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     leave ();
 #else
   (void) external_lit;
@@ -6721,26 +6760,26 @@ picosat_assume (int int_lit)
 {
   Lit *lit;
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     enter ();
   else
     check_ready ();
 
-  if (state != READY)
+  if (ps->state != READY)
     reset_incremental_usage ();
 
   lit = import_lit (int_lit);
-  if (alshead == eoals)
+  if (ps->alshead == ps->eoals)
     {
-      assert (alstail == als);
-      ENLARGE (als, alshead, eoals);
-      alstail = als;
+      assert (ps->alstail == ps->als);
+      ENLARGE (ps->als, ps->alshead, ps->eoals);
+      ps->alstail = ps->als;
     }
 
-  *alshead++ = lit;
-  LOG (fprintf (out, "%sassumption %d\n", prefix, int_lit));
+  *ps->alshead++ = lit;
+  LOG (fprintf (ps->out, "%sassumption %d\n", ps->prefix, int_lit));
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     leave ();
 }
 
@@ -6752,52 +6791,52 @@ picosat_sat (int l)
 
   enter ();
 
-  calls++;
-  LOG (fprintf (out, "%sSTART call %u\n", prefix, calls));
+  ps->calls++;
+  LOG (fprintf (ps->out, "%sSTART call %u\n", ps->prefix, ps->calls));
 
-  if (added < ahead)
+  if (ps->added < ps->ahead)
     {
 #ifndef NADC
-      if (addingtoado)
+      if (ps->addingtoado)
 	ABORT ("API usage: incomplete all different constraint");
       else
 #endif
 	ABORT ("API usage: incomplete clause");
     }
 
-  if (state != READY)
+  if (ps->state != READY)
     reset_incremental_usage ();
 
   res = sat (l);
 
-  assert (state == READY);
+  assert (ps->state == READY);
 
   switch (res)
     {
     case PICOSAT_UNSATISFIABLE:
       ch = '0';
-      state = UNSAT;
+      ps->state = UNSAT;
       break;
     case PICOSAT_SATISFIABLE:
       ch = '1';
-      state = SAT;
+      ps->state = SAT;
       break;
     default:
       ch = '?';
-      state = UNKNOWN;
+      ps->state = UNKNOWN;
       break;
     }
 
-  if (verbosity)
+  if (ps->verbosity)
     {
       report (1, ch);
       rheader ();
     }
 
   leave ();
-  LOG (fprintf (out, "%sEND call %u\n", prefix, calls));
+  LOG (fprintf (ps->out, "%sEND call %u\n", ps->prefix, ps->calls));
 
-  last_sat_call_result = res;
+  ps->last_sat_call_result = res;
 
   return res;
 }
@@ -6805,7 +6844,7 @@ picosat_sat (int l)
 int
 picosat_res (void)
 {
-  return last_sat_call_result;
+  return ps->last_sat_call_result;
 }
 
 int
@@ -6816,13 +6855,13 @@ picosat_deref (int int_lit)
   check_ready ();
   check_sat_state ();
   ABORTIF (!int_lit, "API usage: can not deref zero literal");
-  ABORTIF (mtcls, "API usage: deref after empty clause generated");
+  ABORTIF (ps->mtcls, "API usage: deref after empty clause generated");
 
 #ifdef STATS
-  derefs++;
+  ps->derefs++;
 #endif
 
-  if (abs (int_lit) > (int) max_var)
+  if (abs (int_lit) > (int) ps->max_var)
     return 0;
 
   lit = int2lit (int_lit);
@@ -6844,12 +6883,12 @@ picosat_deref_toplevel (int int_lit)
 
   check_ready ();
   ABORTIF (!int_lit, "API usage: can not deref zero literal");
-  ABORTIF (mtcls, "API usage: deref after empty clause generated");
+  ABORTIF (ps->mtcls, "API usage: deref after empty clause generated");
 
 #ifdef STATS
-  derefs++;
+  ps->derefs++;
 #endif
-  if (abs (int_lit) > (int) max_var)
+  if (abs (int_lit) > (int) ps->max_var)
     return 0;
 
   lit = int2lit (int_lit);
@@ -6871,7 +6910,7 @@ int
 picosat_inconsistent (void)
 {
   check_ready ();
-  return mtcls != 0;
+  return ps->mtcls != 0;
 }
 
 int
@@ -6883,20 +6922,20 @@ picosat_corelit (int int_lit)
   check_unsat_state ();
   ABORTIF (!int_lit, "API usage: zero literal can not be in core");
 
-  assert (mtcls || failed_assumption);
+  assert (ps->mtcls || ps->failed_assumption);
 
   res = 0;
 
 #ifdef TRACE
   {
-    ABORTIF (!trace, "tracing disabled");
-    if (measurealltimeinlib)
+    ABORTIF (!ps->trace, "tracing disabled");
+    if (ps->measurealltimeinlib)
       enter ();
     core ();
-    if (abs (int_lit) <= (int) max_var)
-      res = vars[abs (int_lit)].core;
-    assert (!res || failed_assumption || vars[abs (int_lit)].used);
-    if (measurealltimeinlib)
+    if (abs (int_lit) <= (int) ps->max_var)
+      res = ps->vars[abs (int_lit)].core;
+    assert (!res || ps->failed_assumption || ps->vars[abs (int_lit)].used);
+    if (ps->measurealltimeinlib)
       leave ();
   }
 #else
@@ -6915,9 +6954,9 @@ picosat_coreclause (int ocls)
   check_unsat_state ();
 
   ABORTIF (ocls < 0, "API usage: negative original clause index");
-  ABORTIF (ocls >= (int)oadded, "API usage: original clause index exceeded");
+  ABORTIF (ocls >= (int)ps->oadded, "API usage: original clause index exceeded");
 
-  assert (mtcls || failed_assumption);
+  assert (ps->mtcls || ps->failed_assumption);
 
   res  = 0;
 
@@ -6925,16 +6964,16 @@ picosat_coreclause (int ocls)
   {
     Cls ** clsptr, * cls;
 
-    ABORTIF (!trace, "tracing disabled");
-    if (measurealltimeinlib)
+    ABORTIF (!ps->trace, "tracing disabled");
+    if (ps->measurealltimeinlib)
       enter ();
     core ();
-    clsptr = oclauses + ocls;
-    assert (clsptr < ohead);
+    clsptr = ps->oclauses + ocls;
+    assert (clsptr < ps->ohead);
     cls = *clsptr;
     if (cls) 
       res = cls->core;
-    if (measurealltimeinlib)
+    if (ps->measurealltimeinlib)
       leave ();
   }
 #else
@@ -6952,12 +6991,12 @@ picosat_failed_assumption (int int_lit)
   ABORTIF (!int_lit, "API usage: zero literal as assumption");
   check_ready ();
   check_unsat_state ();
-  if (mtcls)
+  if (ps->mtcls)
     return 0;
-  assert (failed_assumption);
-  if (abs (int_lit) > (int) max_var)
+  assert (ps->failed_assumption);
+  if (abs (int_lit) > (int) ps->max_var)
     return 0;
-  if (!extracted_all_failed_assumptions)
+  if (!ps->extracted_all_failed_assumptions)
     extract_all_failed_assumptions ();
   lit = import_lit (int_lit);
   v = LIT2VAR (lit);
@@ -6971,31 +7010,31 @@ picosat_failed_assumptions (void)
   Var * v;
   int ilit;
 
-  falshead = fals;
+  ps->falshead = ps->fals;
   check_ready ();
   check_unsat_state ();
-  if (!mtcls) 
+  if (!ps->mtcls) 
     {
-      assert (failed_assumption);
-      if (!extracted_all_failed_assumptions)
+      assert (ps->failed_assumption);
+      if (!ps->extracted_all_failed_assumptions)
 	extract_all_failed_assumptions ();
 
-      for (p = als; p < alshead; p++)
+      for (p = ps->als; p < ps->alshead; p++)
 	{
 	  lit = *p;
 	  v = LIT2VAR (*p);
 	  if (!v->failed)
 	    continue;
 	  ilit = LIT2INT (lit);
-	  if (falshead == eofals)
-	    ENLARGE (fals, falshead, eofals);
-	  *falshead++ = ilit;
+	  if (ps->falshead == ps->eofals)
+	    ENLARGE (ps->fals, ps->falshead, ps->eofals);
+	  *ps->falshead++ = ilit;
 	}
     }
-  if (falshead == eofals)
-    ENLARGE (fals, falshead, eofals);
-  *falshead++ = 0;
-  return fals;
+  if (ps->falshead == ps->eofals)
+    ENLARGE (ps->fals, ps->falshead, ps->eofals);
+  *ps->falshead++ = 0;
+  return ps->fals;
 }
 
 static const char * enumstr (int i) {
@@ -7009,7 +7048,7 @@ static const char * enumstr (int i) {
 const int *
 picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
 {
-  int i, j, ilit, len, oldlen, norig = alshead - als, nwork, * work, res;
+  int i, j, ilit, len, oldlen, norig = ps->alshead - ps->als, nwork, * work, res;
   signed char * redundant;
   Lit ** p, * lit;
   int failed;
@@ -7018,24 +7057,24 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
   check_ready ();
   check_unsat_state ();
   len = 0;
-  if (!mtcls) 
+  if (!ps->mtcls) 
     {
-      assert (failed_assumption);
-      if (!extracted_all_failed_assumptions)
+      assert (ps->failed_assumption);
+      if (!ps->extracted_all_failed_assumptions)
 	extract_all_failed_assumptions ();
 
-      for (p = als; p < alshead; p++)
+      for (p = ps->als; p < ps->alshead; p++)
 	if (LIT2VAR (*p)->failed)
 	  len++;
     }
 
-  if (mass)
-    DELETEN (mass, szmass);
-  szmass = len + 1;
-  NEWN (mass, szmass);
+  if (ps->mass)
+    DELETEN (ps->mass, ps->szmass);
+  ps->szmass = len + 1;
+  NEWN (ps->mass, ps->szmass);
 
   i = 0;
-  for (p = als; p < alshead; p++)
+  for (p = ps->als; p < ps->alshead; p++)
     {
       lit = *p;
       v = LIT2VAR (lit);
@@ -7043,21 +7082,21 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
 	continue;
       ilit = LIT2INT (lit);
       assert (i < len);
-      mass[i++] = ilit;
+      ps->mass[i++] = ilit;
     }
   assert (i == len);
-  mass[i] = 0;
-  if (verbosity)
-    fprintf (out, 
+  ps->mass[i] = 0;
+  if (ps->verbosity)
+    fprintf (ps->out, 
       "%sinitial set of failed assumptions of size %d out of %d (%.0f%%)\n",
-      prefix, len, norig, PERCENT (len, norig));
+      ps->prefix, len, norig, PERCENT (len, norig));
   if (cb)
-    cb (s, mass);
+    cb (s, ps->mass);
 
   nwork = len;
   NEWN (work, nwork);
   for (i = 0; i < len; i++)
-    work[i] = mass[i];
+    work[i] = ps->mass[i];
 
   NEWN (redundant, nwork);
   CLRN (redundant, nwork);
@@ -7067,10 +7106,10 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
       if (redundant[i])
 	continue;
 
-      if (verbosity > 1)
-	fprintf (out,
+      if (ps->verbosity > 1)
+	fprintf (ps->out,
 	         "%strying to drop %d%s assumption %d\n", 
-		 prefix, i, enumstr (i), work[i]);
+		 ps->prefix, i, enumstr (i), work[i]);
       for (j = 0; j < nwork; j++)
 	if (i != j && !redundant[j])
 	  picosat_assume (work[j]);
@@ -7078,10 +7117,10 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
       res = picosat_sat (-1);
       if (res == 10)
 	{
-	  if (verbosity > 1)
-	    fprintf (out,
+	  if (ps->verbosity > 1)
+	    fprintf (ps->out,
 		     "%sfailed to drop %d%s assumption %d\n", 
-		     prefix, i, enumstr (i), work[i]);
+		     ps->prefix, i, enumstr (i), work[i]);
 
 	  if (fix)
 	    {
@@ -7092,10 +7131,10 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
       else
 	{
 	  assert (res == 20);
-	  if (verbosity > 1)
-	    fprintf (out,
+	  if (ps->verbosity > 1)
+	    fprintf (ps->out,
 		     "%ssuceeded to drop %d%s assumption %d\n", 
-		     prefix, i, enumstr (i), work[i]);
+		     ps->prefix, i, enumstr (i), work[i]);
 	  redundant[i] = 1;
 	  for (j = 0; j < nwork; j++)
 	    {
@@ -7109,10 +7148,10 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
 	      if (!failed)
 		{
 		  redundant[j] = -1;
-		  if (verbosity > 1)
-		    fprintf (out,
+		  if (ps->verbosity > 1)
+		    fprintf (ps->out,
 			     "%salso suceeded to drop %d%s assumption %d\n", 
-			     prefix, j, enumstr (j), work[j]);
+			     ps->prefix, j, enumstr (j), work[j]);
 		}
 	    }
 
@@ -7120,8 +7159,8 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
 	    len = 0;
 	    for (j = 0; j < nwork; j++)
 	      if (!redundant[j])
-		mass[len++] = work[j];
-	    mass[len] = 0;
+		ps->mass[len++] = work[j];
+	    ps->mass[len] = 0;
 	    assert (len < oldlen);
 
 	    if (fix)
@@ -7148,26 +7187,26 @@ picosat_mus_assumptions (void * s, void (*cb)(void*,const int*), int fix)
 		redundant[j] = 1;
 	      }
 
-	    if (verbosity)
-	      fprintf (out, 
+	    if (ps->verbosity)
+	      fprintf (ps->out, 
 	"%sreduced set of failed assumptions of size %d out of %d (%.0f%%)\n",
-		prefix, len, norig, PERCENT (len, norig));
+		ps->prefix, len, norig, PERCENT (len, norig));
 	    if (cb)
-	      cb (s, mass);
+	      cb (s, ps->mass);
 	}
     }
 
   DELETEN (work, nwork);
   DELETEN (redundant, nwork);
 
-  if (verbosity)
-    fprintf (out, "%sreinitializaing unsat state", prefix);
+  if (ps->verbosity)
+    fprintf (ps->out, "%sreinitializaing unsat state", ps->prefix);
   for (i = 0; i < len; i++)
-    picosat_assume (mass[i]);
+    picosat_assume (ps->mass[i]);
   res = picosat_sat (-1);
   assert (res == 20);
 
-  return mass;
+  return ps->mass;
 }
 
 int
@@ -7178,7 +7217,7 @@ picosat_usedlit (int int_lit)
   check_sat_or_unsat_or_unknown_state ();
   ABORTIF (!int_lit, "API usage: zero literal can not be used");
   int_lit = abs (int_lit);
-  res = (int_lit <= (int) max_var) ? vars[int_lit].used : 0;
+  res = (int_lit <= (int) ps->max_var) ? ps->vars[int_lit].used : 0;
   return res;
 }
 
@@ -7212,33 +7251,33 @@ size_t
 picosat_max_bytes_allocated (void)
 {
   check_ready ();
-  return max_bytes;
+  return ps->max_bytes;
 }
 
 void
 picosat_set_propagation_limit (unsigned long long l)
 {
-  lpropagations = l;
+  ps->lpropagations = l;
 }
 
 unsigned long long
 picosat_propagations (void)
 {
-  return propagations;
+  return ps->propagations;
 }
 
 int
 picosat_variables (void)
 {
   check_ready ();
-  return (int) max_var;
+  return (int) ps->max_var;
 }
 
 int
 picosat_added_original_clauses (void)
 {
   check_ready ();
-  return (int) oadded;
+  return (int) ps->oadded;
 }
 
 void
@@ -7247,140 +7286,140 @@ picosat_stats (void)
   unsigned redlits;
 #ifdef STATS
   check_ready ();
-  assert (sdecisions + rdecisions + assumptions == decisions);
+  assert (ps->sdecisions + ps->rdecisions + ps->assumptions == ps->decisions);
 #endif
-  if (calls > 1)
-    fprintf (out, "%s%u calls\n", prefix, calls);
-  fprintf (out, "%s%u iterations\n", prefix, iterations);
-  fprintf (out, "%s%u restarts", prefix, restarts);
+  if (ps->calls > 1)
+    fprintf (ps->out, "%s%u calls\n", ps->prefix, ps->calls);
+  fprintf (ps->out, "%s%u iterations\n", ps->prefix, ps->iterations);
+  fprintf (ps->out, "%s%u restarts", ps->prefix, ps->restarts);
 #ifdef STATS
-  fprintf (out, " (%u skipped)", skippedrestarts);
+  fprintf (ps->out, " (%u skipped)", ps->skippedrestarts);
 #endif
-  fputc ('\n', out);
+  fputc ('\n', ps->out);
 #ifndef NFL
-  fprintf (out, "%s%u failed literals", prefix, failedlits);
+  fprintf (ps->out, "%s%u failed literals", ps->prefix, ps->failedlits);
 #ifdef STATS
-  fprintf (out,
+  fprintf (ps->out,
            ", %u calls, %u rounds, %llu propagations",
-           flcalls, flrounds, flprops);
+           ps->flcalls, ps->flrounds, ps->flprops);
 #endif
-  fputc ('\n', out);
+  fputc ('\n', ps->out);
 #ifdef STATS
-  fprintf (out, 
+  fprintf (ps->out, 
     "%sfl: %u = %.1f%% implicit, %llu oopsed, %llu tried, %llu skipped\n", 
-    prefix, 
-    ifailedlits, PERCENT (ifailedlits, failedlits),
-    floopsed, fltried, flskipped);
+    ps->prefix, 
+    ps->ifailedlits, PERCENT (ps->ifailedlits, ps->failedlits),
+    ps->floopsed, ps->fltried, ps->flskipped);
 #endif
 #endif
-  fprintf (out, "%s%u conflicts", prefix, conflicts);
+  fprintf (ps->out, "%s%u conflicts", ps->prefix, ps->conflicts);
 #ifdef STATS
-  fprintf (out, " (%u uips = %.1f%%)\n", uips, PERCENT(uips,conflicts));
+  fprintf (ps->out, " (%u uips = %.1f%%)\n", ps->uips, PERCENT(ps->uips,ps->conflicts));
 #else
-  fputc ('\n', out);
+  fputc ('\n', ps->out);
 #endif
 #ifndef NADC
-  fprintf (out, "%s%u adc conflicts\n", prefix, adoconflicts);
+  fprintf (ps->out, "%s%u adc conflicts\n", ps->prefix, ps->adoconflicts);
 #endif
 #ifdef STATS
-  fprintf (out, "%s%llu dereferenced literals\n", prefix, derefs);
+  fprintf (ps->out, "%s%llu dereferenced literals\n", ps->prefix, ps->derefs);
 #endif
-  fprintf (out, "%s%u decisions", prefix, decisions);
+  fprintf (ps->out, "%s%u decisions", ps->prefix, ps->decisions);
 #ifdef STATS
-  fprintf (out, " (%u random = %.2f%%",
-           rdecisions, PERCENT (rdecisions, decisions));
-  fprintf (out, ", %u assumptions", assumptions);
-  fputc (')', out);
+  fprintf (ps->out, " (%u random = %.2f%%",
+           ps->rdecisions, PERCENT (ps->rdecisions, ps->decisions));
+  fprintf (ps->out, ", %u assumptions", ps->assumptions);
+  fputc (')', ps->out);
 #endif
-  fputc ('\n', out);
+  fputc ('\n', ps->out);
 #ifdef STATS
-  fprintf (out,
+  fprintf (ps->out,
            "%s%u static phase decisions (%.1f%% of all variables)\n",
-	   prefix,
-	   staticphasedecisions, PERCENT (staticphasedecisions, max_var));
+	   ps->prefix,
+	   ps->staticphasedecisions, PERCENT (ps->staticphasedecisions, ps->max_var));
 #endif
-  fprintf (out, "%s%u fixed variables\n", prefix, fixed);
-  assert (nonminimizedllits >= minimizedllits);
-  redlits = nonminimizedllits - minimizedllits;
-  fprintf (out, "%s%u learned literals\n", prefix, llitsadded);
-  fprintf (out, "%s%.1f%% deleted literals\n",
-     prefix, PERCENT (redlits, nonminimizedllits));
+  fprintf (ps->out, "%s%u fixed variables\n", ps->prefix, ps->fixed);
+  assert (ps->nonminimizedllits >= ps->minimizedllits);
+  redlits = ps->nonminimizedllits - ps->minimizedllits;
+  fprintf (ps->out, "%s%u learned literals\n", ps->prefix, ps->llitsadded);
+  fprintf (ps->out, "%s%.1f%% deleted literals\n",
+     ps->prefix, PERCENT (redlits, ps->nonminimizedllits));
 
 #ifdef STATS
 #ifndef NO_BINARY_CLAUSES
-  fprintf (out,
+  fprintf (ps->out,
 	   "%s%llu antecedents (%.1f antecedents per clause",
-	   prefix, antecedents, AVERAGE (antecedents, conflicts));
+	   ps->prefix, ps->antecedents, AVERAGE (ps->antecedents, ps->conflicts));
 #endif
 #ifdef TRACE
-  if (trace)
-    fprintf (out, ", %.1f bytes/antecedent)", AVERAGE (znts, antecedents));
+  if (ps->trace)
+    fprintf (ps->out, ", %.1f bytes/antecedent)", AVERAGE (ps->znts, ps->antecedents));
 #endif
 #if !defined(NO_BINARY_CLAUSES) || defined(TRACE)
-  fputs (")\n", out);
+  fputs (")\n", ps->out);
 #endif
 
-  fprintf (out, "%s%llu propagations (%.1f propagations per decision)\n",
-           prefix, propagations, AVERAGE (propagations, decisions));
-  fprintf (out, "%s%llu visits (%.1f per propagation)\n",
-	   prefix, visits, AVERAGE (visits, propagations));
-  fprintf (out, 
+  fprintf (ps->out, "%s%llu propagations (%.1f propagations per decision)\n",
+           ps->prefix, ps->propagations, AVERAGE (ps->propagations, ps->decisions));
+  fprintf (ps->out, "%s%llu visits (%.1f per propagation)\n",
+	   ps->prefix, ps->visits, AVERAGE (ps->visits, ps->propagations));
+  fprintf (ps->out, 
            "%s%llu binary clauses visited (%.1f%% %.1f per propagation)\n",
-	   prefix, bvisits, 
-	   PERCENT (bvisits, visits),
-	   AVERAGE (bvisits, propagations));
-  fprintf (out, 
+	   ps->prefix, ps->bvisits, 
+	   PERCENT (ps->bvisits, ps->visits),
+	   AVERAGE (ps->bvisits, ps->propagations));
+  fprintf (ps->out, 
            "%s%llu ternary clauses visited (%.1f%% %.1f per propagation)\n",
-	   prefix, tvisits, 
-	   PERCENT (tvisits, visits),
-	   AVERAGE (tvisits, propagations));
-  fprintf (out, 
+	   ps->prefix, ps->tvisits, 
+	   PERCENT (ps->tvisits, ps->visits),
+	   AVERAGE (ps->tvisits, ps->propagations));
+  fprintf (ps->out, 
            "%s%llu large clauses visited (%.1f%% %.1f per propagation)\n",
-	   prefix, lvisits, 
-	   PERCENT (lvisits, visits),
-	   AVERAGE (lvisits, propagations));
-  fprintf (out, "%s%llu other true (%.1f%% of visited clauses)\n",
-	   prefix, othertrue, PERCENT (othertrue, visits));
-  fprintf (out, 
+	   ps->prefix, ps->lvisits, 
+	   PERCENT (ps->lvisits, ps->visits),
+	   AVERAGE (ps->lvisits, ps->propagations));
+  fprintf (ps->out, "%s%llu other true (%.1f%% of visited clauses)\n",
+	   ps->prefix, ps->othertrue, PERCENT (ps->othertrue, ps->visits));
+  fprintf (ps->out, 
            "%s%llu other true in binary clauses (%.1f%%)"
 	   ", %llu upper (%.1f%%)\n",
-           prefix, othertrue2, PERCENT (othertrue2, othertrue),
-	   othertrue2u, PERCENT (othertrue2u, othertrue2));
-  fprintf (out, 
+           ps->prefix, ps->othertrue2, PERCENT (ps->othertrue2, ps->othertrue),
+	   ps->othertrue2u, PERCENT (ps->othertrue2u, ps->othertrue2));
+  fprintf (ps->out, 
            "%s%llu other true in large clauses (%.1f%%)"
 	   ", %llu upper (%.1f%%)\n",
-           prefix, othertruel, PERCENT (othertruel, othertrue),
-	   othertruelu, PERCENT (othertruelu, othertruel));
-  fprintf (out, "%s%llu ternary and large traversals (%.1f per visit)\n",
-	   prefix, traversals, AVERAGE (traversals, visits));
-  fprintf (out, "%s%llu large traversals (%.1f per large visit)\n",
-	   prefix, ltraversals, AVERAGE (ltraversals, lvisits));
-  fprintf (out, "%s%llu assignments\n", prefix, assignments);
+           ps->prefix, ps->othertruel, PERCENT (ps->othertruel, ps->othertrue),
+	   ps->othertruelu, PERCENT (ps->othertruelu, ps->othertruel));
+  fprintf (ps->out, "%s%llu ternary and large traversals (%.1f per visit)\n",
+	   ps->prefix, ps->traversals, AVERAGE (ps->traversals, ps->visits));
+  fprintf (ps->out, "%s%llu large traversals (%.1f per large visit)\n",
+	   ps->prefix, ps->ltraversals, AVERAGE (ps->ltraversals, ps->lvisits));
+  fprintf (ps->out, "%s%llu assignments\n", ps->prefix, ps->assignments);
 #else
-  fprintf (out, "%s%llu propagations\n", prefix, picosat_propagations ());
+  fprintf (ps->out, "%s%llu propagations\n", ps->prefix, picosat_propagations ());
 #endif
-  fprintf (out, "%s%.1f%% variables used\n", prefix, PERCENT (vused, max_var));
+  fprintf (ps->out, "%s%.1f%% variables used\n", ps->prefix, PERCENT (ps->vused, ps->max_var));
 
   sflush ();
-  fprintf (out, "%s%.1f seconds in library\n", prefix, seconds);
-  fprintf (out, "%s%.1f megaprops/second\n",
-	   prefix, AVERAGE (propagations / 1e6f, seconds));
+  fprintf (ps->out, "%s%.1f seconds in library\n", ps->prefix, ps->seconds);
+  fprintf (ps->out, "%s%.1f megaprops/second\n",
+	   ps->prefix, AVERAGE (ps->propagations / 1e6f, ps->seconds));
 #ifdef STATS
-  fprintf (out, "%s%.1f million visits per second\n",
-	   prefix, AVERAGE (visits / 1e6f, seconds));
-  fprintf (out,
+  fprintf (ps->out, "%s%.1f million visits per second\n",
+	   ps->prefix, AVERAGE (ps->visits / 1e6f, ps->seconds));
+  fprintf (ps->out,
 	   "%srecycled %.1f MB in %u reductions\n",
-	   prefix, rrecycled / (double) (1 << 20), reductions);
-  fprintf (out,
+	   ps->prefix, ps->rrecycled / (double) (1 << 20), ps->reductions);
+  fprintf (ps->out,
 	   "%srecycled %.1f MB in %u simplifications\n",
-	   prefix, srecycled / (double) (1 << 20), simps);
+	   ps->prefix, ps->srecycled / (double) (1 << 20), ps->simps);
 #else
-  fprintf (out, "%s%u simplifications\n", prefix, simps);
-  fprintf (out, "%s%u reductions\n", prefix, reductions);
-  fprintf (out, "%s%.1f MB recycled\n", prefix, recycled / (double) (1 << 20));
+  fprintf (ps->out, "%s%u simplifications\n", ps->prefix, ps->simps);
+  fprintf (ps->out, "%s%u reductions\n", ps->prefix, ps->reductions);
+  fprintf (ps->out, "%s%.1f MB recycled\n", ps->prefix, ps->recycled / (double) (1 << 20));
 #endif
-  fprintf (out, "%s%.1f MB maximally allocated\n",
-	   prefix, picosat_max_bytes_allocated () / (double) (1 << 20));
+  fprintf (ps->out, "%s%.1f MB maximally allocated\n",
+	   ps->prefix, picosat_max_bytes_allocated () / (double) (1 << 20));
 }
 
 #ifndef NGETRUSAGE
@@ -7409,7 +7448,7 @@ double
 picosat_seconds (void)
 {
   check_ready ();
-  return seconds;
+  return ps->seconds;
 }
 
 void
@@ -7423,13 +7462,13 @@ picosat_print (FILE * file)
   Cls **p, *cls;
   unsigned n;
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     enter ();
   else
     check_ready ();
 
   n = 0;
-  n +=  alshead - als;
+  n +=  ps->alshead - ps->als;
 
   for (p = SOC; p != EOC; p = NXC (p))
     {
@@ -7446,7 +7485,7 @@ picosat_print (FILE * file)
     }
 
 #ifdef NO_BINARY_CLAUSES
-  last = int2lit (-max_var);
+  last = int2lit (-ps->max_var);
   for (lit = int2lit (1); lit <= last; lit++)
     {
       stack = LIT2IMPLS (lit);
@@ -7457,7 +7496,7 @@ picosat_print (FILE * file)
     }
 #endif
 
-  fprintf (file, "p cnf %d %u\n", max_var, n);
+  fprintf (file, "p cnf %d %u\n", ps->max_var, n);
 
   for (p = SOC; p != EOC; p = NXC (p))
     {
@@ -7481,7 +7520,7 @@ picosat_print (FILE * file)
     }
 
 #ifdef NO_BINARY_CLAUSES
-  last = int2lit (-max_var);
+  last = int2lit (-ps->max_var);
   for (lit = int2lit (1); lit <= last; lit++)
     {
       stack = LIT2IMPLS (lit);
@@ -7494,13 +7533,13 @@ picosat_print (FILE * file)
 
   {
     Lit **r;
-    for (r = als; r < alshead; r++)
+    for (r = ps->als; r < ps->alshead; r++)
       fprintf (file, "%d 0\n", lit2int (*r));
   }
 
   fflush (file);
 
-  if (measurealltimeinlib)
+  if (ps->measurealltimeinlib)
     leave ();
 }
 
@@ -7521,14 +7560,14 @@ picosat_message (int level, const char * fmt, ...)
 {
   va_list ap;
 
-  if (level > verbosity)
+  if (level > ps->verbosity)
     return;
 
-  fputs (prefix, out);
+  fputs (ps->prefix, ps->out);
   va_start (ap, fmt);
-  vfprintf (out, fmt, ap);
+  vfprintf (ps->out, fmt, ap);
   va_end (ap);
-  fputc ('\n', out);
+  fputc ('\n', ps->out);
 }
 
 int
@@ -7539,8 +7578,8 @@ picosat_changed (void)
   check_ready ();
   check_sat_state ();
 
-  res = (min_flipped <= saved_max_var);
-  assert (!res || saved_flips != flips);
+  res = (ps->min_flipped <= ps->saved_max_var);
+  assert (!res || ps->saved_flips != ps->flips);
 
   return res;
 }
@@ -7556,7 +7595,7 @@ setemgr (void * nmgr)
 void
 picosat_set_new (void * nmgr, void * (*nnew)(void*,size_t))
 {
-  ABORTIF (state != RESET, 
+  ABORTIF (ps && ps->state != RESET,
            "API usage: 'picosat_set_new' after 'picosat_init'");
   enew = nnew;
   setemgr (nmgr);
@@ -7565,7 +7604,7 @@ picosat_set_new (void * nmgr, void * (*nnew)(void*,size_t))
 void
 picosat_set_resize (void * nmgr, void * (*nresize)(void*,void*,size_t,size_t))
 {
-  ABORTIF (state != RESET,
+  ABORTIF (ps && ps->state != RESET,
            "API usage: 'picosat_set_resize' after 'picosat_init'");
   eresize = nresize;
   setemgr (nmgr);
@@ -7574,7 +7613,7 @@ picosat_set_resize (void * nmgr, void * (*nresize)(void*,void*,size_t,size_t))
 void
 picosat_set_delete (void * nmgr, void (*ndelete)(void*,void*,size_t))
 {
-  ABORTIF (state != RESET, 
+  ABORTIF (ps && ps->state != RESET,
            "API usage: 'picosat_set_delete' after 'picosat_init'");
   edelete = ndelete;
   setemgr (nmgr);
@@ -7590,8 +7629,8 @@ void
 picosat_reset_scores (void)
 {
   Rnk * r;
-  hhead = heap + 1;
-  for (r = rnks + 1; r <= rnks + max_var; r++)
+  ps->hhead = ps->heap + 1;
+  for (r = ps->rnks + 1; r <= ps->rnks + ps->max_var; r++)
     {
       CLR (r);
       hpush (r);
@@ -7613,7 +7652,7 @@ picosat_set_global_default_phase (int phase)
                       "with negative argument");
   ABORTIF (phase > 3, "API usage: 'picosat_set_global_default_phase' "
                       "with argument > 3");
-  defaultphase = phase;
+  ps->defaultphase = phase;
 }
 
 void
@@ -7692,30 +7731,30 @@ unsigned
 picosat_ado_conflicts (void)
 {
   check_ready ();
-  return adoconflicts;
+  return ps->adoconflicts;
 }
 
 void
 picosat_disable_ado (void)
 {
   check_ready ();
-  assert (!adodisabled);
-  adodisabled = 1;
+  assert (!ps->adodisabled);
+  ps->adodisabled = 1;
 }
 
 void
 picosat_enable_ado (void)
 {
   check_ready ();
-  assert (adodisabled);
-  adodisabled = 0;
+  assert (ps->adodisabled);
+  ps->adodisabled = 0;
 }
 
 void
 picosat_set_ado_conflict_limit (unsigned newadoconflictlimit)
 {
   check_ready ();
-  adoconflictlimit = newadoconflictlimit;
+  ps->adoconflictlimit = newadoconflictlimit;
 }
 
 #endif
@@ -60,6 +60,19 @@ void picosat_set_delete (void *, void (*)(void *, void *, size_t));
 void picosat_init (void);               /* constructor */
 void picosat_reset (void);              /* destructor */
 
+/*------------------------------------------------------------------------*/
+/* Every 'picosat_init' creates a new solver instance which becomes the
+ * current instance of the calling thread.  All other functions operate on
+ * the current instance.  The memory manager set above is shared by all
+ * instances.  'picosat_context' returns the current instance and
+ * 'picosat_set_context' makes a previously created instance current again,
+ * which allows to keep several solvers alive at the same time without
+ * reloading their clauses.  An instance must not be current in two threads
+ * at once.  'picosat_reset' destroys the current instance.
+ */
+void * picosat_context (void);
+void picosat_set_context (void *);
+
 /*------------------------------------------------------------------------*/
 /* The following five functions are essentially parameters to 'init', and
  * thus should be called right after 'picosat_init' before doing anything
@@ -40,35 +40,44 @@
 /* BlockDefectAnalyzer                                                  */
 /************************************************************************/
 
-std::string BlockDefectAnalyzer::getBlockPrecondition(ConditionalBlock *cb,
-                                                      const ConfigurationModel *model) {
-    StringJoiner formula;
+Formula BlockDefectAnalyzer::getBlockPrecondition(ConditionalBlock *cb,
+                                                  const ConfigurationModel *model) {
+    Formula formula;
 
     /* Adding block and code constraints extraced from code sat stream */
-    const std::string code_formula = cb->getCodeConstraints();
+    const Formula &code_formula = cb->getCodeFormula();
     formula.push_back(cb->getName());
-    formula.push_back(code_formula);
+    formula.append(code_formula);
 
     if (model) {
         /* Adding kconfig constraints and kconfig missing */
         std::set<std::string> missingSet;
-        std::string kconfig_formula;
+        Formula kconfig_formula;
         model->doIntersect(code_formula, cb->getFile()->getChecker(), missingSet, kconfig_formula);
-        formula.push_back(kconfig_formula);
+        formula.append(kconfig_formula);
         if (model->isComplete())
             formula.push_back(ConfigurationModel::getMissingItemsConstraints(missingSet));
     }
-    return formula.join("\n&& ");
+    return formula;
 }
 
 static const BlockDefect *analyzeBlock_helper(ConditionalBlock *block,
-                                              ConfigurationModel *main_model) {
-    BlockDefect *defect = new DeadBlockDefect(block);
+                                              ConfigurationModel *main_model,
+                                              BlockWitnesses *witnesses) {
+    BlockDefect *defect = nullptr;
+    if (!witnesses || !witnesses->isAlive(block)) {
+        defect = new DeadBlockDefect(block);
+        if (!defect->isDefect(main_model, true)) {
+            delete defect;
+            defect = nullptr;
+        }
+    }
 
     // If this is neither an Implementation, Configuration nor Referential *dead*,
     // then destroy the analysis and retry with an Undead Analysis
-    if (!defect->isDefect(main_model, true)) {
-        delete defect;
+    if (!defect) {
+        if (witnesses && witnesses->isDeselectable(block))
+            return nullptr;
         defect = new UndeadBlockDefect(block);
 
         // No defect found, block seems OK
@@ -116,9 +125,10 @@ static const BlockDefect *analyzeBlock_helper(ConditionalBlock *block,
 }
 
 const BlockDefect *BlockDefectAnalyzer::analyzeBlock(ConditionalBlock *block,
-                                                     ConfigurationModel *main_model) {
+                                                     ConfigurationModel *main_model,
+                                                     BlockWitnesses *witnesses) {
     try {
-        return analyzeBlock_helper(block, main_model);
+        return analyzeBlock_helper(block, main_model, witnesses);
     } catch (CNFBuilderError &e) {
         Logging::error("Couldn't process ", block->getFile()->getFilename(), ":", block->getName(),
                        ": ", e.what());
@@ -129,6 +139,107 @@ const BlockDefect *BlockDefectAnalyzer::analyzeBlock(ConditionalBlock *block,
     return nullptr;
 }
 
+/************************************************************************/
+/* BlockWitnesses                                                       */
+/************************************************************************/
+
+BlockWitnesses::BlockWitnesses(CppFile *file, const ConfigurationModel *model) {
+    ConditionalBlock *top = file->topBlock();
+    index[top] = 0;
+    for (const auto &block : *file)  // ConditionalBlock *
+        index.emplace(block, index.size());
+    vars.assign(index.size(), 0);
+    parents.assign(index.size(), -1);
+    alive.assign(index.size(), false);
+    deselectable.assign(index.size(), false);
+    askedAlive.assign(index.size(), false);
+    askedDeselectable.assign(index.size(), false);
+
+    checker.reset(new SatChecker(BlockDefectAnalyzer::getBlockPrecondition(top, model)));
+    // the cnf is used for all further questions
+    checker->setIncremental(false);
+    try {
+        stats.queries++;
+        if (!(*checker)())
+            return;
+    } catch (CNFBuilderError &e) {
+        Logging::error("Couldn't process ", file->getFilename(), ": ", e.what());
+        return;
+    } catch (std::bad_alloc &) {
+        Logging::error("Couldn't process ", file->getFilename(), ": Out of Memory.");
+        return;
+    }
+    cnf = checker->getCNF();
+    for (const auto &entry : index) {  // pair<const ConditionalBlock *, size_t>
+        vars[entry.second] = cnf->getCNFVar(entry.first->getName());
+        const auto parent = index.find(entry.first->getParent());
+        if (entry.first != top && parent != index.end())
+            parents[entry.second] = parent->second;
+    }
+    record();
+}
+
+BlockWitnesses::~BlockWitnesses() {}
+
+bool BlockWitnesses::isAlive(const ConditionalBlock *block) {
+    const auto it = index.find(block);
+    if (!cnf || it == index.end())
+        return false;
+    const size_t i = it->second;
+    if (!alive[i] && !askedAlive[i] && vars[i] != 0) {
+        askedAlive[i] = true;
+        solve({vars[i]});
+    }
+    return alive[i];
+}
+
+bool BlockWitnesses::isDeselectable(const ConditionalBlock *block) {
+    const auto it = index.find(block);
+    if (!cnf || it == index.end())
+        return false;
+    const size_t i = it->second;
+    if (parents[i] < 0)
+        return false;
+    const int parent = vars[parents[i]];
+    if (!deselectable[i] && !askedDeselectable[i] && vars[i] != 0 && parent != 0) {
+        askedDeselectable[i] = true;
+        solve({parent, -vars[i]});
+    }
+    return deselectable[i];
+}
+
+bool BlockWitnesses::solve(const std::vector<int> &assumptions) {
+    for (size_t i = 0; i < vars.size(); i++) {
+        if (vars[i] == 0 || (alive[i] && deselectable[i]))
+            continue;
+        cnf->preferLiteral(alive[i] ? -vars[i] : vars[i]);
+    }
+    for (int lit : assumptions)
+        cnf->pushAssumption(lit);
+    stats.queries++;
+    if (!cnf->checkSatisfiable())
+        return false;
+    record();
+    return true;
+}
+
+void BlockWitnesses::record() {
+    for (size_t i = 0; i < vars.size(); i++) {
+        if (vars[i] == 0)
+            continue;
+        if (cnf->deref(vars[i])) {
+            if (!alive[i]) {
+                alive[i] = true;
+                stats.alive++;
+            }
+        } else if (!deselectable[i] && parents[i] >= 0 && vars[parents[i]] != 0
+                   && cnf->deref(vars[parents[i]])) {
+            deselectable[i] = true;
+            stats.deselectable++;
+        }
+    }
+}
+
 /************************************************************************/
 /* BlockDefect                                                          */
 /************************************************************************/
@@ -182,7 +293,7 @@ bool BlockDefect::isNoKconfigDefect(const ConfigurationModel *model) const {
     if (!model)
         return true;
 
-    std::string expr;
+    std::set<std::string> items;
     if (_cb->isElseBlock()) {
         // Check prior blocks
         const ConditionalBlock *prev = _cb->getPrev();
@@ -193,12 +304,12 @@ bool BlockDefect::isNoKconfigDefect(const ConfigurationModel *model) const {
         }
     } else if (_cb == _cb->getFile()->topBlock()) {
         // If current block is the file, take the entire formula.
-        expr = _formula;
+        items = _formula.getSymbols();
     } else {
         // Otherwise, take the expression.
-        expr = _cb->ifdefExpression();
+        items = undertaker::itemsOfString(_cb->ifdefExpression());
     }
-    for (const std::string &str : undertaker::itemsOfString(expr))
+    for (const std::string &str : items)
         if (model->inConfigurationSpace(str))
             return false;
 
@@ -222,7 +333,7 @@ bool BlockDefect::writeReportToFile(bool skip_no_kconfig) const {
             << _cb->filename() << ":" << _cb->lineStart() << ":" << _cb->colStart() << ":"
             << _cb->filename() << ":" << _cb->lineEnd() << ":" << _cb->colEnd() << ":"
             << std::endl;
-        out << SatChecker::pprinter(_formula);
+        out << SatChecker::pprinter(_formula.str());
         out.close();
     }
     return true;
@@ -242,6 +353,7 @@ void DeadBlockDefect::reportMUS() const {
         return;
     // call Satchecker and get the CNF-Object
     SatChecker code_constraints(_musFormula);
+    code_constraints.setIncremental(false);
     code_constraints();
     kconfig::PicosatCNF *cnf = code_constraints.getCNF();
     // call picosat in quiet mode with stdin as input and stdout as output
@@ -324,17 +436,17 @@ void DeadBlockDefect::reportMUS() const {
 }
 
 bool DeadBlockDefect::isDefect(const ConfigurationModel *model, bool is_main_model) {
-    StringJoiner formula;
+    Formula formula;
 
     if (_arch == "")
         _arch = ModelContainer::lookupArch(model);
 
-    std::string code_formula = _cb->getCodeConstraints();
+    const Formula &code_formula = _cb->getCodeFormula();
     formula.push_back(_cb->getName());
-    formula.push_back(code_formula);
-    _formula = formula.join("\n&&\n");
+    formula.append(code_formula);
+    _formula = formula;
 
-    SatChecker code_constraints(_formula);
+    SatChecker code_constraints(formula);
 
     if (!code_constraints()) {
         _defectType = DEFECTTYPE::Implementation;
@@ -344,24 +456,23 @@ bool DeadBlockDefect::isDefect(const ConfigurationModel *model, bool is_main_mod
     }
     if (model) {
         std::set<std::string> missingSet;
-        std::string kconfig_formula = _cb->getCodeConstraints();
+        Formula kconfig_formula;
         model->doIntersect(code_formula, _cb->getFile()->getChecker(), missingSet,
                            kconfig_formula);
-        formula.push_back(kconfig_formula);
-        std::string formula_str = formula.join("\n&&\n");
-        SatChecker kconfig_constraints(formula_str);
+        formula.append(kconfig_formula);
+        SatChecker kconfig_constraints(formula);
 
-//        Logging::debug("kconfig_constraints: ", formula_str);
+//        Logging::debug("kconfig_constraints: ", formula.str());
 
         if (!kconfig_constraints()) {
             if (_defectType != DEFECTTYPE::Configuration) {
                 // Wasn't already identified as Configuration defect
                 _arch = ModelContainer::lookupArch(model);
             }
-            _formula = formula_str;
+            _formula = formula;
             // save formula for mus analysis when we are analysing the main_model
             if (is_main_model)
-                _musFormula = formula_str;
+                _musFormula = formula;
             _defectType = DEFECTTYPE::Configuration;
             return true;
         } else {
@@ -370,8 +481,7 @@ bool DeadBlockDefect::isDefect(const ConfigurationModel *model, bool is_main_mod
                 return false;
 
             formula.push_back(ConfigurationModel::getMissingItemsConstraints(missingSet));
-            std::string formula_str = formula.join("\n&&\n");
-            SatChecker missing_constraints(formula_str);
+            SatChecker missing_constraints(formula);
 
             if (!missing_constraints()) {
                 if (_defectType != DEFECTTYPE::Configuration) {
@@ -379,8 +489,8 @@ bool DeadBlockDefect::isDefect(const ConfigurationModel *model, bool is_main_mod
                 }
                 // save formula for mus analysis when we are analysing the main_model
                 if (is_main_model)
-                    _musFormula = formula_str;
-                _formula = formula_str;
+                    _musFormula = formula;
+                _formula = formula;
                 return true;
             }
         }
@@ -397,7 +507,7 @@ UndeadBlockDefect::UndeadBlockDefect(ConditionalBlock *cb) : BlockDefect(cb) {
 }
 
 bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
-    StringJoiner formula;
+    Formula formula;
     const ConditionalBlock *parent = _cb->getParent();
 
     // no parent -> it's B00 -> impossible to be undead
@@ -407,12 +517,12 @@ bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
     if (_arch == "")
         _arch = ModelContainer::lookupArch(model);
 
-    std::string code_formula = _cb->getCodeConstraints();
+    const Formula &code_formula = _cb->getCodeFormula();
     formula.push_back("( " + parent->getName() + " && ! " + _cb->getName() + " )");
-    formula.push_back(code_formula);
-    _formula = formula.join("\n&&\n");
+    formula.append(code_formula);
+    _formula = formula;
 
-    SatChecker code_constraints(_formula);
+    SatChecker code_constraints(formula);
 
     if (!code_constraints()) {
         _defectType = DEFECTTYPE::Implementation;
@@ -422,19 +532,18 @@ bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
 
     if (model) {
         std::set<std::string> missingSet;
-        std::string kconfig_formula = _cb->getCodeConstraints();
+        Formula kconfig_formula;
         model->doIntersect(code_formula, _cb->getFile()->getChecker(), missingSet,
                            kconfig_formula);
-        formula.push_back(kconfig_formula);
-        std::string formula_str = formula.join("\n&&\n");
-        SatChecker kconfig_constraints(formula_str);
+        formula.append(kconfig_formula);
+        SatChecker kconfig_constraints(formula);
 
         if (!kconfig_constraints()) {
             if (_defectType != DEFECTTYPE::Configuration) {
                 // Wasn't already identified as Configuration defect
                 _arch = ModelContainer::lookupArch(model);
             }
-            _formula = formula_str;
+            _formula = formula;
             _defectType = DEFECTTYPE::Configuration;
             return true;
         } else {
@@ -444,14 +553,13 @@ bool UndeadBlockDefect::isDefect(const ConfigurationModel *model, bool) {
                 return false;
 
             formula.push_back(ConfigurationModel::getMissingItemsConstraints(missingSet));
-            std::string formula_str = formula.join("\n&&\n");
-            SatChecker missing_constraints(formula_str);
+            SatChecker missing_constraints(formula);
 
             if (!missing_constraints()) {
                 if (_defectType != DEFECTTYPE::Configuration) {
                     _defectType = DEFECTTYPE::Referential;
                 }
-                _formula = formula_str;
+                _formula = formula;
                 return true;
             }
         }
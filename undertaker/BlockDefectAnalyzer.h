@@ -33,11 +33,23 @@
  * defect and report its results.
  */
 
+#include "Formula.h"
+
 #include <string>
+#include <vector>
+#include <map>
+#include <memory>
 
 class ConditionalBlock;
 class ConfigurationModel;
+class CppFile;
 class BlockDefect;
+class BlockWitnesses;
+class SatChecker;
+
+namespace kconfig {
+    class PicosatCNF;
+}
 
 
 /************************************************************************/
@@ -45,10 +57,70 @@ class BlockDefect;
 /************************************************************************/
 
 namespace BlockDefectAnalyzer {
-    const BlockDefect *analyzeBlock(ConditionalBlock *, ConfigurationModel *);
-    std::string getBlockPrecondition(ConditionalBlock *, const ConfigurationModel *);
+    /**
+     * \brief checks the block for defects
+     *
+     * If witnesses are given, checks of blocks they already settle are
+     * skipped. All witnesses have to stem from the same file and model.
+     */
+    const BlockDefect *analyzeBlock(ConditionalBlock *, ConfigurationModel *,
+                                    BlockWitnesses *witnesses = nullptr);
+    Formula getBlockPrecondition(ConditionalBlock *, const ConfigurationModel *);
 }
 
+/************************************************************************/
+/* BlockWitnesses                                                       */
+/************************************************************************/
+
+/**
+ * \brief solutions of a file that prove blocks to be neither dead nor undead
+ *
+ * The precondition of the whole file (see getBlockPrecondition()) contains
+ * every constraint of the per block checks. Hence, a block that is enabled
+ * in any of its solutions can't be dead, and a block that is disabled
+ * while its parent is enabled can't be undead, on any level of the
+ * analysis.
+ *
+ * The precondition is turned into a cnf only once, each question that
+ * isn't settled yet is answered by a single solver call under
+ * assumptions. Before every call, the solver is told to enable blocks
+ * that aren't known to be alive and to disable the others, so each
+ * solution settles as many blocks as possible.
+ */
+class BlockWitnesses {
+public:
+    struct Stats {
+        int queries = 0;        //!< solver calls
+        int alive = 0;          //!< blocks proven not to be dead
+        int deselectable = 0;   //!< blocks proven not to be undead
+    };
+
+    BlockWitnesses(CppFile *file, const ConfigurationModel *model);
+    ~BlockWitnesses();
+
+    //! true if the block is enabled in some solution, it isn't dead then
+    bool isAlive(const ConditionalBlock *block);
+
+    //! true if the block is disabled and its parent enabled in some solution
+    bool isDeselectable(const ConditionalBlock *block);
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    //! owns the cnf of the file precondition
+    std::unique_ptr<SatChecker> checker;
+    kconfig::PicosatCNF *cnf = nullptr;
+    std::map<const ConditionalBlock *, size_t> index;
+    //! per block: cnf variable (0 if unknown), index of the parent (-1 for none)
+    std::vector<int> vars, parents;
+    //! per block: proven facts and questions that were already asked
+    std::vector<bool> alive, deselectable, askedAlive, askedDeselectable;
+    Stats stats;
+
+    bool solve(const std::vector<int> &assumptions);
+    void record();
+};
+
 class BlockDefect {
 public:
     enum class DEFECTTYPE { None, Implementation, Configuration, Referential, NoKconfig };
@@ -107,7 +179,7 @@ protected:
     DEFECTTYPE _defectType = DEFECTTYPE::None;
     bool _isGlobal = false;
 
-    std::string _formula;
+    Formula _formula;
     std::string _arch;
     std::string _suffix;
     ConditionalBlock *_cb;
@@ -120,7 +192,7 @@ protected:
 
 //! Checks a given block for "un-selectable block" defects.
 class DeadBlockDefect : public BlockDefect {
-    std::string _musFormula;
+    Formula _musFormula;
 public:
     //! c'tor for a Dead Block Defect
     DeadBlockDefect(ConditionalBlock *);
@@ -0,0 +1,128 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolExpArena.h"
+#include "bool.h"
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace kconfig;
+
+
+/* the open scopes of this thread, the innermost one is the last */
+static thread_local std::vector<BoolExpArena *> activeArenas;
+
+BoolExpArena::Scope::Scope(BoolExpArena *arena) : arena(arena) {
+    if (!arena)
+        return;
+    for (BoolExpArena *other : activeArenas) {
+        if (other == arena) {
+            // nested scope on the same arena
+            this->arena = nullptr;
+            return;
+        }
+    }
+    activeArenas.push_back(arena);
+}
+
+BoolExpArena::Scope::~Scope() {
+    if (!arena)
+        return;
+    activeArenas.pop_back();
+    arena->release();
+}
+
+BoolExpArena::~BoolExpArena() {
+    release();
+    for (Chunk &chunk : chunks)
+        std::free(chunk.memory);
+}
+
+void BoolExpArena::release() {
+    size_t used = 0;
+    for (Chunk &chunk : chunks) {
+        for (size_t offset = 0; offset < chunk.used;) {
+            Header *header = reinterpret_cast<Header *>(chunk.memory + offset);
+            if (header->live) {
+                BoolExp *node = reinterpret_cast<BoolExp *>(header + 1);
+                // the arena destroys all children itself
+                node->gcMarked = true;
+                node->~BoolExp();
+            }
+            offset += sizeof(Header) + header->size;
+        }
+        used += chunk.used;
+        chunk.used = 0;
+    }
+    if (used > stats.peakBytes)
+        stats.peakBytes = used;
+    if (used > 0)
+        stats.releases++;
+    current = 0;
+}
+
+void *BoolExpArena::take(size_t size) {
+    // keep every node aligned like the header
+    size = (size + sizeof(Header) - 1) / sizeof(Header) * sizeof(Header);
+    const size_t needed = sizeof(Header) + size;
+    while (current < chunks.size() && chunks[current].size - chunks[current].used < needed)
+        current++;
+    if (current == chunks.size()) {
+        // chunks grow, so a large scope doesn't end up with lots of them
+        const size_t grown = chunkSize << (chunks.size() < 8 ? chunks.size() : 8);
+        const size_t bytes = needed > grown ? needed : grown;
+        char *memory = static_cast<char *>(std::malloc(bytes));
+        if (!memory)
+            throw std::bad_alloc();
+        chunks.push_back({memory, bytes, 0});
+    }
+    Chunk &chunk = chunks[current];
+    Header *header = reinterpret_cast<Header *>(chunk.memory + chunk.used);
+    header->size = size;
+    // the constructor has yet to run, see deallocate()
+    header->live = true;
+    chunk.used += needed;
+    stats.nodes++;
+    return header + 1;
+}
+
+BoolExpArena *BoolExpArena::owner(const void *p) {
+    const char *c = static_cast<const char *>(p);
+    for (BoolExpArena *arena : activeArenas)
+        for (const Chunk &chunk : arena->chunks)
+            if (c >= chunk.memory && c < chunk.memory + chunk.used)
+                return arena;
+    return nullptr;
+}
+
+void *BoolExpArena::allocate(size_t size) {
+    return activeArenas.empty() ? nullptr : activeArenas.back()->take(size);
+}
+
+bool BoolExpArena::deallocate(void *p) {
+    if (!owner(p))
+        return false;
+    reinterpret_cast<Header *>(p)[-1].live = false;
+    return true;
+}
+
+bool BoolExpArena::isArenaNode(const void *p) {
+    return owner(p) != nullptr;
+}
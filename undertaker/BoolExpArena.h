@@ -0,0 +1,117 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_BOOLEXPARENA_H
+#define KCONFIG_BOOLEXPARENA_H
+
+#include <cstddef>
+#include <vector>
+
+
+namespace kconfig {
+    /**
+     * \brief region allocator for BoolExp nodes
+     *
+     * While a Scope on an arena is open, every BoolExp of the current
+     * thread is bump-allocated from the chunks of that arena. Closing
+     * the scope releases all of them at once: the nodes are destroyed in
+     * a single pass over the chunks, no memory is handed back to the
+     * heap, the chunks are reused by the next scope.
+     *
+     * Deleting a node of an open arena only destroys this node, its
+     * children are left to the arena. No node of an arena may be
+     * referenced after its scope was closed.
+     */
+    class BoolExpArena {
+    public:
+        struct Stats {
+            size_t nodes = 0;       //!< nodes allocated since the arena was created
+            size_t releases = 0;    //!< number of closed scopes
+            size_t peakBytes = 0;   //!< largest amount of memory used by one scope
+        };
+
+        /**
+         * \brief makes the arena the allocator of the current thread
+         *
+         * Scopes nest, opening a scope on an arena that is active already
+         * or on nullptr doesn't do anything.
+         */
+        class Scope {
+        public:
+            explicit Scope(BoolExpArena *arena);
+            ~Scope();
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            //! nullptr for nested scopes
+            BoolExpArena *arena;
+        };
+
+        explicit BoolExpArena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+        ~BoolExpArena();
+        BoolExpArena(const BoolExpArena &) = delete;
+        BoolExpArena &operator=(const BoolExpArena &) = delete;
+
+        //! destroys all nodes of the arena, the memory is kept for reuse
+        void release();
+
+        const Stats &getStats() const { return stats; }
+
+        /**
+         * \brief memory for a new node
+         *
+         * \return nullptr if no arena is active in the current thread
+         */
+        static void *allocate(size_t size);
+
+        /**
+         * \brief marks a node as destroyed if it belongs to an active arena
+         *
+         * \return false if the memory has to be freed by the caller
+         */
+        static bool deallocate(void *p);
+
+        //! true if the node was allocated from an arena that is still active
+        static bool isArenaNode(const void *p);
+
+    private:
+        struct Chunk {
+            char *memory;
+            size_t size;
+            size_t used;
+        };
+        //! precedes each node within a chunk
+        struct alignas(std::max_align_t) Header {
+            size_t size;
+            bool live;
+        };
+
+        std::vector<Chunk> chunks;
+        //! index of the chunk new nodes are taken from
+        size_t current = 0;
+        size_t chunkSize;
+        Stats stats;
+
+        void *take(size_t size);
+        //! the active arena the node belongs to, nullptr if there is none
+        static BoolExpArena *owner(const void *p);
+    };
+}
+#endif
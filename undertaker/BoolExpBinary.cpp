@@ -0,0 +1,320 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolExpBinary.h"
+
+#include <cstdint>
+#include <iterator>
+
+using namespace kconfig;
+using namespace kconfig::BoolExpBinary;
+
+
+static void appendNumber(std::string &out, size_t value) {
+    while (value >= 0x80) {
+        out += (char) ((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+/************************************************************************/
+/* BoolExpWriter                                                        */
+/************************************************************************/
+
+size_t BoolExpWriter::add(BoolExp *e) {
+    void *value;
+    // the root of a traversal is always visited, even if another formula has it already
+    if (!lookup(e, value)) {
+        e->accept(this);
+        value = result;
+    }
+    roots.push_back((uintptr_t) value - 1);
+    return roots.size() - 1;
+}
+
+void BoolExpWriter::write(std::ostream &out) const {
+    std::string header(magic, sizeof(magic));
+    appendNumber(header, version);
+    appendNumber(header, symbols.size());
+    for (const std::string &name : symbols) {
+        appendNumber(header, name.size());
+        header += name;
+    }
+    appendNumber(header, nodeCount);
+    std::string trailer;
+    appendNumber(trailer, roots.size());
+    for (size_t root : roots)
+        appendNumber(trailer, root);
+    out << header << nodes << trailer;
+}
+
+void BoolExpWriter::begin(Kind kind) {
+    nodes += (char) kind;
+}
+
+void BoolExpWriter::number(size_t value) {
+    appendNumber(nodes, value);
+}
+
+void BoolExpWriter::symbol(const std::string &name) {
+    auto it = symbolIndex.emplace(name, symbols.size()).first;
+    if (it->second == symbols.size())
+        symbols.push_back(name);
+    number(it->second);
+}
+
+void BoolExpWriter::child(BoolExp *e) {
+    void *value = nullptr;
+    lookup(e, value);
+    number(nodeCount - ((uintptr_t) value - 1));
+}
+
+void BoolExpWriter::end() {
+    // the index of the node, plus one: a result is never nullptr
+    result = (void *) (uintptr_t) ++nodeCount;
+}
+
+void BoolExpWriter::visit(BoolExp *) {
+    throw "unknown node in BoolExpWriter";
+}
+
+void BoolExpWriter::visit(BoolExpAnd *e) {
+    begin(AND);
+    child(e->left);
+    child(e->right);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpOr *e) {
+    begin(OR);
+    child(e->left);
+    child(e->right);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpNot *e) {
+    begin(NOT);
+    child(e->right);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpConst *e) {
+    begin(e->value ? ONE : ZERO);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpVar *e) {
+    begin(VAR);
+    symbol(e->getName());
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpImpl *e) {
+    begin(IMPL);
+    child(e->left);
+    child(e->right);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpEq *e) {
+    begin(EQ);
+    child(e->left);
+    child(e->right);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpCall *e) {
+    // the parameters were traversed right before the call
+    begin(CALL);
+    symbol(e->getName());
+    number(e->param->size());
+    for (BoolExp *param : *e->param)
+        child(param);
+    end();
+}
+
+void BoolExpWriter::visit(BoolExpAny *e) {
+    begin(ANY);
+    symbol(e->getName());
+    child(e->left);
+    child(e->right);
+    end();
+}
+
+/************************************************************************/
+/* BoolExpReader                                                        */
+/************************************************************************/
+
+BoolExpReader::BoolExpReader(const std::string &data)
+    : pos((const unsigned char *) data.data()),
+      end((const unsigned char *) data.data() + data.size()) {}
+
+bool BoolExpReader::read(std::istream &in, std::vector<BoolExp *> &roots) {
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return read(data, roots);
+}
+
+bool BoolExpReader::read(const std::string &data, std::vector<BoolExp *> &roots) {
+    roots.clear();
+    if (data.compare(0, sizeof(magic), magic, sizeof(magic)) != 0)
+        return false;
+    BoolExpReader reader(data);
+    reader.pos += sizeof(magic);
+
+    size_t fileVersion, count;
+    if (!reader.number(fileVersion) || fileVersion != version || !reader.number(count))
+        return false;
+    // each entry takes a byte at least, the counts can't exceed what is left
+    if (count > (size_t) (reader.end - reader.pos))
+        return false;
+    reader.symbols.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t length;
+        if (!reader.number(length) || length > (size_t) (reader.end - reader.pos))
+            return false;
+        reader.symbols.emplace_back((const char *) reader.pos, length);
+        reader.pos += length;
+    }
+
+    if (!reader.number(count) || count > (size_t) (reader.end - reader.pos))
+        return false;
+    reader.nodes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!reader.readNode()) {
+            reader.discard();
+            return false;
+        }
+    }
+
+    bool valid = reader.number(count) && count <= (size_t) (reader.end - reader.pos);
+    for (size_t i = 0; valid && i < count; i++) {
+        size_t index;
+        valid = reader.number(index) && index < reader.nodes.size();
+        if (valid)
+            roots.push_back(reader.nodes[index]);
+    }
+    if (!valid || reader.pos != reader.end) {
+        roots.clear();
+        reader.discard();
+        return false;
+    }
+    return true;
+}
+
+bool BoolExpReader::number(size_t &value) {
+    value = 0;
+    for (unsigned shift = 0; pos < end && shift < 64; shift += 7) {
+        const unsigned char byte = *pos++;
+        value |= (size_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool BoolExpReader::symbol(const std::string *&name) {
+    size_t index;
+    if (!number(index) || index >= symbols.size())
+        return false;
+    name = &symbols[index];
+    return true;
+}
+
+bool BoolExpReader::child(BoolExp *&e) {
+    size_t distance;
+    if (!number(distance) || distance == 0 || distance > nodes.size())
+        return false;
+    e = nodes[nodes.size() - distance];
+    return true;
+}
+
+bool BoolExpReader::readNode() {
+    if (pos == end)
+        return false;
+    const unsigned char kind = *pos++;
+    const std::string *name;
+    BoolExp *left, *right;
+    BoolExp *e;
+    switch (kind) {
+    case ZERO:
+    case ONE:
+        e = B_CONST(kind == ONE);
+        break;
+    case VAR:
+        if (!symbol(name))
+            return false;
+        e = new BoolExpVar(*name, false);
+        break;
+    case NOT:
+        if (!child(right))
+            return false;
+        e = new BoolExpNot(right);
+        break;
+    case AND:
+    case OR:
+    case IMPL:
+    case EQ:
+        if (!child(left) || !child(right))
+            return false;
+        if (kind == AND)
+            e = new BoolExpAnd(left, right);
+        else if (kind == OR)
+            e = new BoolExpOr(left, right);
+        else if (kind == IMPL)
+            e = new BoolExpImpl(left, right);
+        else
+            e = new BoolExpEq(left, right);
+        break;
+    case ANY:
+        if (!symbol(name) || !child(left) || !child(right))
+            return false;
+        e = new BoolExpAny(*name, left, right);
+        break;
+    case CALL: {
+        size_t count;
+        if (!symbol(name) || !number(count) || count > (size_t) (end - pos))
+            return false;
+        auto param = new std::list<BoolExp *>();
+        for (size_t i = 0; i < count; i++) {
+            if (!child(left)) {
+                delete param;
+                return false;
+            }
+            param->push_back(left);
+        }
+        e = new BoolExpCall(*name, param);
+        break;
+    }
+    default:
+        return false;
+    }
+    nodes.push_back(e);
+    return true;
+}
+
+void BoolExpReader::discard() {
+    // each node is deleted on its own, the destructor mustn't collect the children
+    for (BoolExp *e : nodes) {
+        e->gcMarked = true;
+        if (BoolExpCall *call = dynamic_cast<BoolExpCall *>(e))
+            delete call->param;
+        delete e;
+    }
+    nodes.clear();
+}
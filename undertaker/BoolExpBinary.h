@@ -0,0 +1,140 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_BOOLEXPBINARY_H
+#define KCONFIG_BOOLEXPBINARY_H
+
+#include "bool.h"
+#include "BoolVisitor.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kconfig {
+    /**
+     * \brief the binary format of BoolExp DAGs
+     *
+     * All numbers are unsigned LEB128 varints:
+     *
+     *     File    := Magic Version Symbols Nodes Roots
+     *     Magic   := 'U' 'T' 'B' 'X'
+     *     Symbols := count {length bytes}     (names of variables, calls, operators)
+     *     Nodes   := count {kind operands}    (children before their parents)
+     *     Roots   := count {node index}
+     *
+     * A node refers to its children by the distance to its own index,
+     * shared nodes are written once. The kind is a single byte:
+     *
+     *     ZERO, ONE                           no operands
+     *     VAR                                 symbol
+     *     NOT                                 child
+     *     AND, OR, IMPL, EQ                   left right
+     *     ANY                                 symbol left right
+     *     CALL                                symbol count {parameter}
+     *
+     * Readers reject files of another version.
+     */
+    namespace BoolExpBinary {
+        const char magic[] = {'U', 'T', 'B', 'X'};
+        const unsigned version = 1;
+
+        enum Kind : unsigned char { ZERO, ONE, VAR, NOT, AND, OR, IMPL, EQ, ANY, CALL };
+    }
+
+    /**
+     * \brief writes formulas in the format of BoolExpBinary
+     *
+     * Formulas are added one by one, nodes they share with formulas
+     * that were added before are written only once.
+     */
+    class BoolExpWriter : public BoolVisitor {
+    public:
+        //! the index of the formula among the roots of the file
+        size_t add(BoolExp *e);
+        void write(std::ostream &out) const;
+
+        size_t getNodeCount() const { return nodeCount; }
+
+    protected:
+        virtual void visit(BoolExp *e)      final override;
+        virtual void visit(BoolExpAnd *e)   final override;
+        virtual void visit(BoolExpOr *e)    final override;
+        virtual void visit(BoolExpNot *e)   final override;
+        virtual void visit(BoolExpConst *e) final override;
+        virtual void visit(BoolExpVar *e)   final override;
+        virtual void visit(BoolExpImpl *e)  final override;
+        virtual void visit(BoolExpEq *e)    final override;
+        virtual void visit(BoolExpCall *e)  final override;
+        virtual void visit(BoolExpAny *e)   final override;
+
+    private:
+        //! the encoded nodes
+        std::string nodes;
+        size_t nodeCount = 0;
+        std::vector<size_t> roots;
+        std::vector<std::string> symbols;
+        std::unordered_map<std::string, size_t> symbolIndex;
+
+        //! starts the next node
+        void begin(BoolExpBinary::Kind kind);
+        //! appends an operand of the node
+        void number(size_t value);
+        void symbol(const std::string &name);
+        void child(BoolExp *e);
+        //! the node is the result of the visit
+        void end();
+    };
+
+    /**
+     * \brief reads formulas in the format of BoolExpBinary
+     *
+     * The nodes are taken from the active BoolExpArena like all others.
+     * The roots share their nodes, so deleting one of them may destroy
+     * parts of the others: keep them in an arena if there are several.
+     */
+    class BoolExpReader {
+    public:
+        /**
+         * \brief the roots of the file, in the order they were added
+         *
+         * false if the input isn't a valid file of this version, no
+         * nodes are left then.
+         */
+        static bool read(std::istream &in, std::vector<BoolExp *> &roots);
+        static bool read(const std::string &data, std::vector<BoolExp *> &roots);
+
+    private:
+        const unsigned char *pos;
+        const unsigned char *end;
+        std::vector<std::string> symbols;
+        std::vector<BoolExp *> nodes;
+
+        BoolExpReader(const std::string &data);
+        bool number(size_t &value);
+        bool symbol(const std::string *&name);
+        bool child(BoolExp *&e);
+        bool readNode();
+        //! destroys the nodes read so far
+        void discard();
+    };
+}
+#endif
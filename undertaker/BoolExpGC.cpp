@@ -21,13 +21,11 @@
 
 #include "BoolExpGC.h"
 
-#include <map>
-
 void kconfig::BoolExpGC::sweep(BoolExp *root) {
-    for (auto &entry : visited) {  // pair<BoolExp *, void *>
-        BoolExp *e = entry.first;
+    for (BoolExp *e : nodes) {
         e->gcMarked = true;
         if (e != root)
             delete e;
     }
+    nodes.clear();
 }
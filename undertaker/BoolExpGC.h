@@ -26,6 +26,8 @@
 #include "bool.h"
 #include "BoolVisitor.h"
 
+#include <vector>
+
 namespace kconfig {
     class BoolExpGC : public BoolVisitor {
     public:
@@ -34,16 +36,20 @@ namespace kconfig {
         void trash(BoolExp *e) { e->accept(this); }
 
     protected:
-        virtual void visit(BoolExp *)      final override {}
-        virtual void visit(BoolExpAnd *)   final override {}
-        virtual void visit(BoolExpOr *)    final override {}
-        virtual void visit(BoolExpNot *)   final override {}
-        virtual void visit(BoolExpConst *) final override {}
-        virtual void visit(BoolExpVar *)   final override {}
-        virtual void visit(BoolExpImpl *)  final override {}
-        virtual void visit(BoolExpEq *)    final override {}
-        virtual void visit(BoolExpCall *)  final override {}
-        virtual void visit(BoolExpAny *)   final override {}
+        virtual void visit(BoolExp *e)      final override { nodes.push_back(e); }
+        virtual void visit(BoolExpAnd *e)   final override { nodes.push_back(e); }
+        virtual void visit(BoolExpOr *e)    final override { nodes.push_back(e); }
+        virtual void visit(BoolExpNot *e)   final override { nodes.push_back(e); }
+        virtual void visit(BoolExpConst *e) final override { nodes.push_back(e); }
+        virtual void visit(BoolExpVar *e)   final override { nodes.push_back(e); }
+        virtual void visit(BoolExpImpl *e)  final override { nodes.push_back(e); }
+        virtual void visit(BoolExpEq *e)    final override { nodes.push_back(e); }
+        virtual void visit(BoolExpCall *)   final override {}
+        virtual void visit(BoolExpAny *e)   final override { nodes.push_back(e); }
+
+    private:
+        //! every node reached by trash(), each one only once
+        std::vector<BoolExp *> nodes;
     };
 };
 
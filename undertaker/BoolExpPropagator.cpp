@@ -0,0 +1,291 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolExpPropagator.h"
+#include "BoolExpArena.h"
+#include "bool.h"
+#include "BoolVisitor.h"
+#include "PicosatCNF.h"
+#include "KconfigWhitelist.h"
+#include "StringJoiner.h"
+
+#include <vector>
+#include <deque>
+#include <unordered_set>
+
+using namespace kconfig;
+
+
+/* the (partial) value of a subformula: either a constant or the expression
+   of what remains of it. 'literal' is set if the remainder is a single
+   substitutable variable, negated if 'positive' is false */
+struct BoolExpPropagator::Value {
+    //! 0 false, 1 true, -1 unknown
+    signed char state;
+    BoolExp *expr;
+    std::string literal;
+    bool positive;
+
+    static Value constant(bool v) {
+        return {v ? (signed char) 1 : (signed char) 0, nullptr, "", true};
+    }
+    static Value open(BoolExp *expr) { return {-1, expr, "", true}; }
+
+    bool isConstant() const { return state >= 0; }
+    bool isTrue() const { return state == 1; }
+    bool isFalse() const { return state == 0; }
+
+    //! negation is the node to use for the negated expression, a new one if nullptr
+    Value negated(BoolExp *negation = nullptr) const {
+        if (isConstant())
+            return constant(!isTrue());
+        Value v = open(negation ? negation : new BoolExpNot(expr));
+        if (!literal.empty()) {
+            v.literal = literal;
+            v.positive = !positive;
+        }
+        return v;
+    }
+};
+
+bool BoolExpPropagator::isSubstitutable(const std::string &name) const {
+    return !KconfigWhitelist::getIgnorelist().isWhitelisted(name);
+}
+
+/* computes the values of all nodes of a conjunct bottom up. The values are
+   kept in a deque, their addresses are the results of the traversal. Nodes
+   whose operands keep their expressions are used as they are */
+class BoolExpPropagator::Evaluator : public BoolVisitor {
+public:
+    Evaluator(const BoolExpPropagator &propagator, const std::map<std::string, bool> &derived)
+        : propagator(propagator), derived(derived) {}
+
+    Value evaluate(BoolExp *e) {
+        // the derived values change between the calls
+        clearVisited();
+        values.clear();
+        e->accept(this);
+        return *static_cast<Value *>(result);
+    }
+
+protected:
+    // constants, calls and comparisons are free variables for the CNFBuilder
+    virtual void visit(BoolExp *e)      final override { make(Value::open(e)); }
+    virtual void visit(BoolExpConst *e) final override { make(Value::open(e)); }
+    virtual void visit(BoolExpCall *e)  final override { make(Value::open(e)); }
+    virtual void visit(BoolExpAny *e)   final override { make(Value::open(e)); }
+
+    virtual void visit(BoolExpVar *e) final override {
+        const std::string &name = e->getName();
+        if (!propagator.isSubstitutable(name))
+            return make(Value::open(e));
+        auto it = propagator.fixed.find(name);
+        if (it != propagator.fixed.end())
+            return make(Value::constant(it->second));
+        it = derived.find(name);
+        if (it != derived.end())
+            return make(Value::constant(it->second));
+        Value v = Value::open(e);
+        v.literal = name;
+        make(std::move(v));
+    }
+
+    virtual void visit(BoolExpNot *e) final override {
+        const Value &r = value(right);
+        make(r.negated(r.expr == e->right ? e : nullptr));
+    }
+
+    virtual void visit(BoolExpAnd *e) final override {
+        const Value &l = value(left), &r = value(right);
+        if (l.isFalse() || r.isFalse())
+            return make(Value::constant(false));
+        if (l.isTrue())
+            return make(r);
+        if (r.isTrue())
+            return make(l);
+        make(Value::open(rebuild<BoolExpAnd>(e, l, r)));
+    }
+
+    virtual void visit(BoolExpOr *e) final override {
+        const Value &l = value(left), &r = value(right);
+        if (l.isTrue() || r.isTrue())
+            return make(Value::constant(true));
+        if (l.isFalse())
+            return make(r);
+        if (r.isFalse())
+            return make(l);
+        make(Value::open(rebuild<BoolExpOr>(e, l, r)));
+    }
+
+    // a -> b == !a || b
+    virtual void visit(BoolExpImpl *e) final override {
+        const Value &l = value(left), &r = value(right);
+        if (l.isFalse() || r.isTrue())
+            return make(Value::constant(true));
+        if (l.isTrue())
+            return make(r);
+        if (r.isFalse())
+            return make(l.negated());
+        make(Value::open(rebuild<BoolExpImpl>(e, l, r)));
+    }
+
+    virtual void visit(BoolExpEq *e) final override {
+        const Value &l = value(left), &r = value(right);
+        if (l.isConstant() && r.isConstant())
+            return make(Value::constant(l.isTrue() == r.isTrue()));
+        if (l.isConstant())
+            return make(l.isTrue() ? r : r.negated());
+        if (r.isConstant())
+            return make(r.isTrue() ? l : l.negated());
+        make(Value::open(rebuild<BoolExpEq>(e, l, r)));
+    }
+
+private:
+    const BoolExpPropagator &propagator;
+    const std::map<std::string, bool> &derived;
+    std::deque<Value> values;
+
+    static const Value &value(void *result) { return *static_cast<Value *>(result); }
+
+    void make(Value v) {
+        values.push_back(std::move(v));
+        result = &values.back();
+    }
+
+    //! e itself if none of its operands changed, a new node of its kind otherwise
+    template<typename T>
+    static BoolExp *rebuild(BoolExp *e, const Value &l, const Value &r) {
+        if (l.expr == e->left && r.expr == e->right)
+            return e;
+        return new T(l.expr, r.expr);
+    }
+};
+
+/* collects the names of all substitutable variables within e, shared
+   subexpressions are looked at once */
+static void collectVariables(BoolExp *e, std::vector<std::string> &names) {
+    std::vector<BoolExp *> stack{e};
+    std::unordered_set<BoolExp *> seen;
+    while (!stack.empty()) {
+        e = stack.back();
+        stack.pop_back();
+        if (!e || !seen.insert(e).second)
+            continue;
+        if (BoolExpVar *var = dynamic_cast<BoolExpVar *>(e)) {
+            names.push_back(var->getName());
+            continue;
+        }
+        if (dynamic_cast<BoolExpAnd *>(e) || dynamic_cast<BoolExpOr *>(e)
+            || dynamic_cast<BoolExpNot *>(e) || dynamic_cast<BoolExpImpl *>(e)
+            || dynamic_cast<BoolExpEq *>(e)) {
+            stack.push_back(e->right);
+            stack.push_back(e->left);
+        }
+    }
+}
+
+BoolExpPropagator::Result BoolExpPropagator::propagate(const std::string &formula,
+                                                       std::string &residual) const {
+    static thread_local BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    BoolExp *exp = BoolExp::parseString(formula);
+    if (!exp) {
+        residual = formula;
+        return Result::RESIDUAL;
+    }
+    std::vector<BoolExp *> conjuncts;
+    Result result = propagate(std::vector<BoolExp *>{exp}, conjuncts);
+    StringJoiner sj;
+    for (BoolExp *conjunct : conjuncts)
+        // a conjunct that is a binary operation needs parentheses within the conjunction
+        sj.push_back(conjunct->left ? "(" + conjunct->str() + ")" : conjunct->str());
+    residual = sj.join("\n&& ");
+    return result;
+}
+
+BoolExpPropagator::Result BoolExpPropagator::propagate(const std::vector<BoolExp *> &formula,
+                                                       std::vector<BoolExp *> &residual) const {
+    // split the toplevel conjunctions, the formulas of the analyses are long chains of '&&'
+    std::vector<BoolExp *> conjuncts, stack(formula.rbegin(), formula.rend());
+    while (!stack.empty()) {
+        BoolExp *e = stack.back();
+        stack.pop_back();
+        if (dynamic_cast<BoolExpAnd *>(e)) {
+            stack.push_back(e->right);
+            stack.push_back(e->left);
+        } else {
+            conjuncts.push_back(e);
+        }
+    }
+
+    std::map<std::string, std::vector<size_t>> occurrences;
+    for (size_t i = 0; i < conjuncts.size(); i++) {
+        std::vector<std::string> names;
+        collectVariables(conjuncts[i], names);
+        for (const std::string &name : names)
+            occurrences[name].push_back(i);
+    }
+
+    std::map<std::string, bool> derived;
+    Evaluator evaluator(*this, derived);
+    std::vector<Value> values(conjuncts.size(), Value::open(nullptr));
+    std::vector<char> queued(conjuncts.size(), 1);
+    std::deque<size_t> worklist;
+    for (size_t i = 0; i < conjuncts.size(); i++)
+        worklist.push_back(i);
+
+    bool contradiction = false;
+    while (!worklist.empty() && !contradiction) {
+        const size_t i = worklist.front();
+        worklist.pop_front();
+        queued[i] = 0;
+        values[i] = evaluator.evaluate(conjuncts[i]);
+        if (values[i].isFalse()) {
+            contradiction = true;
+        } else if (!values[i].literal.empty()) {
+            const std::string name = values[i].literal;
+            derived[name] = values[i].positive;
+            values[i] = Value::constant(true);
+            for (size_t other : occurrences[name]) {
+                if (!queued[other] && !values[other].isConstant()) {
+                    queued[other] = 1;
+                    worklist.push_back(other);
+                }
+            }
+        }
+    }
+    residual.clear();
+    if (contradiction)
+        return Result::CONTRADICTION;
+
+    for (const Value &v : values)
+        if (!v.isConstant())
+            residual.push_back(v.expr);
+    // values of model variables fixed by the formula may contradict the model
+    bool needsModel = !residual.empty();
+    for (const auto &entry : derived)  // pair<string, bool>
+        if (model && model->getCNFVar(entry.first) != 0)
+            needsModel = true;
+    if (!needsModel)
+        return Result::TAUTOLOGY;
+    for (const auto &entry : derived) {
+        BoolExp *var = new BoolExpVar(entry.first, false);
+        residual.push_back(entry.second ? var : new BoolExpNot(var));
+    }
+    return Result::RESIDUAL;
+}
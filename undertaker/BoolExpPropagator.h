@@ -0,0 +1,89 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_BOOLEXPPROPAGATOR_H
+#define KCONFIG_BOOLEXPPROPAGATOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace kconfig {
+    class BoolExp;
+    class PicosatCNF;
+
+    /**
+     * \brief substitutes known values into a conjunction of formulas
+     *
+     * The values of variables a model forces (see CNFBackbone) are
+     * substituted into each conjunct. Conjuncts that shrink to a single
+     * literal fix another variable, which is substituted as well, until
+     * nothing changes anymore.
+     *
+     * Constants, function calls, comparisons and variables of the
+     * ignorelist are left alone, CNFBuilder turns each of their
+     * occurrences into a free variable.
+     */
+    class BoolExpPropagator {
+    public:
+        enum class Result {
+            CONTRADICTION,  //!< the formula is false under the fixed values
+            TAUTOLOGY,      //!< the formula holds in every solution of the model
+            RESIDUAL,       //!< the formula has to be checked, see propagate()
+        };
+
+        /**
+         * \param fixed the variables with a known value
+         * \param model the model the values are taken from. Variables of
+         *     the model that are fixed by the formula still require a
+         *     check of the model.
+         */
+        BoolExpPropagator(const std::map<std::string, bool> &fixed, const PicosatCNF *model)
+            : fixed(fixed), model(model) {}
+
+        /**
+         * \brief simplifies the conjunction of the given expressions
+         *
+         * \param residual receives the remaining conjuncts and the
+         *     variables fixed by the formula as unit conjuncts, it is
+         *     satisfiable together with the model iff the formula is.
+         *
+         * The expressions are left untouched. The residual uses their
+         * unchanged subexpressions, the nodes built for it are meant to
+         * be allocated within a BoolExpArena scope: deleting them would
+         * delete the shared subexpressions as well.
+         */
+        Result propagate(const std::vector<BoolExp *> &formula,
+                         std::vector<BoolExp *> &residual) const;
+
+        //! the same for the text of a formula, unparsable ones are returned unchanged
+        Result propagate(const std::string &formula, std::string &residual) const;
+
+    private:
+        struct Value;
+        class Evaluator;
+
+        const std::map<std::string, bool> &fixed;
+        const PicosatCNF *model;
+
+        bool isSubstitutable(const std::string &name) const;
+    };
+}
+#endif
@@ -19,183 +19,415 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
-#include "bool.h"
 #include "BoolExpSimplifier.h"
+#include "KconfigWhitelist.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+using namespace kconfig;
 
-void kconfig::BoolExpSimplifier::visit(BoolExp *) {
-    this->result = nullptr;
-}
 
-void kconfig::BoolExpSimplifier::visit(BoolExpNot *) {
-    BoolExp *node = static_cast<BoolExp *>(this->right);
-    BoolExpConst *constant = dynamic_cast<BoolExpConst*>(node);
-    if (constant) {
-        bool v = !constant->value;
-        this->result = B_CONST(v);
-        return;
+/* a copy of a subexpression that is kept as it is */
+static BoolExp *clone(BoolExp *e) {
+    if (BoolExpVar *var = dynamic_cast<BoolExpVar*>(e))
+        return new BoolExpVar(*var);
+    if (BoolExpConst *constant = dynamic_cast<BoolExpConst*>(e))
+        return B_CONST(constant->value);
+    if (BoolExpCall *call = dynamic_cast<BoolExpCall*>(e)) {
+        auto param = new std::list<BoolExp *>();
+        for (BoolExp *p : *call->param)
+            param->push_back(clone(p));
+        return new BoolExpCall(call->getName(), param);
     }
-    BoolExpNot *notExpr = dynamic_cast<BoolExpNot*>(node);
-    if (notExpr) {
-        this->result = notExpr->right;
-        return;
+    if (dynamic_cast<BoolExpAny*>(e))
+        return new BoolExpAny(e->getName(), clone(e->left), clone(e->right));
+    if (dynamic_cast<BoolExpNot*>(e))
+        return B_NOT(clone(e->right));
+    if (dynamic_cast<BoolExpAnd*>(e))
+        return B_AND(clone(e->left), clone(e->right));
+    if (dynamic_cast<BoolExpOr*>(e))
+        return B_OR(clone(e->left), clone(e->right));
+    if (dynamic_cast<BoolExpImpl*>(e))
+        return B_IMPL(clone(e->left), clone(e->right));
+    return new BoolExpEq(clone(e->left), clone(e->right));
+}
+
+/* the module state of a boolean symbol is never set */
+static bool isBooleanModule(BoolExpVar *var) {
+    return var->rel == rel_mod && var->sym->type == S_BOOLEAN;
+}
+
+BoolExp *BoolExpSimplifier::simplify(BoolExp *e) {
+    // clear() would keep the buckets of the largest expression so far,
+    // and wipe all of them in every call
+    entries.clear();
+    constants[false] = constants[true] = -1;
+    vars = decltype(vars)();
+    negations = decltype(negations)();
+    junctions = decltype(junctions)();
+    assumptions = decltype(assumptions)();
+    known = decltype(known)();
+    generation = generations = 0;
+
+    const int root = rewrite(e, false);
+    contradiction = root == constants[false];
+
+    // the nodes of the result, the chains of AND and OR are binary trees
+    std::vector<bool> counted(entries.size(), false);
+    std::vector<int> pending{root};
+    while (!pending.empty()) {
+        const int id = pending.back();
+        pending.pop_back();
+        if (counted[id])
+            continue;
+        counted[id] = true;
+        const Entry &entry = entries[id];
+        if (entry.kind == Kind::AND || entry.kind == Kind::OR)
+            stats.nodesAfter += entry.operands.size() - 1;
+        else
+            stats.nodesAfter++;
+        pending.insert(pending.end(), entry.operands.begin(), entry.operands.end());
     }
-    this->result = new BoolExpNot(node);
+    return entries[root].node;
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpAnd *) {
-    BoolExp *sr = static_cast<BoolExp *>(this->right);
-    BoolExp *sl = static_cast<BoolExp *>(this->left);
-    BoolExpConst *right = dynamic_cast<BoolExpConst*>(sr);
-    BoolExpConst *left = dynamic_cast<BoolExpConst*>(sl);
-
-    if (left != nullptr || right != nullptr) {
-        BoolExpConst *c = left ? left : right;
-        BoolExp *var = left ? sr : sl;
-        if (c->value == true) {
-            this->result = var;
-            return;
+int BoolExpSimplifier::rewrite(BoolExp *e, bool negated) {
+    stats.nodesBefore++;
+    // the result of a node depends on the assumptions
+    const Known key{e, negated, generation};
+    auto it = known.find(key);
+    if (it != known.end())
+        return it->second;
+
+    int id;
+    if (dynamic_cast<BoolExpNot*>(e)) {
+        id = rewrite(e->right, !negated);
+    } else if (dynamic_cast<BoolExpAnd*>(e) || dynamic_cast<BoolExpOr*>(e)
+               || dynamic_cast<BoolExpImpl*>(e)) {
+        id = rewriteJunction(e, negated);
+    } else if (dynamic_cast<BoolExpEq*>(e)) {
+        id = rewriteEq(e, negated);
+    } else if (BoolExpConst *c = dynamic_cast<BoolExpConst*>(e)) {
+        id = freeConstants ? copy(e, negated) : constant(c->value != negated);
+    } else if (BoolExpVar *v = dynamic_cast<BoolExpVar*>(e)) {
+        if (isBooleanModule(v)) {
+            id = constant(negated);
+        } else if (isFree(v)) {
+            id = copy(e, negated);
         } else {
-            this->result = c;            //0
-            return;
-        }
-    }
-    {
-        // X && X
-        BoolExpVar *right = dynamic_cast<BoolExpVar*>(sr);
-        BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
-        if (left != nullptr && right != nullptr) {
-            if (right->equals(left)) {
-                //delete right;
-                this->result = left;
-                return;
+            id = var(v);
+            auto assumption = assumptions.find(id);
+            if (assumption != assumptions.end()) {
+                stats.assumed++;
+                id = constant(assumption->second != negated);
+            } else if (negated) {
+                id = negation(id);
             }
         }
+    } else {
+        // calls and comparisons
+        id = copy(e, negated);
     }
-    {
-        // X && !X
-        BoolExpVar *right = dynamic_cast<BoolExpVar*>(sr);
-        BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
-        if (left != nullptr || right != nullptr) {
-            BoolExpVar *var = left ? left : right;
-            BoolExp *other = left ? sr : sl;
-            BoolExpNot *inverse = dynamic_cast<BoolExpNot*>(other);
-            if (inverse && inverse->right->equals(var)) {
-                 this->result = B_CONST(false);
-                 return;
-            }
+    known.emplace(key, id);
+    return id;
+}
+
+int BoolExpSimplifier::rewriteJunction(BoolExp *e, bool negated) {
+    // De Morgan: a negated AND is an OR of negated operands
+    const bool isAnd = (dynamic_cast<BoolExpAnd*>(e) != nullptr) != negated;
+    const Kind kind = isAnd ? Kind::AND : Kind::OR;
+
+    // the operands of the chain. Chains are flattened along their left
+    // operands, as B_AND() and joinAnd() build them; a right operand of
+    // the same kind is a subexpression of its own, which is usually
+    // shared with other expressions, and stays nested.
+    struct Operand {
+        BoolExp *node;
+        bool negated;
+        bool nested;
+    };
+    std::vector<Operand> chain;
+    std::vector<Operand> pending{{e, negated, false}};
+    while (!pending.empty()) {
+        const Operand operand = pending.back();
+        BoolExp *node = operand.node;
+        const bool neg = operand.negated;
+        pending.pop_back();
+        const bool isImpl = dynamic_cast<BoolExpImpl*>(node) != nullptr;
+        bool sameKind;
+        if (isAnd)
+            sameKind = neg ? (dynamic_cast<BoolExpOr*>(node) || isImpl)
+                           : dynamic_cast<BoolExpAnd*>(node) != nullptr;
+        else
+            sameKind = neg ? dynamic_cast<BoolExpAnd*>(node) != nullptr
+                           : (dynamic_cast<BoolExpOr*>(node) || isImpl);
+        if (node != e && dynamic_cast<BoolExpNot*>(node)) {
+            stats.nodesBefore++;
+            pending.push_back({node->right, !neg, operand.nested});
+        } else if (sameKind && !operand.nested) {
+            if (node != e)
+                stats.nodesBefore++;
+            // A -> B is !A || B
+            pending.push_back({node->right, neg, true});
+            pending.push_back({node->left, isImpl ? !neg : neg, false});
+        } else {
+            chain.push_back(operand);
         }
     }
-    this->result = B_AND(sl, sr);
-}
 
-void kconfig::BoolExpSimplifier::visit(BoolExpOr *) {
-    BoolExp *sr = static_cast<BoolExp *>(this->right);
-    BoolExp *sl = static_cast<BoolExp *>(this->left);
-    {
-        BoolExpConst *right = dynamic_cast<BoolExpConst*>(sr);
-        BoolExpConst *left = dynamic_cast<BoolExpConst*>(sl);
-
-        // x || 0; X||1
-        if (left != nullptr || right != nullptr) {
-            BoolExpConst *c = left ? left : right;
-            BoolExp *var = left ? sr : sl;
-            if (c->value == false) {
-                this->result = var;
-                 return;
-            } else {
-                 this->result = c;        //1
-                 return;
-            }
+    // symbols that are operands are assumed in the others: true within
+    // an AND, false within an OR, as only then the others matter
+    std::vector<int> results(chain.size(), -1);
+    std::vector<int> added;
+    const unsigned outer = generation;
+    for (size_t i = 0; i < chain.size(); i++) {
+        if (!dynamic_cast<BoolExpVar*>(chain[i].node))
+            continue;
+        const int id = results[i] = rewrite(chain[i].node, chain[i].negated);
+        const Entry &entry = entries[id];
+        int symbol = -1;
+        if (entry.kind == Kind::VAR)
+            symbol = id;
+        else if (entry.kind == Kind::NOT && entries[entry.operands[0]].kind == Kind::VAR)
+            symbol = entry.operands[0];
+        if (symbol >= 0 && assumptions.emplace(symbol, (symbol == id) == isAnd).second) {
+            added.push_back(symbol);
+            generation = ++generations;
         }
     }
-    {
-        // X || !X
-        BoolExpVar *right = dynamic_cast<BoolExpVar*>(sr);
-        BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
-        if (left != nullptr || right != nullptr) {
-            BoolExpVar *var = left ? left : right;
-            BoolExp *other = left ? sr : sl;
-            BoolExpNot *inverse = dynamic_cast<BoolExpNot*>(other);
-            if (inverse && inverse->right->equals(var)) {
-                 this->result = B_CONST(true);
-                 return;
-            }
+    for (size_t i = 0; i < chain.size(); i++) {
+        if (results[i] < 0)
+            results[i] = rewrite(chain[i].node, chain[i].negated);
+    }
+    for (int symbol : added)
+        assumptions.erase(symbol);
+    generation = outer;
+
+    // the operands are compared as sets sorted by key, the result keeps
+    // their order, so its gates are the ones of the unsimplified chain
+    std::vector<int> operands;
+    for (int id : results) {
+        if (isConstant(id, isAnd)) {
+            stats.constants++;
+            continue;
         }
+        if (isConstant(id, !isAnd)) {
+            stats.constants++;
+            return constant(!isAnd);
+        }
+        operands.push_back(id);
     }
-    {
-        // X || X
-        BoolExpVar *right = dynamic_cast<BoolExpVar*>(sr);
-        BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
-        if (left != nullptr && right != nullptr) {
-            if (right->equals(left)) {
-                //delete right;
-                 this->result = left;
-                 return;
-            }
+    auto before = [this](int a, int b) { return entries[a].key < entries[b].key; };
+    std::vector<int> sorted = operands;
+    std::sort(sorted.begin(), sorted.end(), before);
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    if (sorted.size() < operands.size()) {
+        stats.duplicates += operands.size() - sorted.size();
+        std::unordered_set<int> seen;
+        operands.erase(std::remove_if(operands.begin(), operands.end(),
+                                      [&seen](int id) { return !seen.insert(id).second; }),
+                       operands.end());
+    }
+
+    for (int id : sorted) {
+        const int other = complement(id);
+        if (other >= 0 && std::binary_search(sorted.begin(), sorted.end(), other, before)) {
+            stats.complements++;
+            return constant(!isAnd);
         }
     }
-    {
-        // X || X
-        BoolExpVar *right = dynamic_cast<BoolExpVar*>(sr);
-        BoolExpVar *left = dynamic_cast<BoolExpVar*>(sl);
-        if (left != nullptr && right != nullptr) {
-            if (right->equals(left)) {
-                 this->result = left;
-                 return;
+    // A && (A || B) is A, A || (A && B) is A, and (A || B) && (A || B || C)
+    // is A || B: a dual chain is absorbed by an operand that is one of its
+    // operands, or by a dual chain whose operands are a subset of its own
+    const Kind dual = isAnd ? Kind::OR : Kind::AND;
+    std::unordered_map<int, std::vector<int>> byFirst;
+    for (int id : sorted) {
+        if (entries[id].kind == dual)
+            byFirst[entries[id].operands.front()].push_back(id);
+    }
+    if (byFirst.empty())
+        return junction(kind, std::move(operands));
+    auto absorbed = [&](int id) {
+        if (entries[id].kind != dual)
+            return false;
+        const std::vector<int> &mine = entries[id].operands;
+        for (int operand : mine) {
+            if (std::binary_search(sorted.begin(), sorted.end(), operand, before))
+                return true;
+            auto it = byFirst.find(operand);
+            if (it == byFirst.end())
+                continue;
+            for (int other : it->second) {
+                const std::vector<int> &theirs = entries[other].operands;
+                if (other != id && std::includes(mine.begin(), mine.end(),
+                                                  theirs.begin(), theirs.end(), before))
+                    return true;
             }
         }
+        return false;
+    };
+    std::vector<int> dropped;
+    for (int id : sorted) {
+        if (absorbed(id))
+            dropped.push_back(id);
+    }
+    stats.absorbed += dropped.size();
+    std::sort(dropped.begin(), dropped.end());
+    std::vector<int> kept;
+    for (int id : operands) {
+        if (!std::binary_search(dropped.begin(), dropped.end(), id))
+            kept.push_back(id);
     }
-    this->result = B_OR(sl, sr);
+    return junction(kind, std::move(kept));
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpImpl *) {
-    BoolExp *sr = static_cast<BoolExp *>(this->right);
-    BoolExp *sl = static_cast<BoolExp *>(this->left);
-    {
-        BoolExpConst *right = dynamic_cast<BoolExpConst*>(sr);
-
-        // x -> 1;
-        if (right != nullptr && right->value == true) {
-            //delete sr;
-            //delete sl;
-            this->result = B_CONST(true);
-            return;
-        }
-        // x-> 0
-        if (right != nullptr && right->value == false) {
-            //delete sr;
-            BoolExp *notsl = B_NOT(sl);
-            BoolExp *notsl_simpl =  notsl->simplify();
-            //delete notsl;
-            this->result = notsl_simpl;
-            return;
-        }
+int BoolExpSimplifier::rewriteEq(BoolExp *e, bool negated) {
+    // !(A <-> B) is A <-> !B
+    const int a = rewrite(e->left, false);
+    const int b = rewrite(e->right, negated);
+    if (isConstant(a, true) || isConstant(b, true)) {
+        stats.constants++;
+        return isConstant(a, true) ? b : a;
+    }
+    if (isConstant(a, false)) {
+        stats.constants++;
+        return rewrite(e->right, !negated);
+    }
+    if (isConstant(b, false)) {
+        stats.constants++;
+        return rewrite(e->left, true);
+    }
+    if (a == b)
+        return constant(true);
+    if (complement(a) == b)
+        return constant(false);
+    const bool ordered = entries[a].key < entries[b].key;
+    const int first = ordered ? a : b, second = ordered ? b : a;
+    auto it = junctions.find({Kind::EQ, {first, second}});
+    if (it != junctions.end())
+        return it->second;
+    const int id = add(new BoolExpEq(entries[first].node, entries[second].node), Kind::EQ,
+                       {first, second});
+    junctions.emplace(std::make_pair(Kind::EQ, std::vector<int>{first, second}), id);
+    return id;
+}
+
+int BoolExpSimplifier::add(BoolExp *node, Kind kind, std::vector<int> operands) {
+    // equal nodes get the same key in all calls, each atom is a key of its own
+    int key = nextKey;
+    if (kind == Kind::VAR) {
+        key = varKeys.emplace(node->getName(), key).first->second;
+    } else if (kind != Kind::ATOM) {
+        std::vector<int> shape;
+        if (kind == Kind::CONST)
+            shape.push_back(dynamic_cast<BoolExpConst*>(node)->value);
+        for (int id : operands)
+            shape.push_back(entries[id].key);
+        key = keys.emplace(std::make_pair(kind, std::move(shape)), key).first->second;
     }
-    this->result = new BoolExpImpl(sl, sr);
+    if (key == nextKey)
+        nextKey++;
+    entries.push_back(Entry{node, kind, std::move(operands), key});
+    return entries.size() - 1;
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpEq *) {
-    BoolExp *sr = static_cast<BoolExp *>(this->right);
-    BoolExp *sl = static_cast<BoolExp *>(this->left);
-    this->result = new BoolExpEq(sl, sr);
+int BoolExpSimplifier::constant(bool value) {
+    if (constants[value] < 0)
+        constants[value] = add(B_CONST(value), Kind::CONST);
+    return constants[value];
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpAny *) {
-    this->result = nullptr;
+int BoolExpSimplifier::var(BoolExpVar *e) {
+    auto it = vars.find(e->getName());
+    if (it != vars.end())
+        return it->second;
+    const int id = add(new BoolExpVar(*e), Kind::VAR);
+    vars.emplace(e->getName(), id);
+    return id;
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpCall *) {
-    this->result = nullptr;
+int BoolExpSimplifier::negation(int id) {
+    if (entries[id].kind == Kind::NOT)
+        return entries[id].operands[0];
+    if (entries[id].kind == Kind::CONST)
+        return constant(id != constants[true]);
+    auto it = negations.find(id);
+    if (it != negations.end())
+        return it->second;
+    const int negated = add(B_NOT(entries[id].node), Kind::NOT, {id});
+    negations.emplace(id, negated);
+    return negated;
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpConst *e) {
-    this->result = new BoolExpConst(*e);
+int BoolExpSimplifier::complement(int id) const {
+    const Entry &entry = entries[id];
+    if (entry.kind == Kind::NOT)
+        return entry.operands[0];
+    auto it = negations.find(id);
+    if (it != negations.end())
+        return it->second;
+    if (entry.kind != Kind::AND && entry.kind != Kind::OR)
+        return -1;
+    // De Morgan, for chains of negated and plain symbols
+    Shape dual(entry.kind == Kind::AND ? Kind::OR : Kind::AND, {});
+    for (int operand : entry.operands) {
+        int other = -1;
+        if (entries[operand].kind == Kind::NOT) {
+            other = entries[operand].operands[0];
+        } else {
+            auto it = negations.find(operand);
+            if (it != negations.end())
+                other = it->second;
+        }
+        if (other < 0)
+            return -1;
+        dual.second.push_back(other);
+    }
+    std::sort(dual.second.begin(), dual.second.end(),
+              [this](int a, int b) { return entries[a].key < entries[b].key; });
+    auto junction = junctions.find(dual);
+    return junction != junctions.end() ? junction->second : -1;
 }
 
-void kconfig::BoolExpSimplifier::visit(BoolExpVar *e) {
-    if (e->rel == rel_mod && e->sym->type == S_BOOLEAN) {
-        this->result = B_CONST(false);
-        return;
+int BoolExpSimplifier::junction(Kind kind, std::vector<int> operands) {
+    if (operands.empty())
+        return constant(kind == Kind::AND);
+    if (operands.size() == 1)
+        return operands.front();
+    // the node is built in the given order, the entry keeps the operands sorted
+    std::vector<int> sorted = operands;
+    std::sort(sorted.begin(), sorted.end(),
+              [this](int a, int b) { return entries[a].key < entries[b].key; });
+    auto it = junctions.find({kind, sorted});
+    if (it != junctions.end())
+        return it->second;
+    BoolExp *node = entries[operands[0]].node;
+    for (size_t i = 1; i < operands.size(); i++) {
+        if (kind == Kind::AND)
+            node = B_AND(node, entries[operands[i]].node);
+        else
+            node = B_OR(node, entries[operands[i]].node);
     }
-    this->result = new BoolExpVar(*e);
+    const int id = add(node, kind, sorted);
+    junctions.emplace(std::make_pair(kind, std::move(sorted)), id);
+    return id;
+}
+
+int BoolExpSimplifier::copy(BoolExp *e, bool negated) {
+    // each copy is distinct, like the free variable the CNFBuilder makes of it
+    const int id = add(clone(e), Kind::ATOM);
+    return negated ? negation(id) : id;
+}
+
+bool BoolExpSimplifier::isFree(BoolExpVar *e) const {
+    return useKconfigWhitelist && KconfigWhitelist::getIgnorelist().isWhitelisted(e->getName());
+}
+
+std::ostream &kconfig::operator<<(std::ostream &out, const BoolExpSimplifier::Stats &stats) {
+    out << "nodes: " << stats.nodesBefore << " -> " << stats.nodesAfter << std::endl;
+    out << "constants: " << stats.constants << ", duplicates: " << stats.duplicates
+        << ", complements: " << stats.complements << std::endl;
+    out << "absorbed: " << stats.absorbed << ", assumed: " << stats.assumed << std::endl;
+    return out;
 }
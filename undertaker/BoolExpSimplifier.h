@@ -24,27 +24,173 @@
 #define KCONFIG_BOOLSIMPLIFIER_H
 
 #include "bool.h"
-#include "BoolVisitor.h"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace kconfig {
-    class BoolExpSimplifier : public BoolVisitor {
+    /**
+     * \brief rewrites expressions into smaller equivalent ones
+     *
+     * The result is in negation normal form: negations are pushed down
+     * to the symbols, implications become disjunctions. Chains of ANDs
+     * and ORs are flattened along their left operands, the way B_AND()
+     * and joinAnd() build them. Their operands are compared as sets
+     * sorted by key and then
+     *
+     *  - constants are folded,
+     *  - duplicate operands are dropped, complementary ones decide the chain,
+     *  - absorbed operands are dropped: A && (A || B) becomes A,
+     *    (A || B) && (A || B || C) becomes A || B,
+     *  - symbols that are operands of a chain are assumed in the other
+     *    operands: A && (!A || B) becomes A && B.
+     *
+     * The remaining operands keep their order, and a right operand of the
+     * same kind stays a chain of its own: such subexpressions are
+     * usually shared by many clauses of a model, and the CNFBuilder
+     * shares their gates only as long as they keep their shape.
+     *
+     * Equivalences are kept, the negation of an equivalence is moved to
+     * its right operand. Structurally identical subexpressions of the
+     * result share their nodes, the input is never part of the result.
+     *
+     * Calls and comparisons are free variables for the CNFBuilder, each
+     * of them is kept as a distinct operand. The same holds for
+     * constants and ignored symbols if the CNFBuilder treats them as
+     * free variables, see the constructor.
+     */
+    class BoolExpSimplifier {
     public:
-        BoolExp *getResult(void) const {
-            return static_cast<BoolExp *>(this->result);
-        }
-
-    protected:
-        virtual void visit(BoolExp *e)      final override;
-        virtual void visit(BoolExpAnd *e)   final override;
-        virtual void visit(BoolExpOr *e)    final override;
-        virtual void visit(BoolExpNot *e)   final override;
-        virtual void visit(BoolExpConst *e) final override;
-        virtual void visit(BoolExpVar *e)   final override;
-        virtual void visit(BoolExpImpl *e)  final override;
-        virtual void visit(BoolExpEq *e)    final override;
-        virtual void visit(BoolExpCall *e)  final override;
-        virtual void visit(BoolExpAny *e)   final override;
+        struct Stats {
+            unsigned long nodesBefore = 0, nodesAfter = 0;
+            unsigned long constants = 0;    //!< operands that were folded into a constant
+            unsigned long duplicates = 0;   //!< operands that occurred twice in a chain
+            unsigned long complements = 0;  //!< chains decided by complementary operands
+            unsigned long absorbed = 0;     //!< operands dropped by absorption
+            unsigned long assumed = 0;      //!< symbols replaced by an assumption
+        };
+
+        /**
+         * \param freeConstants constants are distinct unknown values,
+         *        see CNFBuilder::ConstantPolicy::FREE
+         * \param useKconfigWhitelist symbols of the ignorelist are
+         *        distinct unknown values
+         */
+        explicit BoolExpSimplifier(bool freeConstants = false, bool useKconfigWhitelist = false)
+            : freeConstants(freeConstants), useKconfigWhitelist(useKconfigWhitelist) {}
+
+        //! a new expression that is equivalent to e, e is left untouched
+        BoolExp *simplify(BoolExp *e);
+
+        /**
+         * \brief true if the last result of simplify() was folded into false
+         *
+         * With free constants, a constant of the input is copied as it
+         * is, the result may then be a BoolExpConst that isn't false.
+         */
+        bool isContradiction() const { return contradiction; }
+
+        //! accumulated over all calls of simplify()
+        const Stats &getStats() const { return stats; }
+
+    private:
+        enum class Kind { ATOM, CONST, VAR, NOT, AND, OR, EQ };
+        //! a node of the result, the index of the entry is its id
+        struct Entry {
+            BoolExp *node;
+            Kind kind;
+            //! the operands of AND, OR and EQ, the operand of NOT
+            std::vector<int> operands;
+            //! orders the operands of chains, see keys
+            int key;
+        };
+
+        //! a node by its kind and its operands
+        typedef std::pair<Kind, std::vector<int>> Shape;
+        struct ShapeHash {
+            size_t operator()(const Shape &shape) const {
+                size_t h = (size_t) shape.first;
+                for (int operand : shape.second)
+                    h = h * 0x9e3779b97f4a7c15ULL + operand;
+                return h;
+            }
+        };
+
+        const bool freeConstants;
+        const bool useKconfigWhitelist;
+        Stats stats;
+
+        //@{
+        //! the result of the current call, reset by simplify()
+        std::vector<Entry> entries;
+        int constants[2];
+        bool contradiction = false;
+        std::unordered_map<std::string, int> vars;
+        std::unordered_map<int, int> negations;
+        std::unordered_map<Shape, int, ShapeHash> junctions;
+        //! symbols with an assumed value in the subexpression that is simplified
+        std::unordered_map<int, bool> assumptions;
+        /**
+         * \brief the results of the nodes that were simplified
+         *
+         * A result holds for the assumptions it was simplified with,
+         * each set of assumptions has a generation of its own. Nodes that
+         * are shared by several operands of a chain are hence simplified
+         * once per chain.
+         */
+        struct Known {
+            BoolExp *node;
+            bool negated;
+            unsigned generation;
+            bool operator==(const Known &other) const {
+                return node == other.node && negated == other.negated
+                    && generation == other.generation;
+            }
+        };
+        struct KnownHash {
+            size_t operator()(const Known &k) const {
+                return std::hash<BoolExp *>()(k.node) * 31 + k.generation * 2 + k.negated;
+            }
+        };
+        std::unordered_map<Known, int, KnownHash> known;
+        unsigned generation = 0, generations = 0;
+        //@}
+
+        //@{
+        /**
+         * \brief the keys of the nodes of all calls
+         *
+         * The operands of chains are sorted by their keys, equal chains
+         * are therefore built the same way in every result, and the
+         * CNFBuilder shares their gates across clauses.
+         */
+        std::unordered_map<Shape, int, ShapeHash> keys;
+        std::unordered_map<std::string, int> varKeys;
+        int nextKey = 0;
+        //@}
+
+        //! the id of e, or of !e if negated is set
+        int rewrite(BoolExp *e, bool negated);
+        int rewriteJunction(BoolExp *e, bool negated);
+        int rewriteEq(BoolExp *e, bool negated);
+
+        int add(BoolExp *node, Kind kind, std::vector<int> operands = {});
+        int constant(bool value);
+        int var(BoolExpVar *e);
+        int negation(int id);
+        int junction(Kind kind, std::vector<int> operands);
+        int copy(BoolExp *e, bool negated);
+        bool isConstant(int id, bool value) const { return constants[value] == id; }
+        //! the id of the complement of the node, -1 if it isn't known
+        int complement(int id) const;
+        //! the value of a symbol that is never assumed, see the constructor
+        bool isFree(BoolExpVar *e) const;
     };
+
+    std::ostream &operator<<(std::ostream &out, const BoolExpSimplifier::Stats &stats);
 };
 
 #endif
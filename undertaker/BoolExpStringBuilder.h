@@ -26,22 +26,44 @@
 #include "bool.h"
 #include "BoolVisitor.h"
 
+#include <deque>
+#include <string>
+#include <vector>
+
 namespace kconfig {
+    /**
+     * \brief the text of a formula
+     *
+     * The visit of a node only records its operator and the texts of its
+     * children, str() writes all of them in one pass without recursion.
+     * The text of a long chain isn't copied into each of its nodes.
+     */
     class BoolExpStringBuilder : public BoolVisitor {
     public:
-        std::string str(void) const{
-            return *(static_cast<std::string *>(this->result));
-        }
-
-        ~BoolExpStringBuilder() {
-            for (auto &entry : visited)  // pair<BoolExp *, void *>
-                if (entry.second)
-                    delete static_cast<std::string *>(entry.second);
+        std::string str(void) const {
+            std::string s;
+            // the pieces and texts that are still to be written, the next one on top
+            std::vector<Item> pending{{static_cast<const Piece *>(this->result), nullptr}};
+            while (!pending.empty()) {
+                const Item item = pending.back();
+                pending.pop_back();
+                if (!item.piece) {
+                    s += item.text;
+                    continue;
+                }
+                const Piece *p = item.piece;
+                if (p->right)
+                    push(pending, p->right, p->braceRight);
+                pending.push_back({nullptr, p->text.c_str()});
+                if (p->left)
+                    push(pending, p->left, p->braceLeft);
+            }
+            return s;
         }
 
     protected:
         virtual void visit(BoolExp *)       final override {
-            this->result = new std::string("__something_went_horribly_wrong__");
+            this->result = make("__something_went_horribly_wrong__");
         }
 
         virtual void visit(BoolExpAnd *e)   final override {
@@ -58,11 +80,11 @@ namespace kconfig {
 
         virtual void visit(BoolExpConst *e) final override {
             const char *v = e->value ? "1" : "0";
-            this->result = new std::string(v);
+            this->result = make(v);
         }
 
         virtual void visit(BoolExpVar *e)   final override {
-            this->result = new std::string(e->getName());
+            this->result = make(e->getName());
         }
 
         virtual void visit(BoolExpImpl *e)  final override {
@@ -81,7 +103,7 @@ namespace kconfig {
                 paramstring += ptr->str();
                 first = false;
             }
-            this->result = new std::string{ e->getName() + " (" + paramstring + ")" };
+            this->result = make(e->getName() + " (" + paramstring + ")");
         }
 
         virtual void visit(BoolExpAny *e)   final override {
@@ -89,26 +111,43 @@ namespace kconfig {
         }
 
     private:
-        static const char *lbrace (BoolExp *parent, BoolExp *child) {
-            return (child->getEvaluationPriority() >= parent->getEvaluationPriority()) ? "" : "(";
+        //! the text of a node, the texts of its children are written around it
+        struct Piece {
+            std::string text;
+            const Piece *left, *right;
+            bool braceLeft, braceRight;
+        };
+        //! either a piece or a plain text
+        struct Item {
+            const Piece *piece;
+            const char *text;
+        };
+
+        //! the pieces of all visited nodes, a deque doesn't move its elements
+        std::deque<Piece> pieces;
+
+        Piece *make(std::string s) {
+            pieces.push_back({std::move(s), nullptr, nullptr, false, false});
+            return &pieces.back();
         }
 
-        static const char *rbrace (BoolExp *parent, BoolExp *child) {
-            return (child->getEvaluationPriority() >= parent->getEvaluationPriority()) ? "" : ")";
+        static bool brace(BoolExp *parent, BoolExp *child) {
+            return child->getEvaluationPriority() < parent->getEvaluationPriority();
+        }
+
+        static void push(std::vector<Item> &pending, const Piece *p, bool braced) {
+            if (braced)
+                pending.push_back({nullptr, ")"});
+            pending.push_back({p, nullptr});
+            if (braced)
+                pending.push_back({nullptr, "("});
         }
 
         void makestr(const std::string &op, BoolExp *e) {
-            std::string *l = static_cast<std::string *>(left);
-            std::string *r = static_cast<std::string *>(right);
-            auto s = new std::string();
-            if (l) {
-                *s += lbrace(e, e->left) + *l + rbrace(e, e->left);
-            }
-            *s += op;
-            if (r) {
-                *s += lbrace(e, e->right) + *r + rbrace(e, e->right);
-            }
-            this->result = s;
+            const Piece *l = static_cast<const Piece *>(left);
+            const Piece *r = static_cast<const Piece *>(right);
+            pieces.push_back({op, l, r, l && brace(e, e->left), r && brace(e, e->right)});
+            this->result = &pieces.back();
         }
     };
 }
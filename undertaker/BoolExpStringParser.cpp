@@ -0,0 +1,343 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolExpStringParser.h"
+#include "bool.h"
+
+#include <list>
+#include <vector>
+
+using namespace kconfig;
+
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline bool isHexDigit(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static inline bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.';
+}
+
+static inline bool isIdentifierChar(char c) { return isIdentifierStart(c) || isDigit(c); }
+
+BoolExpStringParser::BoolExpStringParser(const char *begin, const char *end)
+    : pos(begin), end(end) {
+    next();
+}
+
+/* the rules of BoolExpLexer.l, the longest match wins, on a tie the first rule */
+void BoolExpStringParser::next() {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n'))
+        pos++;
+    text = pos;
+    if (pos == end) {
+        token = Token::END;
+        length = 0;
+        return;
+    }
+    // the '.' rule hands a NUL byte to the parser as 'eof', and so every byte above
+    // 0x7f, which is a negative char, bison takes all token numbers below 1 as 'eof'
+    if (*pos == '\0' || (*pos & 0x80)) {
+        token = Token::END;
+        length = 1;
+        pos++;
+        return;
+    }
+    auto peek = [this](size_t i) { return pos + i < end ? pos[i] : '\0'; };
+    auto integerSuffix = [this](const char *p) {  // u?[lL]{0,2}
+        if (p < end && *p == 'u')
+            p++;
+        for (int i = 0; i < 2 && p < end && (*p == 'l' || *p == 'L'); i++)
+            p++;
+        return p;
+    };
+
+    const char c = *pos;
+    size_t len = 1;
+    if (isDigit(c)) {
+        const char *p = pos;
+        if (c == '0' && peek(1) == 'x' && isHexDigit(peek(2))) {
+            for (p += 2; p < end && isHexDigit(*p); p++)
+                ;
+            token = Token::TTRUE;
+        } else {
+            for (; p < end && isDigit(*p); p++)
+                ;
+            // only a single '0' is false, "00" is a decimal number
+            token = (p == pos + 1 && c == '0') ? Token::TFALSE : Token::TTRUE;
+        }
+        len = integerSuffix(p) - pos;
+    } else if (c == '\'' && peek(1) != '\n' && pos + 2 < end && peek(2) == '\'') {
+        token = Token::TTRUE;
+        len = 3;
+    } else if (isIdentifierStart(c)) {
+        while (pos + len < end && isIdentifierChar(pos[len]))
+            len++;
+        token = Token::IDENTIFIER;
+    } else {
+        const char c1 = peek(1), c2 = peek(2);
+        token = Token::COP;
+        switch (c) {
+        case '|':
+            if (c1 == '|') { token = Token::OR; len = 2; }
+            break;
+        case '&':
+            if (c1 == '&') { token = Token::AND; len = 2; }
+            break;
+        case '<':
+            if (c1 == '-' && c2 == '>') { token = Token::EQ; len = 3; }
+            else if (c1 == '<' && c2 == '<') len = 3;
+            else if (c1 == '<' || c1 == '=') len = 2;
+            break;
+        case '-':
+            if (c1 == '>') { token = Token::IMPL; len = 2; }
+            break;
+        case '>':
+            if (c1 == '>' || c1 == '=') len = 2;
+            break;
+        case '=':
+            if (c1 == '=') len = 2;
+            else token = Token::INVALID;
+            break;
+        case '!':
+            if (c1 == '=') len = 2;
+            else token = Token::NOT;
+            break;
+        case '?': case ':': case '*': case '/': case '+': case '%':
+            break;
+        case '(':
+            token = Token::LPAREN;
+            break;
+        case ')':
+            token = Token::RPAREN;
+            break;
+        case ',':
+            token = Token::COMMA;
+            break;
+        default:
+            token = Token::INVALID;
+        }
+    }
+    length = len;
+    pos += len;
+}
+
+int BoolExpStringParser::precedence(Token token) {
+    switch (token) {
+    case Token::EQ:   return 1;
+    case Token::IMPL: return 2;
+    case Token::OR:   return 3;
+    case Token::AND:  return 4;
+    case Token::COP:  return 5;
+    default:          return 0;
+    }
+}
+
+BoolExp *BoolExpStringParser::parse() {
+    BoolExp *e = parseExpr(1);
+    // bison wants the end of its input after 'Line : Expr END', one more 'eof'
+    if (e && token == Token::END && length)
+        next();
+    if (e && token != Token::END) {
+        delete e;
+        return nullptr;
+    }
+    return e;
+}
+
+BoolExp *BoolExpStringParser::parseExpr(int minPrecedence) {
+    BoolExp *left = parseLiteral();
+    if (!left)
+        return nullptr;
+    int prec;
+    while ((prec = precedence(token)) >= minPrecedence) {
+        const Token op = token;
+        const std::string opText = (op == Token::COP) ? std::string(text, length) : "";
+        next();
+        // all operators are left associative
+        BoolExp *right = parseExpr(prec + 1);
+        if (!right) {
+            delete left;
+            return nullptr;
+        }
+        if (op == Token::AND || op == Token::OR) {
+            // the operands of a run of one junction are joined at once, see joinAnd()
+            std::vector<BoolExp *> operands{left, right};
+            while (token == op) {
+                next();
+                BoolExp *e = parseExpr(prec + 1);
+                if (!e) {
+                    for (BoolExp *operand : operands)
+                        delete operand;
+                    return nullptr;
+                }
+                operands.push_back(e);
+            }
+            left = (op == Token::AND) ? joinAnd(operands) : joinOr(operands);
+            continue;
+        }
+        switch (op) {
+        case Token::EQ:   left = new BoolExpEq(left, right); break;
+        case Token::IMPL: left = new BoolExpImpl(left, right); break;
+        default:          left = new BoolExpAny(opText, left, right); break;
+        }
+    }
+    return left;
+}
+
+BoolExp *BoolExpStringParser::parseLiteral() {
+    int negations = 0;
+    for (; token == Token::NOT; next())
+        negations++;
+    BoolExp *e = parseAtom();
+    if (!e)
+        return nullptr;
+    while (negations-- > 0)
+        e = new BoolExpNot(e);
+    return e;
+}
+
+BoolExp *BoolExpStringParser::parseAtom() {
+    switch (token) {
+    case Token::TTRUE:
+    case Token::TFALSE: {
+        BoolExp *e = B_CONST(token == Token::TTRUE);
+        next();
+        return e;
+    }
+    case Token::LPAREN: {
+        next();
+        BoolExp *e = parseExpr(1);
+        if (e && token != Token::RPAREN) {
+            delete e;
+            return nullptr;
+        }
+        next();
+        return e;
+    }
+    case Token::IDENTIFIER:
+        break;
+    default:
+        return nullptr;
+    }
+
+    std::string name(text, length);
+    next();
+    if (token != Token::LPAREN)
+        return new BoolExpVar(std::move(name), false);
+
+    // the first parameter may be left out, "f(, x)" is as valid as "f()"
+    auto param = new std::list<BoolExp *>();
+    next();
+    bool valid = true;
+    if (token != Token::RPAREN && token != Token::COMMA) {
+        BoolExp *e = parseExpr(1);
+        valid = e != nullptr;
+        if (valid)
+            param->push_back(e);
+    }
+    while (valid && token == Token::COMMA) {
+        next();
+        BoolExp *e = parseExpr(1);
+        valid = e != nullptr;
+        if (valid)
+            param->push_back(e);
+    }
+    if (!valid || token != Token::RPAREN) {
+        for (BoolExp *e : *param)
+            delete e;
+        delete param;
+        return nullptr;
+    }
+    next();
+    return new BoolExpCall(name, param);
+}
+
+/* the decisions of parse(), an expression is a sequence of operands and
+   binary operators, the parentheses only have to match */
+bool BoolExpStringParser::scanSymbols(std::set<std::string> &symbols) {
+    // the open parentheses, true for the ones of function calls
+    std::vector<bool> open;
+    bool operand = true;  // an operand is expected next
+    for (;;) {
+        if (operand) {
+            switch (token) {
+            case Token::NOT:
+                next();
+                continue;
+            case Token::TTRUE:
+            case Token::TFALSE:
+                operand = false;
+                next();
+                continue;
+            case Token::LPAREN:
+                open.push_back(false);
+                next();
+                continue;
+            case Token::IDENTIFIER:
+                break;
+            default:
+                return false;
+            }
+            const char *name = text;
+            const size_t nameLength = length;
+            next();
+            if (token != Token::LPAREN) {
+                symbols.emplace(name, nameLength);
+                operand = false;
+                continue;
+            }
+            next();
+            if (token == Token::RPAREN) {
+                operand = false;
+                next();
+                continue;
+            }
+            // the first parameter may be left out, "f(, x)" is as valid as "f()"
+            open.push_back(true);
+            if (token == Token::COMMA)
+                next();
+            continue;
+        }
+        switch (token) {
+        case Token::END:
+            if (length)
+                next();
+            return token == Token::END && open.empty();
+        case Token::RPAREN:
+            if (open.empty())
+                return false;
+            open.pop_back();
+            next();
+            continue;
+        case Token::COMMA:
+            if (open.empty() || !open.back())
+                return false;
+            operand = true;
+            next();
+            continue;
+        default:
+            if (precedence(token) == 0)
+                return false;
+            operand = true;
+            next();
+        }
+    }
+}
@@ -0,0 +1,105 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_BOOLEXPSTRINGPARSER_H
+#define KCONFIG_BOOLEXPSTRINGPARSER_H
+
+#include <cstddef>
+#include <set>
+#include <string>
+
+
+namespace kconfig {
+    class BoolExp;
+
+    /**
+     * \brief hand-written parser for the grammar of BoolExpParser.y
+     *
+     * The tokens are scanned in place, the text of an identifier is
+     * copied only into the node it ends up in. Binary operators are
+     * parsed by precedence climbing, chains of one operator are built
+     * in a loop, so long conjunctions don't grow the stack. Nodes are
+     * taken from the active BoolExpArena like all others.
+     *
+     * It accepts exactly the language of the bison parser (which is
+     * kept as BoolExp::parseStringBison() for reference) and builds
+     * the same trees, except for runs of more than joinChainLength
+     * operands of '&&' or '||': they are joined as balanced trees by
+     * joinAnd() and joinOr(), the bison parser chains them to the left.
+     *
+     *     Expr    := Expr '<->' Expr | Expr '->' Expr
+     *              | Expr '||' Expr | Expr '&&' Expr | Expr COP Expr
+     *              | '!' Expr | Atom           (loosest to tightest, left assoc.)
+     *     Atom    := Const | ID | ID '(' Params ')' | '(' Expr ')'
+     *     Params  := [Expr] {',' Expr}
+     *
+     * COP is any C operator of BoolExpLexer.l, it becomes a BoolExpAny.
+     * Const is a number or a character literal, only '0' is false.
+     */
+    class BoolExpStringParser {
+    public:
+        BoolExpStringParser(const char *begin, const char *end);
+
+        //! the formula, nullptr if the input isn't valid
+        BoolExp *parse();
+
+        static BoolExp *parse(const std::string &s) {
+            return BoolExpStringParser(s.data(), s.data() + s.size()).parse();
+        }
+
+        /**
+         * \brief the symbols BoolExpSymbolSet finds in parse(s)
+         *
+         * The input is checked against the grammar token by token, no
+         * nodes are built. Names of functions aren't symbols, their
+         * parameters are. Invalid input has no symbols at all.
+         */
+        static std::set<std::string> symbols(const std::string &s) {
+            std::set<std::string> result;
+            if (!BoolExpStringParser(s.data(), s.data() + s.size()).scanSymbols(result))
+                result.clear();
+            return result;
+        }
+
+    private:
+        enum class Token {
+            END, IDENTIFIER, TTRUE, TFALSE, OR, AND, EQ, IMPL, COP,
+            LPAREN, RPAREN, COMMA, NOT, INVALID,
+        };
+
+        const char *pos;
+        const char *end;
+        //@{
+        //! the current token, an END of one byte doesn't end the input
+        Token token;
+        const char *text;
+        size_t length;
+        //@}
+
+        void next();
+        BoolExp *parseExpr(int minPrecedence);
+        BoolExp *parseLiteral();
+        BoolExp *parseAtom();
+        //! false if the input isn't valid, symbols may be incomplete then
+        bool scanSymbols(std::set<std::string> &symbols);
+        //! 0 if the token isn't a binary operator
+        static int precedence(Token token);
+    };
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "BoolVisitor.h"
+
+#include <atomic>
+
+using namespace kconfig;
+
+
+/* epochs are unique across threads, marks left by a visitor of another
+   thread never match */
+static std::atomic<uint64_t> epochs(0);
+
+/* the visitor of the current thread that owns the marks in the nodes */
+static thread_local BoolVisitor *markOwner = nullptr;
+
+BoolVisitor::BoolVisitor() : left(nullptr), right(nullptr), result(nullptr) {
+    ownsMarks = (markOwner == nullptr);
+    if (ownsMarks)
+        markOwner = this;
+    epoch = ++epochs;
+}
+
+BoolVisitor::~BoolVisitor() {
+    if (ownsMarks)
+        markOwner = nullptr;
+}
+
+void BoolVisitor::clearVisited() {
+    if (ownsMarks)
+        epoch = ++epochs;
+    else
+        table.clear();
+}
+
+/************************************************************************/
+/* VisitedTable                                                         */
+/************************************************************************/
+
+static inline size_t slotOf(const BoolExp *node, size_t mask) {
+    uintptr_t h = reinterpret_cast<uintptr_t>(node);
+    h ^= h >> 17;
+    h *= 0x9e3779b97f4a7c15ULL;
+    return (h >> 29) & mask;
+}
+
+void **BoolVisitor::VisitedTable::find(BoolExp *node) const {
+    if (used == 0)
+        return nullptr;
+    const size_t mask = slots.size() - 1;
+    for (size_t i = slotOf(node, mask); slots[i].node; i = (i + 1) & mask)
+        if (slots[i].node == node)
+            return const_cast<void **>(&slots[i].value);
+    return nullptr;
+}
+
+void BoolVisitor::VisitedTable::insert(BoolExp *node, void *value) {
+    if (2 * (used + 1) > slots.size())
+        grow();
+    const size_t mask = slots.size() - 1;
+    size_t i = slotOf(node, mask);
+    while (slots[i].node && slots[i].node != node)
+        i = (i + 1) & mask;
+    if (!slots[i].node)
+        used++;
+    slots[i] = {node, value};
+}
+
+void BoolVisitor::VisitedTable::clear() {
+    if (used == 0)
+        return;
+    for (Slot &slot : slots)
+        slot = {nullptr, nullptr};
+    used = 0;
+}
+
+void BoolVisitor::VisitedTable::grow() {
+    std::vector<Slot> old(slots.empty() ? 32 : 2 * slots.size(), Slot{nullptr, nullptr});
+    old.swap(slots);
+    used = 0;
+    for (const Slot &slot : old)
+        if (slot.node)
+            insert(slot.node, slot.value);
+}
+
+/************************************************************************/
+/* traversal                                                            */
+/************************************************************************/
+
+void BoolVisitor::traverse(BoolExp *root) {
+    // nested traversals start above the frames of the outer ones
+    const size_t base = stack.size();
+    stack.push_back({root, nullptr, nullptr, 0});
+    while (stack.size() > base) {
+        Frame &frame = stack.back();
+        if (frame.done < 2) {
+            const bool isLeft = (frame.done++ == 0);
+            BoolExp *child = isLeft ? frame.node->left : frame.node->right;
+            if (child && !lookup(child, isLeft ? frame.left : frame.right))
+                stack.push_back({child, nullptr, nullptr, 0});
+            continue;
+        }
+        BoolExp *node = frame.node;
+        left = frame.left;
+        right = frame.right;
+        result = nullptr;
+        // the frame is gone before the dispatch, it may traverse the parameters of a call
+        stack.pop_back();
+        node->dispatch(this);
+        markVisited(node, result);
+        if (stack.size() > base) {
+            Frame &parent = stack.back();
+            (parent.done == 1 ? parent.left : parent.right) = result;
+        }
+    }
+}
@@ -24,9 +24,28 @@
 
 #include "bool.h"
 
-#include <map>
+#include <cstdint>
+#include <vector>
 
 namespace kconfig {
+    /**
+     * \brief base class of all traversals of BoolExp DAGs
+     *
+     * Each node is visited once, the result of its visit is handed to
+     * all parents. The visited state is kept in the nodes themselves
+     * (BoolExp::visitMark): the marks carry the epoch of the visitor, a
+     * new epoch invalidates all marks of a visitor at once.
+     *
+     * Only one visitor per thread can own the marks, it is the oldest
+     * one that is still alive. Visitors that are created meanwhile, for
+     * instance a BoolExpGC that runs while a CNFBuilder translates a
+     * model, keep their state in a hash table of their own.
+     *
+     * The traversal doesn't recurse: the nodes whose children are still
+     * pending are kept on a stack of the visitor, a chain of a hundred
+     * thousand operands costs as much heap as it has nodes, but no
+     * thread stack.
+     */
     class BoolVisitor {
         friend class BoolExpVar;
         friend class BoolExpNot;
@@ -40,14 +59,24 @@ namespace kconfig {
         friend class BoolExpAny;
 
     public:
+        BoolVisitor();
+        virtual ~BoolVisitor();
+        BoolVisitor(const BoolVisitor &) = delete;
+        BoolVisitor &operator=(const BoolVisitor &) = delete;
+
         bool isVisited(BoolExp *node) const {
-            return visited.find(node) != visited.end();
+            if (ownsMarks)
+                return node->visitMark.epoch == epoch;
+            return table.find(node) != nullptr;
         }
 
     protected:
-        std::map <BoolExp *, void *> visited;
         void *left, *right;
         void *result;
+
+        //! forgets all visited nodes
+        void clearVisited();
+
         virtual void visit(BoolExp *e) = 0;
         virtual void visit(BoolExpAnd *e) = 0;
         virtual void visit(BoolExpOr *e) = 0;
@@ -58,6 +87,73 @@ namespace kconfig {
         virtual void visit(BoolExpEq *e) = 0;
         virtual void visit(BoolExpCall *e) = 0;
         virtual void visit(BoolExpAny *e) = 0;
+
+        //! looks up the result of a visited node
+        bool lookup(BoolExp *node, void *&value) {
+            if (ownsMarks) {
+                if (node->visitMark.epoch != epoch)
+                    return false;
+                value = node->visitMark.result;
+                return true;
+            }
+            void **entry = table.find(node);
+            if (!entry)
+                return false;
+            value = *entry;
+            return true;
+        }
+
+        void markVisited(BoolExp *node, void *value) {
+            if (ownsMarks) {
+                node->visitMark.epoch = epoch;
+                node->visitMark.result = value;
+            } else {
+                table.insert(node, value);
+            }
+        }
+
+    private:
+        //! open addressing hash table, for visitors that don't own the marks
+        class VisitedTable {
+        public:
+            void **find(BoolExp *node) const;
+            void insert(BoolExp *node, void *value);
+            void clear();
+
+        private:
+            struct Slot {
+                BoolExp *node;
+                void *value;
+            };
+            std::vector<Slot> slots;
+            size_t used = 0;
+
+            void grow();
+        };
+
+        uint64_t epoch;
+        bool ownsMarks;
+        VisitedTable table;
+
+        //! a node whose children are visited
+        struct Frame {
+            BoolExp *node;
+            //! the results of the children
+            void *left, *right;
+            //! the number of children that are done, left first
+            int done;
+        };
+        //! the nodes of all running traversals, the innermost one on top
+        std::vector<Frame> stack;
+
+        /**
+         * \brief visits the nodes below the root that weren't visited yet
+         *
+         * The root itself is always visited. The parameters of a call are
+         * traversed as roots of their own when the call is dispatched,
+         * unless they were visited already.
+         */
+        void traverse(BoolExp *root);
     };
 }
 #endif
@@ -0,0 +1,103 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "CNFBackbone.h"
+#include "PicosatCNF.h"
+
+#include <deque>
+#include <cstdlib>
+
+using namespace kconfig;
+
+
+const std::string CNFBackbone::metaKey = "BACKBONE";
+
+CNFBackbone::CNFBackbone(const PicosatCNF &model) {
+    PicosatCNF cnf(model, Picosat::SAT_MIN);
+    if (!cnf.checkSatisfiable())
+        return;
+    satisfiable = true;
+
+    // several names may share a variable, each variable is probed only once. A name
+    // may stand for the negated variable, its sign is kept with it
+    std::map<int, std::vector<std::pair<std::string, bool>>> names;
+    model.forEachSymbol([&names](StringRef name, int var) {
+        names[abs(var)].emplace_back(name.str(), var > 0);
+    });
+    std::vector<int> candidates;
+    for (const auto &entry : names)  // pair<int, vector<pair<string, bool>>>
+        candidates.push_back(cnf.deref(entry.first) ? entry.first : -entry.first);
+
+    cnf.setDefaultPhase(Picosat::SAT_MAX);
+    if (cnf.checkSatisfiable()) {
+        size_t kept = 0;
+        for (int lit : candidates)
+            if (cnf.deref(abs(lit)) == (lit > 0))
+                candidates[kept++] = lit;
+        candidates.resize(kept);
+    }
+    stats.candidates = candidates.size();
+
+    std::vector<int> forced;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const int lit = candidates[i];
+        if (lit == 0)
+            continue;
+        if (cnf.derefToplevel(lit) == 1) {
+            stats.toplevel++;
+            forced.push_back(lit);
+            continue;
+        }
+        stats.probes++;
+        cnf.pushAssumption(-lit);
+        if (!cnf.checkSatisfiable()) {
+            forced.push_back(lit);
+            // makes the following probes cheaper
+            cnf.pushVar(lit);
+            cnf.pushClause();
+            continue;
+        }
+        // the new solution disagrees with lit, all other disagreeing candidates are no backbone
+        for (size_t j = i + 1; j < candidates.size(); j++)
+            if (candidates[j] != 0 && cnf.deref(abs(candidates[j])) != (candidates[j] > 0))
+                candidates[j] = 0;
+    }
+
+    for (int lit : forced)
+        for (const auto &name : names[abs(lit)])  // pair<string, bool>
+            values[name.first] = (lit > 0) == name.second;
+    stats.forced = values.size();
+}
+
+void CNFBackbone::store(PicosatCNF *cnf) const {
+    for (const auto &entry : values)  // pair<string, bool>
+        cnf->addMetaValue(metaKey, entry.second ? entry.first : "!" + entry.first);
+}
+
+bool CNFBackbone::load(const PicosatCNF &cnf, std::map<std::string, bool> &values) {
+    const std::deque<std::string> *items = cnf.getMetaValue(metaKey);
+    if (!items)
+        return false;
+    for (const std::string &item : *items) {
+        if (item.size() > 1 && item[0] == '!')
+            values[item.substr(1)] = false;
+        else
+            values[item] = true;
+    }
+    return true;
+}
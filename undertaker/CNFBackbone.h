@@ -0,0 +1,83 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_CNFBACKBONE_H
+#define KCONFIG_CNFBACKBONE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace kconfig {
+    class PicosatCNF;
+
+    /**
+     * \brief the named variables a model forces to a fixed value
+     *
+     * Candidates are the values two solutions with opposite default
+     * phases agree on. Variables the solver fixes on the top level are
+     * taken as they are, every other candidate is probed by assuming its
+     * complement: if that is unsatisfiable, the candidate is forced,
+     * otherwise the new solution rules out all candidates it disagrees
+     * with.
+     *
+     * The backbone is stored in the meta information of the model, see
+     * store() and load(), thus it has to be computed only once.
+     */
+    class CNFBackbone {
+    public:
+        struct Stats {
+            int candidates = 0;  //!< named variables left after the first two solutions
+            int toplevel = 0;    //!< candidates fixed without any assumption
+            int probes = 0;      //!< number of solver calls for the remaining candidates
+            int forced = 0;      //!< size of the backbone
+        };
+
+        //! name of the meta value the backbone is stored in
+        static const std::string metaKey;
+
+        //! computes the backbone of the given model
+        explicit CNFBackbone(const PicosatCNF &model);
+
+        //! false if the model has no solution, it has no backbone then
+        bool isSatisfiable() const { return satisfiable; }
+
+        //! the variables and their forced values
+        const std::map<std::string, bool> &getValues() const { return values; }
+
+        const Stats &getStats() const { return stats; }
+
+        //! adds the backbone to the meta information of the given cnf, "CONFIG_A" or "!CONFIG_B"
+        void store(PicosatCNF *cnf) const;
+
+        /**
+         * \brief reads a backbone written by store()
+         *
+         * \return false if the cnf has no backbone
+         */
+        static bool load(const PicosatCNF &cnf, std::map<std::string, bool> &values);
+
+    private:
+        bool satisfiable = false;
+        std::map<std::string, bool> values;
+        Stats stats;
+    };
+}
+#endif
@@ -22,15 +22,41 @@
 #include "CNFBuilder.h"
 #include "PicosatCNF.h"
 #include "KconfigWhitelist.h"
+#include "BoolExpArena.h"
 #include "exceptions/CNFBuilderError.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
 using namespace kconfig;
 
+// the cnf literal of a node is the result of its visit
+static inline void *toResult(int literal) { return (void *) (intptr_t) literal; }
+static inline int toLiteral(void *result) { return (int) (intptr_t) result; }
+
+/* Encoding::POLARITY keeps the literal of a node and the polarities its
+   clauses cover in the mark. Polarities 0 mark a node that has been
+   flattened into the chain with the number given as literal. */
+static inline void *toMark(int literal, int polarities) {
+    return (void *) ((intptr_t) literal * 4 + polarities);
+}
+static inline int markPolarities(void *mark) { return (int) ((intptr_t) mark & 3); }
+static inline int markLiteral(void *mark) {
+    return (int) (((intptr_t) mark - markPolarities(mark)) / 4);
+}
+static inline int flip(int polarity) { return (polarity & 1) << 1 | (polarity & 2) >> 1; }
+
 
 CNFBuilder::CNFBuilder(PicosatCNF *cnf, std::string sat, bool useKconfigWhitelist,
-                       ConstantPolicy constPolicy)
-        : cnf(cnf), constPolicy(constPolicy), useKconfigWhitelist(useKconfigWhitelist) {
+                       ConstantPolicy constPolicy, Encoding encoding)
+        : cnf(cnf), constPolicy(constPolicy), useKconfigWhitelist(useKconfigWhitelist),
+          encoding(encoding) {
     if (sat != "") {
+        // the expression lives only as long as it is translated
+        static thread_local BoolExpArena arena;
+        BoolExpArena::Scope scope(&arena);
         BoolExp *exp = BoolExp::parseString(sat);
         if (!exp) {
             throw CNFBuilderError("CNFBuilder: Couldn't parse: " + sat);
@@ -40,8 +66,41 @@ CNFBuilder::CNFBuilder(PicosatCNF *cnf, std::string sat, bool useKconfigWhitelis
     }
 }
 
+void CNFBuilder::setSimplify(bool enable) {
+    if (!enable)
+        simplifier.reset();
+    else if (!simplifier)
+        simplifier.reset(new BoolExpSimplifier(constPolicy == ConstantPolicy::FREE,
+                                               useKconfigWhitelist));
+}
+
+void CNFBuilder::pushSimplifiedClause(BoolExp *e) {
+    // the simplified expression lives only as long as it is translated
+    static thread_local BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    BoolExp *simplified = simplifier->simplify(e);
+    if (simplifier->isContradiction()) {
+        // a free constant would make a contradiction satisfiable, a constant of e that
+        // is copied as it is gets its free variable from translate()
+        int v = this->cnf->newVar();
+        cnf->pushVar(v);
+        cnf->pushClause();
+        cnf->pushVar(-v);
+        cnf->pushClause();
+        return;
+    }
+    translate(simplified);
+}
+
 void CNFBuilder::pushClause(BoolExp *e) {
-    visited.clear();
+    if (simplifier)
+        pushSimplifiedClause(e);
+    else
+        translate(e);
+}
+
+void CNFBuilder::translate(BoolExp *e) {
+    clearVisited();
     BoolExpConst *constant = dynamic_cast<BoolExpConst*>(e);
 
     if (constant) {
@@ -59,8 +118,12 @@ void CNFBuilder::pushClause(BoolExp *e) {
         const std::string always_on("ALWAYS_ON");
         cnf->addMetaValue(always_on, variable->str());
     }
+    if (encoding == Encoding::POLARITY) {
+        pushPolarityClauses(e);
+        return;
+    }
     e->accept(this);
-    cnf->pushVar(e->CNFVar);
+    cnf->pushVar(toLiteral(result));
     cnf->pushClause();
 }
 
@@ -79,20 +142,46 @@ int CNFBuilder::addVar(std::string symname) {
     return cv;
 }
 
+int CNFBuilder::gateVar(Gate::Op op, int a, int b, bool &created) {
+    // A || B is !(!A && !B), and !A <-> B is !(A <-> B): gates that only
+    // differ in negations share a variable
+    bool negated = false;
+    if (op == Gate::OR) {
+        op = Gate::AND;
+        a = -a;
+        b = -b;
+        negated = true;
+    } else if (op == Gate::EQ) {
+        negated = (a < 0) != (b < 0);
+        a = std::abs(a);
+        b = std::abs(b);
+    }
+    // AND and EQ are commutative
+    if (a > b)
+        std::swap(a, b);
+    auto it = gates.emplace(Gate{op, a, b}, 0).first;
+    created = it->second == 0;
+    if (created)
+        it->second = this->cnf->newVar();
+    else
+        sharedGates++;
+    return negated ? -it->second : it->second;
+}
+
 void CNFBuilder::visit(BoolExp *) {
     throw "CNF ERROR";
 }
 
-void CNFBuilder::visit(BoolExpAnd *e) {
-    if (e->CNFVar)
+void CNFBuilder::visit(BoolExpAnd *) {
+    int a = toLiteral(left);
+    int b = toLiteral(right);
+    bool created;
+    int h = gateVar(Gate::AND, a, b, created);
+    result = toResult(h);
+    if (!created)
         return;
 
-    e->CNFVar = this->cnf->newVar();
-
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
     // H <-> (A && B)
     // (!H || A) && ( !H || B) && ( H || !A || !B)
     cnf->pushVar(-h);
@@ -109,16 +198,16 @@ void CNFBuilder::visit(BoolExpAnd *e) {
     cnf->pushClause();
 }
 
-void CNFBuilder::visit(BoolExpOr *e) {
-    if (e->CNFVar)
+void CNFBuilder::visit(BoolExpOr *) {
+    int a = toLiteral(left);
+    int b = toLiteral(right);
+    bool created;
+    int h = gateVar(Gate::OR, a, b, created);
+    result = toResult(h);
+    if (!created)
         return;
 
-    e->CNFVar = this->cnf->newVar();
-
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
 
     // H <-> (A || B)
     // (H || !A) && ( H || !B) && ( !H || A || B)
@@ -136,16 +225,17 @@ void CNFBuilder::visit(BoolExpOr *e) {
     cnf->pushClause();
 }
 
-void CNFBuilder::visit(BoolExpImpl *e) {
-    if (e->CNFVar)
+void CNFBuilder::visit(BoolExpImpl *) {
+    int a = toLiteral(left);
+    int b = toLiteral(right);
+    // A -> B == !A || B
+    bool created;
+    int h = gateVar(Gate::OR, -a, b, created);
+    result = toResult(h);
+    if (!created)
         return;
 
-    e->CNFVar = this->cnf->newVar();
-
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
     // H <-> (A -> B)
     // (H ||  A) && (H || !B ) && (!H || !A || B)
     cnf->pushVar(h);
@@ -162,16 +252,16 @@ void CNFBuilder::visit(BoolExpImpl *e) {
     cnf->pushClause();
 }
 
-void CNFBuilder::visit(BoolExpEq *e) {
-    if (e->CNFVar)
+void CNFBuilder::visit(BoolExpEq *) {
+    int a = toLiteral(left);
+    int b = toLiteral(right);
+    bool created;
+    int h = gateVar(Gate::EQ, a, b, created);
+    result = toResult(h);
+    if (!created)
         return;
 
-    e->CNFVar = this->cnf->newVar();
-
     // add clauses
-    int h = e->CNFVar;
-    int a = e->left->CNFVar;
-    int b = e->right->CNFVar;
     // H <-> (A <-> B)
     // (H || !A || !B) && (H || A || B) && (!H || A || !B) && (!H || !A || B)
     cnf->pushVar(h);
@@ -195,48 +285,244 @@ void CNFBuilder::visit(BoolExpEq *e) {
     cnf->pushClause();
 }
 
-void CNFBuilder::visit(BoolExpAny *e) {
+void CNFBuilder::visit(BoolExpAny *) {
     // add free variable for arith. Operators (ie, handle them later..)
-    e->CNFVar = this->cnf->newVar();
+    result = toResult(this->cnf->newVar());
 }
 
-void CNFBuilder::visit(BoolExpCall *e) {
+void CNFBuilder::visit(BoolExpCall *) {
     // add free variable for function calls (i.e., handle them later..)
-    e->CNFVar = this->cnf->newVar();
+    result = toResult(this->cnf->newVar());
 }
 
-void CNFBuilder::visit(BoolExpNot *e) {
-    if (e->CNFVar)
-        return;
-
-    e->CNFVar = -(e->right->CNFVar);
+void CNFBuilder::visit(BoolExpNot *) {
+    result = toResult(-toLiteral(right));
 }
 
 void CNFBuilder::visit(BoolExpConst *e) {
-    if (e->CNFVar)
-        return;
+    result = toResult(constLiteral(e));
+}
 
+void CNFBuilder::visit(BoolExpVar *e) {
+    result = toResult(varLiteral(e));
+}
+
+int CNFBuilder::constLiteral(BoolExpConst *e) {
     if (constPolicy == ConstantPolicy::FREE){
         //handle consts as free var
-        e->CNFVar = this->cnf->newVar();
-        return;
+        return this->cnf->newVar();
     }
     if (!this->boolvar) {
         this->boolvar = this->cnf->newVar();
         cnf->pushVar(boolvar);
         cnf->pushClause();
     }
-    e->CNFVar = e->value ? boolvar : -boolvar;
+    return e->value ? boolvar : -boolvar;
 }
 
-void CNFBuilder::visit(BoolExpVar *e) {
+int CNFBuilder::varLiteral(BoolExpVar *e) {
     std::string symname = e->str();
-    if (e->CNFVar)
-        return;
 
     if (useKconfigWhitelist && KconfigWhitelist::getIgnorelist().isWhitelisted(symname))
         // use free variables for symbols in wl
-        e->CNFVar = this->cnf->newVar();
-    else
-        e->CNFVar = this->addVar(symname);
+        return this->cnf->newVar();
+    return this->addVar(symname);
+}
+
+/* Plaisted-Greenbaum encoding: a positive occurrence of a subexpression
+   only needs 'H -> subexpression', a negative one only the converse. */
+
+void CNFBuilder::pushPolarityClauses(BoolExp *e) {
+    std::vector<std::pair<BoolExp *, bool>> conjuncts, disjuncts;
+    chainOperands(e, Gate::AND, conjuncts);
+    for (const auto &conjunct : conjuncts) {
+        BoolExpConst *constant = dynamic_cast<BoolExpConst*>(conjunct.first);
+        if (constant && constant->value)
+            continue;
+        // a disjunction is a clause of its own, its operands are encoded first
+        disjuncts.clear();
+        chainOperands(conjunct.first, Gate::OR, disjuncts);
+        std::vector<int> clause;
+        for (const auto &disjunct : disjuncts) {
+            if (disjunct.second)
+                clause.push_back(-encode(disjunct.first, NEGATIVE));
+            else
+                clause.push_back(encode(disjunct.first, POSITIVE));
+        }
+        for (int literal : clause)
+            cnf->pushVar(literal);
+        cnf->pushClause();
+    }
+}
+
+void CNFBuilder::chainOperands(BoolExp *e, Gate::Op op,
+                               std::vector<std::pair<BoolExp *, bool>> &operands) {
+    const int chain = ++chains;
+    // the second member tells if the operand is negated, as the premise of an implication
+    std::vector<std::pair<BoolExp *, bool>> pending{{e, false}};
+    while (!pending.empty()) {
+        BoolExp *node = pending.back().first;
+        const bool negated = pending.back().second;
+        pending.pop_back();
+
+        void *mark;
+        const bool known = lookup(node, mark);
+        // shared by two operands of this chain, AND and OR are idempotent, a negated
+        // occurrence is an operand of its own
+        if (!negated && known && markPolarities(mark) == 0 && markLiteral(mark) == chain)
+            continue;
+        // nodes that are encoded already are used as they are
+        const bool flatten = !negated && (node == e || !known || markPolarities(mark) == 0);
+        if (flatten && op == Gate::AND && dynamic_cast<BoolExpAnd*>(node)) {
+            pending.emplace_back(node->right, false);
+            pending.emplace_back(node->left, false);
+        } else if (flatten && op == Gate::OR && dynamic_cast<BoolExpOr*>(node)) {
+            pending.emplace_back(node->right, false);
+            pending.emplace_back(node->left, false);
+        } else if (flatten && op == Gate::OR && dynamic_cast<BoolExpImpl*>(node)) {
+            pending.emplace_back(node->right, false);
+            pending.emplace_back(node->left, true);
+        } else {
+            operands.emplace_back(node, negated);
+            continue;
+        }
+        markVisited(node, toMark(chain, 0));
+    }
+}
+
+int CNFBuilder::encode(BoolExp *e, int polarity) {
+    void *mark;
+    int literal = 0, done = 0;
+    if (lookup(e, mark) && markPolarities(mark) != 0) {
+        literal = markLiteral(mark);
+        done = markPolarities(mark);
+        if ((polarity & ~done) == 0)
+            return literal;
+    }
+    const int missing = polarity & ~done;
+
+    if (BoolExpNot *n = dynamic_cast<BoolExpNot*>(e)) {
+        literal = -encode(n->right, flip(missing));
+    } else if (dynamic_cast<BoolExpAnd*>(e) || dynamic_cast<BoolExpOr*>(e)
+               || dynamic_cast<BoolExpImpl*>(e)) {
+        const Gate::Op op = dynamic_cast<BoolExpAnd*>(e) ? Gate::AND : Gate::OR;
+        std::vector<std::pair<BoolExp *, bool>> chain;
+        chainOperands(e, op, chain);
+        std::vector<int> operands;
+        for (const auto &operand : chain) {
+            if (operand.second)
+                operands.push_back(-encode(operand.first, flip(missing)));
+            else
+                operands.push_back(encode(operand.first, missing));
+        }
+        // the chain may flatten to other operands than on the first visit, the clauses
+        // of the missing polarities are added to the literal the node has already
+        literal = define(op, std::move(operands), missing, literal);
+    } else if (dynamic_cast<BoolExpEq*>(e)) {
+        // both values of the operands matter for an equivalence
+        const int a = encode(e->left, BOTH);
+        const int b = encode(e->right, BOTH);
+        literal = define(Gate::EQ, {a, b}, missing, literal);
+    } else if (!literal) {
+        // symbols, constants, calls and comparisons are the same for both polarities
+        if (BoolExpVar *var = dynamic_cast<BoolExpVar*>(e))
+            literal = varLiteral(var);
+        else if (BoolExpConst *constant = dynamic_cast<BoolExpConst*>(e))
+            literal = constLiteral(constant);
+        else if (dynamic_cast<BoolExpCall*>(e) || dynamic_cast<BoolExpAny*>(e))
+            literal = this->cnf->newVar();
+        else
+            throw "CNF ERROR";
+        done = BOTH;
+    }
+    markVisited(e, toMark(literal, done | missing));
+    return literal;
+}
+
+int CNFBuilder::define(Gate::Op op, std::vector<int> operands, int polarity, int literal) {
+    std::sort(operands.begin(), operands.end());
+    if (op != Gate::EQ) {
+        operands.erase(std::unique(operands.begin(), operands.end()), operands.end());
+        if (operands.size() == 1 && !literal)
+            return operands.front();
+    }
+    int h = literal, missing = polarity;
+    if (!literal) {
+        auto it = naryGates.emplace(NaryGate{op, operands}, Definition{0, 0}).first;
+        Definition &definition = it->second;
+        if (definition.var == 0)
+            definition.var = this->cnf->newVar();
+        else
+            sharedGates++;
+        h = definition.var;
+        missing = polarity & ~definition.polarities;
+        definition.polarities |= polarity;
+    }
+    const std::vector<int> &ops = operands;
+
+    switch (op) {
+    case Gate::AND:
+        // H -> (A && B && ...): (!H || A) && (!H || B) && ...
+        if (missing & POSITIVE) {
+            for (int a : ops) {
+                cnf->pushVar(-h);
+                cnf->pushVar(a);
+                cnf->pushClause();
+            }
+        }
+        // (A && B && ...) -> H: (H || !A || !B || ...)
+        if (missing & NEGATIVE) {
+            cnf->pushVar(h);
+            for (int a : ops)
+                cnf->pushVar(-a);
+            cnf->pushClause();
+        }
+        break;
+    case Gate::OR:
+        // H -> (A || B || ...): (!H || A || B || ...)
+        if (missing & POSITIVE) {
+            cnf->pushVar(-h);
+            for (int a : ops)
+                cnf->pushVar(a);
+            cnf->pushClause();
+        }
+        // (A || B || ...) -> H: (H || !A) && (H || !B) && ...
+        if (missing & NEGATIVE) {
+            for (int a : ops) {
+                cnf->pushVar(h);
+                cnf->pushVar(-a);
+                cnf->pushClause();
+            }
+        }
+        break;
+    case Gate::EQ: {
+        const int a = ops[0], b = ops[1];
+        // H -> (A <-> B): (!H || !A || B) && (!H || A || !B)
+        if (missing & POSITIVE) {
+            cnf->pushVar(-h);
+            cnf->pushVar(-a);
+            cnf->pushVar(b);
+            cnf->pushClause();
+
+            cnf->pushVar(-h);
+            cnf->pushVar(a);
+            cnf->pushVar(-b);
+            cnf->pushClause();
+        }
+        // (A <-> B) -> H: (H || A || B) && (H || !A || !B)
+        if (missing & NEGATIVE) {
+            cnf->pushVar(h);
+            cnf->pushVar(a);
+            cnf->pushVar(b);
+            cnf->pushClause();
+
+            cnf->pushVar(h);
+            cnf->pushVar(-a);
+            cnf->pushVar(-b);
+            cnf->pushClause();
+        }
+        break;
+    }
+    }
+    return h;
 }
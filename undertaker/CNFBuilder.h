@@ -25,8 +25,13 @@
 
 #include "bool.h"
 #include "BoolVisitor.h"
+#include "BoolExpSimplifier.h"
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 
 namespace kconfig {
@@ -35,23 +40,112 @@ namespace kconfig {
     class CNFBuilder : public BoolVisitor {
     public:
         enum class ConstantPolicy {BOUND, FREE};
+        /** how subexpressions are translated into clauses **/
+        enum class Encoding {
+            /** Tseitin: each binary operator gets a variable that is
+                equivalent to its subexpression **/
+            TSEITIN,
+            /** Plaisted-Greenbaum: chains of the same operator get a
+                single variable, it only implies its subexpression (or is
+                implied by it) as far as the polarity of its occurrences
+                requires. Top-level conjuncts and disjunctions become
+                clauses of their own. The assignment of the symbols
+                still satisfies the expression, the one of the helper
+                variables may not. **/
+            POLARITY,
+        };
         PicosatCNF *cnf;
     private:
         int boolvar = 0;
         ConstantPolicy constPolicy;
         bool useKconfigWhitelist = false;
+        Encoding encoding;
+        std::unique_ptr<BoolExpSimplifier> simplifier;
+
+        /** an operator applied to the cnf literals of its operands.
+            Operands of commutative operators are sorted, an implication
+            is stored as the disjunction it is equivalent to. **/
+        struct Gate {
+            enum Op : int {AND, OR, EQ} op;
+            int a, b;
+
+            bool operator==(const Gate &other) const {
+                return op == other.op && a == other.a && b == other.b;
+            }
+        };
+        struct GateHash {
+            size_t operator()(const Gate &g) const {
+                return (size_t) g.op * 0x9e3779b97f4a7c15ULL
+                       ^ ((size_t) (unsigned) g.a << 32 | (unsigned) g.b);
+            }
+        };
+        /** the Tseitin variable of every gate built so far, structurally
+            identical subexpressions share it and its clauses **/
+        std::unordered_map<Gate, int, GateHash> gates;
+        int sharedGates = 0;
+
+        //! returns the literal of the gate, it is created if it doesn't exist yet
+        int gateVar(Gate::Op op, int a, int b, bool &created);
+
+        /* Encoding::POLARITY */
+        enum Polarity : int {POSITIVE = 1, NEGATIVE = 2, BOTH = 3};
+        /** an n-ary gate, its sorted operands are cnf literals **/
+        struct NaryGate {
+            Gate::Op op;
+            std::vector<int> operands;
+
+            bool operator==(const NaryGate &other) const {
+                return op == other.op && operands == other.operands;
+            }
+        };
+        struct NaryGateHash {
+            size_t operator()(const NaryGate &g) const {
+                size_t hash = (size_t) g.op * 0x9e3779b97f4a7c15ULL;
+                for (int operand : g.operands)
+                    hash = (hash ^ (unsigned) operand) * 0x100000001b3ULL;
+                return hash;
+            }
+        };
+        /** the variable of a gate and the polarities it has clauses for **/
+        struct Definition {
+            int var;
+            int polarities;
+        };
+        std::unordered_map<NaryGate, Definition, NaryGateHash> naryGates;
+        //! tells apart the nodes flattened by chainOperands() calls
+        int chains = 0;
+
+        //! the literal of e, its clauses cover the given polarities
+        int encode(BoolExp *e, int polarity);
+        //! the operands of the chain of AND (or OR and IMPL) nodes e is the head of
+        void chainOperands(BoolExp *e, Gate::Op op,
+                           std::vector<std::pair<BoolExp *, bool>> &operands);
+        /**
+         * \brief the variable of the n-ary gate with clauses for the given polarities
+         *
+         * With a literal, the clauses are added to it instead.
+         */
+        int define(Gate::Op op, std::vector<int> operands, int polarity, int literal = 0);
+        void pushPolarityClauses(BoolExp *e);
+        void pushSimplifiedClause(BoolExp *e);
+        //! the clauses of pushClause(), without simplification
+        void translate(BoolExp *e);
+
+        int varLiteral(BoolExpVar *e);
+        int constLiteral(BoolExpConst *e);
 
     public:
         CNFBuilder(PicosatCNF *cnf, std::string sat = "", bool useKconfigWhitelist=false,
-                ConstantPolicy constPolicy=ConstantPolicy::BOUND);
+                ConstantPolicy constPolicy=ConstantPolicy::BOUND,
+                Encoding encoding=Encoding::TSEITIN);
 
         //! Add clauses from the parsed boolean expression e
         /**
          * \param[in,out] e the parsed expression
          *
-         * Note that this triggers the traversal on the tree e,
-         * which (as every visitor), and therefrore potentially
-         * modifies the CNF variable assignment.
+         * The cnf literals of the nodes are kept by the builder, not
+         * in the nodes, so the same expression can be pushed to
+         * several cnfs.
          */
         void pushClause(BoolExp *e);
 
@@ -66,6 +160,20 @@ namespace kconfig {
          */
         int addVar(std::string s);
 
+        //! number of subexpressions that reused the variable of an identical one
+        int getSharedGates() const { return sharedGates; }
+
+        /**
+         * \brief simplify expressions before they are translated
+         *
+         * The simplifier treats constants and ignored symbols like the
+         * builder does. Symbols that the simplification drops don't get
+         * a variable.
+         */
+        void setSimplify(bool enable);
+        //! nullptr unless simplification is enabled
+        const BoolExpSimplifier *getSimplifier() const { return simplifier.get(); }
+
     protected:
         virtual void visit(BoolExp *e)      final override;
         virtual void visit(BoolExpAnd *e)   final override;
@@ -0,0 +1,553 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "CNFPreprocessor.h"
+#include "PicosatCNF.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace kconfig;
+
+
+CNFPreprocessor::CNFPreprocessor(PicosatCNF *cnf) : cnf(cnf), varcount(cnf->getVarCount()) {
+    const std::vector<int> &literals = cnf->getClauses();
+    stats.varsBefore = varcount;
+    stats.clausesBefore = cnf->getClauseCount();
+    stats.literalsBefore = literals.size() - stats.clausesBefore;
+
+    occs.resize(2 * (varcount + 1));
+    value.assign(varcount + 1, 0);
+    probeValue.assign(varcount + 1, 0);
+    mark.assign(2 * (varcount + 1), 0);
+    named.assign(varcount + 1, 0);
+    substitute.assign(varcount + 1, 0);
+    eliminated.assign(varcount + 1, 0);
+    cnf->forEachSymbol([this](StringRef, int var) {
+        if (abs(var) <= varcount)
+            named[abs(var)] = 1;
+    });
+
+    Clause clause;
+    for (int lit : literals) {
+        if (lit != 0) {
+            clause.push_back(lit);
+            continue;
+        }
+        addClause(clause);
+        clause.clear();
+    }
+}
+
+bool CNFPreprocessor::occurs(uint32_t c, int lit) const {
+    return !removed[c] && std::find(clauses[c].begin(), clauses[c].end(), lit) != clauses[c].end();
+}
+
+std::vector<uint32_t> CNFPreprocessor::clausesWith(int lit) const {
+    std::vector<uint32_t> result;
+    for (uint32_t c : occs[index(lit)])
+        if (occurs(c, lit))
+            result.push_back(c);
+    return result;
+}
+
+int CNFPreprocessor::representative(int lit) const {
+    while (substitute[abs(lit)] != 0)
+        lit = lit > 0 ? substitute[lit] : -substitute[-lit];
+    return lit;
+}
+
+void CNFPreprocessor::addClause(Clause clause) {
+    if (unsat)
+        return;
+    // drop false and duplicate literals, satisfied clauses and tautologies
+    std::sort(clause.begin(), clause.end(), [](int a, int b) {
+        return abs(a) < abs(b) || (abs(a) == abs(b) && a < b);
+    });
+    size_t length = 0;
+    for (size_t i = 0; i < clause.size(); i++) {
+        const int lit = clause[i];
+        if (valueOf(lit) > 0)
+            return;
+        if (valueOf(lit) < 0 || (length > 0 && clause[length - 1] == lit))
+            continue;
+        if (length > 0 && clause[length - 1] == -lit)
+            return;
+        clause[length++] = lit;
+    }
+    clause.resize(length);
+
+    if (clause.empty()) {
+        unsat = true;
+    } else if (clause.size() == 1) {
+        assign(clause[0]);
+    } else {
+        const uint32_t c = clauses.size();
+        for (int lit : clause)
+            occs[index(lit)].push_back(c);
+        clauses.push_back(std::move(clause));
+        removed.push_back(0);
+    }
+}
+
+void CNFPreprocessor::removeClause(uint32_t c) {
+    removed[c] = 1;
+    Clause().swap(clauses[c]);
+}
+
+void CNFPreprocessor::assign(int lit) {
+    value[abs(lit)] = lit > 0 ? 1 : -1;
+    trail.push_back(lit);
+}
+
+bool CNFPreprocessor::propagate() {
+    const size_t start = propagated;
+    while (!unsat && propagated < trail.size()) {
+        const int lit = trail[propagated++];
+        for (uint32_t c : clausesWith(lit))
+            removeClause(c);
+        for (uint32_t c : clausesWith(-lit)) {
+            Clause &clause = clauses[c];
+            clause.erase(std::remove(clause.begin(), clause.end(), -lit), clause.end());
+            if (clause.size() > 1)
+                continue;
+            // the remaining literal is unassigned, all others are gone already
+            const int unit = clause.empty() ? 0 : clause[0];
+            removeClause(c);
+            if (unit == 0 || valueOf(unit) < 0) {
+                unsat = true;
+                break;
+            }
+            if (valueOf(unit) == 0)
+                assign(unit);
+        }
+        occs[index(lit)].clear();
+        occs[index(-lit)].clear();
+    }
+    return propagated > start;
+}
+
+void CNFPreprocessor::rebuildOccurrences() {
+    for (std::vector<uint32_t> &occ : occs)
+        occ.clear();
+    // compact the clause list as well, most removed clauses are gone for good
+    size_t alive = 0;
+    for (size_t c = 0; c < clauses.size(); c++) {
+        if (removed[c])
+            continue;
+        if (alive != c)
+            clauses[alive] = std::move(clauses[c]);
+        removed[alive] = 0;
+        for (int lit : clauses[alive])
+            occs[index(lit)].push_back(alive);
+        alive++;
+    }
+    clauses.resize(alive);
+    removed.resize(alive);
+}
+
+bool CNFPreprocessor::substituteEquivalences() {
+    // binary implication graph over literal indices: (a || b) gives -a -> b and -b -> a
+    const size_t nodes = 2 * (varcount + 1);
+    std::vector<uint32_t> edgeStart(nodes + 1, 0), edges;
+    for (const Clause &clause : clauses) {
+        if (clause.size() != 2)
+            continue;
+        edgeStart[index(-clause[0]) + 1]++;
+        edgeStart[index(-clause[1]) + 1]++;
+    }
+    for (size_t n = 0; n < nodes; n++)
+        edgeStart[n + 1] += edgeStart[n];
+    edges.resize(edgeStart[nodes]);
+    std::vector<uint32_t> fill(edgeStart.begin(), edgeStart.end() - 1);
+    for (const Clause &clause : clauses) {
+        if (clause.size() != 2)
+            continue;
+        edges[fill[index(-clause[0])]++] = index(clause[1]);
+        edges[fill[index(-clause[1])]++] = index(clause[0]);
+    }
+    if (edges.empty())
+        return false;
+
+    // iterative tarjan, component[n] is the id of the scc of node n
+    const uint32_t none = UINT32_MAX;
+    std::vector<uint32_t> order(nodes, none), lowlink(nodes, 0), component(nodes, none);
+    std::vector<uint32_t> stack, callStack, edgePos(nodes, 0);
+    uint32_t counter = 0, components = 0;
+    for (uint32_t root = 2; root < nodes; root++) {
+        if (order[root] != none || edgeStart[root] == edgeStart[root + 1])
+            continue;
+        callStack.push_back(root);
+        while (!callStack.empty()) {
+            const uint32_t n = callStack.back();
+            if (order[n] == none) {
+                order[n] = lowlink[n] = counter++;
+                edgePos[n] = edgeStart[n];
+                stack.push_back(n);
+            }
+            if (edgePos[n] < edgeStart[n + 1]) {
+                const uint32_t next = edges[edgePos[n]++];
+                if (order[next] == none)
+                    callStack.push_back(next);
+                else if (component[next] == none)
+                    lowlink[n] = std::min(lowlink[n], order[next]);
+                continue;
+            }
+            callStack.pop_back();
+            if (!callStack.empty())
+                lowlink[callStack.back()] = std::min(lowlink[callStack.back()], lowlink[n]);
+            if (lowlink[n] == order[n]) {
+                uint32_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    component[member] = components;
+                } while (member != n);
+                components++;
+            }
+        }
+    }
+
+    // the representative of each component: named variables first, then the smallest one
+    auto literal = [](uint32_t n) { return (n & 1) ? -(int) (n / 2) : (int) (n / 2); };
+    auto better = [this](int a, int b) {
+        if (named[abs(a)] != named[abs(b)])
+            return named[abs(a)] > named[abs(b)];
+        return abs(a) < abs(b);
+    };
+    std::vector<int> best(components, 0);
+    for (uint32_t n = 2; n < nodes; n++) {
+        if (component[n] == none)
+            continue;
+        int &b = best[component[n]];
+        if (b == 0 || better(literal(n), b))
+            b = literal(n);
+    }
+
+    std::vector<int> replaced;
+    for (int v = 1; v <= varcount; v++) {
+        const uint32_t comp = component[index(v)];
+        if (comp == none || value[v] != 0)
+            continue;
+        if (comp == component[index(-v)]) {
+            unsat = true;
+            return true;
+        }
+        if (abs(best[comp]) == v)
+            continue;
+        substitute[v] = best[comp];
+        replaced.push_back(v);
+        stats.equivalences++;
+    }
+
+    for (int v : replaced) {
+        for (int lit : {v, -v}) {
+            for (uint32_t c : clausesWith(lit)) {
+                Clause clause = clauses[c];
+                for (int &other : clause)
+                    other = representative(other);
+                removeClause(c);
+                addClause(std::move(clause));
+            }
+            occs[index(lit)].clear();
+        }
+    }
+    propagate();
+    return !replaced.empty();
+}
+
+bool CNFPreprocessor::subsume() {
+    const int before = stats.subsumed + stats.strengthened;
+    for (uint32_t c = 0; c < clauses.size() && !unsat; c++) {
+        if (removed[c])
+            continue;
+        // candidates have to contain the literal of c with the fewest occurrences
+        int pivot = clauses[c][0];
+        size_t fewest = SIZE_MAX;
+        for (int lit : clauses[c]) {
+            const size_t count = occs[index(lit)].size() + occs[index(-lit)].size();
+            if (count < fewest) {
+                pivot = lit;
+                fewest = count;
+            }
+        }
+        for (int lit : clauses[c])
+            mark[index(lit)] = 1;
+
+        for (int lit : {pivot, -pivot}) {
+            for (uint32_t d : clausesWith(lit)) {
+                if (d == c || clauses[d].size() < clauses[c].size())
+                    continue;
+                size_t same = 0, flipped = 0;
+                int flippedLit = 0;
+                for (int other : clauses[d]) {
+                    if (mark[index(other)]) {
+                        same++;
+                    } else if (mark[index(-other)]) {
+                        flipped++;
+                        flippedLit = other;
+                    }
+                }
+                if (same == clauses[c].size()) {
+                    removeClause(d);
+                    stats.subsumed++;
+                } else if (flipped == 1 && same + 1 == clauses[c].size()) {
+                    // self-subsuming resolution: flippedLit can be dropped from d
+                    Clause &clause = clauses[d];
+                    clause.erase(std::find(clause.begin(), clause.end(), flippedLit));
+                    stats.strengthened++;
+                    if (clause.size() == 1) {
+                        const int unit = clause[0];
+                        removeClause(d);
+                        if (valueOf(unit) < 0)
+                            unsat = true;
+                        else if (valueOf(unit) == 0)
+                            assign(unit);
+                    }
+                }
+            }
+        }
+        for (int lit : clauses[c])
+            mark[index(lit)] = 0;
+    }
+    propagate();
+    return stats.subsumed + stats.strengthened > before;
+}
+
+bool CNFPreprocessor::probeLiteral(int lit, std::vector<int> &implied, size_t &budget) {
+    auto current = [this](int l) {
+        const int v = valueOf(l);
+        return v != 0 ? v : (l > 0 ? probeValue[l] : -probeValue[-l]);
+    };
+    bool conflict = false;
+    implied.clear();
+    implied.push_back(lit);
+    probeValue[abs(lit)] = lit > 0 ? 1 : -1;
+    for (size_t next = 0; next < implied.size() && !conflict; next++) {
+        const int falsified = -implied[next];
+        for (uint32_t c : occs[index(falsified)]) {
+            if (budget > 0)
+                budget--;
+            if (!occurs(c, falsified))
+                continue;
+            int unassigned = 0, count = 0;
+            bool satisfied = false;
+            for (int other : clauses[c]) {
+                const int v = current(other);
+                if (v > 0) {
+                    satisfied = true;
+                    break;
+                }
+                if (v == 0) {
+                    unassigned = other;
+                    count++;
+                }
+            }
+            if (satisfied || count > 1)
+                continue;
+            if (count == 0) {
+                conflict = true;
+                break;
+            }
+            probeValue[abs(unassigned)] = unassigned > 0 ? 1 : -1;
+            implied.push_back(unassigned);
+        }
+    }
+    for (int l : implied)
+        probeValue[abs(l)] = 0;
+    return !conflict;
+}
+
+bool CNFPreprocessor::probe(size_t &budget) {
+    const size_t before = trail.size();
+    std::vector<int> positive, negative;
+    for (int v = 1; v <= varcount && budget > 0 && !unsat; v++) {
+        if (value[v] != 0 || substitute[v] != 0 || eliminated[v])
+            continue;
+        // only variables of binary clauses imply anything on their own
+        bool binary = false;
+        for (int lit : {v, -v})
+            for (uint32_t c : occs[index(lit)])
+                binary |= !removed[c] && clauses[c].size() == 2;
+        if (!binary)
+            continue;
+
+        if (!probeLiteral(v, positive, budget)) {
+            stats.failedLiterals++;
+            assign(-v);
+            propagate();
+            continue;
+        }
+        if (!probeLiteral(-v, negative, budget)) {
+            stats.failedLiterals++;
+            assign(v);
+            propagate();
+            continue;
+        }
+        // literals implied by both phases hold in every solution
+        for (size_t i = 1; i < positive.size(); i++)
+            mark[index(positive[i])] = 1;
+        std::vector<int> common;
+        for (size_t i = 1; i < negative.size(); i++)
+            if (mark[index(negative[i])])
+                common.push_back(negative[i]);
+        for (size_t i = 1; i < positive.size(); i++)
+            mark[index(positive[i])] = 0;
+        for (int lit : common)
+            if (valueOf(lit) == 0)
+                assign(lit);
+        propagate();
+    }
+    return trail.size() > before;
+}
+
+bool CNFPreprocessor::eliminate() {
+    const int before = stats.eliminated;
+    for (int v = 1; v <= varcount && !unsat; v++) {
+        if (named[v] || value[v] != 0 || substitute[v] != 0 || eliminated[v])
+            continue;
+        const std::vector<uint32_t> pos = clausesWith(v), neg = clausesWith(-v);
+        if ((pos.empty() && neg.empty())
+            || pos.size() + neg.size() > maxEliminationOccurrences)
+            continue;
+
+        // all non-tautological resolvents, there may be no more of them than clauses
+        std::vector<Clause> resolvents;
+        bool bounded = true;
+        for (uint32_t p : pos) {
+            for (uint32_t n : neg) {
+                Clause resolvent;
+                bool tautology = false;
+                for (int lit : clauses[p])
+                    if (lit != v) {
+                        resolvent.push_back(lit);
+                        mark[index(lit)] = 1;
+                    }
+                for (int lit : clauses[n]) {
+                    if (lit == -v || mark[index(lit)])
+                        continue;
+                    if (mark[index(-lit)])
+                        tautology = true;
+                    resolvent.push_back(lit);
+                }
+                for (int lit : clauses[p])
+                    mark[index(lit)] = 0;
+                if (tautology)
+                    continue;
+                if (resolvent.size() > maxResolventLength
+                    || resolvents.size() == pos.size() + neg.size()) {
+                    bounded = false;
+                    break;
+                }
+                resolvents.push_back(std::move(resolvent));
+            }
+            if (!bounded)
+                break;
+        }
+        if (!bounded)
+            continue;
+
+        for (uint32_t c : pos)
+            removeClause(c);
+        for (uint32_t c : neg)
+            removeClause(c);
+        occs[index(v)].clear();
+        occs[index(-v)].clear();
+        eliminated[v] = 1;
+        stats.eliminated++;
+        for (Clause &resolvent : resolvents)
+            addClause(std::move(resolvent));
+        propagate();
+    }
+    return stats.eliminated > before;
+}
+
+bool CNFPreprocessor::run() {
+    propagate();
+    size_t budget = probingBudget;
+    while (!unsat && stats.rounds < maxRounds) {
+        stats.rounds++;
+        rebuildOccurrences();
+        bool changed = substituteEquivalences();
+        changed |= !unsat && subsume();
+        changed |= !unsat && probe(budget);
+        changed |= !unsat && eliminate();
+        if (!changed)
+            break;
+    }
+    if (unsat)
+        return false;
+    stats.units = trail.size();
+    write();
+    return true;
+}
+
+void CNFPreprocessor::write() {
+    std::vector<Clause> result;
+    for (size_t c = 0; c < clauses.size(); c++)
+        if (!removed[c])
+            result.push_back(clauses[c]);
+    // named variables keep their meaning, even if they vanished from all clauses
+    for (int v = 1; v <= varcount; v++) {
+        if (!named[v])
+            continue;
+        if (value[v] != 0) {
+            result.push_back({value[v] > 0 ? v : -v});
+        } else if (substitute[v] != 0) {
+            const int r = representative(v);
+            if (valueOf(r) != 0)
+                result.push_back({valueOf(r) > 0 ? v : -v});
+            else {
+                result.push_back({-v, r});
+                result.push_back({v, -r});
+            }
+        }
+    }
+
+    std::vector<char> used(varcount + 1, 0);
+    for (const Clause &clause : result)
+        for (int lit : clause)
+            used[abs(lit)] = 1;
+    std::vector<int> mapping(varcount + 1, 0);
+    int vars = 0;
+    for (int v = 1; v <= varcount; v++)
+        if (used[v] || named[v])
+            mapping[v] = ++vars;
+
+    std::vector<int> literals;
+    for (const Clause &clause : result) {
+        for (int lit : clause)
+            literals.push_back(lit > 0 ? mapping[lit] : -mapping[-lit]);
+        literals.push_back(0);
+    }
+    stats.varsAfter = vars;
+    stats.clausesAfter = result.size();
+    stats.literalsAfter = literals.size() - result.size();
+    cnf->replaceClauses(literals, mapping, vars);
+}
+
+std::ostream &kconfig::operator<<(std::ostream &out, const CNFPreprocessor::Stats &stats) {
+    out << "variables: " << stats.varsBefore << " -> " << stats.varsAfter << std::endl;
+    out << "clauses: " << stats.clausesBefore << " -> " << stats.clausesAfter << std::endl;
+    out << "literals: " << stats.literalsBefore << " -> " << stats.literalsAfter << std::endl;
+    out << "units: " << stats.units << ", failed literals: " << stats.failedLiterals
+        << ", equivalences: " << stats.equivalences << std::endl;
+    out << "subsumed: " << stats.subsumed << ", strengthened: " << stats.strengthened
+        << ", eliminated: " << stats.eliminated << ", rounds: " << stats.rounds << std::endl;
+    return out;
+}
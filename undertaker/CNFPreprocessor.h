@@ -0,0 +1,134 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_CNFPREPROCESSOR_H
+#define KCONFIG_CNFPREPROCESSOR_H
+
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace kconfig {
+    class PicosatCNF;
+
+    /**
+     * \brief simplifies the clauses of a model before it is stored
+     *
+     * The following techniques are applied until nothing changes:
+     *   - unit propagation
+     *   - failed literal probing, including literals implied by both
+     *     phases of a variable
+     *   - substitution of equivalent literals, found as strongly
+     *     connected components of the binary implication graph
+     *   - subsumption and self-subsuming resolution
+     *   - bounded variable elimination
+     *
+     * Named variables (c var) are never eliminated or substituted away:
+     * they keep their meaning, i.e. an assignment of the named variables
+     * can be extended to a solution of the simplified model iff it can
+     * be extended to a solution of the original one. Only unnamed
+     * variables, e.g. the helpers of the Tseitin transformation, vanish.
+     * The remaining variables are numbered densely afterwards.
+     */
+    class CNFPreprocessor {
+    public:
+        struct Stats {
+            int varsBefore = 0, varsAfter = 0;
+            int clausesBefore = 0, clausesAfter = 0;
+            size_t literalsBefore = 0, literalsAfter = 0;
+            int units = 0;          //!< variables fixed by propagation or probing
+            int failedLiterals = 0; //!< literals whose assumption leads to a conflict
+            int equivalences = 0;   //!< variables replaced by an equivalent literal
+            int subsumed = 0;       //!< clauses removed as they contain another one
+            int strengthened = 0;   //!< literals removed by self-subsuming resolution
+            int eliminated = 0;     //!< unnamed variables removed by resolution
+            int rounds = 0;
+        };
+
+        explicit CNFPreprocessor(PicosatCNF *cnf);
+
+        /**
+         * \brief simplifies the clauses of the cnf in place
+         *
+         * \return false if the model is unsatisfiable, the cnf isn't
+         *     changed then
+         */
+        bool run();
+
+        const Stats &getStats() const { return stats; }
+
+        //! limit on the number of clauses a variable occurs in to be eliminated
+        static const size_t maxEliminationOccurrences = 16;
+        //! resolvents longer than this prevent an elimination
+        static const size_t maxResolventLength = 24;
+        //! number of clause visits all probes together may spend
+        static const size_t probingBudget = 10000000;
+        //! upper bound for the number of times all techniques are applied
+        static const int maxRounds = 8;
+
+    private:
+        typedef std::vector<int> Clause;
+
+        PicosatCNF *cnf;
+        Stats stats;
+        int varcount;
+        std::vector<Clause> clauses;
+        std::vector<char> removed;
+        //! clauses per literal, may contain stale entries, see occurs()
+        std::vector<std::vector<uint32_t>> occs;
+        //! per variable: 1 true, -1 false, 0 unassigned
+        std::vector<signed char> value;
+        std::vector<char> named;
+        //! per variable: the literal it has been substituted by, 0 if none
+        std::vector<int> substitute;
+        std::vector<char> eliminated;
+        std::vector<int> trail;
+        //! temporary assignments of the current probe
+        std::vector<signed char> probeValue;
+        //! per literal, scratch space of subsume() and probe()
+        std::vector<char> mark;
+        size_t propagated = 0;
+        bool unsat = false;
+
+        static size_t index(int lit) { return lit > 0 ? 2 * lit : -2 * lit + 1; }
+        int valueOf(int lit) const { return lit > 0 ? value[lit] : -value[-lit]; }
+        bool occurs(uint32_t c, int lit) const;
+        std::vector<uint32_t> clausesWith(int lit) const;
+
+        void addClause(Clause clause);
+        void removeClause(uint32_t c);
+        void assign(int lit);
+        bool propagate();
+        void rebuildOccurrences();
+        bool substituteEquivalences();
+        bool subsume();
+        bool probe(size_t &budget);
+        //! false if assuming lit leads to a conflict, implied receives all implied literals
+        bool probeLiteral(int lit, std::vector<int> &implied, size_t &budget);
+        //! follows the chain of substitutions of the variable of lit
+        int representative(int lit) const;
+        bool eliminate();
+        void write();
+    };
+
+    std::ostream &operator<<(std::ostream &out, const CNFPreprocessor::Stats &stats);
+}
+#endif
@@ -0,0 +1,159 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "CNFSlicer.h"
+#include "PicosatCNF.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+
+using namespace kconfig;
+
+
+CNFSlicer::CNFSlicer(const PicosatCNF &model) : model(model), varcount(model.getVarCount()) {
+    const std::vector<int> &literals = model.getClauses();
+
+    clauseStart.push_back(0);
+    for (size_t i = 0; i < literals.size(); i++)
+        if (literals[i] == 0)
+            clauseStart.push_back(i + 1);
+    const size_t clauses = clauseStart.size() - 1;
+
+    // union-find over the variables of each clause
+    std::vector<uint32_t> parent(varcount + 1);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](uint32_t v) {
+        while (parent[v] != v)
+            v = parent[v] = parent[parent[v]];
+        return v;
+    };
+    for (size_t c = 0; c < clauses; c++) {
+        if (literals[clauseStart[c]] == 0)
+            continue;
+        const uint32_t first = find(abs(literals[clauseStart[c]]));
+        for (uint32_t i = clauseStart[c] + 1; literals[i] != 0; i++)
+            parent[find(abs(literals[i]))] = first;
+    }
+
+    // number the components densely, variable 0 gets one of its own
+    std::vector<uint32_t> id(varcount + 1, UINT32_MAX);
+    uint32_t components = 0;
+    component.resize(varcount + 1);
+    for (int v = 0; v <= varcount; v++) {
+        uint32_t root = find(v);
+        if (id[root] == UINT32_MAX)
+            id[root] = components++;
+        component[v] = id[root];
+    }
+
+    // the empty clause belongs to component 0, which is never part of a slice
+    compStart.assign(components + 1, 0);
+    for (size_t c = 0; c < clauses; c++)
+        compStart[component[abs(literals[clauseStart[c]])] + 1]++;
+    std::partial_sum(compStart.begin(), compStart.end(), compStart.begin());
+    compClauses.resize(clauses);
+    std::vector<uint32_t> fill(compStart.begin(), compStart.end() - 1);
+    for (size_t c = 0; c < clauses; c++)
+        compClauses[fill[component[abs(literals[clauseStart[c]])]]++] = c;
+
+    occStart.assign(2 * (varcount + 1) + 1, 0);
+    for (int lit : literals)
+        if (lit != 0)
+            occStart[literalIndex(lit) + 1]++;
+    std::partial_sum(occStart.begin(), occStart.end(), occStart.begin());
+    occClauses.resize(occStart.back());
+    fill.assign(occStart.begin(), occStart.end() - 1);
+    for (size_t c = 0; c < clauses; c++)
+        for (uint32_t i = clauseStart[c]; literals[i] != 0; i++)
+            occClauses[fill[literalIndex(literals[i])]++] = c;
+
+    // dropping whole components is only sound if each one is satisfiable
+    PicosatCNF copy(model);
+    usable = copy.checkSatisfiable();
+}
+
+CNFSlicer::Stats CNFSlicer::slice(PicosatCNF *query) const {
+    const std::vector<int> &literals = model.getClauses();
+    Stats stats;
+    stats.clauses = clauseStart.size() - 1;
+
+    // model variables mentioned by the query must keep all their clauses
+    std::vector<char> frozen(varcount + 1, 0);
+    std::vector<char> touched(compStart.size() - 1, 0);
+    std::vector<uint32_t> components;
+    for (int lit : query->getClauses()) {
+        const int v = abs(lit);
+        if (v == 0 || v > varcount || frozen[v])
+            continue;
+        frozen[v] = 1;
+        if (!touched[component[v]]) {
+            touched[component[v]] = 1;
+            components.push_back(component[v]);
+        }
+    }
+
+    std::vector<char> alive(stats.clauses, 0);
+    std::vector<uint32_t> count(2 * (varcount + 1), 0);
+    std::vector<uint32_t> candidates;
+    for (uint32_t comp : components) {
+        for (uint32_t n = compStart[comp]; n < compStart[comp + 1]; n++) {
+            const uint32_t c = compClauses[n];
+            alive[c] = 1;
+            candidates.push_back(c);
+            for (uint32_t i = clauseStart[c]; literals[i] != 0; i++)
+                count[literalIndex(literals[i])]++;
+        }
+    }
+    stats.candidates = candidates.size();
+
+    // pure literal elimination, restricted to variables the query doesn't mention
+    std::vector<int> pure;
+    for (uint32_t c : candidates)
+        for (uint32_t i = clauseStart[c]; literals[i] != 0; i++)
+            if (!frozen[abs(literals[i])] && count[literalIndex(-literals[i])] == 0)
+                pure.push_back(literals[i]);
+    while (!pure.empty()) {
+        const int lit = pure.back();
+        pure.pop_back();
+        const size_t l = literalIndex(lit);
+        for (uint32_t n = occStart[l]; n < occStart[l + 1]; n++) {
+            const uint32_t c = occClauses[n];
+            if (!alive[c])
+                continue;
+            alive[c] = 0;
+            for (uint32_t i = clauseStart[c]; literals[i] != 0; i++) {
+                const int other = literals[i];
+                if (--count[literalIndex(other)] == 0 && !frozen[abs(other)]
+                    && count[literalIndex(-other)] > 0)
+                    pure.push_back(-other);
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    for (uint32_t c : candidates) {
+        if (!alive[c])
+            continue;
+        for (uint32_t i = clauseStart[c]; literals[i] != 0; i++)
+            query->pushVar(literals[i]);
+        query->pushClause();
+        stats.kept++;
+    }
+    return stats;
+}
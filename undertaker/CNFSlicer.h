@@ -0,0 +1,85 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_CNFSLICER_H
+#define KCONFIG_CNFSLICER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace kconfig {
+    class PicosatCNF;
+
+    /**
+     * \brief extracts the part of a model that a query depends on
+     *
+     * The clauses of a satisfiable model fall into connected components
+     * of clauses that share variables. A query can only be influenced by
+     * the components its variables belong to, all others are satisfiable
+     * on their own. Within these components, a literal of a variable the
+     * query doesn't mention, whose complement occurs in no remaining
+     * clause, can always be set to true; all clauses containing it are
+     * dropped until no such literal is left. Both steps preserve the
+     * satisfiability of query && model.
+     *
+     * The assignment of a sliced check is only a solution for the slice,
+     * not for the whole model.
+     */
+    class CNFSlicer {
+    public:
+        struct Stats {
+            size_t clauses = 0;      //!< clauses of the model
+            size_t candidates = 0;   //!< clauses in the components of the query
+            size_t kept = 0;         //!< clauses that were added to the query
+        };
+
+        //! builds the dependency graph of the model, which has to outlive the slicer
+        explicit CNFSlicer(const PicosatCNF &model);
+
+        //! false if the model itself is unsatisfiable, it can't be sliced then
+        bool isUsable() const { return usable; }
+
+        /**
+         * \brief adds the clauses of the model that the query depends on
+         *
+         * \param query a cnf with the symbols of the model (see
+         *     PicosatCNF::copySymbols()), which must contain the clauses
+         *     of the query only
+         */
+        Stats slice(PicosatCNF *query) const;
+
+    private:
+        const PicosatCNF &model;
+        bool usable;
+        int varcount;
+        //! clause -> index of its first literal within the model clauses
+        std::vector<uint32_t> clauseStart;
+        //! variable -> connected component
+        std::vector<uint32_t> component;
+        //! the clauses of each component, compClauses[compStart[c]..compStart[c+1])
+        std::vector<uint32_t> compStart, compClauses;
+        //! the clauses each literal occurs in, indexed by literalIndex()
+        std::vector<uint32_t> occStart, occClauses;
+
+        size_t literalIndex(int lit) const { return lit > 0 ? 2 * lit : -2 * lit + 1; }
+    };
+}
+#endif
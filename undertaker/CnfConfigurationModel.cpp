@@ -24,9 +24,12 @@
 
 #include "CnfConfigurationModel.h"
 #include "Tools.h"
-#include "StringJoiner.h"
 #include "Logging.h"
 #include "PicosatCNF.h"
+#include "CNFSlicer.h"
+#include "CNFBackbone.h"
+#include "SatCache.h"
+#include "exceptions/IOException.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
@@ -39,7 +42,23 @@ CnfConfigurationModel::CnfConfigurationModel(const std::string &filename) {
     _name = filepath.stem().string();
 
     _cnf = new kconfig::PicosatCNF();
-    _cnf->readFromFile(filename);
+
+    // prefer a binary version written from this model, it is mapped instead of parsed
+    const std::string binary = kconfig::PicosatCNF::binaryFileName(filename);
+    boost::system::error_code ec;
+    bool loaded = false;
+    if (boost::filesystem::exists(binary, ec)) {
+        try {
+            _cnf->readFromBinaryFile(binary, filename);
+            loaded = true;
+        } catch (kconfig::IOException &e) {
+            Logging::warn("Ignoring binary model ", binary, ": ", e.what());
+            delete _cnf;
+            _cnf = new kconfig::PicosatCNF();
+        }
+    }
+    if (!loaded)
+        _cnf->readFromFile(filename);
     configuration_space_regex = _cnf->getMetaValue("CONFIGURATION_SPACE_REGEX");
 
     if (configuration_space_regex != nullptr && configuration_space_regex->size() > 0) {
@@ -49,6 +68,9 @@ CnfConfigurationModel::CnfConfigurationModel(const std::string &filename) {
     } else {
         _inConfigurationSpace_regexp = boost::regex("^CONFIG_[^ ]+$");
     }
+    _hasBackbone = kconfig::CNFBackbone::load(*_cnf, _backbone);
+    if (_hasBackbone)
+        Logging::info("Model ", _name, " forces ", _backbone.size(), " variables");
     if (_cnf->getVarCount() == 0) {
         // if the model is empty (e.g., if /dev/null was loaded), it cannot possibly be complete
         _cnf->addMetaValue("CONFIGURATION_SPACE_INCOMPLETE", "1");
@@ -56,9 +78,33 @@ CnfConfigurationModel::CnfConfigurationModel(const std::string &filename) {
 }
 
 CnfConfigurationModel::~CnfConfigurationModel() {
+    delete _slicer;
+    delete _queryCnf;
     delete _cnf;
 }
 
+kconfig::PicosatCNF *CnfConfigurationModel::getQueryCNF(void) {
+    if (!_queryCnf)
+        _queryCnf = new kconfig::PicosatCNF(*_cnf);
+    return _queryCnf;
+}
+
+const kconfig::CNFSlicer *CnfConfigurationModel::getSlicer(void) {
+    if (!_slicer) {
+        _slicer = new kconfig::CNFSlicer(*_cnf);
+        if (!_slicer->isUsable())
+            Logging::warn("Model ", _name, " is unsatisfiable, queries on it can't be sliced");
+    }
+    return _slicer;
+}
+
+uint64_t CnfConfigurationModel::getIdentity(void) {
+    // white- and blacklists only end up in the formulas, not in the clauses
+    if (_identity == 0)
+        _identity = SatCache::identity(*_cnf);
+    return _identity;
+}
+
 void CnfConfigurationModel::addFeatureToWhitelist(const std::string feature) {
     const std::string magic("ALWAYS_ON");
     _cnf->addMetaValue(magic, feature);
@@ -93,16 +139,19 @@ int CnfConfigurationModel::doIntersect(const std::string exp,
                                     std::set<std::string> &missing,
                                     std::string &intersected) const {
     const std::set<std::string> start_items = undertaker::itemsOfString(exp);
-    return doIntersect(start_items, c, missing, intersected);
+    Formula formula;
+    int valid_items = doIntersect(start_items, c, missing, formula);
+    intersected = formula.str();
+    return valid_items;
 }
 
 
 int CnfConfigurationModel::doIntersect(const std::set<std::string> start_items,
                                     const ConfigurationModel::Checker *c,
                                     std::set<std::string> &missing,
-                                    std::string &intersected) const {
-    StringJoiner sj;
+                                    Formula &intersected) const {
     int valid_items = 0;
+    intersected.clear();
 
 
     const std::string magic_on("ALWAYS_ON");
@@ -116,12 +165,12 @@ int CnfConfigurationModel::doIntersect(const std::set<std::string> start_items,
             if (always_on) {
                 const auto &cit = std::find(always_on->begin(), always_on->end(), str);
                 if (cit != always_on->end()) // str is found
-                    sj.push_back(str);
+                    intersected.push_back(str);
             }
             if (always_off) {
                 const auto &cit = std::find(always_off->begin(), always_off->end(), str);
                 if (cit != always_off->end()) // str is found
-                    sj.push_back("!" + str);
+                    intersected.push_back("!" + str);
             }
         } else {
             // check if the symbol might be in the model space.
@@ -138,8 +187,7 @@ int CnfConfigurationModel::doIntersect(const std::set<std::string> start_items,
                 missing.insert(str);
         }
     }
-    sj.push_back("._." + _name + "._.");
-    intersected = sj.join("\n&& ");
+    intersected.push_back("._." + _name + "._.");
     Logging::debug("Out of ", start_items.size(), " items ", missing.size(),
                    " have been put in the MissingSet using ", _name);
     return valid_items;
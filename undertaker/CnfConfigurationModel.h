@@ -27,11 +27,14 @@
 
 #include <string>
 #include <set>
+#include <map>
 #include <list>
+#include <cstdint>
 #include <boost/regex.hpp>
 
 namespace kconfig {
     class PicosatCNF;
+    class CNFSlicer;
 }
 
 
@@ -73,7 +76,9 @@ public:
     virtual int doIntersect(const std::set<std::string> exp,
                     const ConfigurationModel::Checker *c,
                     std::set<std::string> &missing,
-                    std::string &intersected)                      const final override;
+                    Formula &intersected)                          const final override;
+
+    using ConfigurationModel::doIntersect;
 
     virtual std::set<std::string> findSetOfInterestingItems(const std::set<std::string> &)
                                                                    const final override;
@@ -109,9 +114,35 @@ public:
 
     const kconfig::PicosatCNF *getCNF(void) { return _cnf; }
 
+    //! returns a long living copy of the model that queries can be layered upon
+    /*!
+     * The model clauses are handed to the solver only once, queries have
+     * to be wrapped into PicosatCNF::pushLayer() and PicosatCNF::popLayer().
+     */
+    kconfig::PicosatCNF *getQueryCNF(void);
+
+    //! returns a hash of the model clauses and variables, see SatCache::identity()
+    uint64_t getIdentity(void);
+
+    //! returns the slicer for queries on this model, it is built on the first call
+    const kconfig::CNFSlicer *getSlicer(void);
+
+    //! returns the variables the model forces to a fixed value, nullptr if the model file has none
+    /*!
+     * The backbone is stored in the model file, see kconfig::CNFBackbone.
+     */
+    const std::map<std::string, bool> *getBackbone(void) const {
+        return _hasBackbone ? &_backbone : nullptr;
+    }
+
 private:
     std::string _name;
     boost::regex _inConfigurationSpace_regexp;
     kconfig::PicosatCNF *_cnf;
+    kconfig::PicosatCNF *_queryCnf = nullptr;
+    kconfig::CNFSlicer *_slicer = nullptr;
+    uint64_t _identity = 0;
+    std::map<std::string, bool> _backbone;
+    bool _hasBackbone = false;
 };
 #endif
@@ -28,11 +28,13 @@
 #include "ModelContainer.h"
 #include "Logging.h"
 #include "PumaConditionalBlock.h"
-typedef PumaConditionalBlock ConditionalBlockImpl;
+#include "CppFileCache.h"
+#include "DirectiveScanner.h"
 #include "cpp14.h"
 
 #include <boost/regex.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
 #include <set>
 
 
@@ -40,42 +42,33 @@ typedef PumaConditionalBlock ConditionalBlockImpl;
 /* static functions                                                     */
 /************************************************************************/
 
-static int lineFromPosition(std::string line) {
+static unsigned int lineFromPosition(const std::string &position) {
     // INPUT: foo:121:2
     // OUTPUT: 121
-    size_t start = line.find_first_of(':');
-    assert (start != line.npos);
-    size_t stop = line.find_first_of(':', start);
-    assert (stop != line.npos);
+    size_t start = position.find_first_of(':');
+    assert (start != position.npos);
     try {
-        return std::stoi(line.substr(start+1, stop));
-    } catch (std::invalid_argument &) {
+        int line = std::stoi(position.substr(start + 1));
+        return line > 0 ? line : 0;
+    } catch (std::logic_error &) {  // invalid_argument, out_of_range
         return 0;
     }
 }
 
-static ConditionalBlockImpl *createDummyElseBlock(ConditionalBlock *i, ConditionalBlock *parent,
-                                                  ConditionalBlock *prev) {
-    ConditionalBlockImpl *superblock = dynamic_cast<ConditionalBlockImpl *>(i);
-    if (!superblock) {
-        Logging::error("failed to access the super-class of Conditionalblock");
-        exit(1);
+/* calls f(begin, end) for each word of exp, the defined symbols are
+   looked up by them. Words are separated by the characters the define
+   rewriting always took as boundaries of a symbol. */
+template <typename F>
+static void forEachWord(const std::string &exp, F f) {
+    static const char *const symbolSpace = "() ><&|!-";
+    size_t begin = exp.find_first_not_of(symbolSpace);
+    while (begin != exp.npos) {
+        size_t end = exp.find_first_of(symbolSpace, begin);
+        if (end == exp.npos)
+            end = exp.size();
+        f(begin, end);
+        begin = exp.find_first_not_of(symbolSpace, end);
     }
-    PumaConditionalBlockBuilder &builder = superblock->getBuilder();
-
-    auto tok = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "#else");
-    auto ptok = new Puma::PreTreeToken(tok);
-
-    auto tok2 = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "");
-    auto ptok2 = new Puma::PreTreeToken(tok2);
-
-    auto node = new Puma::PreElseDirective(ptok, ptok2);
-    unsigned long *nodeNum = builder.getNodeNum();
-
-    auto newBlock = new ConditionalBlockImpl(i->getFile(), parent,
-            prev, node, (*nodeNum)++, builder);
-    newBlock->setDummyBlock();
-    return newBlock;
 }
 
 /************************************************************************/
@@ -85,6 +78,9 @@ static ConditionalBlockImpl *createDummyElseBlock(ConditionalBlock *i, Condition
 // initialize static filename_regex at startup
 const boost::regex CppFile::filename_regex(R"(^.*/arch/([A-Za-z0-9]+)/.*$)");
 
+CppFileCache *CppFile::cache = nullptr;
+bool CppFile::useScanner = false;
+
 CppFile::CppFile(const std::string &f) : checker(this) {
     if (!boost::filesystem::exists(f))
         return;
@@ -92,8 +88,22 @@ CppFile::CppFile(const std::string &f) : checker(this) {
         filename = f;
     else
         filename = f.substr(2); // skip leading "./"
-    _builder = make_unique<PumaConditionalBlockBuilder>(this, f);
-    top_block = _builder->topBlock();
+    if (cache)
+        top_block = cache->load(this);
+    if (!top_block && useScanner) {
+        PlainConditionalBlockBuilder scanned;
+        if (DirectiveScanner(f, PumaConditionalBlockBuilder::getIncludePaths()).scan(scanned)) {
+            top_block = scanned.build(this);
+            if (cache)
+                cache->store(*this, {});  // scanned files don't include others
+        }
+    }
+    if (!top_block) {
+        _builder = make_unique<PumaConditionalBlockBuilder>(this, f);
+        top_block = _builder->topBlock();
+        if (cache && top_block)
+            cache->store(*this, _builder->getIncludedFiles());
+    }
 
     boost::filesystem::path filepath(filename);
     // check if the 'absolute path' to the given file matches the regex
@@ -117,30 +127,125 @@ CppFile::~CppFile() {
         delete entry.second;
 }
 
+void CppFile::addDefine(ConditionalBlock *block, bool define, const std::string &symbol) {
+    auto i = define_map.find(symbol);
+    if (i == define_map.end())
+        // First define for this item
+        i = define_map.emplace(symbol, new CppDefine(block, define, symbol)).first;
+    else
+        i->second->newDefine(block, define);
+
+    block->addDefine(i->second);
+    define_directives.push_back({size(), block, define, symbol});
+}
+
+void CppFile::rewriteDefinedSymbols(std::string &exp) const {
+    if (define_map.empty())
+        return;
+    std::string rewritten;
+    size_t copied = 0;
+    forEachWord(exp, [&](size_t begin, size_t end) {
+        const auto i = define_map.find(exp.substr(begin, end - begin));
+        if (i == define_map.end())
+            return;
+        rewritten.append(exp, copied, begin - copied);
+        rewritten += i->second->getActualSymbol();
+        copied = end;
+    });
+    if (copied == 0)  // no defined symbol in exp
+        return;
+    rewritten.append(exp, copied, exp.npos);
+    exp.swap(rewritten);
+}
+
+std::vector<CppDefine *> CppFile::usedDefines(const std::string &exp) const {
+    std::vector<DefineMap::const_iterator> used;
+    if (!define_map.empty())
+        forEachWord(exp, [&](size_t begin, size_t end) {
+            const auto i = define_map.find(exp.substr(begin, end - begin));
+            if (i != define_map.end())
+                used.push_back(i);
+        });
+    // in the order of define_map, as the constraints are added in this order
+    std::sort(used.begin(), used.end(),
+              [](DefineMap::const_iterator a, DefineMap::const_iterator b) {
+                  return a->first < b->first;
+              });
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+    std::vector<CppDefine *> defines;
+    for (const auto &i : used)
+        defines.push_back(i->second);
+    return defines;
+}
+
 bool CppFile::ItemChecker::operator()(const std::string &item) const {
     std::map<std::string, CppDefine*> *defines =  file->getDefines();
     return defines->find(item.substr(0, item.find('.'))) == defines->end();
 }
 
 ConditionalBlock *CppFile::getBlockAtPosition(const std::string &position) {
-    int line = lineFromPosition(position);
-    ConditionalBlock *block = nullptr;
-    int block_length = -1;
-
-    // Iterate over all block
-    for (auto &block_it : *this) {  // ConditionalBlock *
-        int begin = block_it->lineStart();
-        int last  = block_it->lineEnd();
-
-        if (last < begin) continue;
-        /* Found a short block, using this one */
-        if ((((last - begin) < block_length) || block_length == -1)
-                && begin < line && line < last) {
-            block = block_it;
-            block_length = last - begin;
+    return getBlockAtLine(lineFromPosition(position));
+}
+
+ConditionalBlock *CppFile::getBlockAtLine(unsigned int line) {
+    if (line_index.empty())
+        buildLineIndex();
+    auto i = std::upper_bound(line_index.begin(), line_index.end(), line,
+                              [](unsigned int value,
+                                 const std::pair<unsigned int, ConditionalBlock *> &entry) {
+                                  return value < entry.first;
+                              });
+    return std::prev(i)->second;  // the first entry is line 0
+}
+
+std::vector<ConditionalBlock *> CppFile::getBlocksAtLines(const std::vector<unsigned int> &lines) {
+    std::vector<ConditionalBlock *> blocks;
+    blocks.reserve(lines.size());
+    for (unsigned int line : lines)
+        blocks.push_back(getBlockAtLine(line));
+    return blocks;
+}
+
+void CppFile::buildLineIndex() {
+    /* The blocks are swept by the lines between their directives. Blocks
+       of included files may overlap any block, hence all blocks that
+       contain a line are kept in a set, the shortest is the innermost and
+       of equally long ones the first in the file is taken. */
+    struct Event {
+        unsigned int line;
+        bool enter;
+        size_t block;
+    };
+    std::vector<ConditionalBlock *> blocks(begin(), end());
+    std::vector<Event> events;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const unsigned int first = blocks[i]->lineStart(), last = blocks[i]->lineEnd();
+        if (last < first + 2)  // no line between the directives
+            continue;
+        events.push_back({first + 1, true, i});
+        events.push_back({last, false, i});
+    }
+    std::sort(events.begin(), events.end(),
+              [](const Event &a, const Event &b) { return a.line < b.line; });
+
+    std::set<std::pair<unsigned int, size_t>> containing;  // (length, block)
+    line_index.assign(1, {0, nullptr});
+    for (auto event = events.begin(); event != events.end();) {
+        const unsigned int line = event->line;
+        for (; event != events.end() && event->line == line; ++event) {
+            const ConditionalBlock *block = blocks[event->block];
+            const std::pair<unsigned int, size_t> key(block->lineEnd() - block->lineStart(),
+                                                      event->block);
+            if (event->enter)
+                containing.insert(key);
+            else
+                containing.erase(key);
         }
+        ConditionalBlock *innermost =
+            containing.empty() ? nullptr : blocks[containing.begin()->second];
+        if (innermost != line_index.back().second)
+            line_index.emplace_back(line, innermost);
     }
-    return block;
 }
 
 const std::string &CppFile::getFileVar() {
@@ -153,12 +258,35 @@ const std::string &CppFile::getFileVar() {
     return fileVar;
 }
 
+const ConstraintPtr &CppFile::getTopConstraint() {
+    if (!top_constraint)
+        top_constraint = std::make_shared<Constraint>("B00");
+    return top_constraint;
+}
+
+const ConstraintPtr &CppFile::getFileConstraint() {
+    if (!file_constraint) {
+        StringJoiner file_joiner;
+
+        file_joiner.push_back("(");
+        file_joiner.push_back("B00");
+        file_joiner.push_back("<->");
+        // push the file inference symbol
+        file_joiner.push_back(getFileVar());
+        file_joiner.push_back(")");
+        file_constraint = std::make_shared<Constraint>(file_joiner.join(" "));
+    }
+    return file_constraint;
+}
+
 void CppFile::decisionCoverage() {
 #if 0
     Logging::debug("======== before TRANSFORMATION ========");
     this->topBlock()->printConditionalBlocks(0);
 #endif
     this->topBlock()->processForDecisionCoverage();
+    // the dummy blocks are looked up as well
+    line_index.clear();
 #if 0
     Logging::debug("======== after TRANSFORMATION ========");
     this->topBlock()->printConditionalBlocks(0);
@@ -207,7 +335,7 @@ void ConditionalBlock::processForDecisionCoverage() {
         if (prev != this->end() && (*i)->isIfBlock() &&
                 ((*prev)->isIfBlock() || (*prev)->isElseIfBlock())) {
             ConditionalBlock *parent = const_cast<ConditionalBlock *>((*i)->_parent);
-            ConditionalBlockImpl *nblock = createDummyElseBlock(*i, parent, *prev);
+            ConditionalBlock *nblock = (*i)->createDummyElseBlock(parent, *prev);
             parent->insert(i, nblock);
             // this inserts the Block also into the correct position in the CppFile List
             insertBlockIntoFile(*i, nblock);
@@ -215,7 +343,7 @@ void ConditionalBlock::processForDecisionCoverage() {
         // when the last element of the list is an if-expression
         if (*i == this->back() && ((*i)->isIfBlock() || (*i)->isElseIfBlock())) {
             ConditionalBlock *parent = const_cast<ConditionalBlock *>((*i)->_parent);
-            ConditionalBlockImpl *nblock = createDummyElseBlock(*i, parent, *i);
+            ConditionalBlock *nblock = (*i)->createDummyElseBlock(parent, *i);
             parent->push_back(nblock);
             // this inserts the Block also into the correct position in the CppFile List
             if (*i == this->getFile()->back())
@@ -260,18 +388,17 @@ void ConditionalBlock::lateConstructor() {
         _exp.erase(pos,7);
 
     /* Define Rewriting */
-    for (auto &entry : *cpp_file->getDefines())  // pair<string, CppDefine *>
-        entry.second->replaceDefinedSymbol(_exp);
+    cpp_file->rewriteDefinedSymbols(_exp);
 }
 
-std::string ConditionalBlock::getConstraintsHelper(UniqueStringJoiner *and_clause) {
+std::string ConditionalBlock::getConstraintsHelper(UniqueFormula *and_clause) {
     if (!_parent) return "B00"; // top_level block, represents file
 
-    UniqueStringJoiner sj; // on our stack
-    bool join = false;
-    if (!and_clause) {
-        and_clause = &sj; // We are the toplevel call
-        join = true; // We also must return a true string
+    if (constraint) {
+        if (!and_clause)
+            return constraint->str();
+        and_clause->push_back(constraint);
+        return "";
     }
     StringJoiner innerClause, predecessors;
 
@@ -291,23 +418,29 @@ std::string ConditionalBlock::getConstraintsHelper(UniqueStringJoiner *and_claus
     if (predecessors.size() > 0)
        innerClause.push_back("( ! (" + predecessors.join(" || ") + ") )");
 
-    and_clause->push_back( "( " + getName() + " <-> " + innerClause.join(" && ") + " )");
-
-    return join ? and_clause->join(" && ") : "";
+    // the block doesn't change anymore, its constraint is built only once
+    constraint = std::make_shared<Constraint>(
+        "( " + getName() + " <-> " + innerClause.join(" && ") + " )");
+    return getConstraintsHelper(and_clause);
 }
 
-std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
-                                                 std::set<ConditionalBlock *> *visited) {
-    UniqueStringJoiner sj; // on our stack
-    bool join = false;
-
-    if (!and_clause) {
-        if (cached_code_expression)
-            return *cached_code_expression;
-        and_clause = &sj; // We are the toplevel call
-        join = true; // We also must return a true string
+const Formula &ConditionalBlock::getCodeFormula() {
+    if (!cached_code_formula) {
+        UniqueFormula and_clause;
+        if (!_parent) {
+            /* When we are the toplevel call we ensure, that no
+            element is added more than once to the and_clause,
+            therefore we can disable the unique attribute within
+            the UniqueFormula to improve performance */
+            and_clause.disableUniqueness();
+        }
+        getCodeConstraints(&and_clause, nullptr);
     }
+    return *cached_code_formula;
+}
 
+void ConditionalBlock::getCodeConstraints(UniqueFormula *and_clause,
+                                          std::set<ConditionalBlock *> *visited) {
     std::set<ConditionalBlock *> vs;
     if (!visited)
         visited = &vs;
@@ -317,13 +450,6 @@ std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
         visited->insert(this);
 
         if (!_parent) { // Toplevel block
-            if (join == true) {
-                /* When we are the toplevel call we ensure, that no
-                element is added more than once to the and_clause,
-                therefore we can disable the unique attribute within
-                the StringJoiner to improve performance */
-                and_clause->disableUniqueness();
-            }
 
             // Add expressions for all blocks
             for (auto &block : *cpp_file)  // ConditionalBlock *
@@ -335,7 +461,7 @@ std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
                 define->getConstraintsHelper(and_clause);
             }
 
-            and_clause->push_back("B00");
+            and_clause->push_back(cpp_file->getTopConstraint());
         } else {
             const ConditionalBlock *block = this;
             const_cast<ConditionalBlock *>(block)->getConstraintsHelper(and_clause);
@@ -348,32 +474,17 @@ std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
             if (block && block != cpp_file->topBlock())
                 const_cast<ConditionalBlock *>(block)->getCodeConstraints(and_clause, visited);
 
-            and_clause->push_back("B00");
-            for (auto &entry : *cpp_file->getDefines()) {  // pair<string, CppDefine *>
-                CppDefine *define = entry.second;
-                if (define->containsDefinedSymbol(ExpressionStr()))
-                    define->getConstraints(and_clause, visited);
-            }
+            and_clause->push_back(cpp_file->getTopConstraint());
+            for (CppDefine *define : cpp_file->usedDefines(ExpressionStr()))
+                define->getConstraints(and_clause, visited);
         }
 
-        if (ModelContainer::getInstance().size() > 0) {
-            StringJoiner file_joiner;
-
-            file_joiner.push_back("(");
-            file_joiner.push_back("B00");
-            file_joiner.push_back("<->");
-            // push the file inference symbol
-            file_joiner.push_back(fileVar());
-            file_joiner.push_back(")");
-            and_clause->push_back(file_joiner.join(" "));
-        }
+        if (ModelContainer::getInstance().size() > 0)
+            and_clause->push_back(cpp_file->getFileConstraint());
     }
 
-    if (!cached_code_expression)
-        cached_code_expression = new std::string(and_clause->join("\n&& "));
-
-    // Do the join of the and clause only if we are the toplevel clause
-    return join ? and_clause->join("\n&& ") : "";
+    if (!cached_code_formula)
+        cached_code_formula = new Formula(*and_clause);
 }
 
 /************************************************************************/
@@ -381,7 +492,7 @@ std::string ConditionalBlock::getCodeConstraints(UniqueStringJoiner *and_clause,
 /************************************************************************/
 
 CppDefine::CppDefine(ConditionalBlock *defined_in, bool define, const std::string &id)
-        : actual_symbol(id), defined_symbol(id) {
+        : actual_symbol(id) {
     newDefine(defined_in, define);
 }
 
@@ -401,49 +512,24 @@ void CppDefine::newDefine(ConditionalBlock *parent, bool define) {
     std::string right_side = (define ? "" : "!") + new_symbol;
 
     // Block defined -> new_symbol is active
-    defineExpressions.push_back("(" + parent->getName() + " -> " + right_side + ")");
+    defineExpressions.push_back(std::make_shared<Constraint>(
+        "(" + parent->getName() + " -> " + right_side + ")"));
 
     // !block defined -> old symbol == new_symbol
-    defineExpressions.push_back("(!" + parent->getName() + " -> (" + actual_symbol + " <-> " + new_symbol + "))");
+    defineExpressions.push_back(std::make_shared<Constraint>(
+        "(!" + parent->getName() + " -> (" + actual_symbol + " <-> " + new_symbol + "))"));
 
     /* B --> B. */
     actual_symbol = new_symbol;
-
-    const std::string symbolSpace = "([() ><&|!-]|^|$)";
-
-    replaceRegex = boost::regex(symbolSpace + "(" + defined_symbol + ")" + symbolSpace);
 }
 
-void CppDefine::replaceDefinedSymbol(std::string &exp) {
-    if (exp.find(defined_symbol) == exp.npos)  // exp doesn't contain defined_symbol
-        return;
-
-    boost::match_results<std::string::iterator> what;
-    while (boost::regex_search(exp.begin(), exp.end(), what, replaceRegex))
-        exp.replace(what[2].first, what[2].second, actual_symbol);
+void CppDefine::getConstraintsHelper(UniqueFormula *and_clause) const {
+    for (const ConstraintPtr &constraint : defineExpressions)
+        and_clause->push_back(constraint);
 }
 
-bool CppDefine::containsDefinedSymbol(const std::string &exp) {
-    if (exp.find(defined_symbol) == exp.npos)  // exp doesn't contain defined_symbol
-        return false;
-    return boost::regex_search(exp, replaceRegex);
-}
-
-
-void CppDefine::getConstraintsHelper(UniqueStringJoiner *and_clause) const {
-    for (const std::string &str : defineExpressions)
-        and_clause->push_back(str);
-}
-
-std::string CppDefine::getConstraints(UniqueStringJoiner *and_clause,
+void CppDefine::getConstraints(UniqueFormula *and_clause,
         std::set<ConditionalBlock *> *visited) {
-    UniqueStringJoiner sj; // on our stack
-    bool join = false;
-    if (!and_clause) {
-        and_clause = &sj; // We are the toplevel call
-        join = true; // We also must return a true string
-    }
-
     std::set<ConditionalBlock *> vs;
     if (!visited)
         visited = &vs;
@@ -456,5 +542,4 @@ std::string CppDefine::getConstraints(UniqueStringJoiner *and_clause,
             block->getCodeConstraints(and_clause, visited);
         }
     }
-    return join ? and_clause->join("\n&& ") : "";
 }
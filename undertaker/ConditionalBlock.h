@@ -26,13 +26,15 @@
 
 #include "ConfigurationModel.h"
 #include "BlockDefectAnalyzer.h"
+#include "Formula.h"
 
 #include <boost/regex.hpp>
+#include <vector>
 
 class ConditionalBlock;
 class CppDefine;
+class CppFileCache;
 class PumaConditionalBlockBuilder;
-struct UniqueStringJoiner;
 
 typedef std::list<ConditionalBlock *> CondBlockList;
 
@@ -63,18 +65,58 @@ class CppFile : public CondBlockList {
      */
     DefineMap * getDefines() { return &define_map; };
 
+    //! a #define or #undef directive, in the order of the file
+    struct DefineDirective {
+        size_t blocks;       //!< number of blocks in the file before the directive
+        ConditionalBlock *block;
+        bool define;         //!< false for #undef
+        std::string symbol;
+    };
+
+    //! records a #define (or an #undef) of symbol in block
+    void addDefine(ConditionalBlock *block, bool define, const std::string &symbol);
+
+    /**
+     * Replaces the defined symbols in exp by the symbols of their latest
+     * define. The words of exp are looked up in the defines, each once.
+     */
+    void rewriteDefinedSymbols(std::string &exp) const;
+
+    //! \return the defines of the symbols that are used in exp, ordered by symbol
+    std::vector<CppDefine *> usedDefines(const std::string &exp) const;
+    const std::vector<DefineDirective> &getDefineDirectives() const { return define_directives; }
+
     //! \return filename given in the constructor
     const std::string &getFilename() const { return filename; };
 
     //! \return file variable to identify the correct file inferences
     const std::string &getFileVar();
 
+    //@{
+    //! constraints that are part of the code constraints of many blocks
+    const ConstraintPtr &getTopConstraint();   //!< "B00"
+    const ConstraintPtr &getFileConstraint();  //!< "( B00 <-> FILE_... )"
+    //@}
+
     /**
-     * \param postition format: "filename:line:pos"
-     * \return innermost block at specific position
+     * \param postition format: "filename:line:pos" or "filename:line"
+     * \return innermost block at specific position, see getBlockAtLine()
      */
     ConditionalBlock *getBlockAtPosition(const std::string &position);
 
+    /**
+     * A block contains the lines between its directive and the directive
+     * that ends it, the lines of the directives belong to the enclosing
+     * block. Lookups take logarithmic time, the index is built on the
+     * first lookup (and after decisionCoverage()).
+     * \return innermost block containing line, nullptr for lines of the
+     * top block
+     */
+    ConditionalBlock *getBlockAtLine(unsigned int line);
+
+    //! \return getBlockAtLine() for each of lines
+    std::vector<ConditionalBlock *> getBlocksAtLines(const std::vector<unsigned int> &lines);
+
     //! start modification of ConditionalBlocks for decision coverage analysis
     void decisionCoverage();
 
@@ -92,16 +134,33 @@ class CppFile : public CondBlockList {
 
     const ItemChecker *getChecker() const { return &checker;}
 
+    /**
+     * If set, files are restored from this cache instead of being
+     * parsed, files that were parsed are added to it.
+     */
+    static CppFileCache *cache;
+
+    /**
+     * If set, the directives of files are read by the DirectiveScanner,
+     * only the files it refuses are parsed.
+     */
+    static bool useScanner;
+
  private:
     std::string filename;
     std::string fileVar;  // the inference Variable for this file
     std::string specific_arch;
+    ConstraintPtr top_constraint, file_constraint;
     ConditionalBlock *top_block = nullptr;
     std::map<std::string, CppDefine *> define_map;
+    std::vector<DefineDirective> define_directives;
+    //! innermost block from each line on, ordered by line, see getBlockAtLine()
+    std::vector<std::pair<unsigned int, ConditionalBlock *>> line_index;
     const CppFile::ItemChecker checker;
     std::unique_ptr<PumaConditionalBlockBuilder> _builder;
 
     void printCppFile();
+    void buildLineIndex();
 
     static const boost::regex filename_regex;
 };
@@ -130,6 +189,9 @@ public:
     virtual bool isDummyBlock()          const = 0; //!< is Dummy-Block
     virtual void setDummyBlock()               = 0; //!< set Block to dummy state
     virtual const std::string getName()  const = 0; //!< unique identifier for block
+    //! \return new dummy #else block of the same kind, see processForDecisionCoverage()
+    virtual ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                                   ConditionalBlock *prev) = 0;
 
     /**
      * This function doesn't affect the logic of the CPPPC algorithm, but changes
@@ -151,7 +213,7 @@ public:
     //! Has to be called after constructing a ConditionalBlock
     void lateConstructor();
 
-    virtual ~ConditionalBlock() { delete cached_code_expression; };
+    virtual ~ConditionalBlock() { delete cached_code_formula; };
 
     //! \return name of the file containing this block
     const std::string &filename() const { return cpp_file->getFilename(); };
@@ -170,12 +232,25 @@ public:
     //! \return rewritten (define) macro expression
     std::string ifdefExpression() const { return _exp; };
 
-    std::string getCodeConstraints(UniqueStringJoiner *and_clause = nullptr,
-                                  std::set<ConditionalBlock *> *visited = nullptr);
+    //! \return the text of getCodeFormula(), for reports and the cpppc output
+    std::string getCodeConstraints() { return getCodeFormula().str(); }
+
+    /**
+     * \return the constraints of the block, its predecessors and the
+     * defines it depends on, they are computed only once
+     */
+    const Formula &getCodeFormula();
+
+    //! adds the code constraints to and_clause, blocks in visited are skipped
+    void getCodeConstraints(UniqueFormula *and_clause, std::set<ConditionalBlock *> *visited);
 
     void addDefine(CppDefine* define) { _defines.push_back(define); }
 
-    std::string getConstraintsHelper(UniqueStringJoiner *and_clause = nullptr);
+    /**
+     * Adds the constraint of the block itself to and_clause. Without
+     * and_clause, its text is returned.
+     */
+    std::string getConstraintsHelper(UniqueFormula *and_clause = nullptr);
     const std::list<CppDefine *> &getDefines() const { return _defines; };
 
     //! the following functions have to be public because decisionCoverage() is
@@ -197,7 +272,8 @@ protected:
 
 private:
     std::string _exp;
-    std::string *cached_code_expression = nullptr;
+    ConstraintPtr constraint;
+    Formula *cached_code_formula = nullptr;
 
     void insertBlockIntoFile(ConditionalBlock *prevBlock, ConditionalBlock *nblock,
             bool insertAfter = false);
@@ -212,25 +288,20 @@ public:
     CppDefine(ConditionalBlock *parent, bool define, const std::string &id);
     void newDefine(ConditionalBlock *parent, bool define);
 
-    void replaceDefinedSymbol(std::string &exp);
+    //! \return the symbol that stands for the defined symbol after the latest define
+    const std::string &getActualSymbol() const { return actual_symbol; }
 
-    std::string getConstraints(UniqueStringJoiner *and_clause = nullptr,
-                                  std::set<ConditionalBlock *> *visited = nullptr);
+    //! adds the constraints of the define and the blocks it depends on to and_clause
+    void getConstraints(UniqueFormula *and_clause, std::set<ConditionalBlock *> *visited);
 
-    void getConstraintsHelper(UniqueStringJoiner *and_clause) const;
-
-    bool containsDefinedSymbol(const std::string &exp);
+    void getConstraintsHelper(UniqueFormula *and_clause) const;
 
 private:
     std::set<std::string> isUndef;
     std::string actual_symbol; // The defined symbol will be replaced by this
 
-    std::string defined_symbol; // The defined symbol
-
     std::deque <ConditionalBlock *> defined_in;
-    std::list <std::string> defineExpressions;
-
-    boost::regex replaceRegex;
+    std::list <ConstraintPtr> defineExpressions;
 };
 
 #endif /* _CONDITIONALBLOCK_H_ */
@@ -26,6 +26,7 @@
 #define configuration_model_h__
 
 #include "RsfReader.h" // for 'StringList'
+#include "Formula.h"
 
 #include <string>
 #include <set>
@@ -70,10 +71,19 @@ public:
                     std::set<std::string> &missing,
                     std::string &intersected) const = 0;
 
+    //! the constraints of the model on the given items replace intersected
     virtual int doIntersect(const std::set<std::string> exp,
                     const ConfigurationModel::Checker *c,
                     std::set<std::string> &missing,
-                    std::string &intersected) const = 0;
+                    Formula &intersected) const = 0;
+
+    //! doIntersect() on the items of a formula, its text isn't needed
+    int doIntersect(const Formula &exp,
+                    const ConfigurationModel::Checker *c,
+                    std::set<std::string> &missing,
+                    Formula &intersected) const {
+        return doIntersect(exp.getSymbols(), c, missing, intersected);
+    }
 
     virtual std::set<std::string> findSetOfInterestingItems(const std::set<std::string> &) const = 0;
 
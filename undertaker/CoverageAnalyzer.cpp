@@ -73,7 +73,9 @@ std::string CoverageAnalyzer::baseFileExpression(const ConfigurationModel *model
 std::list<SatChecker::AssignmentMap> SimpleCoverageAnalyzer::blockCoverage(ConfigurationModel *model) {
     std::set<std::string> blocks_set;
     std::list<SatChecker::AssignmentMap> ret;
-    std::set<SatChecker::AssignmentMap> found_solutions;
+    // solutions are compared by the values of the items in 'configuration_space' only
+    std::set<std::vector<bool>> found_solutions;
+    std::vector<std::string> configuration_space;
 
     const std::string base_formula = baseFileExpression(model);
 
@@ -81,8 +83,6 @@ std::list<SatChecker::AssignmentMap> SimpleCoverageAnalyzer::blockCoverage(Confi
         BaseExpressionSatChecker sc(base_formula);
 
         for (const auto &block : *file) {      // ConditionalBlock *
-            SatChecker::AssignmentMap current_solution;
-
             if (blocks_set.find(block->getName()) == blocks_set.end()) {
                 /* does this block contribute to the set of configurations? */
                 bool new_solution = false;
@@ -91,36 +91,39 @@ std::list<SatChecker::AssignmentMap> SimpleCoverageAnalyzer::blockCoverage(Confi
                 if (!sc( { block->getName() } ))
                     continue;
 
-                static const boost::regex block_regexp("^B\\d+$");
-                for (const auto &assignment : sc.getAssignment()) { // pair<string, bool>
-                    const std::string &name = assignment.first;
-                    const bool enabled = assignment.second;
-
-                    if (boost::regex_match(name, block_regexp)) {
-                        // if a block is enabled, and not already in the block set, we enable it
-                        // with this configuration and get a new solution
-                        if (enabled && blocks_set.find(name) == blocks_set.end()) {
-                            blocks_set.insert(name);
-                            new_solution = true;
-                        }
-                        // No blocks in the assignment maps
-                        continue;
+                const SatChecker::AssignmentView &assignment = sc.getAssignment();
+                for (const auto &b : *file) {  // ConditionalBlock *
+                    // if a block is enabled, and not already in the block set, we enable it
+                    // with this configuration and get a new solution
+                    const std::string &name = b->getName();
+                    if (assignment[name] && blocks_set.find(name) == blocks_set.end()) {
+                        blocks_set.insert(name);
+                        new_solution = true;
                     }
-
-                    /* If no model is given or the symbol is in the
-                       model space we can push the assignment to the
-                       current solution.
-                    */
-                    if (!model || model->inConfigurationSpace(name))
-                        current_solution.emplace(name, enabled);
                 }
 
-                if (found_solutions.find(current_solution) == found_solutions.end()) {
-                    found_solutions.insert(current_solution);
-
-                    if (new_solution)
-                        ret.push_back(sc.getAssignment());
+                /* The variables of the base expression are the same for
+                   every check, so the items that are in the model space
+                   (or all items, if no model is given) are collected
+                   only once.
+                */
+                if (configuration_space.empty()) {
+                    static const boost::regex block_regexp("^B\\d+$");
+                    assignment.forEach([&](kconfig::StringRef ref, bool) {
+                        std::string name = ref.str();
+                        if (boost::regex_match(name, block_regexp))
+                            return;
+                        if (!model || model->inConfigurationSpace(name))
+                            configuration_space.push_back(name);
+                    });
                 }
+                std::vector<bool> current_solution;
+                current_solution.reserve(configuration_space.size());
+                for (const std::string &name : configuration_space)
+                    current_solution.push_back(assignment[name]);
+
+                if (found_solutions.insert(current_solution).second && new_solution)
+                    ret.push_back(assignment.materialize());
             }
         }
     } catch (CNFBuilderError &e) {
@@ -151,11 +154,9 @@ std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(Con
         BaseExpressionSatChecker sc(base_formula);
 
         if(sc(configuration)) { // Configuration is an empty list here
-            static const boost::regex block_regexp("^B\\d+$");
-            for (const auto &assignment : sc.getAssignment()) {  // pair<string, bool>
-                if (assignment.second == false) continue; // Not enabled
-                const std::string &block_name = assignment.first;
-                if (boost::regex_match(block_name, block_regexp)) {
+            for (const auto &block : *file) {  // ConditionalBlock *
+                const std::string &block_name = block->getName();
+                if (sc.getAssignment()[block_name]) {
                     configuration.insert(block_name);
                     blocks_set.insert(block_name);
                 }
@@ -213,7 +214,7 @@ std::list<SatChecker::AssignmentMap> MinimizeCoverageAnalyzer::blockCoverage(Con
             if (configuration.size() == 0) continue;
 
             assert(sc(configuration));
-            ret.push_back(sc.getAssignment());
+            ret.push_back(sc.getAssignment().materialize());
 
             // We have added an assignment, so we can clear the
             // configuration-set for the next configuration
@@ -0,0 +1,310 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CppFileCache.h"
+#include "PlainConditionalBlock.h"
+#include "Logging.h"
+#include "exceptions/IOException.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+using kconfig::IOException;
+
+/*
+ * The format of an entry, all numbers are unsigned LEB128 varints and
+ * strings are written as their length and their bytes:
+ *
+ *     Entry   := Magic Format Key Digest Files Blocks Defines
+ *     Magic   := 'U' 'T' 'C' 'F'
+ *     Key     := version filename count {include path}
+ *     Files   := count {path Digest}       (the included files)
+ *     Blocks  := count {kind parent prev startline startcolumn endline endcolumn expression}
+ *     Defines := count {blocks block define symbol}
+ *
+ * A digest is a pair of numbers. Blocks are written in the order of the
+ * file, parents and predecessors are referred to by their index plus
+ * one, 0 is the top block (or no predecessor). A define is preceded by
+ * the given number of blocks.
+ */
+namespace {
+    const char entryMagic[4] = {'U', 'T', 'C', 'F'};
+    const size_t entryFormat = 1;
+
+    struct Digest {
+        uint64_t hi, lo;
+
+        bool operator==(const Digest &other) const { return hi == other.hi && lo == other.lo; }
+        bool operator!=(const Digest &other) const { return !(*this == other); }
+    };
+
+    // two independent 64 bit hashes over the same input, as in SatCache
+    Digest digest(const std::string &data) {
+        uint64_t fnv = 14695981039346656037ull;
+        uint64_t mix = 0x9e3779b97f4a7c15ull;
+        for (const char c : data) {
+            fnv = (fnv ^ (unsigned char) c) * 1099511628211ull;
+            mix = (mix ^ (unsigned char) c) * 0xff51afd7ed558ccdull;
+            mix ^= mix >> 29;
+        }
+        return {fnv, mix};
+    }
+
+    bool readFile(const std::string &path, std::string &contents) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.good())
+            return false;
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return !in.bad();
+    }
+
+    class Writer {
+    public:
+        std::string data;
+
+        void number(uint64_t value) {
+            while (value >= 0x80) {
+                data += (char) ((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            data += (char) value;
+        }
+        void string(const std::string &str) {
+            number(str.size());
+            data += str;
+        }
+        void digest(const Digest &d) {
+            number(d.hi);
+            number(d.lo);
+        }
+    };
+
+    class Reader {
+    public:
+        Reader(const std::string &data)
+            : pos((const unsigned char *) data.data()),
+              end((const unsigned char *) data.data() + data.size()) {}
+
+        bool atEnd() const { return pos == end; }
+
+        bool magic() {
+            if ((size_t) (end - pos) < sizeof(entryMagic)
+                || !std::equal(entryMagic, entryMagic + sizeof(entryMagic), (const char *) pos))
+                return false;
+            pos += sizeof(entryMagic);
+            return true;
+        }
+        bool number(uint64_t &value) {
+            value = 0;
+            for (unsigned shift = 0; pos < end && shift < 64; shift += 7) {
+                const unsigned char byte = *pos++;
+                value |= (uint64_t) (byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return true;
+            }
+            return false;
+        }
+        //! a count of entries, each takes a byte at least
+        bool count(uint64_t &value) {
+            return number(value) && value <= (uint64_t) (end - pos);
+        }
+        bool string(std::string &str) {
+            uint64_t length;
+            if (!count(length))
+                return false;
+            str.assign((const char *) pos, length);
+            pos += length;
+            return true;
+        }
+        bool digest(Digest &d) { return number(d.hi) && number(d.lo); }
+
+    private:
+        const unsigned char *pos;
+        const unsigned char *end;
+    };
+
+    //! the key of an entry, apart from the file itself
+    void writeKey(Writer &out, const std::string &version, const std::string &filename,
+                  const std::list<std::string> &includePaths) {
+        out.string(version);
+        out.string(filename);
+        out.number(includePaths.size());
+        for (const std::string &path : includePaths)
+            out.string(path);
+    }
+}
+
+/************************************************************************/
+/* CppFileCache                                                         */
+/************************************************************************/
+
+CppFileCache::CppFileCache(const std::string &directory, const std::string &version,
+                           const std::list<std::string> &includePaths)
+    : directory(directory), version(version), includePaths(includePaths) {
+    boost::system::error_code error;
+    boost::filesystem::create_directories(directory, error);
+    if (error || !boost::filesystem::is_directory(directory))
+        throw IOException("Could not create cache directory " + directory);
+}
+
+std::string CppFileCache::entryPath(const std::string &filename) const {
+    Writer key;
+    writeKey(key, version, filename, includePaths);
+    const Digest d = digest(key.data);
+    char name[2 * 16 + 1];
+    snprintf(name, sizeof(name), "%016llx%016llx", (unsigned long long) d.hi,
+             (unsigned long long) d.lo);
+    return directory + "/" + name;
+}
+
+ConditionalBlock *CppFileCache::load(CppFile *file) {
+    const std::string &filename = file->getFilename();
+    std::string contents, data;
+    if (!readFile(filename, contents) || !readFile(entryPath(filename), data))
+        return nullptr;
+
+    Reader in(data);
+    uint64_t format, count;
+    std::string str;
+    if (!in.magic() || !in.number(format) || format != entryFormat)
+        return nullptr;
+    // the name of the entry is only a hash of the key, it has to match exactly
+    if (!in.string(str) || str != version || !in.string(str) || str != filename
+        || !in.count(count) || count != includePaths.size())
+        return nullptr;
+    for (const std::string &path : includePaths)
+        if (!in.string(str) || str != path)
+            return nullptr;
+
+    Digest d;
+    if (!in.digest(d) || d != digest(contents) || !in.count(count))
+        return nullptr;
+    for (uint64_t i = 0; i < count; i++) {
+        std::string included;
+        if (!in.string(str) || !in.digest(d) || !readFile(str, included) || d != digest(included))
+            return nullptr;
+    }
+
+    PlainConditionalBlockBuilder builder;
+    std::vector<PlainConditionalBlockBuilder::Block> &blocks = builder.blocks;
+    if (!in.count(count))
+        return nullptr;
+    blocks.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        PlainConditionalBlockBuilder::Block &b = blocks[i];
+        uint64_t kind, parent, prev, line[4];
+        if (!in.number(kind) || !in.number(parent) || !in.number(prev)
+            || !in.number(line[0]) || !in.number(line[1]) || !in.number(line[2])
+            || !in.number(line[3]) || !in.string(b.expression))
+            return nullptr;
+        // blocks refer to blocks before them only
+        if (kind == (uint64_t) PlainConditionalBlock::Kind::TOP
+            || kind > (uint64_t) PlainConditionalBlock::Kind::ELSE || parent > i || prev > i)
+            return nullptr;
+        b.kind = (PlainConditionalBlock::Kind) kind;
+        b.parent = parent;
+        b.prev = prev;
+        b.start = {(unsigned int) line[0], (unsigned int) line[1]};
+        b.end = {(unsigned int) line[2], (unsigned int) line[3]};
+    }
+
+    std::vector<PlainConditionalBlockBuilder::Define> &defines = builder.defines;
+    if (!in.count(count))
+        return nullptr;
+    defines.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        PlainConditionalBlockBuilder::Define &def = defines[i];
+        uint64_t before, block, define;
+        if (!in.number(before) || !in.number(block) || !in.number(define)
+            || !in.string(def.symbol))
+            return nullptr;
+        // the block of a directive exists already, directives are in order
+        if (before > blocks.size() || block > before || define > 1
+            || (i > 0 && before < defines[i - 1].blocks))
+            return nullptr;
+        def.blocks = before;
+        def.block = block;
+        def.define = define;
+    }
+    if (!in.atEnd())
+        return nullptr;
+
+    ConditionalBlock *top = builder.build(file);
+    Logging::debug("restored ", filename, " from the cache");
+    return top;
+}
+
+void CppFileCache::store(const CppFile &file, const std::list<std::string> &includedFiles) {
+    const std::string &filename = file.getFilename();
+    std::string contents;
+    if (!readFile(filename, contents))
+        return;
+
+    Writer out;
+    out.data.assign(entryMagic, sizeof(entryMagic));
+    out.number(entryFormat);
+    writeKey(out, version, filename, includePaths);
+    out.digest(digest(contents));
+    out.number(includedFiles.size());
+    for (const std::string &path : includedFiles) {
+        std::string included;
+        if (!readFile(path, included))
+            return;
+        out.string(path);
+        out.digest(digest(included));
+    }
+
+    std::unordered_map<const ConditionalBlock *, uint64_t> index;
+    index[file.topBlock()] = 0;
+    out.number(file.size());
+    for (const ConditionalBlock *block : file) {
+        const uint64_t i = index.size();
+        index[block] = i;
+        out.number((uint64_t) PlainConditionalBlock::kindOf(block));
+        out.number(index.at(block->getParent()));
+        out.number(block->getPrev() ? index.at(block->getPrev()) : 0);
+        out.number(block->lineStart());
+        out.number(block->colStart());
+        out.number(block->lineEnd());
+        out.number(block->colEnd());
+        out.string(block->isElseBlock() ? "" : block->ExpressionStr());
+    }
+    out.number(file.getDefineDirectives().size());
+    for (const CppFile::DefineDirective &directive : file.getDefineDirectives()) {
+        out.number(directive.blocks);
+        out.number(index.at(directive.block));
+        out.number(directive.define);
+        out.string(directive.symbol);
+    }
+
+    // entries are never seen half written, the last writer wins
+    const std::string path = entryPath(filename);
+    const std::string tmp = path + "." + std::to_string(getpid());
+    std::ofstream entry(tmp, std::ios::binary | std::ios::trunc);
+    entry << out.data;
+    entry.close();
+    if (!entry.good() || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        Logging::warn("could not write cache entry ", path, " for ", filename);
+        std::remove(tmp.c_str());
+    }
+}
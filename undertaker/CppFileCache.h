@@ -0,0 +1,88 @@
+// -*- mode: c++ -*-
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CPPFILE_CACHE_H
+#define _CPPFILE_CACHE_H
+
+#include <list>
+#include <string>
+
+class ConditionalBlock;
+class CppFile;
+
+
+/************************************************************************/
+/* CppFileCache                                                         */
+/************************************************************************/
+
+/**
+ * \brief persistent cache of the block structure of parsed files
+ *
+ * Each parsed file gets an entry in the cache directory, named after a
+ * hash of the program version, the filename and the include paths. The
+ * entry holds the hash of the file contents and of all files that were
+ * included into it, the blocks with their positions, kinds, parents,
+ * predecessors and expressions after macro expansion, and the #define
+ * and #undef directives in the order of the file.
+ *
+ * An entry is only used if none of the files it was built from has
+ * changed, the file is restored as PlainConditionalBlocks then. The
+ * blocks get the same names and formulas as if they had been parsed.
+ * Headers that couldn't be found when the entry was written aren't
+ * looked for again.
+ *
+ * Entries are replaced atomically, concurrent runs and forked workers
+ * may use the same directory.
+ */
+class CppFileCache {
+public:
+    /**
+     * \param directory is created if it doesn't exist
+     * \param version version of the program, entries of other versions are ignored
+     * \param includePaths the include paths of the parser
+     * \throws kconfig::IOException if the directory can't be created
+     */
+    CppFileCache(const std::string &directory, const std::string &version,
+                 const std::list<std::string> &includePaths);
+
+    /**
+     * \brief restores the blocks and defines of file
+     *
+     * \return the top block, nullptr if there is no valid entry for the
+     * file, it is left untouched then
+     */
+    ConditionalBlock *load(CppFile *file);
+
+    /**
+     * \brief adds a file that was just parsed
+     *
+     * Must be called before the blocks of file are changed (see
+     * CppFile::decisionCoverage()). Failures are logged only.
+     * \param includedFiles the files the parser pasted into file
+     */
+    void store(const CppFile &file, const std::list<std::string> &includedFiles);
+
+private:
+    std::string directory;
+    std::string version;
+    std::list<std::string> includePaths;
+
+    //! name of the entry of filename in the directory
+    std::string entryPath(const std::string &filename) const;
+};
+#endif
@@ -0,0 +1,450 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DirectiveScanner.h"
+#include "Logging.h"
+
+#include <boost/filesystem.hpp>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef PlainConditionalBlock::Kind Kind;
+typedef PlainConditionalBlock::Position Position;
+
+namespace {
+    //! read only mapping of a whole file, empty files aren't mapped
+    struct MappedFile {
+        const char *data = nullptr;
+        size_t size = 0;
+        bool good = false;
+
+        MappedFile(const std::string &filename) {
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                size = st.st_size;
+                void *mapped = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+                if (mapped != MAP_FAILED) {
+                    data = static_cast<const char *>(mapped);
+                    good = true;
+                }
+            }
+            close(fd);
+        }
+        ~MappedFile() {
+            if (data)
+                munmap(const_cast<char *>(data), size);
+        }
+    };
+
+    // the macros the preprocessor defines itself, it would expand them
+    const std::unordered_set<std::string> builtinMacros = {
+        "__FILE__", "__LINE__", "__DATE__", "__TIME__", "__BASE_FILE__", "__INCLUDE_LEVEL__",
+        "__COUNTER__"};
+
+    bool isBlank(char c) { return c == ' ' || c == '\t'; }
+    bool isIdentifierStart(char c) { return isalpha((unsigned char) c) || c == '_'; }
+    bool isIdentifierChar(char c) { return isalnum((unsigned char) c) || c == '_'; }
+
+    size_t skipBlanks(const std::string &text, size_t i) {
+        while (i < text.size() && isBlank(text[i]))
+            i++;
+        return i;
+    }
+
+    //! the identifier at position i of text, empty if there is none
+    std::string identifierAt(const std::string &text, size_t i) {
+        if (i >= text.size() || !isIdentifierStart(text[i]))
+            return "";
+        size_t last = i + 1;
+        while (last < text.size() && isIdentifierChar(text[last]))
+            last++;
+        return text.substr(i, last - i);
+    }
+
+    /* Moves i to the next identifier of a condition, numbers and
+       character literals are skipped */
+    bool nextIdentifier(const std::string &exp, size_t &i, size_t &length) {
+        while (i < exp.size()) {
+            const char c = exp[i];
+            if (isIdentifierStart(c)) {
+                length = identifierAt(exp, i).size();
+                return true;
+            }
+            if (isdigit((unsigned char) c)) {
+                // a preprocessing number, exponents may have a sign
+                for (i++; i < exp.size(); i++) {
+                    const char d = exp[i];
+                    const bool sign = (d == '+' || d == '-')
+                                      && strchr("eEpP", exp[i - 1]) != nullptr;
+                    if (!isIdentifierChar(d) && d != '.' && !sign)
+                        break;
+                }
+            } else if (c == '\'' || c == '"') {
+                for (i++; i < exp.size() && exp[i] != c; i++)
+                    if (exp[i] == '\\')
+                        i++;
+                i++;
+            } else {
+                i++;
+            }
+        }
+        return false;
+    }
+
+    /* IS_ENABLED(X) -> (defined(X) || defined(X_MODULE)), IS_BUILTIN(X) ->
+       defined(X) and IS_MODULE(X) -> defined(X_MODULE), as
+       normalize_defined_makros() does on the tokens of the parser. The
+       parser knows the plain forms only, others are refused */
+    bool normalizeDefinedMacros(std::string &exp) {
+        size_t i = 0, length;
+        while (nextIdentifier(exp, i, length)) {
+            const std::string id = exp.substr(i, length);
+            if (id != "IS_ENABLED" && id != "IS_BUILTIN" && id != "IS_MODULE") {
+                i += length;
+                continue;
+            }
+            const size_t open = i + length;
+            const std::string option = identifierAt(exp, open + 1);
+            const size_t close = open + 1 + option.size();
+            if (open >= exp.size() || exp[open] != '(' || option.empty()
+                || close >= exp.size() || exp[close] != ')')
+                return false;
+
+            std::string replacement;
+            if (id == "IS_BUILTIN")
+                replacement = "defined(" + option + ")";
+            else if (id == "IS_MODULE")
+                replacement = "defined(" + option + "_MODULE)";
+            else
+                replacement = "(defined(" + option + ") || defined(" + option + "_MODULE))";
+            exp.replace(i, close + 1 - i, replacement);
+            i += replacement.size();
+        }
+        return true;
+    }
+
+    //! '#define X 0' is an #undef for the parser, after identifies the symbol
+    bool isNullDefinition(const std::string &text, size_t after) {
+        if (after >= text.size() || !isBlank(text[after]))
+            return false;
+        const size_t i = skipBlanks(text, after);
+        return i < text.size() && text[i] == '0'
+               && (i + 1 == text.size() || (!isIdentifierChar(text[i + 1]) && text[i + 1] != '.'));
+    }
+}
+
+/************************************************************************/
+/* DirectiveScanner                                                     */
+/************************************************************************/
+
+DirectiveScanner::DirectiveScanner(const std::string &filename,
+                                   const std::list<std::string> &includePaths)
+    : filename(filename), includePaths(includePaths) {}
+
+bool DirectiveScanner::scan(PlainConditionalBlockBuilder &builder) {
+    MappedFile file(filename);
+    if (!file.good) {
+        Logging::debug("could not read ", filename, " for scanning");
+        return false;
+    }
+    this->builder = &builder;
+    pos = lineBegin = file.data;
+    end = file.data + file.size;
+    line = 1;
+    open.assign(1, 0);
+    functionMacros.clear();
+
+    // only blanks and comments were in front of pos on its line
+    bool lineStart = true;
+    while (pos < end) {
+        const char c = *pos;
+        if (c == '\n') {
+            newline(++pos);
+            lineStart = true;
+        } else if (const size_t n = continuation(pos)) {
+            pos += n;
+            newline(pos);
+        } else if (c == '/' && pos + 1 < end && pos[1] == '*') {
+            skipBlockComment();
+        } else if (c == '/' && pos + 1 < end && pos[1] == '/') {
+            skipLineComment();
+        } else if (c == '#' && lineStart) {
+            if (!directive())
+                return false;
+        } else if (c == '"' || c == '\'') {
+            skipLiteral(nullptr);
+            lineStart = false;
+        } else {
+            if (!isspace((unsigned char) c))
+                lineStart = false;
+            pos++;
+        }
+    }
+    if (open.size() > 1) {
+        directiveLine = line;
+        return refuse("#if without #endif");
+    }
+    return true;
+}
+
+size_t DirectiveScanner::continuation(const char *p) const {
+    if (*p != '\\')
+        return 0;
+    if (p + 1 < end && p[1] == '\n')
+        return 2;
+    if (p + 2 < end && p[1] == '\r' && p[2] == '\n')
+        return 3;
+    return 0;
+}
+
+void DirectiveScanner::newline(const char *next) {
+    line++;
+    lineBegin = next;
+}
+
+void DirectiveScanner::skipBlockComment() {
+    for (pos += 2; pos < end; pos++) {
+        if (*pos == '*' && pos + 1 < end && pos[1] == '/') {
+            pos += 2;
+            return;
+        }
+        if (*pos == '\n')
+            newline(pos + 1);
+    }
+}
+
+void DirectiveScanner::skipLineComment() {
+    while (pos < end && *pos != '\n') {
+        if (const size_t n = continuation(pos)) {
+            pos += n;
+            newline(pos);
+        } else {
+            pos++;
+        }
+    }
+}
+
+// a literal ends at its quote or at the end of the line, as in a C lexer
+void DirectiveScanner::skipLiteral(std::string *text) {
+    const char quote = *pos;
+    if (text)
+        *text += quote;
+    for (pos++; pos < end && *pos != '\n';) {
+        if (const size_t n = continuation(pos)) {
+            pos += n;
+            newline(pos);
+            continue;
+        }
+        const char c = *pos++;
+        if (text)
+            *text += c;
+        if (c == quote)
+            return;
+        if (c == '\\' && pos < end && *pos != '\n' && !continuation(pos)) {
+            if (text)
+                *text += *pos;
+            pos++;
+        }
+    }
+}
+
+void DirectiveScanner::readLine(Line &directive) {
+    bool afterComment = false;
+    while (pos < end && *pos != '\n') {
+        if (const size_t n = continuation(pos)) {
+            pos += n;
+            newline(pos);
+            continue;
+        }
+        const char c = *pos;
+        if (c == '/' && pos + 1 < end && (pos[1] == '*' || pos[1] == '/')) {
+            const unsigned int before = line;
+            if (pos[1] == '*')
+                skipBlockComment();
+            else
+                skipLineComment();
+            directive.commentInside |= line != before;
+            directive.text += ' ';
+            afterComment = true;
+            continue;
+        }
+        if (afterComment && !isspace((unsigned char) c))
+            directive.commentInside = true;
+        if (c == '"' || c == '\'') {
+            skipLiteral(&directive.text);
+        } else {
+            directive.text += c;
+            pos++;
+        }
+    }
+}
+
+bool DirectiveScanner::directive() {
+    const Position start = {line, (unsigned int) (pos - lineBegin) + 1};
+    directiveLine = line;
+    pos++;
+    Line directive;
+    readLine(directive);
+    const std::string &text = directive.text;
+    const size_t at = skipBlanks(text, 0);
+    const std::string name = identifierAt(text, at);
+    const size_t operand = skipBlanks(text, at + name.size());
+
+    if (name == "if" || name == "elif") {
+        std::string expression;
+        if (!condition(directive, operand, expression))
+            return false;
+        if (name == "if")
+            return openBlock(Kind::IF, expression, start);
+        return continueBlock(Kind::ELIF, expression, start);
+    } else if (name == "ifdef" || name == "ifndef") {
+        const std::string symbol = identifierAt(text, operand);
+        if (symbol.empty())
+            return refuse("#" + name + " without a symbol");
+        if (builtinMacros.count(symbol))
+            return refuse("macro " + symbol + " in a condition");
+        return openBlock(name == "ifdef" ? Kind::IF : Kind::IFNDEF, symbol, start);
+    } else if (name == "else") {
+        return continueBlock(Kind::ELSE, "", start);
+    } else if (name == "endif") {
+        return closeBlock(start);
+    } else if (name == "define" || name == "undef") {
+        const std::string symbol = identifierAt(text, operand);
+        if (symbol.empty())
+            return refuse("#" + name + " without a symbol");
+        const size_t after = operand + symbol.size();
+        if (name == "define" && after < text.size() && text[after] == '(') {
+            // the parser expands the function-like macros of the top level only
+            if (open.size() == 1)
+                functionMacros.insert(symbol);
+            else
+                functionMacros.erase(symbol);
+            return true;
+        }
+        define(symbol, name == "define" && !isNullDefinition(text, after));
+    } else if (name == "include") {
+        return include(text.substr(operand));
+    }
+    // #error, #warning, #pragma and others don't matter
+    return true;
+}
+
+bool DirectiveScanner::openBlock(Kind kind, const std::string &expression, Position start) {
+    builder->blocks.push_back({kind, open.back(), 0, start, {0, 0}, expression});
+    open.push_back(builder->blocks.size());
+    return true;
+}
+
+bool DirectiveScanner::continueBlock(Kind kind, const std::string &expression, Position start) {
+    const size_t prev = open.back();
+    if (prev == 0)
+        return refuse("#elif or #else without #if");
+    if (builder->blocks[prev - 1].kind == Kind::ELSE)
+        return refuse("#elif or #else after #else");
+    builder->blocks[prev - 1].end = start;
+    open.pop_back();
+    builder->blocks.push_back({kind, open.back(), prev, start, {0, 0}, expression});
+    open.push_back(builder->blocks.size());
+    return true;
+}
+
+bool DirectiveScanner::closeBlock(Position start) {
+    if (open.back() == 0)
+        return refuse("#endif without #if");
+    builder->blocks[open.back() - 1].end = start;
+    open.pop_back();
+    return true;
+}
+
+void DirectiveScanner::define(const std::string &symbol, bool define) {
+    // the parser ignores directives of function-like macros, #undef removes them
+    const bool macro = functionMacros.count(symbol) > 0;
+    if (!define)
+        functionMacros.erase(symbol);
+    if (!macro)
+        builder->defines.push_back({builder->blocks.size(), open.back(), define, symbol});
+}
+
+/* The expression is taken as buildString() does: the text after the
+   blank following the directive, without trailing blanks */
+bool DirectiveScanner::condition(const Line &directive, size_t at, std::string &expression) {
+    const std::string &text = directive.text;
+    size_t last = text.size();
+    while (last > at && isBlank(text[last - 1]))
+        last--;
+    expression = text.substr(at, last - at);
+    if (expression.empty())
+        return refuse("condition without an expression");
+    if (directive.commentInside)
+        return refuse("comment inside of a condition");
+    if (expression.find('\r') != std::string::npos)
+        return refuse("carriage return in a condition");
+    if (!normalizeDefinedMacros(expression))
+        return refuse("IS_ENABLED(), IS_BUILTIN() or IS_MODULE() not applied to a symbol");
+
+    size_t i = 0, length;
+    while (nextIdentifier(expression, i, length)) {
+        const std::string id = expression.substr(i, length);
+        if (functionMacros.count(id))
+            return refuse("function-like macro " + id + " in a condition");
+        if (builtinMacros.count(id))
+            return refuse("macro " + id + " in a condition");
+        i += length;
+    }
+    return true;
+}
+
+/* The parser pastes included files into the file, files with #include
+   directives it would resolve are refused */
+bool DirectiveScanner::include(const std::string &operand) {
+    if (operand.empty())
+        return true;
+    const char close = operand[0] == '"' ? '"' : operand[0] == '<' ? '>' : 0;
+    const size_t last = close ? operand.find(close, 1) : std::string::npos;
+    if (last == std::string::npos)
+        return refuse("computed #include");
+
+    namespace fs = boost::filesystem;
+    const fs::path header = operand.substr(1, last - 1);
+    std::list<fs::path> candidates;
+    if (header.is_absolute()) {
+        candidates.push_back(header);
+    } else {
+        candidates.push_back(fs::path(filename).parent_path() / header);
+        candidates.push_back(header);
+        for (const std::string &path : includePaths)
+            candidates.push_back(fs::path(path) / header);
+    }
+    for (const fs::path &candidate : candidates) {
+        boost::system::error_code error;
+        if (fs::is_regular_file(candidate, error))
+            return refuse("#include of " + candidate.string());
+    }
+    return true;
+}
+
+bool DirectiveScanner::refuse(const std::string &reason) {
+    Logging::debug(filename, ":", directiveLine, ": ", reason, ", parsing the file");
+    return false;
+}
@@ -0,0 +1,107 @@
+// -*- mode: c++ -*-
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DIRECTIVE_SCANNER_H
+#define _DIRECTIVE_SCANNER_H
+
+#include "PlainConditionalBlock.h"
+
+#include <list>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+
+/************************************************************************/
+/* DirectiveScanner                                                     */
+/************************************************************************/
+
+/**
+ * \brief extracts the conditional blocks of a file without a preprocessor
+ *
+ * The file is mapped and read once. Only the directives are looked at,
+ * comments, string and character literals and line continuations are
+ * skipped as a C preprocessor does. The blocks get the same numbers,
+ * positions and expressions as the ones of the PumaConditionalBlockBuilder,
+ * including its normalizations: IS_ENABLED(), IS_BUILTIN() and IS_MODULE()
+ * are replaced in conditions and '#define X 0' is taken as '#undef X'.
+ *
+ * Files the scanner can't handle like the parser are refused, they have
+ * to be parsed with Puma:
+ *  - #include directives the parser would resolve, their blocks belong
+ *    to the file then
+ *  - function-like macros of the file, or macros of the preprocessor,
+ *    used in conditions, they would be expanded
+ *  - comments inside of conditions and unbalanced conditionals
+ */
+class DirectiveScanner {
+public:
+    /**
+     * \param includePaths the include paths of the parser, for #include
+     * directives
+     */
+    DirectiveScanner(const std::string &filename, const std::list<std::string> &includePaths);
+
+    /**
+     * \brief scans the blocks and #define directives of the file
+     *
+     * \return false if the file can't be read or has to be parsed, the
+     * reason is logged then and builder is incomplete
+     */
+    bool scan(PlainConditionalBlockBuilder &builder);
+
+private:
+    //! a directive, continuations are removed and comments are blanks
+    struct Line {
+        std::string text;
+        bool commentInside = false;  //!< a comment before other text or over several lines
+    };
+
+    const std::string filename;
+    const std::list<std::string> includePaths;
+
+    const char *pos = nullptr, *end = nullptr;
+    const char *lineBegin = nullptr;
+    unsigned int line = 1;
+    unsigned int directiveLine = 0;
+
+    PlainConditionalBlockBuilder *builder = nullptr;
+    //! the open blocks, as references of the builder (0 is the top block)
+    std::vector<size_t> open;
+    //! the function-like macros the parser would expand
+    std::unordered_set<std::string> functionMacros;
+
+    size_t continuation(const char *p) const;
+    void newline(const char *next);
+    void skipBlockComment();
+    void skipLineComment();
+    void skipLiteral(std::string *text);
+    void readLine(Line &directive);
+
+    bool directive();
+    bool openBlock(PlainConditionalBlock::Kind kind, const std::string &expression,
+                   PlainConditionalBlock::Position start);
+    bool continueBlock(PlainConditionalBlock::Kind kind, const std::string &expression,
+                       PlainConditionalBlock::Position start);
+    bool closeBlock(PlainConditionalBlock::Position start);
+    void define(const std::string &symbol, bool define);
+    bool condition(const Line &directive, size_t at, std::string &expression);
+    bool include(const std::string &operand);
+    bool refuse(const std::string &reason);
+};
+#endif
@@ -109,22 +109,23 @@ TristateRepr ExpressionTranslator::visit_unequal(struct expr *e, TristateRepr le
 TristateRepr ExpressionTranslator::visit_list(struct expr *e) {
     struct TristateRepr res;
 
-    BoolExp *all = nullptr;
-    BoolExp *mod = nullptr;
+    // a choice may have hundreds of entries, the joins don't get as deep
+    std::vector<BoolExp *> all;
+    std::vector<BoolExp *> mod;
     for (struct expr *itnode = e; itnode != nullptr; itnode = itnode->left.expr) {
         struct symbol *yessym = itnode->right.sym;
-        BoolExp *xorExp = nullptr;
+        std::vector<BoolExp *> xorExp;
         for (struct expr *itnode1 = e; itnode1 != nullptr; itnode1 = itnode1->left.expr) {
             struct symbol *cursym = itnode1->right.sym;
             BoolExp *lit = (cursym == yessym) ? B_VAR(cursym, rel_yes)
                                               : &(!*B_VAR(cursym, rel_yes));
-            xorExp = xorExp ? &(*xorExp && *lit) : lit;
+            xorExp.push_back(lit);
         }
-        all = all ? &(*all || *xorExp) : xorExp;
-        mod = mod ? &(*mod || *B_VAR(yessym, rel_mod)) : B_VAR(yessym, rel_mod);
+        all.push_back(joinAnd(xorExp));
+        mod.push_back(B_VAR(yessym, rel_mod));
     }
-    res.yes = all;
-    res.mod = mod;
+    res.yes = joinOr(all);
+    res.mod = joinOr(mod);
     return res;
 }
 
@@ -0,0 +1,97 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Formula.h"
+#include "bool.h"
+#include "BoolExpSymbolSet.h"
+#include "SatCache.h"
+
+#include <sstream>
+
+
+/************************************************************************/
+/* Constraint                                                           */
+/************************************************************************/
+
+Constraint::Constraint(std::string text) : text(std::move(text)) {
+    // model references look like '._.name._.', see ConfigurationModel::doIntersect()
+    const std::string &t = this->text;
+    const std::string::size_type pos = t.find("._.");
+    if (pos == std::string::npos)
+        return;
+    if (pos == 0 && t.size() > 6 && t.compare(t.size() - 3, 3, "._.") == 0
+        && t.find_first_of(" \t\n()!&|") == std::string::npos)
+        modelName = t.substr(3, t.size() - 6);
+    else
+        embeddedModel = true;
+}
+
+Constraint::~Constraint() {
+    delete expression;
+}
+
+kconfig::BoolExp *Constraint::getExpression() const {
+    if (!parsed) {
+        expression = kconfig::BoolExp::parseString(text);
+        parsed = true;
+    }
+    return expression;
+}
+
+const Constraint::Shape &Constraint::getShape() const {
+    if (!shape)
+        shape.reset(new Shape(SatCache::shape(text)));
+    return *shape;
+}
+
+
+/************************************************************************/
+/* Formula                                                              */
+/************************************************************************/
+
+void Formula::push_back(std::string text) {
+    if (text.empty())
+        return;
+    constraints.push_back(std::make_shared<Constraint>(std::move(text)));
+}
+
+void Formula::append(const Formula &other) {
+    constraints.insert(constraints.end(), other.begin(), other.end());
+}
+
+std::string Formula::str(const std::string &separator) const {
+    if (constraints.empty())
+        return "";
+
+    std::stringstream ss;
+    ss << constraints.front()->str();
+    for (auto it = constraints.begin() + 1, e = constraints.end(); it != e; ++it)
+        ss << separator << (*it)->str();
+    return ss.str();
+}
+
+std::set<std::string> Formula::getSymbols() const {
+    std::set<std::string> symbols;
+    for (const ConstraintPtr &constraint : constraints) {
+        if (!constraint->getModelName().empty())
+            continue;
+        kconfig::BoolExpSymbolSet symset(constraint->getExpression());
+        for (const std::string &symbol : symset.getSymbolSet())
+            symbols.insert(symbol);
+    }
+    return symbols;
+}
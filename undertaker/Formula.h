@@ -0,0 +1,158 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// -*- mode: c++ -*-
+#ifndef formula_h__
+#define formula_h__
+
+#include <memory>
+#include <set>
+#include <string>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+namespace kconfig {
+    class BoolExp;
+}
+
+
+/************************************************************************/
+/* Constraint                                                           */
+/************************************************************************/
+
+/**
+ * \brief a conjunct of a formula: its text and the expression it stands for
+ *
+ * The text is parsed the first time the expression is asked for, the
+ * expression is kept as long as the constraint lives. Constraints that
+ * describe a block, a define or a model item are created once and shared
+ * by all formulas they end up in, so each of them is parsed once per run
+ * instead of once per check.
+ *
+ * The expression outlives any BoolExpArena scope, hence it mustn't be
+ * asked for the first time while a scope is open. Its users mustn't
+ * modify it.
+ */
+class Constraint {
+public:
+    explicit Constraint(std::string text);
+    ~Constraint();
+    Constraint(const Constraint &) = delete;
+    Constraint &operator=(const Constraint &) = delete;
+
+    const std::string &str() const { return text; }
+
+    //! the parsed text, nullptr if it isn't a valid formula
+    kconfig::BoolExp *getExpression() const;
+
+    //! the name of the model, if the constraint is a model reference like '._.x86._.'
+    const std::string &getModelName() const { return modelName; }
+
+    //! true if a model reference is part of a longer text, see SatChecker
+    bool embedsModel() const { return embeddedModel; }
+
+    //! what SatCache keys a formula by
+    struct Shape {
+        uint64_t hi, lo;  //!< hash of the normalized text, see SatCache::normalize()
+        //! the block variables of the text, in the order of their first occurrence
+        std::vector<std::string> blocks;
+    };
+
+    //! the shape of the text, computed the first time it is asked for
+    const Shape &getShape() const;
+
+private:
+    const std::string text;
+    std::string modelName;
+    bool embeddedModel = false;
+    mutable bool parsed = false;
+    mutable kconfig::BoolExp *expression = nullptr;
+    mutable std::unique_ptr<Shape> shape;
+};
+
+typedef std::shared_ptr<const Constraint> ConstraintPtr;
+
+
+/************************************************************************/
+/* Formula                                                              */
+/************************************************************************/
+
+/**
+ * \brief a conjunction of constraints
+ *
+ * This is what the analyses hand to the SatChecker: the constraints are
+ * translated one by one, the text of the whole formula is only joined
+ * if it is printed (see str()).
+ */
+class Formula {
+public:
+    typedef std::vector<ConstraintPtr>::const_iterator const_iterator;
+
+    Formula() = default;
+    //! a formula of a single constraint, "" is the empty formula
+    explicit Formula(std::string text) { push_back(std::move(text)); }
+
+    //! appends a new constraint, "" will be ignored like in StringJoiner
+    void push_back(std::string text);
+    void push_back(ConstraintPtr constraint) { constraints.push_back(std::move(constraint)); }
+    //! appends all constraints of the other formula
+    void append(const Formula &other);
+
+    const_iterator begin() const { return constraints.begin(); }
+    const_iterator end() const { return constraints.end(); }
+    size_t size() const { return constraints.size(); }
+    bool empty() const { return constraints.empty(); }
+    void clear() { constraints.clear(); }
+
+    /**
+     * \brief the text of the formula
+     *
+     * The constraints are joined like StringJoiner::join() does.
+     */
+    std::string str(const std::string &separator = "\n&& ") const;
+
+    //! the symbols of all constraints, model references excluded, see itemsOfString()
+    std::set<std::string> getSymbols() const;
+
+private:
+    std::vector<ConstraintPtr> constraints;
+};
+
+/**
+ * \brief Formula that contains each constraint only once
+ *
+ * Constraints are told apart by their identity, shared constraints are
+ * therefore added only once. Like UniqueStringJoiner, this can be turned
+ * off if the caller knows that there are no duplicates.
+ */
+class UniqueFormula : public Formula {
+public:
+    void push_back(std::string text) { Formula::push_back(std::move(text)); }
+    void push_back(ConstraintPtr constraint) {
+        if (uniqueFlag && !seen.insert(constraint.get()).second)
+            return;
+        Formula::push_back(std::move(constraint));
+    }
+    void disableUniqueness() { uniqueFlag = false; }
+
+private:
+    bool uniqueFlag = true;
+    std::unordered_set<const Constraint *> seen;
+};
+
+#endif
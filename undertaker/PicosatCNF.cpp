@@ -26,6 +26,13 @@
 
 #include <fstream>
 #include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace Picosat {
 // include picosat header as C
@@ -37,22 +44,72 @@ namespace Picosat {
 using namespace kconfig;
 
 
-static bool picosatIsInitalized = false;
-static PicosatCNF *currentContext = nullptr;
-
 PicosatCNF::PicosatCNF(Picosat::SATMode defaultPhase) : defaultPhase(defaultPhase) {}
 
-// copy delegate constructor with initializing _picosat and setting default_phase
+PicosatCNF::PicosatCNF(const PicosatCNF &cnf)
+    : names(cnf.names), symboltypes(cnf.symboltypes), cnfvars(cnf.cnfvars),
+      associatedSymbols(cnf.associatedSymbols), boolvars(cnf.boolvars), clauses(cnf.clauses),
+      assumptions(cnf.assumptions), meta_information(cnf.meta_information),
+      defaultPhase(cnf.defaultPhase), varcount(cnf.varcount), clausecount(cnf.clausecount) {}
+
+// copy delegate constructor with setting default_phase
 PicosatCNF::PicosatCNF(const PicosatCNF &cnf, Picosat::SATMode defaultPhase) : PicosatCNF(cnf) {
     this->defaultPhase = defaultPhase;
 }
 
+void PicosatCNF::copySymbols(const PicosatCNF &cnf) {
+    assert(clauses.empty() && layers.empty());
+    names = cnf.names;
+    symboltypes = cnf.symboltypes;
+    cnfvars = cnf.cnfvars;
+    associatedSymbols = cnf.associatedSymbols;
+    boolvars = cnf.boolvars;
+    meta_information = cnf.meta_information;
+    varcount = cnf.varcount;
+}
+
+void PicosatCNF::replaceClauses(const std::vector<int> &newClauses,
+                                const std::vector<int> &mapping, int newVarcount) {
+    assert(layers.empty());
+    if (solver) {
+        Picosat::picosat_set_context(solver);
+        Picosat::picosat_reset();
+        solver = nullptr;
+    }
+    loadedLiterals = 0;
+    freeVars.clear();
+    retiredSelectors.clear();
+    loadedSelectors = 0;
+    freeSelectors.clear();
+    assumptions.clear();
+
+    clauses = newClauses;
+    clausecount = std::count(clauses.begin(), clauses.end(), 0);
+    boolvars.assign(newVarcount + 1, SymbolTable::npos);
+    for (uint32_t id = 0; id < cnfvars.size(); id++) {
+        const int var = abs(cnfvars[id]);
+        if (var == 0)
+            continue;
+        const int mapped = (size_t) var < mapping.size() ? mapping[var] : 0;
+        cnfvars[id] = cnfvars[id] < 0 ? -mapped : mapped;
+        if (mapped != 0)
+            boolvars[mapped] = id;
+    }
+    varcount = newVarcount;
+}
+
 PicosatCNF::~PicosatCNF() {
-    if (this == currentContext) {
-        currentContext = nullptr;
+    if (solver) {
+        Picosat::picosat_set_context(solver);
+        Picosat::picosat_reset();
     }
 }
 
+void PicosatCNF::activateSolver(void) const {
+    // picosat operates on the instance that is current for the calling thread
+    Picosat::picosat_set_context(solver);
+}
+
 void PicosatCNF::readFromFile(const std::string &filename) {
     std::ifstream i(filename);
     if (!i.good()) {
@@ -140,15 +197,13 @@ void PicosatCNF::toStream(std::ostream &out) const {
 
         out << sj.str() << std::endl;
     }
-    for (const auto &entry : this->symboltypes) {  // pair<string, kconfig_symbol_type>
-        const std::string &sym = entry.first;
-        int type = entry.second;
-        out << "c sym " << sym << " " << type << std::endl;
+    for (const uint32_t &id : sortedNames(true)) {
+        int type = symboltypes[id];
+        out << "c sym " << names.c_str(id) << " " << type << std::endl;
     }
-    for (const auto &entry : this->cnfvars) {  // pair<string, int>
-        const std::string &sym = entry.first;
-        int var = entry.second;
-        out << "c var " << sym << " " << var << std::endl;
+    for (const uint32_t &id : sortedNames(false)) {
+        int var = cnfvars[id];
+        out << "c var " << names.c_str(id) << " " << var << std::endl;
     }
     out << "p cnf " << varcount << " " << this->clausecount << std::endl;
 
@@ -158,37 +213,281 @@ void PicosatCNF::toStream(std::ostream &out) const {
     }
 }
 
-kconfig_symbol_type PicosatCNF::getSymbolType(const std::string &name) const {
-    const auto &it = this->symboltypes.find(name); // pair<string, kconfig_symbol_type>
-    return (it == this->symboltypes.end()) ? K_S_UNKNOWN : it->second;
+/* Binary model format, all values in host byte order:
+ *
+ *   BinaryHeader
+ *   int32_t  literals[header.literals]               clauses, each terminated by 0
+ *   header.vars  x { int32_t cnfvar, uint32_t len, char name[len] }
+ *   header.syms  x { int32_t type,   uint32_t len, char name[len] }
+ *   header.metas x { uint32_t count, uint32_t len, char key[len],
+ *                    count x { uint32_t len, char value[len] } }
+ *
+ * The literals directly follow the header, so they are properly aligned
+ * within the mapped file.
+ */
+namespace {
+    const char binaryMagic[8] = {'U', 'T', 'C', 'N', 'F', 'B', 'I', 'N'};
+    const uint32_t binaryVersion = 2;
+    const uint32_t binaryByteOrder = 0x01020304;
+
+    struct BinaryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteorder;
+        //! FNV-1a hash of everything following the header
+        uint64_t checksum;
+        //! size and modification time (in ns) of the text model, 0 if there is none
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        int32_t varcount;
+        int32_t clausecount;
+        uint64_t literals;
+        uint64_t vars;
+        uint64_t syms;
+        uint64_t metas;
+        uint64_t payloadSize;
+    };
+
+    uint64_t fnv1a(const char *data, size_t size) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= (unsigned char) data[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    void putValue(std::string &buf, T value) {
+        buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void putString(std::string &buf, const std::string &str) {
+        putValue<uint32_t>(buf, str.size());
+        buf.append(str);
+    }
+
+    //! bounds checked reading from the mapped payload
+    struct BinaryCursor {
+        const char *pos;
+        const char *end;
+
+        template<typename T>
+        T getValue() {
+            if (end - pos < (ptrdiff_t) sizeof(T))
+                throw IOException("truncated binary CNF file");
+            T value;
+            memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+        std::string getString() {
+            uint32_t len = getValue<uint32_t>();
+            if ((size_t) (end - pos) < len)
+                throw IOException("truncated binary CNF file");
+            std::string str(pos, len);
+            pos += len;
+            return str;
+        }
+    };
+
+    //! stamps the header with the size and modification time of the text model
+    bool statSource(const std::string &source, uint64_t &size, int64_t &time) {
+        struct stat st;
+        if (stat(source.c_str(), &st) != 0)
+            return false;
+        size = st.st_size;
+        time = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    //! read only mapping of a whole file, shared between forked processes
+    struct MappedFile {
+        void *data = MAP_FAILED;
+        size_t size = 0;
+
+        MappedFile(const std::string &filename) {
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw IOException("Could not open binary CNF-File");
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                size = st.st_size;
+                data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            close(fd);
+            if (data == MAP_FAILED)
+                throw IOException("Could not map binary CNF-File");
+        }
+        ~MappedFile() {
+            munmap(data, size);
+        }
+    };
+}
+
+std::string PicosatCNF::binaryFileName(const std::string &filename) {
+    return filename + ".bin";
+}
+
+void PicosatCNF::readFromBinaryFile(const std::string &filename, const std::string &source) {
+    MappedFile file(filename);
+    const char *data = static_cast<const char *>(file.data);
+
+    BinaryHeader header;
+    if (file.size < sizeof(header))
+        throw IOException("truncated binary CNF file");
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0)
+        throw IOException("not a binary CNF file");
+    if (header.version != binaryVersion || header.byteorder != binaryByteOrder)
+        throw IOException("unsupported binary CNF file version");
+    if (source != "") {
+        uint64_t size;
+        int64_t time;
+        if (!statSource(source, size, time) || header.sourceSize != size
+            || header.sourceTime != time)
+            throw IOException("binary CNF file wasn't written from " + source);
+    }
+    if (header.payloadSize != file.size - sizeof(header))
+        throw IOException("truncated binary CNF file");
+    if (header.checksum != fnv1a(data + sizeof(header), header.payloadSize))
+        throw IOException("checksum mismatch in binary CNF file");
+    if (header.literals > header.payloadSize / sizeof(int))
+        throw IOException("truncated binary CNF file");
+
+    BinaryCursor cursor = {data + sizeof(header), data + file.size};
+
+    const int *literals = reinterpret_cast<const int *>(cursor.pos);
+    clauses.insert(clauses.end(), literals, literals + header.literals);
+    cursor.pos += header.literals * sizeof(int);
+
+    names.reserve(header.vars + 3 * header.syms, header.payloadSize);
+    for (uint64_t n = 0; n < header.vars; n++) {
+        int var = cursor.getValue<int32_t>();
+        setCNFVar(cursor.getString(), var);
+    }
+    for (uint64_t n = 0; n < header.syms; n++) {
+        kconfig_symbol_type type = (kconfig_symbol_type) cursor.getValue<int32_t>();
+        setSymbolType(cursor.getString(), type);
+    }
+    for (uint64_t n = 0; n < header.metas; n++) {
+        uint32_t count = cursor.getValue<uint32_t>();
+        std::deque<std::string> &values = meta_information[cursor.getString()];
+        for (uint32_t v = 0; v < count; v++)
+            values.push_back(cursor.getString());
+    }
+    varcount = std::max(varcount, (int) header.varcount);
+    clausecount += header.clausecount;
+}
+
+// XXX do not modify the output format without adjusting: readFromBinaryFile
+void PicosatCNF::toBinaryFile(const std::string &filename, const std::string &source) const {
+    std::string payload;
+    const std::vector<uint32_t> vars = sortedNames(false), syms = sortedNames(true);
+    payload.reserve(clauses.size() * sizeof(int) + names.size() * 32);
+    payload.append(reinterpret_cast<const char *>(clauses.data()), clauses.size() * sizeof(int));
+
+    for (const uint32_t &id : vars) {
+        putValue<int32_t>(payload, cnfvars[id]);
+        putString(payload, names.get(id).str());
+    }
+    for (const uint32_t &id : syms) {
+        putValue<int32_t>(payload, symboltypes[id]);
+        putString(payload, names.get(id).str());
+    }
+    for (const auto &entry : meta_information) {  // pair<string, deque<string>>
+        putValue<uint32_t>(payload, entry.second.size());
+        putString(payload, entry.first);
+        for (const std::string &str : entry.second)
+            putString(payload, str);
+    }
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    header.version = binaryVersion;
+    header.byteorder = binaryByteOrder;
+    header.checksum = fnv1a(payload.data(), payload.size());
+    if (source != "" && !statSource(source, header.sourceSize, header.sourceTime))
+        Logging::warn("Couldn't stat ", source, ", the binary model won't be used");
+    header.varcount = varcount;
+    header.clausecount = clausecount;
+    header.literals = clauses.size();
+    header.vars = vars.size();
+    header.syms = syms.size();
+    header.metas = meta_information.size();
+    header.payloadSize = payload.size();
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(payload.data(), payload.size());
+    if (!out.good())
+        Logging::error("Couldn't write to ", filename);
+}
+
+uint32_t PicosatCNF::internName(StringRef name) {
+    uint32_t id = names.intern(name);
+    if (id == cnfvars.size()) {
+        symboltypes.push_back(-1);
+        cnfvars.push_back(0);
+        associatedSymbols.push_back(SymbolTable::npos);
+    }
+    return id;
+}
+
+std::vector<uint32_t> PicosatCNF::sortedNames(bool symbols) const {
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 0; id < names.size(); id++)
+        if (symbols ? symboltypes[id] >= 0 : cnfvars[id] != 0)
+            ids.push_back(id);
+    std::sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+        return strcmp(names.c_str(a), names.c_str(b)) < 0;
+    });
+    return ids;
+}
+
+kconfig_symbol_type PicosatCNF::getSymbolType(StringRef name) const {
+    uint32_t id = names.find(name);
+    if (id == SymbolTable::npos || symboltypes[id] < 0)
+        return K_S_UNKNOWN;
+    return (kconfig_symbol_type) symboltypes[id];
 }
 
 void PicosatCNF::setSymbolType(const std::string &sym, kconfig_symbol_type type) {
-    std::string config_sym = "CONFIG_" + sym;
-    this->associatedSymbols[config_sym] = sym;
+    uint32_t id = internName(sym);
+    uint32_t config_sym = internName("CONFIG_" + sym);
+    this->associatedSymbols[config_sym] = id;
 
     if (type == K_S_TRISTATE) {
-        std::string config_sym_mod = "CONFIG_" + sym + "_MODULE";
-        this->associatedSymbols[config_sym_mod] = sym;
+        uint32_t config_sym_mod = internName("CONFIG_" + sym + "_MODULE");
+        this->associatedSymbols[config_sym_mod] = id;
     }
-    this->symboltypes[sym] = type;
+    this->symboltypes[id] = type;
 }
 
-int PicosatCNF::getCNFVar(const std::string &var) const {
-    const auto &it = this->cnfvars.find(var); // pair<string, int>
-    return (it == this->cnfvars.end()) ? 0 : it->second;
+int PicosatCNF::getCNFVar(StringRef var) const {
+    uint32_t id = names.find(var);
+    return (id == SymbolTable::npos) ? 0 : cnfvars[id];
 }
 
-void PicosatCNF::setCNFVar(const std::string &var, int CNFVar) {
+void PicosatCNF::setCNFVar(StringRef var, int CNFVar) {
     if (abs(CNFVar) > this->varcount) {
         this->varcount = abs(CNFVar);
     }
-    this->cnfvars[var] = CNFVar;
-    this->boolvars[CNFVar] = var;
+    uint32_t id = internName(var);
+    if (!layers.empty() && this->cnfvars[id] == 0)
+        layers.back().names.push_back(id);
+    this->cnfvars[id] = CNFVar;
+    if ((size_t) abs(CNFVar) >= boolvars.size())
+        boolvars.resize(abs(CNFVar) + 1, SymbolTable::npos);
+    this->boolvars[abs(CNFVar)] = id;
 }
 
-std::string &PicosatCNF::getSymbolName(int CNFVar) {
-    return this->boolvars[CNFVar];
+std::string PicosatCNF::getSymbolName(int CNFVar) const {
+    if ((size_t) CNFVar >= boolvars.size() || boolvars[CNFVar] == SymbolTable::npos)
+        return "";
+    return names.get(boolvars[CNFVar]).str();
 }
 
 void PicosatCNF::pushVar(int v) {
@@ -196,7 +495,8 @@ void PicosatCNF::pushVar(int v) {
         this->varcount = abs(v);
     }
     if (v == 0) {
-        this->clausecount++;
+        this->pushClause();
+        return;
     }
     clauses.push_back(v);
 }
@@ -208,6 +508,8 @@ void PicosatCNF::pushVar(std::string &v, bool val) {
 }
 
 void PicosatCNF::pushClause(void) {
+    if (!layers.empty())
+        clauses.push_back(-layers.back().selector);
     this->clausecount++;
     clauses.push_back(0);
 }
@@ -238,28 +540,54 @@ void PicosatCNF::pushAssumption(const std::string &v, bool val) {
 }
 
 bool PicosatCNF::checkSatisfiable(void) {
-    // make sure the current data is stored within picosat
-    if (this != currentContext){
-        // if not, reset the context....
-        if (picosatIsInitalized) {
-            Picosat::picosat_reset();
-        }
+    if (solver && 2 * retiredSelectors.size() > (size_t) varcount) {
+        // the retired clauses are dead weight, the active ones are reloaded below
+        activateSolver();
+        Picosat::picosat_reset();
+        solver = nullptr;
+        loadedLiterals = 0;
+        freeSelectors.insert(freeSelectors.end(), retiredSelectors.begin(),
+                             retiredSelectors.end());
+        retiredSelectors.clear();
+        loadedSelectors = 0;
+    }
+    if (!solver) {
         Picosat::picosat_init();
-        picosatIsInitalized = true;
-        // and load the current context
-        currentContext = this;
-        Picosat::picosat_set_global_default_phase(defaultPhase);
-        // tell picosat how many different variables it will receive
-        Picosat::picosat_adjust(varcount);
-
-        for (const int &clause : clauses)
-            Picosat::picosat_add(clause);
+        solver = Picosat::picosat_context();
+    } else {
+        activateSolver();
+    }
+    Picosat::picosat_set_global_default_phase(defaultPhase);
+    // tell picosat how many different variables it will receive
+    Picosat::picosat_adjust(varcount);
+
+    // permanently disable the clauses of popped layers
+    for (; loadedSelectors < retiredSelectors.size(); loadedSelectors++) {
+        Picosat::picosat_add(-retiredSelectors[loadedSelectors]);
+        Picosat::picosat_add(0);
     }
+
+    // make sure all finished clauses are stored within picosat, the solver
+    // already knows everything up to 'loadedLiterals' from previous calls
+    auto lastClauseEnd = std::find(clauses.rbegin(), clauses.rend(), 0).base();
+    for (auto it = clauses.begin() + loadedLiterals; it < lastClauseEnd; ++it)
+        Picosat::picosat_add(*it);
+    loadedLiterals = lastClauseEnd - clauses.begin();
+
+    for (const int &lit : preferred)
+        Picosat::picosat_set_default_phase_lit(lit, 1);
     for (const int &assumption : assumptions)
         Picosat::picosat_assume(assumption);
+    for (const Layer &layer : layers)
+        Picosat::picosat_assume(layer.selector);
 
     assumptions.clear();
-    return Picosat::picosat_sat(-1) == PICOSAT_SATISFIABLE;
+    const bool satisfiable = Picosat::picosat_sat(-1) == PICOSAT_SATISFIABLE;
+    // preferences are phases of the solver, they would outlive the check
+    for (const int &lit : preferred)
+        Picosat::picosat_set_default_phase_lit(lit, 0);
+    preferred.clear();
+    return satisfiable;
 }
 
 void PicosatCNF::pushAssumptions(std::map<std::string, bool> &a) {
@@ -271,6 +599,9 @@ void PicosatCNF::pushAssumptions(std::map<std::string, bool> &a) {
 }
 
 bool PicosatCNF::deref(int s) const {
+    if (!solver)
+        return false;
+    activateSolver();
     return Picosat::picosat_deref(s) == 1;
 }
 
@@ -284,16 +615,29 @@ bool PicosatCNF::deref(const char *c) const {
     return this->deref(cnfvar);
 }
 
-const std::string *PicosatCNF::getAssociatedSymbol(const std::string &var) const {
-    const auto &it = this->associatedSymbols.find(var); // pair<string, string>
-    return (it == this->associatedSymbols.end()) ? nullptr : &(it->second);
+int PicosatCNF::derefToplevel(int s) const {
+    if (!solver)
+        return 0;
+    activateSolver();
+    return Picosat::picosat_deref_toplevel(s);
+}
+
+const char *PicosatCNF::getAssociatedSymbol(StringRef var) const {
+    uint32_t id = names.find(var);
+    if (id == SymbolTable::npos || associatedSymbols[id] == SymbolTable::npos)
+        return nullptr;
+    return names.c_str(associatedSymbols[id]);
 }
 
 const int *PicosatCNF::failedAssumptions(void) const {
+    activateSolver();
     return Picosat::picosat_failed_assumptions();
 }
 
 void PicosatCNF::addMetaValue(const std::string &key, const std::string &value) {
+    // meta information describes the persistent formula, not retractable clauses
+    if (!layers.empty())
+        return;
     std::deque<std::string> &values = meta_information[key];
     if (std::find(values.begin(), values.end(), value) == values.end())
         // value wasn't found within values, add it
@@ -308,6 +652,51 @@ const std::deque<std::string> *PicosatCNF::getMetaValue(const std::string &key)
 }
 
 int PicosatCNF::newVar(void) {
-    varcount++;
-    return varcount;
+    if (layers.empty()) {
+        varcount++;
+        return varcount;
+    }
+    int v;
+    if (freeVars.empty()) {
+        v = ++varcount;
+    } else {
+        v = freeVars.back();
+        freeVars.pop_back();
+    }
+    layers.back().vars.push_back(v);
+    return v;
+}
+
+void PicosatCNF::pushLayer(void) {
+    int selector;
+    if (freeSelectors.empty()) {
+        selector = ++varcount;
+    } else {
+        selector = freeSelectors.back();
+        freeSelectors.pop_back();
+    }
+    layers.push_back({selector, clauses.size(), clausecount, {}, {}});
+}
+
+void PicosatCNF::popLayer(void) {
+    assert(!layers.empty());
+    Layer &layer = layers.back();
+
+    if (loadedLiterals > layer.clauseStart) {
+        // the solver already knows (some of) the clauses of this layer
+        retiredSelectors.push_back(layer.selector);
+        loadedLiterals = layer.clauseStart;
+    } else {
+        freeSelectors.push_back(layer.selector);
+    }
+    clauses.resize(layer.clauseStart);
+    clausecount = layer.clauseCount;
+
+    // the names stay interned, they are likely to be used by the next layer again
+    for (const uint32_t &id : layer.names) {
+        boolvars[abs(cnfvars[id])] = SymbolTable::npos;
+        cnfvars[id] = 0;
+    }
+    freeVars.insert(freeVars.end(), layer.vars.begin(), layer.vars.end());
+    layers.pop_back();
 }
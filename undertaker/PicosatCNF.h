@@ -25,6 +25,7 @@
 #define KCONFIG_PICOSATCNF_H
 
 #include "Kconfig.h"
+#include "SymbolTable.h"
 
 #include <vector>
 #include <map>
@@ -44,44 +45,111 @@ namespace Picosat {
 
 namespace kconfig {
     class PicosatCNF {
-        //! this map contains the the type of each Kconfig symbol
-        std::map<std::string, kconfig_symbol_type> symboltypes;
+        /** all variable and symbol names of this cnf.
+            The following vectors are indexed by the ids of this table and
+            grow together with it, see internName() **/
+        SymbolTable names;
+        //! the type of each Kconfig symbol, -1 if the name is no symbol
+        std::vector<signed char> symboltypes;
 
         /**
         * \brief mapping between boolean variable names and their cnf-id
-        *  Keep in sync with "booleanvars"
+        *  0 if the name isn't a variable. Keep in sync with "boolvars"
         */
-        std::map<std::string, int> cnfvars;
+        std::vector<int> cnfvars;
         /** mapping between the names of boolean variables and symbols
             Some boolean variable represent model symbols. if so, the have
-            to be stored in this map.
+            to be stored in this table.
             Example:
             { "CONFIG_FOO"  -> "FOO", "CONFIG_FOO_MODULE" -> "FOO" }
         **/
-        std::map<std::string, std::string> associatedSymbols;
-        /** contains the variable name for cnf-id.
-            Not all cnf-id will have a name. Must kept in sync with "symboltypes"
+        std::vector<uint32_t> associatedSymbols;
+        /** contains the name id for cnf-id.
+            Not all cnf-id will have a name, these are SymbolTable::npos
         **/
-        std::map<int, std::string> boolvars;
+        std::vector<uint32_t> boolvars;
         std::vector<int> clauses;
         std::vector<int> assumptions;
+        //! literals the next check tries first, see preferLiteral()
+        std::vector<int> preferred;
         std::map<std::string, std::deque<std::string>> meta_information;
         Picosat::SATMode defaultPhase;
         int varcount = 0;
         int clausecount = 0;
+        /** the picosat instance owned by this cnf. It is created on the first
+            call to checkSatisfiable and keeps all clauses loaded until this
+            object is destroyed, thus switching between several cnfs (or
+            threads) never requires to reload a formula. **/
+        void *solver = nullptr;
+        //! number of entries in "clauses" that have already been passed to "solver"
+        size_t loadedLiterals = 0;
+
+        /** a retractable set of clauses, see pushLayer() **/
+        struct Layer {
+            int selector;
+            size_t clauseStart;
+            int clauseCount;
+            //! variables created while this layer was the innermost one
+            std::vector<int> vars;
+            //! variable names registered while this layer was the innermost one
+            std::vector<uint32_t> names;
+        };
+        std::vector<Layer> layers;
+        //! variables of popped layers, they don't occur in any active clause anymore
+        std::vector<int> freeVars;
+        /** selectors of popped layers that are fixed to false within "solver",
+            the first 'loadedSelectors' of them have already been passed to it.
+            They can't be used again before the solver is rebuilt. **/
+        std::vector<int> retiredSelectors;
+        size_t loadedSelectors = 0;
+        //! selectors that don't occur in any clause of "solver"
+        std::vector<int> freeSelectors;
+
+        void activateSolver(void) const;
+        uint32_t internName(StringRef name);
+        //! returns the ids of all names that are variables or symbols in lexical order
+        std::vector<uint32_t> sortedNames(bool symbols) const;
     public:
         PicosatCNF(Picosat::SATMode = Picosat::SAT_MIN);
+        //! copies the formula and all symbol information, but not the solver state
+        PicosatCNF(const PicosatCNF &);
         PicosatCNF(const PicosatCNF &, Picosat::SATMode);
         ~PicosatCNF();
+        /** copies all names, symbol types and meta information of the given
+            cnf, but none of its clauses. Only allowed on an empty cnf, the
+            variables keep their cnf-ids (see CNFSlicer) **/
+        void copySymbols(const PicosatCNF &);
+        /** replaces all clauses by the given, 0 terminated ones and renumbers
+            the variables: mapping[v] is the new cnf-id of the old variable v.
+            Names of variables mapped to 0 are dropped. Not allowed within a
+            layer, the solver is reset (see CNFPreprocessor) **/
+        void replaceClauses(const std::vector<int> &clauses, const std::vector<int> &mapping,
+                            int varcount);
+        PicosatCNF &operator=(const PicosatCNF &) = delete;
         void readFromFile(const std::string &filename);
         void readFromStream(std::istream &i);
         void toFile(const std::string &filename) const;
         void toStream(std::ostream &out) const;
-        kconfig_symbol_type getSymbolType(const std::string &name) const;
+        /** reads a model written by toBinaryFile.
+            The file is mapped into memory, the clauses are copied in one
+            piece and the symbol tables are taken over without parsing.
+            If a source is given, the binary model has to be written from
+            this text model: its size and modification time have to match
+            the ones recorded by toBinaryFile.
+            @throws IOException if the file is missing, truncated, has an
+            unsupported version, a wrong checksum or doesn't match the source **/
+        void readFromBinaryFile(const std::string &filename, const std::string &source = "");
+        /** writes the model in binary format, source is the text model
+            written before (see readFromBinaryFile) **/
+        void toBinaryFile(const std::string &filename, const std::string &source = "") const;
+        //! name of the binary model that accompanies the given text model
+        static std::string binaryFileName(const std::string &filename);
+        kconfig_symbol_type getSymbolType(StringRef name) const;
         void setSymbolType(const std::string &sym, kconfig_symbol_type type);
-        int getCNFVar(const std::string &var) const;
-        void setCNFVar(const std::string &var, int CNFVar);
-        std::string &getSymbolName(int CNFVar);
+        int getCNFVar(StringRef var) const;
+        void setCNFVar(StringRef var, int CNFVar);
+        //! returns the name of the given cnf-id, an empty string if it has none
+        std::string getSymbolName(int CNFVar) const;
         void pushVar(int v);
         void pushVar(std::string  &v, bool val);
         void pushClause(void);
@@ -100,14 +168,49 @@ namespace kconfig {
         bool deref(int s) const;
         bool deref(const std::string &s) const;
         bool deref(const char *s) const;
+        /** returns 1 (-1) if the cnf-id s is fixed to true (false) by the
+            clauses alone, independent of any assumption, 0 otherwise **/
+        int derefToplevel(int s) const;
         int getVarCount(void) const { return varcount; }
         int getClauseCount(void) const { return clausecount; }
         const std::vector<int> &getClauses(void) const { return clauses; }
         int newVar(void);
-        const std::string *getAssociatedSymbol(const std::string &var) const;
-        const std::map<std::string, int> &getSymbolMap() const { return cnfvars; }
+        //! returns nullptr if var doesn't belong to a symbol
+        const char *getAssociatedSymbol(StringRef var) const;
+        const SymbolTable &getNames() const { return names; }
+        //! returns the cnf-id of the name with the given id, 0 if it isn't a variable
+        int getCNFVarById(uint32_t id) const { return cnfvars[id]; }
+        /** calls f(StringRef name, int cnfvar) for every named variable **/
+        template<typename F>
+        void forEachSymbol(F f) const {
+            for (uint32_t id = 0; id < cnfvars.size(); id++)
+                if (cnfvars[id] != 0)
+                    f(names.get(id), cnfvars[id]);
+        }
         const std::deque<std::string> *getMetaValue(const std::string &key) const;
         void addMetaValue(const std::string &key, const std::string &value);
+        void setDefaultPhase(Picosat::SATMode mode) { defaultPhase = mode; }
+        /** the next checkSatisfiable() sets the variable of lit to the value
+            that satisfies lit whenever it decides on it, instead of using
+            the default phase. Like assumptions, this only holds for one
+            check: afterwards the variable is decided by the default phase
+            again, even on a solver that is shared with other checkers **/
+        void preferLiteral(int lit) { preferred.push_back(lit); }
+
+        /** opens a new layer of retractable clauses.
+            Every clause pushed until the matching popLayer() is guarded by
+            a selector variable, which is assumed in checkSatisfiable.
+            Layers nest and have to be closed in reverse order. **/
+        void pushLayer(void);
+        /** retracts all clauses of the innermost layer.
+            Variables and names that were introduced within the layer are
+            forgotten and the variables are reused by subsequent layers.
+            The selector of a layer whose clauses were passed to the solver
+            is fixed to false instead. Once these make up more than half of
+            the variables, the next check rebuilds the solver and they are
+            reused as well. Thus a long living cnf can answer any number of
+            queries without growing. **/
+        void popLayer(void);
     };
 }
 #endif
@@ -0,0 +1,84 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PlainConditionalBlock.h"
+
+
+/************************************************************************/
+/* PlainConditionalBlock                                                */
+/************************************************************************/
+
+const std::string PlainConditionalBlock::getName() const {
+    if (!_parent)
+        return "B00"; // top level block, represents file
+
+    std::string s("B");
+    s += std::to_string(_number);
+    if (useBlockWithFilename)
+        // get the normalized file variable without "FILE" prefix and append to the block name
+        s += &fileVar()[4];
+    return s;
+}
+
+ConditionalBlock *PlainConditionalBlock::createDummyElseBlock(ConditionalBlock *parent,
+                                                              ConditionalBlock *prev) {
+    // all blocks of the file are numbered in order, the new one is the next
+    auto block = new PlainConditionalBlock(cpp_file, parent, prev, Kind::ELSE, cpp_file->size(),
+                                           "", {0, 0}, {0, 0});
+    block->setDummyBlock();
+    return block;
+}
+
+PlainConditionalBlock::Kind PlainConditionalBlock::kindOf(const ConditionalBlock *block) {
+    if (!block->getParent())
+        return Kind::TOP;
+    if (block->isIfndefine())
+        return Kind::IFNDEF;
+    if (block->isElseIfBlock())
+        return Kind::ELIF;
+    if (block->isElseBlock())
+        return Kind::ELSE;
+    return Kind::IF;
+}
+
+
+/************************************************************************/
+/* PlainConditionalBlockBuilder                                         */
+/************************************************************************/
+
+ConditionalBlock *PlainConditionalBlockBuilder::build(CppFile *file) const {
+    std::vector<ConditionalBlock *> built;
+    built.reserve(blocks.size() + 1);
+    built.push_back(new PlainConditionalBlock(file, nullptr, nullptr,
+                                              PlainConditionalBlock::Kind::TOP, 0, "",
+                                              {0, 0}, {0, 0}));
+    auto define = defines.begin();
+    for (size_t i = 0; i <= blocks.size(); i++) {
+        for (; define != defines.end() && define->blocks == i; ++define)
+            file->addDefine(built[define->block], define->define, define->symbol);
+        if (i == blocks.size())
+            break;
+        const Block &b = blocks[i];
+        ConditionalBlock *parent = built[b.parent];
+        auto block = new PlainConditionalBlock(file, parent, b.prev ? built[b.prev] : nullptr,
+                                               b.kind, i, b.expression, b.start, b.end);
+        built.push_back(block);
+        file->push_back(block);
+        parent->push_back(block);
+    }
+    return built[0];
+}
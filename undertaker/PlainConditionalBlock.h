@@ -0,0 +1,135 @@
+// -*- mode: c++ -*-
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PLAIN_CONDITIONAL_BLOCK_H
+#define _PLAIN_CONDITIONAL_BLOCK_H
+
+#include "ConditionalBlock.h"
+
+#include <vector>
+
+
+/************************************************************************/
+/* PlainConditionalBlock                                                */
+/************************************************************************/
+
+/**
+ * \brief a block that keeps all of its properties as plain values
+ *
+ * Unlike PumaConditionalBlock, it doesn't refer to the tree of a parser,
+ * the expression is the one after macro expansion. Blocks of this kind
+ * are restored from a CppFileCache or built by the DirectiveScanner.
+ */
+class PlainConditionalBlock : public ConditionalBlock {
+public:
+    //! the directive that opens the block
+    enum class Kind : unsigned char { TOP, IF, IFNDEF, ELIF, ELSE };
+
+    struct Position {
+        unsigned int line, column;
+    };
+
+    /**
+     * \param number the number in the name of the block ("B<number>")
+     * \param expression the expression after macro expansion, empty for #else
+     */
+    PlainConditionalBlock(CppFile *file, ConditionalBlock *parent, ConditionalBlock *prev,
+                          Kind kind, unsigned long number, const std::string &expression,
+                          Position start, Position end)
+        : ConditionalBlock(file, parent, prev), _kind(kind), _number(number),
+          _expression(expression), _start(start), _end(end) {
+        lateConstructor();
+    }
+
+    //! location related accessors
+    virtual unsigned int lineStart()     const final override { return _start.line; }
+    virtual unsigned int colStart()      const final override { return _start.column; }
+    virtual unsigned int lineEnd()       const final override { return _end.line; }
+    virtual unsigned int colEnd()        const final override { return _end.column; }
+    /// @}
+
+    //! \return expression after macro expansion
+    virtual const char * ExpressionStr() const final override { return _expression.c_str(); }
+    virtual bool isIfBlock()             const final override {
+        return _kind == Kind::TOP || _kind == Kind::IF || _kind == Kind::IFNDEF;
+    }
+    virtual bool isIfndefine()           const final override { return _kind == Kind::IFNDEF; }
+    virtual bool isElseIfBlock()         const final override { return _kind == Kind::ELIF; }
+    virtual bool isElseBlock()           const final override { return _kind == Kind::ELSE; }
+    virtual bool isDummyBlock()          const final override { return _isDummyBlock; }
+    virtual void setDummyBlock()               final override { _isDummyBlock = true; }
+    virtual const std::string getName()  const final override;
+    virtual ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                                   ConditionalBlock *prev) final override;
+
+    Kind getKind() const { return _kind; }
+    unsigned long getNumber() const { return _number; }
+
+    //! the kind of any block, from its properties
+    static Kind kindOf(const ConditionalBlock *block);
+
+private:
+    const Kind _kind;
+    const unsigned long _number;
+    const std::string _expression;
+    const Position _start, _end;
+    bool _isDummyBlock = false;
+};
+
+
+/************************************************************************/
+/* PlainConditionalBlockBuilder                                         */
+/************************************************************************/
+
+/**
+ * \brief the blocks and #define directives of a file, in the order of
+ * the file, from which the file is built as PlainConditionalBlocks
+ *
+ * Blocks refer to their parents and predecessors by their index plus
+ * one, 0 is the top block (or no predecessor).
+ */
+class PlainConditionalBlockBuilder {
+public:
+    struct Block {
+        PlainConditionalBlock::Kind kind;
+        size_t parent, prev;
+        PlainConditionalBlock::Position start, end;
+        std::string expression;
+    };
+
+    struct Define {
+        size_t blocks;  //!< number of blocks before the directive
+        size_t block;   //!< the block the directive is in
+        bool define;    //!< false for #undef
+        std::string symbol;
+    };
+
+    std::vector<Block> blocks;
+    std::vector<Define> defines;
+
+    /**
+     * \brief adds the blocks and defines to file
+     *
+     * The defines before a block rewrite its expression in
+     * lateConstructor(), as they do while parsing. The references have
+     * to be valid (see CppFileCache::load()).
+     * \return the top block
+     */
+    ConditionalBlock *build(CppFile *file) const;
+};
+#endif
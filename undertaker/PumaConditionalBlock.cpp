@@ -136,6 +136,22 @@ const std::string PumaConditionalBlock::getName() const {
     }
 }
 
+ConditionalBlock *PumaConditionalBlock::createDummyElseBlock(ConditionalBlock *parent,
+                                                             ConditionalBlock *prev) {
+    auto tok = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "#else");
+    auto ptok = new Puma::PreTreeToken(tok);
+
+    auto tok2 = new Puma::Token(TOK_PRE_ELSE, Puma::Token::pre_id, "");
+    auto ptok2 = new Puma::PreTreeToken(tok2);
+
+    auto node = new Puma::PreElseDirective(ptok, ptok2);
+    unsigned long *nodeNum = _builder.getNodeNum();
+
+    auto newBlock = new PumaConditionalBlock(cpp_file, parent, prev, node, (*nodeNum)++, _builder);
+    newBlock->setDummyBlock();
+    return newBlock;
+}
+
 bool PumaConditionalBlock::isIfndefine() const {
     return dynamic_cast<const PreIfndefDirective *>(_current_node) != nullptr;
 }
@@ -325,18 +341,7 @@ void PumaConditionalBlockBuilder::visitDefineHelper(PreTreeComposite *node, bool
     if (cpp_parser()->macroManager()->getMacro(definedDFlag) != nullptr)
         return;
 
-    PumaConditionalBlock &block = *_condBlockStack.top();
-
-    CppFile::DefineMap &map = *_file->getDefines();
-    auto i = map.find(definedFlag);
-
-    if (i == map.end())
-        // First define for this item
-        map[definedFlag] = new CppDefine(&block, define, definedFlag);
-    else
-        (*i).second->newDefine(&block, define);
-
-    block.addDefine(map[definedFlag]);
+    _file->addDefine(_condBlockStack.top(), define, definedFlag);
 }
 
 void PumaConditionalBlockBuilder::visitPreDefineConstantDirective_Pre (Puma::PreDefineConstantDirective *node){
@@ -625,6 +630,7 @@ void PumaConditionalBlockBuilder::resolve_includes(Puma::Unit *unit) {
                 removeIncludeGuard(file);
                 mc.paste_before(s, file);
                 already_seen.insert(file);
+                _includedFiles.push_back(file->name());
             }
             mc.kill(s, e);
             mc.commit();
@@ -78,16 +78,16 @@ public:
 
     //! location related accessors
     virtual unsigned int lineStart()     const final override {
-        return getParent() ? _start->location().line() : 0;
+        return getParent() && _start ? _start->location().line() : 0;
     };
     virtual unsigned int colStart()      const final override {
-        return getParent() ? _start->location().column() : 0;
+        return getParent() && _start ? _start->location().column() : 0;
     };
     virtual unsigned int lineEnd()       const final override {
-        return getParent() ? _end  ->location().line() : 0;
+        return getParent() && _end ? _end  ->location().line() : 0;
     };
     virtual unsigned int colEnd()        const final override {
-        return getParent() ? _end  ->location().column() : 0;
+        return getParent() && _end ? _end  ->location().column() : 0;
     };
     /// @}
 
@@ -106,6 +106,8 @@ public:
     virtual bool isDummyBlock()          const final override { return _isDummyBlock; }
     virtual void setDummyBlock()               final override { _isDummyBlock = true; }
     virtual const std::string getName()  const final override;
+    virtual ConditionalBlock *createDummyElseBlock(ConditionalBlock *parent,
+                                                   ConditionalBlock *prev) final override;
     PumaConditionalBlockBuilder &getBuilder() const { return _builder; }
 
     friend class PumaConditionalBlockBuilder;
@@ -135,6 +137,8 @@ class PumaConditionalBlockBuilder : public Puma::PreVisitor {
     Puma::Unit *_unit; // the unit we are working on
 
     static std::list<std::string> _includePaths;
+    // the files that were pasted for #include directives
+    std::list<std::string> _includedFiles;
 
     void visitDefineHelper(Puma::PreTreeComposite *node, bool define);
     void resolve_includes(Puma::Unit *);
@@ -167,6 +171,8 @@ public:
     virtual void visitPreUndefDirective_Pre (Puma::PreUndefDirective *)   final override;
 
     unsigned long * getNodeNum() { return &_nodeNum; }
+    const std::list<std::string> &getIncludedFiles() const { return _includedFiles; }
     static void addIncludePath(const char *);
+    static const std::list<std::string> &getIncludePaths() { return _includePaths; }
 };
 #endif
@@ -25,7 +25,6 @@
 
 #include "RsfConfigurationModel.h"
 #include "Tools.h"
-#include "StringJoiner.h"
 #include "RsfReader.h"
 #include "Logging.h"
 
@@ -116,36 +115,49 @@ std::set<std::string> RsfConfigurationModel::findSetOfInterestingItems(const std
         result.insert(str);
     }
     while (!workingStack.empty()) {
-        const std::string *item = _model->getValue(workingStack.top());
+        const std::set<std::string> &symbols = getDependencySymbols(workingStack.top());
         workingStack.pop();
-        if (item != nullptr && item->compare("") != 0) {
-            for (const std::string &str : undertaker::itemsOfString(*item)) {
-                /* Item already seen? continue */
-                if (result.count(str) == 0) {
-                    workingStack.push(str);
-                    result.insert(str);
-                }
-            }
+        for (const std::string &str : symbols) {
+            /* Item already seen? continue */
+            if (result.insert(str).second)
+                workingStack.push(str);
         }
     }
     return result;
 }
 
+const std::set<std::string> &
+RsfConfigurationModel::getDependencySymbols(const std::string &item) const {
+    // each dependency is scanned once per run, not once per intersection
+    auto it = dependencySymbols.find(item);
+    if (it == dependencySymbols.end()) {
+        const std::string *dependency = _model->getValue(item);
+        std::set<std::string> symbols;
+        if (dependency != nullptr && dependency->compare("") != 0)
+            symbols = undertaker::itemsOfString(*dependency);
+        it = dependencySymbols.emplace(item, std::move(symbols)).first;
+    }
+    return it->second;
+}
+
 int RsfConfigurationModel::doIntersect(const std::string exp,
                                     const ConfigurationModel::Checker *c,
                                     std::set<std::string> &missing,
                                     std::string &intersected) const {
     const std::set<std::string> start_items = undertaker::itemsOfString(exp);
-    return doIntersect(start_items, c, missing, intersected);
+    Formula formula;
+    int valid_items = doIntersect(start_items, c, missing, formula);
+    intersected = formula.str();
+    return valid_items;
 }
 
 
 int RsfConfigurationModel::doIntersect(const std::set<std::string> start_items,
                                     const ConfigurationModel::Checker *c,
                                     std::set<std::string> &missing,
-                                    std::string &intersected) const {
+                                    Formula &intersected) const {
     int valid_items = 0;
-    StringJoiner sj;
+    intersected.clear();
 
     std::set<std::string> interesting = findSetOfInterestingItems(start_items);
 
@@ -172,17 +184,21 @@ int RsfConfigurationModel::doIntersect(const std::set<std::string> start_items,
         if (item != nullptr) {
             valid_items++;
             if (item->compare("") != 0) {
-                sj.push_back("(" + str + " -> (" + *item + "))");
+                // the dependencies of an item are parsed only once per run
+                ConstraintPtr &dependency = dependencies[str];
+                if (!dependency)
+                    dependency = std::make_shared<Constraint>("(" + str + " -> (" + *item + "))");
+                intersected.push_back(dependency);
             }
             if (always_on) {
                 const auto &cit = std::find(always_on->begin(), always_on->end(), str);
                 if (cit != always_on->end()) // str is found
-                    sj.push_back(str);
+                    intersected.push_back(str);
             }
             if (always_off) {
                 const auto &cit = std::find(always_off->begin(), always_off->end(), str);
                 if (cit != always_off->end()) // str is found
-                    sj.push_back("!" + str);
+                    intersected.push_back("!" + str);
             }
         } else {
             // check if the symbol might be in the model space. if not it can't be missing!
@@ -198,7 +214,6 @@ int RsfConfigurationModel::doIntersect(const std::set<std::string> start_items,
                 missing.insert(str);
         }
     }
-    intersected = sj.join("\n&& ");
     Logging::debug("Out of ", start_items.size(), " items ", missing.size(),
                    " have been put in the MissingSet");
     return valid_items;
@@ -29,6 +29,8 @@
 #include <string>
 #include <set>
 #include <list>
+#include <map>
+#include <unordered_map>
 #include <boost/regex.hpp>
 
 
@@ -76,7 +78,9 @@ public:
     virtual int doIntersect(const std::set<std::string> exp,
                     const ConfigurationModel::Checker *c,
                     std::set<std::string> &missing,
-                    std::string &intersected)                      const final override;
+                    Formula &intersected)                          const final override;
+
+    using ConfigurationModel::doIntersect;
 
     virtual std::set<std::string> findSetOfInterestingItems(const std::set<std::string> &)
                                                                    const final override;
@@ -120,6 +124,12 @@ private:
     std::istream *_rsf_stream;
     RsfReader *_model;
     ItemRsfReader *_rsf;
+    //! the constraint of each item on its dependencies, see doIntersect()
+    mutable std::map<std::string, ConstraintPtr> dependencies;
+    //! the symbols of the dependencies of each item, see findSetOfInterestingItems()
+    mutable std::unordered_map<std::string, std::set<std::string>> dependencySymbols;
+
+    const std::set<std::string> &getDependencySymbols(const std::string &item) const;
 };
 
 #endif
@@ -0,0 +1,323 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SatCache.h"
+#include "PicosatCNF.h"
+#include "exceptions/IOException.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using kconfig::IOException;
+
+namespace {
+    const char cacheMagic[8] = {'U', 'T', 'S', 'A', 'T', 'C', 'H', 'E'};
+    const uint32_t cacheVersion = 3;
+    const uint32_t cacheByteOrder = 0x01020304;
+
+    //! number of slots an entry may be away from its hash position
+    const size_t maxProbes = 64;
+
+    enum : uint32_t { EMPTY = 0, BUSY, SAT, UNSAT };
+
+    /* two independent 64 bit hashes over the same input, together
+       they form the 128 bit key of an entry */
+    struct Hasher {
+        uint64_t fnv = 14695981039346656037ull;
+        uint64_t mix = 0x9e3779b97f4a7c15ull;
+
+        void update(const void *data, size_t size) {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; i++) {
+                fnv = (fnv ^ bytes[i]) * 1099511628211ull;
+                mix = (mix ^ bytes[i]) * 0xff51afd7ed558ccdull;
+                mix ^= mix >> 29;
+            }
+        }
+        void update(const std::string &str) { update(str.data(), str.size() + 1); }
+
+        // finalizer of splitmix64
+        static uint64_t finish(uint64_t h) {
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+            return h ^ (h >> 31);
+        }
+    };
+
+    bool isWordChar(char c) {
+        return isalnum((unsigned char) c) || c == '_' || c == '.';
+    }
+
+    bool isBlockVariable(const char *word, size_t len) {
+        if (len < 2 || word[0] != 'B')
+            return false;
+        for (size_t i = 1; i < len; i++)
+            if (!isdigit((unsigned char) word[i]))
+                return false;
+        return true;
+    }
+
+    size_t roundCapacity(size_t capacity) {
+        size_t ret = 64;
+        while (ret < capacity)
+            ret *= 2;
+        return ret;
+    }
+}
+
+struct SatCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    uint64_t capacity;
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+struct SatCache::Entry {
+    uint64_t hi, lo;
+    uint32_t state;
+    uint32_t reserved;
+};
+
+SatCache::SatCache(size_t capacity) {
+    capacity = roundCapacity(capacity);
+    const size_t size = sizeof(Header) + capacity * sizeof(Entry);
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        throw IOException("Could not allocate SAT cache");
+    header = static_cast<Header *>(data);
+    entries = reinterpret_cast<Entry *>(header + 1);
+    mappedSize = size;
+    initialize(capacity);
+}
+
+SatCache::SatCache(const std::string &filename, size_t capacity) {
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw IOException("Could not open SAT cache " + filename);
+    // concurrent runs must not initialize the same file twice
+    flock(fd, LOCK_EX);
+
+    Header existing;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0
+        && pread(fd, &existing, sizeof(existing), 0) == sizeof(existing)
+        && memcmp(existing.magic, cacheMagic, sizeof(cacheMagic)) == 0
+        && existing.version == cacheVersion && existing.byteorder == cacheByteOrder
+        && existing.capacity == roundCapacity(existing.capacity)
+        && (uint64_t) st.st_size == sizeof(Header) + existing.capacity * sizeof(Entry);
+
+    try {
+        if (valid) {
+            map(fd, st.st_size);
+        } else {
+            capacity = roundCapacity(capacity);
+            const size_t size = sizeof(Header) + capacity * sizeof(Entry);
+            // truncating first discards all old contents
+            if (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)
+                throw IOException("Could not resize SAT cache " + filename);
+            map(fd, size);
+            initialize(capacity);
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);  // the mapping stays valid
+}
+
+SatCache::~SatCache() {
+    munmap(header, mappedSize);
+}
+
+void SatCache::map(int fd, size_t size) {
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        throw IOException("Could not map SAT cache");
+    header = static_cast<Header *>(data);
+    entries = reinterpret_cast<Entry *>(header + 1);
+    mappedSize = size;
+    initialHits = __atomic_load_n(&header->hits, __ATOMIC_RELAXED);
+    initialMisses = __atomic_load_n(&header->misses, __ATOMIC_RELAXED);
+}
+
+void SatCache::initialize(size_t capacity) {
+    // fresh mappings are zero filled, i.e. all entries are EMPTY
+    memcpy(header->magic, cacheMagic, sizeof(cacheMagic));
+    header->version = cacheVersion;
+    header->byteorder = cacheByteOrder;
+    header->capacity = capacity;
+    header->entries = header->hits = header->misses = 0;
+    initialHits = initialMisses = 0;
+}
+
+SatCache::Result SatCache::lookup(const Key &key) {
+    const size_t mask = header->capacity - 1;
+    size_t i = key.lo & mask;
+    for (size_t probe = 0; probe < maxProbes; probe++, i = (i + 1) & mask) {
+        const Entry &e = entries[i];
+        const uint32_t state = __atomic_load_n(&e.state, __ATOMIC_ACQUIRE);
+        if (state == EMPTY)
+            break;
+        // BUSY entries are being written right now, their key is unknown
+        if (state != BUSY && e.hi == key.hi && e.lo == key.lo) {
+            __atomic_fetch_add(&header->hits, 1, __ATOMIC_RELAXED);
+            return state == SAT ? Result::SAT : Result::UNSAT;
+        }
+    }
+    __atomic_fetch_add(&header->misses, 1, __ATOMIC_RELAXED);
+    return Result::UNKNOWN;
+}
+
+void SatCache::insert(const Key &key, bool satisfiable) {
+    const size_t mask = header->capacity - 1;
+    size_t i = key.lo & mask;
+    for (size_t probe = 0; probe < maxProbes; probe++, i = (i + 1) & mask) {
+        Entry &e = entries[i];
+        uint32_t state = __atomic_load_n(&e.state, __ATOMIC_ACQUIRE);
+        if (state == EMPTY) {
+            if (__atomic_compare_exchange_n(&e.state, &state, (uint32_t) BUSY, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                e.hi = key.hi;
+                e.lo = key.lo;
+                __atomic_store_n(&e.state, satisfiable ? SAT : UNSAT, __ATOMIC_RELEASE);
+                __atomic_fetch_add(&header->entries, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            // another process took the slot, 'state' holds its value now
+        }
+        if (state != BUSY && e.hi == key.hi && e.lo == key.lo)
+            return;
+    }
+    // the neighbourhood is full, the result is simply not cached
+}
+
+SatCache::Stats SatCache::getStats() const {
+    Stats ret;
+    ret.hits = __atomic_load_n(&header->hits, __ATOMIC_RELAXED) - initialHits;
+    ret.misses = __atomic_load_n(&header->misses, __ATOMIC_RELAXED) - initialMisses;
+    ret.entries = __atomic_load_n(&header->entries, __ATOMIC_RELAXED);
+    ret.capacity = header->capacity;
+    return ret;
+}
+
+/* renumbers the block variables of formula, names receives them in the
+   order of their first occurrence */
+static std::string normalizeBlocks(const std::string &formula,
+                                   std::vector<std::string> *names) {
+    std::unordered_map<std::string, std::string> blocks;
+    std::string ret;
+    ret.reserve(formula.size());
+
+    const char *p = formula.data(), *end = p + formula.size();
+    while (p != end) {
+        if (isspace((unsigned char) *p)) {
+            // a single space keeps tokens apart that were apart before
+            while (p != end && isspace((unsigned char) *p))
+                p++;
+            if (!ret.empty() && p != end)
+                ret += ' ';
+        } else if (isWordChar(*p)) {
+            const char *word = p;
+            while (p != end && isWordChar(*p))
+                p++;
+            if (isBlockVariable(word, p - word)) {
+                auto it = blocks.emplace(std::string(word, p), "");
+                if (it.second) {
+                    it.first->second = "B" + std::to_string(blocks.size() - 1);
+                    if (names)
+                        names->push_back(it.first->first);
+                }
+                ret += it.first->second;
+            } else {
+                ret.append(word, p);
+            }
+        } else {
+            ret += *p++;
+        }
+    }
+    return ret;
+}
+
+std::string SatCache::normalize(const std::string &formula) {
+    return normalizeBlocks(formula, nullptr);
+}
+
+Constraint::Shape SatCache::shape(const std::string &text) {
+    Constraint::Shape ret;
+    Hasher h;
+    h.update(normalizeBlocks(text, &ret.blocks));
+    ret.hi = Hasher::finish(h.fnv);
+    ret.lo = Hasher::finish(h.mix);
+    return ret;
+}
+
+/* tells formulas apart like the normalized text of the whole formula, the
+   block variables of each constraint are numbered within the formula */
+SatCache::Key SatCache::key(const Formula &formula, uint64_t model) const {
+    std::unordered_map<std::string, uint32_t> blocks;
+    Hasher h;
+    for (const ConstraintPtr &constraint : formula) {
+        const Constraint::Shape &shape = constraint->getShape();
+        h.update(&shape.hi, sizeof(shape.hi));
+        h.update(&shape.lo, sizeof(shape.lo));
+        for (const std::string &name : shape.blocks) {
+            const uint32_t number = blocks.emplace(name, blocks.size()).first->second;
+            h.update(&number, sizeof(number));
+        }
+    }
+    h.update(&model, sizeof(model));
+    h.update(&context, sizeof(context));
+    return {Hasher::finish(h.fnv), Hasher::finish(h.mix)};
+}
+
+SatCache::Key SatCache::key(const std::string &formula, uint64_t model) const {
+    return key(Formula(formula), model);
+}
+
+void SatCache::setContext(const std::string &version,
+                          const std::vector<std::string> &ignorelist) {
+    // the order of the list doesn't matter
+    std::vector<std::string> sorted(ignorelist);
+    std::sort(sorted.begin(), sorted.end());
+    Hasher h;
+    h.update(version);
+    for (const std::string &item : sorted)
+        h.update(item);
+    context = Hasher::finish(h.fnv) ^ Hasher::finish(h.mix);
+}
+
+uint64_t SatCache::identity(const kconfig::PicosatCNF &cnf) {
+    Hasher h;
+    const std::vector<int> &clauses = cnf.getClauses();
+    h.update(clauses.data(), clauses.size() * sizeof(int));
+    cnf.forEachSymbol([&](kconfig::StringRef name, int var) {
+        h.update(name.data, name.size + 1);  // including the terminating '\0'
+        h.update(&var, sizeof(var));
+    });
+    return Hasher::finish(h.fnv) ^ Hasher::finish(h.mix);
+}
@@ -0,0 +1,137 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// -*- mode: c++ -*-
+#ifndef sat_cache_h__
+#define sat_cache_h__
+
+#include "Formula.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace kconfig {
+    class PicosatCNF;
+}
+
+
+/************************************************************************/
+/* SatCache                                                             */
+/************************************************************************/
+
+/**
+ * \brief content addressed cache of satisfiability results
+ *
+ * Results are stored under a 128 bit hash of the normalized formula,
+ * the identity of the CNF model it refers to and the context of the
+ * cache (see setContext()). Normalization
+ * renumbers block variables (B42) in the order of their first
+ * occurrence, so the same precondition shape in different files or
+ * at different block positions maps to the same entry. Each constraint
+ * of a formula is normalized once (see Constraint::getShape()), the
+ * key of a formula combines the hashes of its constraints.
+ *
+ * The table lives in a shared mapping: processes forked after the
+ * cache has been opened see and extend the same table. If the cache is
+ * backed by a file, the mapping is the file itself and the results
+ * survive the run. All accesses are lock free, so workers and
+ * concurrent runs on the same file don't block each other.
+ *
+ * Only the result is stored, no solution. Callers that need one have
+ * to solve the formula again (see SatChecker::getAssignment()).
+ */
+class SatCache {
+public:
+    struct Key {
+        uint64_t hi, lo;
+
+        bool operator==(const Key &other) const { return hi == other.hi && lo == other.lo; }
+    };
+
+    enum class Result { UNKNOWN, SAT, UNSAT };
+
+    struct Stats {
+        uint64_t hits;      //!< lookups answered by the cache since it was opened
+        uint64_t misses;    //!< lookups that weren't answered since it was opened
+        uint64_t entries;   //!< results stored in the table, including earlier runs
+        uint64_t capacity;  //!< maximum number of entries
+    };
+
+    //! the table takes 24 bytes per entry, 24 MiB for the default capacity
+    static const size_t defaultCapacity = 1 << 20;
+
+    //! creates an in-memory cache, shared with processes forked afterwards
+    explicit SatCache(size_t capacity = defaultCapacity);
+
+    /**
+     * \brief opens or creates a persistent cache
+     *
+     * Files that aren't a cache of this version are overwritten.
+     * \param capacity only used if a new table is created
+     * \throws kconfig::IOException if the file can't be opened or mapped
+     */
+    SatCache(const std::string &filename, size_t capacity = defaultCapacity);
+    ~SatCache();
+
+    SatCache(const SatCache &) = delete;
+    SatCache &operator=(const SatCache &) = delete;
+
+    Result lookup(const Key &key);
+    void insert(const Key &key, bool satisfiable);
+    Stats getStats() const;
+
+    //! drops whitespace and renumbers block variables (B42 -> B0, B1, ...)
+    static std::string normalize(const std::string &formula);
+
+    //! key for a formula, model is the identity of its CNF model or 0
+    Key key(const Formula &formula, uint64_t model = 0) const;
+    //! the same for the text of a formula
+    Key key(const std::string &formula, uint64_t model = 0) const;
+
+    //! hashes normalize(text) and lists the block variables it renumbers
+    static Constraint::Shape shape(const std::string &text);
+
+    /**
+     * \brief sets what the results depend on besides formula and model
+     *
+     * SatChecker translates the variables of the ignorelist into free
+     * variables, so a result only holds for the same ignorelist. The
+     * version covers changes of the translation itself. Results of other
+     * contexts stay in a persistent cache, but are never found.
+     */
+    void setContext(const std::string &version, const std::vector<std::string> &ignorelist);
+
+    //! hashes the clauses and variable names of a model
+    static uint64_t identity(const kconfig::PicosatCNF &cnf);
+
+private:
+    struct Header;
+    struct Entry;
+
+    Header *header = nullptr;
+    Entry *entries = nullptr;
+    size_t mappedSize = 0;
+    uint64_t initialHits = 0;
+    uint64_t initialMisses = 0;
+    uint64_t context = 0;
+
+    void map(int fd, size_t size);
+    void initialize(size_t capacity);
+};
+#endif
@@ -30,6 +30,9 @@
 #include "CnfConfigurationModel.h"
 #include "Logging.h"
 #include "CNFBuilder.h"
+#include "CNFSlicer.h"
+#include "BoolExpArena.h"
+#include "BoolExpPropagator.h"
 #include "exceptions/CNFBuilderError.h"
 #include "cpp14.h"
 
@@ -42,6 +45,7 @@
 #include <map>
 #include <vector>
 #include <sstream>
+#include <functional>
 
 using kconfig::PicosatCNF;
 using kconfig::CNFBuilder;
@@ -51,6 +55,12 @@ using kconfig::CNFBuilder;
 /* SatChecker                                                           */
 /************************************************************************/
 
+bool SatChecker::useIncrementalModels = false;
+SatChecker::Slicing SatChecker::modelSlicing = SatChecker::Slicing::NONE;
+CNFBuilder::Encoding SatChecker::encoding = CNFBuilder::Encoding::POLARITY;
+bool SatChecker::simplifyFormulas = false;
+SatCache *SatChecker::cache = nullptr;
+
 bool SatChecker::check(const std::string &sat) {
     SatChecker c(sat);
 
@@ -64,42 +74,211 @@ bool SatChecker::check(const std::string &sat) {
     }
 }
 
-static std::unique_ptr<PicosatCNF>
-getCnfWithModelInit(const std::string &formula, Picosat::SATMode mode, std::string *result) {
+/* Returns true if 'formula' references a CNF model. In this case 'cm' is set to
+   the model (nullptr, if it isn't loaded) and the reference is stripped from 'result'.
+   Without 'result', only 'cm' is looked up and missing models aren't reported */
+static bool lookupCnfModel(const std::string &formula, CnfConfigurationModel **cm,
+                           std::string *result) {
     static const boost::regex modelvar_regexp("\\._\\.(.+)\\._\\.");
     boost::match_results<std::string::const_iterator> what;
-    if (boost::regex_search(formula, what, modelvar_regexp)) {
-        // CNF model
-        std::string modelname = what[1];
-        CnfConfigurationModel *cm = dynamic_cast<CnfConfigurationModel *>(
+    if (!boost::regex_search(formula, what, modelvar_regexp))
+        return false;
+
+    std::string modelname = what[1];
+    *cm = dynamic_cast<CnfConfigurationModel *>(
+        ModelContainer::getInstance().lookupModel(modelname));
+    if (!result)
+        return true;
+    if (!*cm) {
+        Logging::error("Could not add model \"", modelname, "\" to cnf");
+        return true;
+    }
+    *result = boost::regex_replace(formula, modelvar_regexp, "1");
+    return true;
+}
+
+/* The same for a formula: constraints that are model references are dropped, references
+   within other constraints are replaced like above */
+static bool lookupCnfModel(const Formula &formula, CnfConfigurationModel **cm,
+                           Formula *result) {
+    bool found = false;
+    for (const ConstraintPtr &constraint : formula) {
+        const std::string &modelname = constraint->getModelName();
+        if (modelname.empty() && !constraint->embedsModel()) {
+            if (result)
+                result->push_back(constraint);
+            continue;
+        }
+        if (found) {
+            // only the first reference counts, as in the text of the formula
+            if (result && modelname.empty())
+                result->push_back(constraint);
+            continue;
+        }
+        if (modelname.empty()) {
+            std::string stripped;
+            found = lookupCnfModel(constraint->str(), cm, result ? &stripped : nullptr);
+            if (result)
+                result->push_back(found && *cm ? stripped : constraint->str());
+            continue;
+        }
+        found = true;
+        *cm = dynamic_cast<CnfConfigurationModel *>(
             ModelContainer::getInstance().lookupModel(modelname));
-        if (!cm) {
+        if (result && !*cm)
             Logging::error("Could not add model \"", modelname, "\" to cnf");
+    }
+    return found;
+}
+
+/* the expressions of the constraints */
+static std::vector<kconfig::BoolExp *> parseFormula(const Formula &formula) {
+    std::vector<kconfig::BoolExp *> ret;
+    for (const ConstraintPtr &constraint : formula) {
+        kconfig::BoolExp *e = constraint->getExpression();
+        if (!e)
+            throw CNFBuilderError("CNFBuilder: Couldn't parse: " + constraint->str());
+        ret.push_back(e);
+    }
+    return ret;
+}
+
+/* translates the conjuncts one by one, which is the same as translating the
+   text of their conjunction */
+static void pushFormula(PicosatCNF *cnf, const std::vector<kconfig::BoolExp *> &formula) {
+    CNFBuilder builder(cnf, "", true, CNFBuilder::ConstantPolicy::FREE, SatChecker::encoding);
+    builder.setSimplify(SatChecker::simplifyFormulas);
+    for (kconfig::BoolExp *e : formula)
+        builder.pushClause(e);
+}
+
+static std::unique_ptr<PicosatCNF>
+getCnfWithModelInit(bool hasModel, CnfConfigurationModel *cm, Picosat::SATMode mode) {
+    if (hasModel) {
+        // CNF model
+        if (!cm)
             return nullptr;
-        }
-        *result = boost::regex_replace(formula, modelvar_regexp, "1");
         return make_unique<PicosatCNF>(*(cm->getCNF()), mode);  // call copy-delegate constructor
     } else {
         // RSF model
-        *result = formula;
         return make_unique<PicosatCNF>(mode);
     }
 }
 
-bool SatChecker::operator()(Picosat::SATMode mode) {
-    std::string sat;
-    _cnf = getCnfWithModelInit(_sat, mode, &sat);
+bool SatChecker::checkLayered(PicosatCNF *cnf, const std::vector<kconfig::BoolExp *> &query,
+                              Picosat::SATMode mode) {
+    cnf->setDefaultPhase(mode);
+    cnf->pushLayer();
+    try {
+        pushFormula(cnf, query);
+        int res = cnf->checkSatisfiable();
+        if (res) {
+            // the solver is shared, its solution is gone with the next check
+            assignment = AssignmentView(cnf);
+            assignment.freeze();
+        }
+        cnf->popLayer();
+        return res;
+    } catch (...) {
+        cnf->popLayer();
+        throw;
+    }
+}
 
-    CNFBuilder builder(_cnf.get(), sat, true, CNFBuilder::ConstantPolicy::FREE);
-    int res = _cnf->checkSatisfiable();
+bool SatChecker::checkSliced(CnfConfigurationModel *cm,
+                             const std::vector<kconfig::BoolExp *> &query,
+                             Picosat::SATMode mode) {
+    _cnf = make_unique<PicosatCNF>(mode);
+    _cnf->copySymbols(*cm->getCNF());
+    pushFormula(_cnf.get(), query);
+    kconfig::CNFSlicer::Stats stats = cm->getSlicer()->slice(_cnf.get());
+    Logging::debug("Sliced model to ", stats.kept, " of ", stats.clauses, " clauses (",
+                   stats.candidates, " in the components of the query)");
+    bool res = _cnf->checkSatisfiable();
+
+    if (modelSlicing == Slicing::VALIDATE) {
+        bool expected = solve(mode, false);
+        if (res != expected)
+            Logging::error("Model slicing changed the result from ", expected, " to ", res,
+                           " for formula: ", str());
+        return expected;
+    }
     if (res) {
-        /* Let's get the assigment out of picosat, because we have to
-            reset the sat solver afterwards */
-        for (const auto &entry : _cnf->getSymbolMap()) {  // pair<string, int>
-            bool selected = this->_cnf->deref(entry.second);
-            assignmentTable.emplace(entry.first, selected);
+        // the solution satisfies the slice only, a complete one is computed on demand
+        _cnf.reset();
+        pending = true;
+    }
+    return res;
+}
+
+bool SatChecker::operator()(Picosat::SATMode mode) {
+    this->mode = mode;
+    pending = false;
+    if (!cache)
+        return solve(mode);
+
+    CnfConfigurationModel *cm = nullptr;
+    if (lookupCnfModel(formula, &cm, nullptr) && !cm)
+        return solve(mode);  // reports the missing model
+
+    const SatCache::Key key = cache->key(formula, cm ? cm->getIdentity() : 0);
+    SatCache::Result cached = cache->lookup(key);
+    if (cached != SatCache::Result::UNKNOWN) {
+        // solved on demand, most callers are only interested in the result
+        assignment = AssignmentView();
+        _cnf.reset();
+        pending = true;
+        return cached == SatCache::Result::SAT;
+    }
+    bool res = solve(mode);
+    cache->insert(key, res);
+    return res;
+}
+
+bool SatChecker::solve(Picosat::SATMode mode, bool allowShortcuts) {
+    Formula constraints;
+    CnfConfigurationModel *cm = nullptr;
+    assignment = AssignmentView();
+    bool hasModel = lookupCnfModel(formula, &cm, &constraints);
+    std::vector<kconfig::BoolExp *> query = parseFormula(constraints);
+    // the residual of the propagation shares nodes with the constraints, the ones
+    // built for it live until the check is done
+    static thread_local kconfig::BoolExpArena arena;
+    kconfig::BoolExpArena::Scope scope(&arena);
+    if (allowShortcuts && hasModel && cm && cm->getBackbone()) {
+        kconfig::BoolExpPropagator propagator(*cm->getBackbone(), cm->getCNF());
+        std::vector<kconfig::BoolExp *> residual;
+        switch (propagator.propagate(query, residual)) {
+        case kconfig::BoolExpPropagator::Result::CONTRADICTION:
+            _cnf.reset();
+            return false;
+        case kconfig::BoolExpPropagator::Result::TAUTOLOGY:
+            // models with a backbone are satisfiable, a solution is computed on demand
+            _cnf.reset();
+            pending = true;
+            return true;
+        case kconfig::BoolExpPropagator::Result::RESIDUAL:
+            query = std::move(residual);
+            break;
         }
     }
+    if (incremental && hasModel && cm) {
+        _cnf.reset();
+        return checkLayered(cm->getQueryCNF(), query, mode);
+    }
+    if (shared && !hasModel) {
+        _cnf.reset();
+        return checkLayered(shared, query, mode);
+    }
+    if (allowShortcuts && modelSlicing != Slicing::NONE && hasModel && cm
+        && cm->getSlicer()->isUsable())
+        return checkSliced(cm, query, mode);
+    _cnf = getCnfWithModelInit(hasModel, cm, mode);
+
+    pushFormula(_cnf.get(), query);
+    int res = _cnf->checkSatisfiable();
+    if (res)
+        assignment = AssignmentView(_cnf.get());
     return res;
 }
 
@@ -111,9 +290,9 @@ std::string SatChecker::pprint() {
         debug_flags = old_debug_flags;
     }
     if (debug_parser.size() > 0)
-        return _sat + "\n\n" + debug_parser + "\n";
+        return str() + "\n\n" + debug_parser + "\n";
     else
-        return _sat + "\n";
+        return str() + "\n";
 }
 
 /************************************************************************/
@@ -143,19 +322,17 @@ void SatChecker::AssignmentMap::setEnabledBlocks(std::vector<bool> &blocks) {
     }
 }
 
-int SatChecker::AssignmentMap::formatKconfig(std::ostream &out,
-                                             const MissingSet &missingSet) const {
+template<typename ForEach>
+int SatChecker::formatKconfig(std::ostream &out, const MissingSet &missingSet, ForEach forEach) {
     std::map<std::string, state> selection, other_variables;
 
     Logging::debug("---- Dumping new assignment map");
 
-    for (const auto &entry : *this) {  // pair<string, bool>
+    forEach([&](const std::string &name, bool valid) {
         static const boost::regex item_regexp("^CONFIG_(.*[^.])$");
         static const boost::regex module_regexp("^CONFIG_(.*)_MODULE$");
         static const boost::regex block_regexp("^B\\d+$");
         static const boost::regex choice_regexp("^CONFIG_CHOICE_.*$");
-        const std::string &name = entry.first;
-        const bool &valid = entry.second;
         boost::match_results<std::string::const_iterator> what;
 
         if (valid && boost::regex_match(name, what, module_regexp)) {
@@ -168,12 +345,12 @@ int SatChecker::AssignmentMap::formatKconfig(std::ostream &out,
             } else {
                 selection[basename] = state::module;
             }
-            continue;
+            return;
         } else if (boost::regex_match(name, what, choice_regexp)) {
             // choices are anonymous in kconfig and only used for
             // cardinality constraints, ignore
             other_variables[what[0]] = valid ? state::yes : state::no;
-            continue;
+            return;
         } else if (boost::regex_match(name, what, item_regexp)) {
             ConfigurationModel *model = ModelContainer::lookupMainModel();
             const std::string &item_name = what[1];
@@ -183,7 +360,7 @@ int SatChecker::AssignmentMap::formatKconfig(std::ostream &out,
             if (missingSet.find(what[0]) != missingSet.end()) {
                 Logging::debug("Ignoring 'missing' item ", what[0]);
                 other_variables[what[0]] = valid ? state::yes : state::no;
-                continue;
+                return;
             }
 
             // ignore entries if already set (e.g., by the module variant).
@@ -198,16 +375,16 @@ int SatChecker::AssignmentMap::formatKconfig(std::ostream &out,
                 Logging::debug("Ignoring 'non-boolean' item ", what[0]);
 
                 other_variables[what[0]] = valid ? state::yes : state::no;
-                continue;
+                return;
             }
 
         } else if (boost::regex_match(name, block_regexp)) {
             // ignore block variables
-            continue;
+            return;
         } else {
             other_variables[name] = valid ? state::yes : state::no;
         }
-    }
+    });
 
     for (const auto &entry : selection) {  // pair<string, state>
         const std::string &item = entry.first;
@@ -248,6 +425,15 @@ int SatChecker::AssignmentMap::formatKconfig(std::ostream &out,
     return selection.size();
 }
 
+int SatChecker::AssignmentMap::formatKconfig(std::ostream &out,
+                                             const MissingSet &missingSet) const {
+    return SatChecker::formatKconfig(out, missingSet, [this](
+        const std::function<void(const std::string &, bool)> &f) {
+        for (const auto &entry : *this)  // pair<string, bool>
+            f(entry.first, entry.second);
+    });
+}
+
 int SatChecker::AssignmentMap::formatModel(std::ostream &out,
                                            const ConfigurationModel *model) const {
     int items = 0;
@@ -313,7 +499,11 @@ int SatChecker::AssignmentMap::formatCommented(std::ostream &out, const CppFile
     Puma::TokenStream stream;
     sighandler_t oldaction;
 
-    PumaConditionalBlock *topBlock = (PumaConditionalBlock *)file.topBlock();
+    PumaConditionalBlock *topBlock = dynamic_cast<PumaConditionalBlock *>(file.topBlock());
+    if (!topBlock) {
+        Logging::error("no tokens to print for ", file.getFilename(), ", it wasn't parsed");
+        return 0;
+    }
     Puma::Unit *unit = topBlock->unit();
     if (!unit) {
         // in this case we have lost. this can happen e.g. on an empty
@@ -439,6 +629,74 @@ int SatChecker::AssignmentMap::formatExec(const CppFile &file, const char *cmd)
     return size();
 }
 
+
+/************************************************************************/
+/* Satchecker::AssignmentView                                           */
+/************************************************************************/
+
+bool SatChecker::AssignmentView::operator[](kconfig::StringRef name) const {
+    if (!cnf)
+        return false;
+    if (!isFrozen) {
+        int var = cnf->getCNFVar(name);
+        return var != 0 && cnf->deref(var);
+    }
+    uint32_t id = cnf->getNames().find(name);
+    return id < frozen.size() && frozen[id] == 1;
+}
+
+bool SatChecker::AssignmentView::contains(kconfig::StringRef name) const {
+    if (!cnf)
+        return false;
+    if (!isFrozen)
+        return cnf->getCNFVar(name) != 0;
+    uint32_t id = cnf->getNames().find(name);
+    return id < frozen.size() && frozen[id] >= 0;
+}
+
+SatChecker::AssignmentMap SatChecker::AssignmentView::materialize() const {
+    AssignmentMap ret;
+    forEach([&ret](kconfig::StringRef name, bool value) {
+        ret.emplace(name.str(), value);
+    });
+    return ret;
+}
+
+void SatChecker::AssignmentView::setEnabledBlocks(std::vector<bool> &blocks) const {
+    if (blocks.empty())
+        return;
+    // B00 is first and means the whole block
+    if ((*this)["B00"])
+        blocks[0] = true;
+    // B0 starts at index 1
+    for (size_t blockno = 1; blockno < blocks.size(); blockno++)
+        if ((*this)["B" + std::to_string(blockno - 1)])
+            blocks[blockno] = true;
+}
+
+int SatChecker::AssignmentView::formatKconfig(std::ostream &out,
+                                              const MissingSet &missingSet) const {
+    return SatChecker::formatKconfig(out, missingSet, [this](
+        const std::function<void(const std::string &, bool)> &f) {
+        forEach([&f](kconfig::StringRef name, bool value) {
+            f(name.str(), value);
+        });
+    });
+}
+
+void SatChecker::AssignmentView::freeze() {
+    if (!cnf || isFrozen)
+        return;
+    const kconfig::SymbolTable &names = cnf->getNames();
+    frozen.assign(names.size(), -1);
+    for (uint32_t id = 0; id < names.size(); id++) {
+        int var = cnf->getCNFVarById(id);
+        if (var != 0)
+            frozen[id] = cnf->deref(var) ? 1 : 0;
+    }
+    isFrozen = true;
+}
+
 void SatChecker::pprintAssignments(std::ostream &out,
                                    const std::list<SatChecker::AssignmentMap> solutions,
                                    const ConfigurationModel *model, const MissingSet &missingSet) {
@@ -515,20 +773,14 @@ bool BaseExpressionSatChecker::operator()(const std::set<std::string> &assumeSym
         _cnf->pushAssumption(str, true);
 
     int res = _cnf->checkSatisfiable();
-    if (res) {
-        /* Let's get the assigment out of picosat, because we have to
-            reset the sat solver afterwards */
-        assignmentTable.clear();
-        for (const auto &entry : _cnf->getSymbolMap()) {  // pair<string, int>
-            bool selected = this->_cnf->deref(entry.second);
-            assignmentTable.emplace(entry.first, selected);
-        }
-    }
+    assignment = res ? AssignmentView(_cnf.get()) : AssignmentView();
     return res;
 }
 
 BaseExpressionSatChecker::BaseExpressionSatChecker(std::string base_expression, int debug)
         : SatChecker(base_expression, debug) {
-    _cnf = getCnfWithModelInit(base_expression, Picosat::SAT_MAX, &base_expression);
+    CnfConfigurationModel *cm = nullptr;
+    bool hasModel = lookupCnfModel(base_expression, &cm, &base_expression);
+    _cnf = getCnfWithModelInit(hasModel, cm, Picosat::SAT_MAX);
     CNFBuilder builder(_cnf.get(), base_expression, true, CNFBuilder::ConstantPolicy::BOUND);
 }
@@ -27,15 +27,20 @@
 #define sat_checker_h__
 
 #include "PicosatCNF.h"
+#include "CNFBuilder.h"
+#include "SatCache.h"
+#include "Formula.h"
 
 #include <map>
 #include <set>
 #include <list>
 #include <memory>
+#include <vector>
 
 typedef std::set<std::string> MissingSet;
 
 class ConfigurationModel;
+class CnfConfigurationModel;
 class CppFile;
 
 
@@ -45,7 +50,17 @@ class CppFile;
 
 class SatChecker {
 public:
-    SatChecker(std::string sat, int debug = 0) : debug_flags(debug), _sat(std::move(sat)) {}
+    SatChecker(std::string sat, int debug = 0)
+        : incremental(useIncrementalModels), debug_flags(debug), formula(std::move(sat)) {}
+
+    /**
+     * The constraints of the formula are translated one by one, their
+     * expressions are parsed only once, no matter how many checks they
+     * take part in. A model reference ('._.x86._.') has to be a
+     * constraint of its own to be recognized here.
+     */
+    SatChecker(Formula formula, int debug = 0)
+        : incremental(useIncrementalModels), debug_flags(debug), formula(std::move(formula)) {}
 
     virtual ~SatChecker() {};
 
@@ -59,7 +74,64 @@ public:
     bool operator()(Picosat::SATMode mode=Picosat::SAT_MAX);
 
     static bool check(const std::string &sat);
-    const std::string str() { return _sat; }
+
+    /**
+     * If set, formulas on CNF models are checked as a retractable layer
+     * on top of a solver that has loaded the model clauses only once
+     * per process (see CnfConfigurationModel::getQueryCNF()).
+     * Defaults to false.
+     */
+    static bool useIncrementalModels;
+
+    /**
+     * If set, results are looked up in and added to this cache. A check
+     * answered by the cache solves the formula only if its assignment or
+     * cnf is asked for afterwards. Defaults to nullptr.
+     */
+    static SatCache *cache;
+
+    enum class Slicing {
+        NONE,      //!< check formulas on the whole CNF model
+        SLICE,     //!< check formulas on the part of the model they depend on
+        VALIDATE,  //!< check both ways and report differing results
+    };
+
+    /**
+     * Selects how formulas on CNF models are checked, see
+     * kconfig::CNFSlicer. Sliced checks that are satisfiable solve the
+     * formula on the whole model again, if their assignment or cnf is
+     * asked for. Incremental checks are never sliced. Defaults to NONE.
+     */
+    static Slicing modelSlicing;
+
+    /**
+     * The encoding the formulas are translated with, models are not
+     * affected. Defaults to POLARITY, TSEITIN is kept to compare the
+     * results and the solving times.
+     */
+    static kconfig::CNFBuilder::Encoding encoding;
+
+    /**
+     * If set, formulas are simplified before they are translated, see
+     * kconfig::BoolExpSimplifier. Symbols the simplification drops are
+     * missing in the assignment. Defaults to false.
+     */
+    static bool simplifyFormulas;
+
+    /**
+     * Overrides useIncrementalModels for this checker. Non incremental
+     * checks are required if getCNF() is used after the check.
+     */
+    void setIncremental(bool enable) { incremental = enable; }
+
+    /**
+     * Formulas without a CNF model are checked as a retractable layer on
+     * top of cnf, which the checkers of a batch of queries share instead
+     * of setting up a solver each. Defaults to nullptr.
+     */
+    void setSharedCNF(kconfig::PicosatCNF *cnf) { shared = cnf; }
+    //! the text of the formula, it is joined on each call
+    const std::string str() { return formula.str(); }
 
     /** pretty prints the given string */
     static std::string pprinter(const std::string sat) {
@@ -189,13 +261,105 @@ public:
             const MissingSet& missingSet, unsigned number) const;
     }; // end struct AssignmentMap
 
+    /**
+     * \brief on-demand access to the solution of a check
+     *
+     * Values are taken from the solver when they are asked for, no map
+     * of the whole model is built. Only named variables are visible,
+     * helper variables of the Tseitin transformation are skipped.
+     *
+     * A view reads from the solver of its checker and is therefore only
+     * valid until the next check of that checker. Checks on a solver that
+     * is shared with other checkers (see useIncrementalModels) freeze()
+     * their view right away.
+     */
+    class AssignmentView {
+    public:
+        AssignmentView() = default;
+        explicit AssignmentView(const kconfig::PicosatCNF *cnf) : cnf(cnf) {}
+
+        //! returns true if name is set, false if it is unset or unknown
+        bool operator[](kconfig::StringRef name) const;
+
+        //! returns true if name is a variable of the checked formula
+        bool contains(kconfig::StringRef name) const;
+
+        /**
+         * \brief calls f(StringRef name, bool value) for every named variable
+         */
+        template<typename F>
+        void forEach(F f) const {
+            if (!cnf)
+                return;
+            if (!isFrozen) {
+                cnf->forEachSymbol([&](kconfig::StringRef name, int var) {
+                    f(name, cnf->deref(var));
+                });
+                return;
+            }
+            const kconfig::SymbolTable &names = cnf->getNames();
+            for (uint32_t id = 0; id < frozen.size(); id++)
+                if (frozen[id] >= 0)
+                    f(names.get(id), frozen[id] == 1);
+        }
+
+        /**
+         * \brief copies the values of the given variables into a map
+         *
+         * Names that aren't variables of the checked formula are skipped.
+         */
+        template<typename Container>
+        AssignmentMap materialize(const Container &names) const {
+            AssignmentMap ret;
+            for (const std::string &name : names)
+                if (contains(name))
+                    ret.emplace(name, (*this)[name]);
+            return ret;
+        }
+
+        //! copies the values of all named variables into a map
+        AssignmentMap materialize() const;
+
+        /**
+         * \brief collect enabled blocks, see AssignmentMap::setEnabledBlocks
+         *
+         * Only the variables B00, B0, ..., B<n> are looked up.
+         */
+        void setEnabledBlocks(std::vector<bool> &blocks) const;
+
+        //! see AssignmentMap::formatKconfig
+        int formatKconfig(std::ostream &out, const MissingSet &missingSet) const;
+
+        /**
+         * \brief copies the current solution out of the solver
+         *
+         * Afterwards the view stays valid, even if the solver is used
+         * for further checks, as long as the cnf itself is alive.
+         */
+        void freeze();
+
+    private:
+        const kconfig::PicosatCNF *cnf = nullptr;
+        bool isFrozen = false;
+        //! value of each name id of the cnf, -1 if the name wasn't a variable
+        std::vector<signed char> frozen;
+    }; // end class AssignmentView
+
     /**
      * After doing the check, you can get the assignments for the
      * formula
      */
-    const AssignmentMap &getAssignment() const { return assignmentTable; }
+    const AssignmentView &getAssignment() {
+        solvePending();
+        return assignment;
+    }
 
+    /**
+     * Returns the cnf of the last check, nullptr for incremental checks
+     * and checks on a shared cnf
+     */
     kconfig::PicosatCNF *getCNF() {
+        solvePending();
         return _cnf.get();
     }
 
@@ -208,15 +372,17 @@ public:
         const MissingSet &missingSet);
 
 protected:
+    bool incremental;
+    kconfig::PicosatCNF *shared = nullptr;
     std::unique_ptr<kconfig::PicosatCNF> _cnf;
     std::map<std::string, int> symbolTable;
-    AssignmentMap assignmentTable;
+    AssignmentView assignment;
     int debug_flags;
     std::string debug_parser;
     int debug_parser_indent;
 
     Picosat::SATMode mode;
-    const std::string _sat;
+    const Formula formula;
 
     // Debugging stuff
     void _debug_parser(std::string d = "", bool newblock = true) {
@@ -235,6 +401,30 @@ protected:
         }
     }
     enum class state {no, yes, module};
+
+    //! shared implementation of the formatKconfig methods, forEach(f) calls f(name, value)
+    template<typename ForEach>
+    static int formatKconfig(std::ostream &out, const MissingSet &missingSet, ForEach forEach);
+
+private:
+    //! set if the last check was answered without a complete solution, see solve()
+    bool pending = false;
+
+    /** Formulas on CNF models with a backbone (see CnfConfigurationModel::getBackbone())
+        are simplified by kconfig::BoolExpPropagator first, formulas that become constant
+        are decided without the solver. Without shortcuts, neither this nor slicing is
+        done, the solution is then complete. **/
+    bool solve(Picosat::SATMode mode, bool allowShortcuts = true);
+    bool checkLayered(kconfig::PicosatCNF *cnf, const std::vector<kconfig::BoolExp *> &query,
+                      Picosat::SATMode mode);
+    bool checkSliced(CnfConfigurationModel *cm, const std::vector<kconfig::BoolExp *> &query,
+                     Picosat::SATMode mode);
+    void solvePending() {
+        if (pending) {
+            pending = false;
+            solve(mode, false);
+        }
+    }
 };
 
 
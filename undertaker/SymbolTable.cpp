@@ -0,0 +1,87 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "SymbolTable.h"
+
+using namespace kconfig;
+
+const uint32_t SymbolTable::npos;
+
+// FNV-1a
+uint32_t SymbolTable::hash(StringRef str) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < str.size; i++) {
+        h ^= (unsigned char) str.data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint32_t SymbolTable::find(StringRef str) const {
+    if (slots.empty())
+        return npos;
+    const size_t mask = slots.size() - 1;
+    const uint32_t h = hash(str);
+    for (size_t i = h & mask; slots[i] != npos; i = (i + 1) & mask) {
+        const uint32_t id = slots[i];
+        if (hashes[id] == h && get(id) == str)
+            return id;
+    }
+    return npos;
+}
+
+uint32_t SymbolTable::intern(StringRef str) {
+    // keep the load factor below 1/2, so probe sequences stay short
+    if (2 * (size() + 1) > slots.size())
+        grow();
+
+    const size_t mask = slots.size() - 1;
+    const uint32_t h = hash(str);
+    size_t i = h & mask;
+    for (; slots[i] != npos; i = (i + 1) & mask) {
+        const uint32_t id = slots[i];
+        if (hashes[id] == h && get(id) == str)
+            return id;
+    }
+    const uint32_t id = size();
+    slots[i] = id;
+    hashes.push_back(h);
+    chars.insert(chars.end(), str.data, str.data + str.size);
+    chars.push_back('\0');
+    offsets.push_back(chars.size());
+    return id;
+}
+
+void SymbolTable::reserve(size_t strings, size_t characters) {
+    chars.reserve(characters + strings);
+    offsets.reserve(strings + 1);
+    hashes.reserve(strings);
+    while (2 * strings > slots.size())
+        grow();
+}
+
+void SymbolTable::grow(void) {
+    slots.assign(slots.empty() ? 64 : 2 * slots.size(), npos);
+    const size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < size(); id++) {
+        size_t i = hashes[id] & mask;
+        while (slots[i] != npos)
+            i = (i + 1) & mask;
+        slots[i] = id;
+    }
+}
@@ -0,0 +1,84 @@
+// -*- mode: c++ -*-
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef KCONFIG_SYMBOLTABLE_H
+#define KCONFIG_SYMBOLTABLE_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+namespace kconfig {
+    /** a non-owning reference to a character sequence, similar to string_view **/
+    struct StringRef {
+        const char *data;
+        size_t size;
+
+        StringRef(const char *data, size_t size) : data(data), size(size) {}
+        StringRef(const char *str) : data(str), size(strlen(str)) {}
+        StringRef(const std::string &str) : data(str.data()), size(str.size()) {}
+
+        bool operator==(const StringRef &other) const {
+            return size == other.size && memcmp(data, other.data, size) == 0;
+        }
+        std::string str() const { return std::string(data, size); }
+    };
+
+    /**
+     * \brief interns strings and numbers them densely
+     *
+     * Every distinct string gets an id out of [0, size()), which stays
+     * valid for the lifetime of the table. All characters live in one
+     * buffer and lookups go through an open addressing hash table, so
+     * copying a table copies three flat arrays instead of a node based
+     * map with one heap allocated string per entry.
+     */
+    class SymbolTable {
+    public:
+        static const uint32_t npos = UINT32_MAX;
+
+        //! returns the id of the given string, npos if it isn't interned
+        uint32_t find(StringRef str) const;
+        //! returns the id of the given string, adds it if needed
+        uint32_t intern(StringRef str);
+
+        StringRef get(uint32_t id) const {
+            return StringRef(&chars[offsets[id]], offsets[id + 1] - offsets[id] - 1);
+        }
+        //! the returned pointer is invalidated by the next call to intern()
+        const char *c_str(uint32_t id) const { return &chars[offsets[id]]; }
+        size_t size() const { return offsets.size() - 1; }
+        void reserve(size_t strings, size_t characters);
+
+    private:
+        //! all strings, each one terminated by '\0'
+        std::vector<char> chars;
+        //! id -> start of the string in "chars", with one additional end marker
+        std::vector<uint32_t> offsets = {0};
+        //! id -> hash value, saves rehashing the strings on growth
+        std::vector<uint32_t> hashes;
+        //! open addressing with linear probing, contains ids or npos
+        std::vector<uint32_t> slots;
+
+        static uint32_t hash(StringRef str);
+        void grow(void);
+    };
+}
+#endif
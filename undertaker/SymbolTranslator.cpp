@@ -36,6 +36,7 @@ void kconfig::SymbolTranslator::pushSymbolInfo(struct symbol *sym) {
 void kconfig::SymbolTranslator::visit_bool_symbol(struct symbol *sym) {
     if (!sym)
         return;
+    BoolExpArena::Scope scope(useArena ? &arena : nullptr);
 
     if (sym->name)
         Logging::debug("CONFIG ", sym->name, " (bool)");
@@ -73,10 +74,10 @@ void kconfig::SymbolTranslator::visit_bool_symbol(struct symbol *sym) {
     // rev.mod -> F1.yes
     BoolExp &FRevMod = !*transRev.mod || f1yes;
     this->pushSymbolInfo(sym);
-    this->addClause(FYes.simplify());
-    this->addClause(FRevYes.simplify());
-    this->addClause(FRevMod.simplify());
-    this->addClause(completeInv.simplify());
+    this->addClause(&FYes);
+    this->addClause(&FRevYes);
+    this->addClause(&FRevMod);
+    this->addClause(&completeInv);
 
     this->_featuresWithStringDep += (expTranslator.getValueComparisonCounter() > 0) ? 1 : 0;
     this->_totalStringComp += expTranslator.getValueComparisonCounter();
@@ -88,6 +89,7 @@ void kconfig::SymbolTranslator::visit_bool_symbol(struct symbol *sym) {
 };
 
 void kconfig::SymbolTranslator::visit_tristate_symbol(struct symbol *sym) {
+    BoolExpArena::Scope scope(useArena ? &arena : nullptr);
     ExpressionTranslator expTranslator(this->symbolSet);
     expr *rev = reverseDepExpression(sym);
     expr *vis = visibilityExpression(sym);
@@ -131,12 +133,12 @@ void kconfig::SymbolTranslator::visit_tristate_symbol(struct symbol *sym) {
 
     this->pushSymbolInfo(sym);
     // this->addComment(sym->name ? sym->name : "Unnamed Menu Or Choice");
-    this->addClause(FYes.simplify());
+    this->addClause(&FYes);
 
-    this->addClause(FMod.simplify());
-    this->addClause(FRevYes.simplify());
-    this->addClause(FRevMod.simplify());
-    this->addClause(completeInv.simplify());
+    this->addClause(&FMod);
+    this->addClause(&FRevYes);
+    this->addClause(&FRevMod);
+    this->addClause(&completeInv);
     this->addClause(&guard);
 
     this->_featuresWithStringDep += (expTranslator.getValueComparisonCounter() > 0) ? 1 : 0;
@@ -188,6 +190,7 @@ void kconfig::SymbolTranslator::visit_string_symbol(struct symbol *sym) {
 }
 
 void kconfig::SymbolTranslator::visit_choice_symbol(struct symbol *sym) {
+    BoolExpArena::Scope scope(useArena ? &arena : nullptr);
     ExpressionTranslator expTranslator(this->symbolSet);
     TristateRepr transChoice = expTranslator.process(choiceExpression(sym));
     BoolExp &f1yes = *B_VAR(sym, rel_yes);
@@ -198,7 +201,7 @@ void kconfig::SymbolTranslator::visit_choice_symbol(struct symbol *sym) {
         // F1.yes-> choice.yes
         BoolExp &CYes = !f1yes || *transChoice.yes || *transChoice.mod;
 
-        this->addClause(CYes.simplify());
+        this->addClause(&CYes);
     } else if (sym->type == S_TRISTATE) {
         Logging::debug("CONFIG ", sym->name, " (choice tri)");
         visit_tristate_symbol(sym);
@@ -207,8 +210,8 @@ void kconfig::SymbolTranslator::visit_choice_symbol(struct symbol *sym) {
         // F1.yes-> !choice.mod ;
         BoolExp &CMod = !f1yes || !*transChoice.mod;
 
-        this->addClause(CYes.simplify());
-        this->addClause(CMod.simplify());
+        this->addClause(&CYes);
+        this->addClause(&CMod);
         visit_tristate_symbol(sym);
     } else {
         throw "Invalid choice type";
@@ -22,6 +22,7 @@
 
 #include "SymbolParser.h"
 #include "CNFBuilder.h"
+#include "BoolExpArena.h"
 
 #include <set>
 
@@ -32,13 +33,21 @@ namespace kconfig {
         int _featuresWithStringDep = 0;
         int _totalStringComp = 0;
         CNFBuilder cnfbuilder;
+        //! holds the expressions of the symbol that is translated
+        BoolExpArena arena;
 
         void addClause(BoolExp *clause);
         void pushSymbolInfo(struct symbol *sym);
     public:
-        SymbolTranslator(PicosatCNF *cnf) : cnfbuilder(cnf) {}
+        SymbolTranslator(PicosatCNF *cnf) : cnfbuilder(cnf) { cnfbuilder.setSimplify(true); }
 
         std::set<struct symbol *> *symbolSet = nullptr;
+        //! if unset, expressions are allocated on the heap and never freed
+        bool useArena = true;
+
+        //! the clauses are simplified unless this is turned off, see BoolExpSimplifier
+        void setSimplify(bool enable) { cnfbuilder.setSimplify(enable); }
+        const BoolExpSimplifier *getSimplifier() const { return cnfbuilder.getSimplifier(); }
 
         int featuresWithStringDependencies() { return _featuresWithStringDep; }
         int totalStringComparisons() { return _totalStringComp; }
@@ -18,11 +18,9 @@
  */
 
 #include "Tools.h"
-#include "BoolExpSymbolSet.h"
+#include "BoolExpStringParser.h"
 
 std::set<std::string> undertaker::itemsOfString(const std::string &str) {
-    kconfig::BoolExp *e = kconfig::BoolExp::parseString(str);
-    kconfig::BoolExpSymbolSet symset(e);
-    delete e;
-    return symset.getSymbolSet();
+    // no tree is built, the symbols are taken from the tokens
+    return kconfig::BoolExpStringParser::symbols(str);
 }
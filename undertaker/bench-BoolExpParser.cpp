@@ -0,0 +1,173 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// compares BoolExpStringParser with the bison parser on the formulas of the cpppc job,
+// and with reading them in the binary format of BoolExpBinary.h, and the symbols of a
+// parsed tree with the ones the parser scans without a tree
+
+#include "bool.h"
+#include "BoolExpArena.h"
+#include "BoolExpBinary.h"
+#include "BoolExpStringParser.h"
+#include "BoolExpSymbolSet.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace kconfig;
+
+static const int rounds = 50;
+
+/* either the output of 'undertaker -j cpppc' or a validation test with
+   the expected output between check-output-start and check-output-end */
+static std::string readFormula(const char *filename) {
+    std::ifstream in(filename);
+    std::stringstream formula;
+    std::string line;
+    bool expected = false, inside = false;
+    while (std::getline(in, line)) {
+        if (line.find("check-output-start") != std::string::npos) {
+            expected = inside = true;
+            formula.str("");
+        } else if (line.find("check-output-end") != std::string::npos) {
+            inside = false;
+        } else if ((inside || !expected) && line.compare(0, 3, "I: ") != 0) {
+            formula << line << "\n";
+        }
+    }
+    return formula.str();
+}
+
+/* the precondition of a file with the given number of blocks, in the
+   shape the cpppc job prints it */
+static std::string largeFormula(int blocks) {
+    std::stringstream formula;
+    formula << "( B0 <-> CONFIG_0 )";
+    for (int i = 1; i < blocks; i++) {
+        formula << "\n&& ( B" << i << " <-> B" << i / 4 << " && CONFIG_" << i % 997;
+        if (i % 3 == 0)
+            formula << " && ( ! (B" << i - 1 << " || B" << i - 2 << ") )";
+        if (i % 7 == 0)
+            formula << " && defined(CONFIG_X_" << i << ") > 2";
+        formula << " )";
+    }
+    formula << "\n&& B00\n&& ._.x86._.";
+    return formula.str();
+}
+
+static void benchmark(const std::string &what, const std::vector<std::string> &formulas,
+                      BoolExp *(*parse)(std::string)) {
+    BoolExpArena arena;
+    size_t bytes = 0, failed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (const std::string &formula : formulas) {
+            BoolExpArena::Scope scope(&arena);
+            if (!parse(formula))
+                failed++;
+            bytes += formula.size();
+        }
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "  " << what << ": " << (long) (seconds * 1000) << " ms, "
+              << (long) (bytes / seconds / (1 << 20)) << " MiB/s";
+    if (failed)
+        std::cout << ", " << failed / rounds << " formulas not parsed";
+    std::cout << std::endl;
+}
+
+static BoolExp *readBinary(std::string data) {
+    std::vector<BoolExp *> roots;
+    return BoolExpReader::read(data, roots) ? roots.front() : nullptr;
+}
+
+/* the formulas in the binary format, as 'undertaker -j cpppc -O binary' writes them */
+static std::vector<std::string> binary(const std::vector<std::string> &formulas) {
+    std::vector<std::string> result;
+    for (const std::string &formula : formulas) {
+        BoolExpArena arena;
+        BoolExpArena::Scope scope(&arena);
+        BoolExpWriter writer;
+        if (BoolExp *e = BoolExp::parseString(formula))
+            writer.add(e);
+        std::stringstream out;
+        writer.write(out);
+        result.push_back(out.str());
+    }
+    return result;
+}
+
+static std::set<std::string> treeSymbols(const std::string &formula) {
+    BoolExp *e = BoolExp::parseString(formula);
+    std::set<std::string> symbols = BoolExpSymbolSet(e).getSymbolSet();
+    delete e;
+    return symbols;
+}
+
+static void benchmarkSymbols(const std::string &what, const std::vector<std::string> &formulas,
+                             std::set<std::string> (*symbols)(const std::string &)) {
+    BoolExpArena arena;
+    size_t count = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (const std::string &formula : formulas) {
+            BoolExpArena::Scope scope(&arena);
+            count += symbols(formula).size();
+        }
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "  " << what << ": " << (long) (seconds * 1000) << " ms, "
+              << count / rounds << " symbols" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <cpppc output or validation test>..." << std::endl;
+        return 1;
+    }
+    std::vector<std::string> corpus, large;
+    size_t bytes = 0;
+    for (int i = 1; i < argc; i++) {
+        corpus.push_back(readFormula(argv[i]));
+        bytes += corpus.back().size();
+    }
+    large.push_back(largeFormula(5000));
+
+    std::cout << corpus.size() << " formulas, " << bytes / 1024 << " KiB, "
+              << rounds << " rounds" << std::endl;
+    benchmark("bison   ", corpus, BoolExp::parseStringBison);
+    benchmark("by hand ", corpus, BoolExp::parseString);
+    benchmark("binary  ", binary(corpus), readBinary);
+    std::cout << "one file with 5000 blocks, " << large.front().size() / 1024 << " KiB" << std::endl;
+    benchmark("bison   ", large, BoolExp::parseStringBison);
+    benchmark("by hand ", large, BoolExp::parseString);
+    benchmark("binary  ", binary(large), readBinary);
+    std::cout << "symbols of the formulas" << std::endl;
+    benchmarkSymbols("tree,    corpus     ", corpus, treeSymbols);
+    benchmarkSymbols("scanner, corpus     ", corpus, BoolExpStringParser::symbols);
+    benchmarkSymbols("tree,    5000 blocks", large, treeSymbols);
+    benchmarkSymbols("scanner, 5000 blocks", large, BoolExpStringParser::symbols);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// runs all BoolVisitors over conjunctions of 100k terms, once chained to the
+// left as B_AND() and the bison parser build them and once joined by joinAnd()
+
+#include "bool.h"
+#include "BoolExpSymbolSet.h"
+#include "CNFBuilder.h"
+#include "PicosatCNF.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace kconfig;
+
+static const int rounds = 5;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+/* the terms of a block precondition, every third one is a disjunction */
+static std::vector<BoolExp *> terms(int count) {
+    std::vector<BoolExp *> result;
+    for (int i = 0; i < count; i++) {
+        BoolExp *b = B_VAR("B" + std::to_string(i), false);
+        if (i % 3 == 0)
+            b = B_OR(b, B_NOT(B_VAR("CONFIG_" + std::to_string(i % 997), false)));
+        result.push_back(b);
+    }
+    return result;
+}
+
+static BoolExp *leftChain(const std::vector<BoolExp *> &operands) {
+    BoolExp *e = operands.front();
+    for (size_t i = 1; i < operands.size(); i++)
+        e = B_AND(e, operands[i]);
+    return e;
+}
+
+/* the tree is deleted afterwards, unless run() has done it already */
+static void measure(const std::string &what, const std::function<size_t(BoolExp *&)> &run,
+                    BoolExp *(*build)(const std::vector<BoolExp *> &), int count) {
+    Clock::duration spent = Clock::duration::zero();
+    size_t sum = 0;
+    for (int i = 0; i < rounds; i++) {
+        BoolExp *e = build(terms(count));
+        const auto start = Clock::now();
+        sum += run(e);
+        spent += Clock::now() - start;
+        delete e;
+    }
+    std::cout << "    " << what << ": "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(spent).count() / rounds
+              << " ms (" << sum / rounds << ")" << std::endl;
+}
+
+static void benchmark(const std::string &what, BoolExp *(*build)(const std::vector<BoolExp *> &),
+                      int count) {
+    std::cout << "  " << what << std::endl;
+    measure("str        ", [](BoolExp *&e) { return e->str().size(); }, build, count);
+    measure("symbols    ", [](BoolExp *&e) {
+        return BoolExpSymbolSet(e).getSymbolSet().size();
+    }, build, count);
+    measure("tseitin    ", [](BoolExp *&e) {
+        PicosatCNF cnf;
+        CNFBuilder(&cnf).pushClause(e);
+        return (size_t) cnf.getClauseCount();
+    }, build, count);
+    measure("polarity   ", [](BoolExp *&e) {
+        PicosatCNF cnf;
+        CNFBuilder(&cnf, "", false, CNFBuilder::ConstantPolicy::BOUND,
+                   CNFBuilder::Encoding::POLARITY).pushClause(e);
+        return (size_t) cnf.getClauseCount();
+    }, build, count);
+    measure("simplify   ", [](BoolExp *&e) {
+        BoolExp *simplified = e->simplify();
+        delete simplified;
+        return (size_t) 1;
+    }, build, count);
+    measure("delete     ", [](BoolExp *&e) {
+        delete e;
+        e = nullptr;
+        return (size_t) 1;
+    }, build, count);
+}
+
+int main(int argc, char **argv) {
+    const int count = argc > 1 ? atoi(argv[1]) : 100000;
+    if (count < 1) {
+        std::cerr << "usage: " << argv[0] << " [number of terms]" << std::endl;
+        return 1;
+    }
+    std::cout << "conjunctions of " << count << " terms, " << rounds << " rounds" << std::endl;
+    benchmark("chained to the left", leftChain, count);
+    benchmark("joined by joinAnd()", joinAnd, count);
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// runs all BoolVisitors over the #if conditions of C files, once with the
+// visited marks in the nodes and once with the hash table of nested visitors
+
+#include "bool.h"
+#include "CNFBuilder.h"
+#include "PicosatCNF.h"
+#include "BoolExpSymbolSet.h"
+
+#include <boost/regex.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace kconfig;
+
+static const int rounds = 1000;
+
+/* the conditions of all #if, #elif, #ifdef and #ifndef lines, 'defined'
+   is dropped like ConditionalBlock does */
+static std::vector<std::string> readConditions(const char *filename) {
+    static const boost::regex directive("^\\s*#\\s*(if|elif|ifdef|ifndef)\\s+(.*)$");
+    static const boost::regex defined("defined\\s*\\(?\\s*(\\w+)\\s*\\)?");
+    std::vector<std::string> conditions;
+    std::ifstream in(filename);
+    std::string line, next;
+    while (std::getline(in, line)) {
+        while (!line.empty() && line.back() == '\\' && std::getline(in, next))
+            line = line.substr(0, line.size() - 1) + next;
+        boost::smatch what;
+        if (!boost::regex_match(line, what, directive))
+            continue;
+        const std::string condition = what[2];
+        if (what[1] == "ifdef")
+            conditions.push_back(condition);
+        else if (what[1] == "ifndef")
+            conditions.push_back("!" + condition);
+        else
+            conditions.push_back(boost::regex_replace(condition, defined, "$1"));
+    }
+    return conditions;
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+/* translates, stringifies, simplifies and deletes the formulas, hence
+   they are parsed for each round. Only the time spent in the visitors
+   is added to 'spent'. */
+static long traverse(const std::vector<std::vector<std::string>> &files, bool perFile,
+                     Clock::duration &spent) {
+    long sum = 0;
+    for (const auto &conditions : files) {
+        std::vector<BoolExp *> formulas;
+        for (const std::string &condition : conditions) {
+            BoolExp *e = BoolExp::parseString(condition);
+            // the conditions of a file share their nodes, as the block preconditions do
+            if (perFile && !formulas.empty())
+                formulas.back() = new BoolExpAnd(formulas.back(), e);
+            else
+                formulas.push_back(e);
+        }
+        // setting up a solver takes longer than translating a condition
+        std::vector<std::unique_ptr<PicosatCNF>> cnfs;
+        for (size_t i = 0; i < formulas.size(); i++)
+            cnfs.emplace_back(new PicosatCNF());
+        const auto start = Clock::now();
+        for (size_t i = 0; i < formulas.size(); i++) {
+            BoolExp *e = formulas[i];
+            CNFBuilder builder(cnfs[i].get());
+            builder.pushClause(e);
+            sum += cnfs[i]->getClauseCount();
+            sum += BoolExpSymbolSet(e).getSymbolSet().size();
+            sum += e->str().size();
+            delete e->simplify();
+            delete e;
+        }
+        spent += Clock::now() - start;
+    }
+    return sum;
+}
+
+static void report(const std::string &what, Clock::duration spent) {
+    std::cout << "  " << what << ": "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(spent).count()
+              << " ms" << std::endl;
+}
+
+static void benchmark(const std::vector<std::vector<std::string>> &files, bool perFile) {
+    const std::string what = perFile ? "per file,      " : "per condition, ";
+    long sum = 0;
+    Clock::duration spent = Clock::duration::zero();
+    for (int i = 0; i < rounds; i++)
+        sum += traverse(files, perFile, spent);
+    report(what + "marks in nodes", spent);
+
+    // a visitor that is alive already owns the marks, all others use a hash table
+    BoolExpSymbolSet owner(nullptr);
+    spent = Clock::duration::zero();
+    for (int i = 0; i < rounds; i++)
+        sum -= traverse(files, perFile, spent);
+    report(what + "hash table    ", spent);
+
+    if (sum != 0)
+        std::cerr << "traversal results differ" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.c>..." << std::endl;
+        return 1;
+    }
+    std::vector<std::vector<std::string>> files;
+    size_t count = 0;
+    for (int i = 1; i < argc; i++) {
+        std::vector<std::string> conditions;
+        for (const std::string &condition : readConditions(argv[i])) {
+            BoolExp *e = BoolExp::parseString(condition);
+            if (!e)
+                continue;
+            delete e;
+            conditions.push_back(condition);
+        }
+        count += conditions.size();
+        if (!conditions.empty())
+            files.push_back(conditions);
+    }
+    std::cout << count << " conditions in " << files.size() << " files, "
+              << rounds << " rounds" << std::endl;
+    benchmark(files, false);
+    benchmark(files, true);
+    return 0;
+}
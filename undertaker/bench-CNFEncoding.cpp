@@ -0,0 +1,133 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// compares the Tseitin and the polarity encoding of CNFBuilder on the formulas of the cpppc job,
+// with and without simplifying them first
+
+#include "bool.h"
+#include "BoolExpArena.h"
+#include "CNFBuilder.h"
+#include "PicosatCNF.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace kconfig;
+
+static const int rounds = 20;
+
+/* either the output of 'undertaker -j cpppc' or a validation test with
+   the expected output between check-output-start and check-output-end */
+static std::string readFormula(const char *filename) {
+    std::ifstream in(filename);
+    std::stringstream formula;
+    std::string line;
+    bool expected = false, inside = false;
+    while (std::getline(in, line)) {
+        if (line.find("check-output-start") != std::string::npos) {
+            expected = inside = true;
+            formula.str("");
+        } else if (line.find("check-output-end") != std::string::npos) {
+            inside = false;
+        } else if ((inside || !expected) && line.compare(0, 3, "I: ") != 0) {
+            formula << line << "\n";
+        }
+    }
+    return formula.str();
+}
+
+/* the precondition of a file with the given number of blocks, in the
+   shape the cpppc job prints it */
+static std::string largeFormula(int blocks) {
+    std::stringstream formula;
+    formula << "( B0 <-> CONFIG_0 )";
+    for (int i = 1; i < blocks; i++) {
+        formula << "\n&& ( B" << i << " <-> B" << i / 4 << " && CONFIG_" << i % 997;
+        if (i % 3 == 0)
+            formula << " && ( ! (B" << i - 1 << " || B" << i - 2 << ") )";
+        if (i % 5 == 0)
+            formula << " && ( CONFIG_" << i % 13 << " || CONFIG_" << i % 17
+                    << " || CONFIG_" << i % 19 << " )";
+        formula << " )";
+    }
+    formula << "\n&& B00\n&& B" << blocks - 1;
+    return formula.str();
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static void benchmark(const std::string &what, const std::vector<BoolExp *> &formulas,
+                      CNFBuilder::Encoding encoding, bool simplify = false) {
+    long vars = 0, clauses = 0, satisfiable = 0;
+    Clock::duration translating = Clock::duration::zero(), solving = translating;
+    for (int i = 0; i < rounds; i++) {
+        for (BoolExp *e : formulas) {
+            PicosatCNF cnf;
+            auto start = Clock::now();
+            CNFBuilder builder(&cnf, "", false, CNFBuilder::ConstantPolicy::FREE, encoding);
+            builder.setSimplify(simplify);
+            builder.pushClause(e);
+            auto translated = Clock::now();
+            satisfiable += cnf.checkSatisfiable();
+            solving += Clock::now() - translated;
+            translating += translated - start;
+            vars += cnf.getVarCount();
+            clauses += cnf.getClauseCount();
+        }
+    }
+    auto ms = [](Clock::duration d) {
+        return (long) std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+    std::cout << "  " << what << ": " << vars / rounds << " vars, " << clauses / rounds
+              << " clauses, " << ms(translating) << " ms translating, " << ms(solving)
+              << " ms solving, " << satisfiable / rounds << " satisfiable" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <cpppc output or validation test>..." << std::endl;
+        return 1;
+    }
+    BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    std::vector<BoolExp *> corpus, large;
+    for (int i = 1; i < argc; i++) {
+        BoolExp *e = BoolExp::parseString(readFormula(argv[i]));
+        if (e)
+            corpus.push_back(e);
+        else
+            std::cerr << argv[i] << ": no formula" << std::endl;
+    }
+    large.push_back(BoolExp::parseString(largeFormula(5000)));
+
+    std::cout << corpus.size() << " formulas, " << rounds << " rounds" << std::endl;
+    benchmark("tseitin             ", corpus, CNFBuilder::Encoding::TSEITIN);
+    benchmark("polarity            ", corpus, CNFBuilder::Encoding::POLARITY);
+    benchmark("tseitin,  simplified", corpus, CNFBuilder::Encoding::TSEITIN, true);
+    benchmark("polarity, simplified", corpus, CNFBuilder::Encoding::POLARITY, true);
+    std::cout << "one file with 5000 blocks" << std::endl;
+    benchmark("tseitin             ", large, CNFBuilder::Encoding::TSEITIN);
+    benchmark("polarity            ", large, CNFBuilder::Encoding::POLARITY);
+    benchmark("tseitin,  simplified", large, CNFBuilder::Encoding::TSEITIN, true);
+    benchmark("polarity, simplified", large, CNFBuilder::Encoding::POLARITY, true);
+    return 0;
+}
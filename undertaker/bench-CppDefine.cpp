@@ -0,0 +1,83 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// rewrites the conditions of a header-like file with 2000 #defines and
+// 2000 blocks and computes the code constraints of all blocks. The file is
+// read by the DirectiveScanner, so the time isn't spent in Puma.
+
+#include "ConditionalBlock.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static const int rounds = 10;
+static const int symbols = 2000;
+
+static const std::string filename = "bench-CppDefine.c";
+
+typedef std::chrono::high_resolution_clock Clock;
+
+/* half of the blocks define two symbols each, the other half use them */
+static void writeFile() {
+    std::ofstream out(filename, std::ios::trunc);
+    for (int i = 0; i < symbols / 2; i++)
+        out << "#ifdef CONFIG_" << i << "\n"
+            << "#define D" << 2 * i << "\n"
+            << "#define D" << 2 * i + 1 << "\n"
+            << "#endif\n";
+    for (int i = 0; i < symbols / 2; i++)
+        out << "#if defined(D" << i * 7 % symbols << ") && (D" << (i * 13 + 1) % symbols
+            << " || !CONFIG_" << i << ")\n"
+            << "#endif\n";
+}
+
+static void report(const std::string &what, Clock::duration spent) {
+    std::cout << "  " << what << ": "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(spent).count()
+              << " ms" << std::endl;
+}
+
+int main() {
+    writeFile();
+    CppFile::useScanner = true;
+
+    size_t sum = 0;
+    Clock::duration reading = Clock::duration::zero(), constraints = reading;
+    for (int i = 0; i < rounds; i++) {
+        auto start = Clock::now();
+        CppFile file(filename);
+        reading += Clock::now() - start;
+        if (!file.good()) {
+            std::cerr << filename << " couldn't be read" << std::endl;
+            return 1;
+        }
+        start = Clock::now();
+        for (ConditionalBlock *block : file)
+            sum += block->getCodeFormula().size();
+        constraints += Clock::now() - start;
+    }
+    std::remove(filename.c_str());
+
+    std::cout << symbols << " defines, " << symbols << " blocks, " << rounds << " rounds ("
+              << sum << " constraints)" << std::endl;
+    report("reading and rewriting", reading);
+    report("code constraints     ", constraints);
+    return 0;
+}
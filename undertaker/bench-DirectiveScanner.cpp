@@ -0,0 +1,72 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// reads the blocks of C files, once parsed with Puma and once with the
+// DirectiveScanner, e.g. 'bench-DirectiveScanner $(find linux -name "*.c")'
+
+#include "ConditionalBlock.h"
+#include "PlainConditionalBlock.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const int rounds = 10;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+/* the blocks and the formulas of all files, as undertaker needs them */
+static size_t readFiles(const std::vector<std::string> &files, size_t &scanned) {
+    size_t sum = 0;
+    for (const std::string &filename : files) {
+        CppFile file(filename);
+        if (!file.good())
+            continue;
+        sum += file.size() + file.topBlock()->getCodeConstraints().size();
+        if (dynamic_cast<PlainConditionalBlock *>(file.topBlock()))
+            scanned++;
+    }
+    return sum;
+}
+
+static void benchmark(const std::vector<std::string> &files, bool useScanner) {
+    CppFile::useScanner = useScanner;
+    size_t sum = 0, scanned = 0;
+    const auto start = Clock::now();
+    for (int i = 0; i < rounds; i++)
+        sum += readFiles(files, scanned);
+    const auto spent = Clock::now() - start;
+    std::cout << "  " << (useScanner ? "scan: " : "puma: ")
+              << std::chrono::duration_cast<std::chrono::milliseconds>(spent).count()
+              << " ms";
+    if (useScanner)
+        std::cout << ", " << files.size() - scanned / rounds << " files parsed with puma";
+    std::cout << " (" << sum << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.c>..." << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> files(argv + 1, argv + argc);
+    std::cout << files.size() << " files, " << rounds << " rounds" << std::endl;
+    benchmark(files, false);
+    benchmark(files, true);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// compares the symbol tables of PicosatCNF with the std::maps they replaced
+
+#include "PicosatCNF.h"
+#include "timer.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include <string>
+
+using namespace kconfig;
+
+static const int rounds = 20;
+
+static void benchmark(const std::string &filename) {
+    PicosatCNF cnf;
+    cnf.readFromFile(filename);
+
+    // the representation used before
+    std::map<std::string, int> cnfvars;
+    std::map<int, std::string> boolvars;
+    std::vector<std::string> lookups;
+    cnf.forEachSymbol([&](StringRef name, int var) {
+        cnfvars.emplace(name.str(), var);
+        boolvars.emplace(var, name.str());
+        lookups.push_back(name.str());
+    });
+    std::cout << filename << ": " << lookups.size() << " names, " << cnf.getVarCount()
+              << " variables" << std::endl;
+
+    long sum = 0;
+    INIT_TIMER(t);
+    for (int i = 0; i < rounds; i++)
+        for (const std::string &name : lookups)
+            sum += cnfvars.find(name)->second;
+    P_STOP_TIMER(t, "  name -> var, std::map  ");
+    START_TIMER(t);
+    for (int i = 0; i < rounds; i++)
+        for (const std::string &name : lookups)
+            sum -= cnf.getCNFVar(name);
+    P_STOP_TIMER(t, "  name -> var, PicosatCNF");
+
+    START_TIMER(t);
+    for (int i = 0; i < rounds; i++)
+        for (int var = 1; var <= cnf.getVarCount(); var++) {
+            const auto &it = boolvars.find(var);
+            if (it != boolvars.end())
+                sum += it->second.size();
+        }
+    P_STOP_TIMER(t, "  var -> name, std::map  ");
+    START_TIMER(t);
+    for (int i = 0; i < rounds; i++)
+        for (int var = 1; var <= cnf.getVarCount(); var++)
+            sum -= cnf.getSymbolName(var).size();
+    P_STOP_TIMER(t, "  var -> name, PicosatCNF");
+
+    START_TIMER(t);
+    for (int i = 0; i < rounds; i++) {
+        std::map<std::string, int> c1(cnfvars);
+        std::map<int, std::string> c2(boolvars);
+        std::vector<int> c3(cnf.getClauses());
+        sum += c1.size() + c2.size() + c3.size();
+    }
+    P_STOP_TIMER(t, "  copy,         std::map  ");
+    START_TIMER(t);
+    for (int i = 0; i < rounds; i++) {
+        PicosatCNF copy(cnf);
+        sum -= 2 * lookups.size() + copy.getClauses().size();
+    }
+    P_STOP_TIMER(t, "  copy,         PicosatCNF");
+
+    if (sum != 0)
+        std::cerr << "lookup results differ" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <model.cnf>..." << std::endl;
+        return 1;
+    }
+    for (int i = 1; i < argc; i++)
+        benchmark(argv[i]);
+    return 0;
+}
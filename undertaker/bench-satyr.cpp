@@ -0,0 +1,111 @@
+/*
+ *   satyr - compiles KConfig files to boolean formulas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// translates Kconfig models with and without BoolExpArena and compares peak RSS and runtime,
+// and the size of the CNF with and without BoolExpSimplifier
+
+#include "SymbolTranslator.h"
+#include "KconfigSymbolSet.h"
+#include "PicosatCNF.h"
+#include "Logging.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace kconfig;
+
+struct Result {
+    long milliseconds;
+    int clauses;
+};
+
+/* the kconfig parser keeps its state in globals, hence every translation
+   runs in a process of its own, which also separates the peak RSS */
+static void translate(const std::string &filename, bool useArena, bool simplify, int fd) {
+    setenv("ARCH", "x86", 0);
+    setenv("SRCARCH", getenv("ARCH"), 0);
+    setenv("KERNELVERSION", "2.6.30-vamos", 0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    PicosatCNF cnf;
+    SymbolTranslator translator(&cnf);
+    KconfigSymbolSet symbolSet;
+    translator.useArena = useArena;
+    translator.setSimplify(simplify);
+    translator.parse(filename);
+    symbolSet.traverse();
+    translator.symbolSet = &symbolSet;
+    translator.traverse();
+
+    Result result;
+    result.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    result.clauses = cnf.getClauseCount();
+    if (write(fd, &result, sizeof(result)) != sizeof(result))
+        _exit(EXIT_FAILURE);
+    _exit(EXIT_SUCCESS);
+}
+
+static bool run(const std::string &filename, bool useArena, bool simplify) {
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        close(fds[0]);
+        translate(filename, useArena, simplify, fds[1]);
+    }
+    close(fds[1]);
+    Result result;
+    const bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !received || status != 0) {
+        std::cerr << filename << ": translation failed" << std::endl;
+        return false;
+    }
+    std::cout << "  " << (useArena ? "arena" : "heap ") << (simplify ? ", simplified" : ", verbatim  ")
+              << ": " << result.milliseconds
+              << " ms, peak RSS " << usage.ru_maxrss / 1024 << " MiB, "
+              << result.clauses << " clauses" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <model.fm>..." << std::endl;
+        return 1;
+    }
+    Logging::setLogLevel(Logging::LOG_ERROR);
+    for (int i = 1; i < argc; i++) {
+        std::cout << argv[i] << ":" << std::endl;
+        if (!run(argv[i], false, true) || !run(argv[i], true, true)
+            || !run(argv[i], true, false))
+            return 1;
+    }
+    return 0;
+}
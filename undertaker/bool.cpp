@@ -22,204 +22,70 @@
 #include "bool.h"
 #include "exceptions/BoolExpParserException.h"
 #include "BoolExpGC.h"
+#include "BoolExpArena.h"
 #include "BoolExpSimplifier.h"
 #include "BoolExpStringBuilder.h"
 #include "BoolExpLexer.h"
+#include "BoolExpStringParser.h"
 
 #include <typeinfo> // for typeid()
 #include <sstream>
 
 
 /************************************************************************/
-/* accept Methods for BoolExp and subclasses. Needed by BoolExpVisitor  */
+/* dispatch Methods for BoolExp and subclasses. Needed by BoolVisitor   */
 /************************************************************************/
 
 void kconfig::BoolExp::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+    visitor->traverse(this);
+}
+
+void kconfig::BoolExp::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpAny::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpAny::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpAnd::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpAnd::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpOr::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpOr::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpImpl::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpImpl::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpEq::accept(kconfig::BoolVisitor *visitor) {
-    void *l = nullptr, *r = nullptr;
-    if (this->left) {
-        if (visitor->isVisited(left)) {
-            l = visitor->visited[left];
-        } else {
-            this->left->accept(visitor);
-            l = visitor->result;
-        }
-    }
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = l;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpEq::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpNot::accept(kconfig::BoolVisitor *visitor) {
-    void *r = nullptr;
-    if (this->right) {
-        if (visitor->isVisited(right)) {
-            r = visitor->visited[right];
-        } else {
-            this->right->accept(visitor);
-            r = visitor->result;
-        }
-    }
-    visitor->left = nullptr;
-    visitor->right = r;
-    visitor->result = nullptr;
+void kconfig::BoolExpNot::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpConst::accept(kconfig::BoolVisitor *visitor) {
-    visitor->result = nullptr;
+void kconfig::BoolExpConst::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
 kconfig::BoolExpConst *kconfig::BoolExpConst::getInstance(bool val) {
     return new kconfig::BoolExpConst(val);
 }
 
-void kconfig::BoolExpVar::accept(kconfig::BoolVisitor *visitor) {
-    visitor->result = nullptr;
+void kconfig::BoolExpVar::dispatch(kconfig::BoolVisitor *visitor) {
     visitor->visit(this);
-    visitor->visited[this] = visitor->result;
 }
 
-void kconfig::BoolExpCall::accept(kconfig::BoolVisitor *visitor) {
+void kconfig::BoolExpCall::dispatch(kconfig::BoolVisitor *visitor) {
+    // the parameters are separate formulas, their results aren't handed to the call
     for (const auto &bool_exp : *this->param)  // BoolExp *
-        bool_exp->accept(visitor);
+        if (!visitor->isVisited(bool_exp))
+            visitor->traverse(bool_exp);
+    visitor->left = visitor->right = visitor->result = nullptr;
     visitor->visit(this);
 }
 
@@ -228,20 +94,24 @@ void kconfig::BoolExpCall::accept(kconfig::BoolVisitor *visitor) {
 /************************************************************************/
 
 bool kconfig::BoolExp::equals(const BoolExp *other) const {
-    if (other == nullptr || typeid(*other) != typeid(*this)) {
-        return false;
-    } else {
-        return ((this->left == other->left || this->left->equals(other->left))
-                && (this->right == other->right || this->right->equals(other->right)));
+    std::vector<std::pair<const BoolExp *, const BoolExp *>> pending{{this, other}};
+    while (!pending.empty()) {
+        const BoolExp *a = pending.back().first, *b = pending.back().second;
+        pending.pop_back();
+        if (a == b)
+            continue;
+        if (a == nullptr || b == nullptr || typeid(*a) != typeid(*b) || !a->equalsNode(b))
+            return false;
+        pending.emplace_back(a->right, b->right);
+        pending.emplace_back(a->left, b->left);
     }
+    return true;
 }
 
-bool kconfig::BoolExpCall::equals(const BoolExp *other) const {
-    const BoolExpCall *otherc = dynamic_cast<const BoolExpCall *>(other);
-    if (otherc == nullptr || this->name != otherc->name
-        || this->param->size() != otherc->param->size()) {
+bool kconfig::BoolExpCall::equalsNode(const BoolExp *other) const {
+    const BoolExpCall *otherc = static_cast<const BoolExpCall *>(other);
+    if (this->name != otherc->name || this->param->size() != otherc->param->size())
         return false;
-    }
     auto ito = otherc->param->begin();  // BoolExp *
     for (const auto &entry : *param) {  // BoolExp *
         if (!entry->equals(*ito))
@@ -251,29 +121,28 @@ bool kconfig::BoolExpCall::equals(const BoolExp *other) const {
     return true;
 }
 
-bool kconfig::BoolExpVar::equals(const BoolExp *other) const {
-    const BoolExpVar *otherv = dynamic_cast<const BoolExpVar *>(other);
-    return otherv != nullptr && this->name == otherv->name;
-}
-
-bool kconfig::BoolExpConst::equals(const BoolExp *other) const {
-    const BoolExpConst *otherc = dynamic_cast<const BoolExpConst *>(other);
-    return otherc != nullptr && this->value == otherc->value;
-}
-
-bool kconfig::BoolExpAny::equals(const BoolExp *other) const {
-    const BoolExpAny *otherc = dynamic_cast<const BoolExpAny *>(other);
-    return otherc != nullptr && this->name == otherc->name
-           && ((this->left == otherc->left || this->left->equals(otherc->left))
-               && (this->right == otherc->right || this->right->equals(otherc->right)));
+bool kconfig::BoolExpConst::equalsNode(const BoolExp *other) const {
+    return this->value == static_cast<const BoolExpConst *>(other)->value;
 }
 
 /************************************************************************/
 /* BoolExp baseclass methods                                            */
 /************************************************************************/
 
+void *kconfig::BoolExp::operator new(size_t size) {
+    if (void *p = BoolExpArena::allocate(size))
+        return p;
+    return ::operator new(size);
+}
+
+void kconfig::BoolExp::operator delete(void *p) {
+    if (!BoolExpArena::deallocate(p))
+        ::operator delete(p);
+}
+
 kconfig::BoolExp::~BoolExp() {
-    if (!gcMarked) {
+    // the children of arena nodes are destroyed by their arena
+    if (!gcMarked && !BoolExpArena::isArenaNode(this)) {
         BoolExpGC gc;
         gc.trash(this);
         gc.sweep(this);
@@ -281,6 +150,10 @@ kconfig::BoolExp::~BoolExp() {
 }
 
 kconfig::BoolExp *kconfig::BoolExp::parseString(std::string s) {
+    return BoolExpStringParser::parse(s);
+}
+
+kconfig::BoolExp *kconfig::BoolExp::parseStringBison(std::string s) {
     BoolExp *result;
     std::stringstream ins(s);
     BoolExpLexer lexer(&ins, nullptr);
@@ -303,9 +176,7 @@ std::string kconfig::BoolExp::str(void) {
 }
 
 kconfig::BoolExp *kconfig::BoolExp::simplify() {
-    BoolExpSimplifier sim;
-    this->accept(&sim);
-    return sim.getResult();
+    return BoolExpSimplifier().simplify(this);
 }
 
 /************************************************************************/
@@ -358,3 +229,37 @@ kconfig::BoolExp &kconfig::operator!(kconfig::BoolExp & l) {
     }
     return *B_NOT(&l);
 }
+
+/************************************************************************/
+/* Joins                                                                */
+/************************************************************************/
+
+template<class Junction>
+static kconfig::BoolExp *join(const std::vector<kconfig::BoolExp *> &operands) {
+    // chains of the first operands, as long as the parser builds them
+    std::vector<kconfig::BoolExp *> level;
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (i % kconfig::joinChainLength == 0)
+            level.push_back(operands[i]);
+        else
+            level.back() = new Junction(level.back(), operands[i]);
+    }
+    // neighbouring chains are paired until a single tree is left
+    while (level.size() > 1) {
+        size_t n = 0;
+        for (size_t i = 0; i + 1 < level.size(); i += 2)
+            level[n++] = new Junction(level[i], level[i + 1]);
+        if (level.size() % 2)
+            level[n++] = level.back();
+        level.resize(n);
+    }
+    return level.front();
+}
+
+kconfig::BoolExp *kconfig::joinAnd(const std::vector<BoolExp *> &operands) {
+    return operands.empty() ? B_CONST(true) : join<BoolExpAnd>(operands);
+}
+
+kconfig::BoolExp *kconfig::joinOr(const std::vector<BoolExp *> &operands) {
+    return operands.empty() ? B_CONST(false) : join<BoolExpOr>(operands);
+}
@@ -29,6 +29,8 @@
 #include <string>
 #include <list>
 #include <ostream>
+#include <cstdint>
+#include <vector>
 
 #define B_AND new kconfig::BoolExpAnd
 #define B_OR new kconfig::BoolExpOr
@@ -52,24 +54,57 @@ namespace kconfig {
     class BoolExp {
     protected:
         std::string name;
+
+        //! compares the contents of a node of the same class, but not its children
+        virtual bool equalsNode(const BoolExp *other) const { return name == other->name; }
     public:
+        //! visit state of the BoolVisitor that owns the marks, isn't copied with the node
+        struct VisitMark {
+            uint64_t epoch = 0;
+            void *result = nullptr;
+
+            VisitMark() = default;
+            VisitMark(const VisitMark &) {}
+            VisitMark &operator=(const VisitMark &) { return *this; }
+        };
+
         bool gcMarked = false;
         BoolExp *left = nullptr;
         BoolExp *right = nullptr;
-        int CNFVar = 0;
+        VisitMark visitMark;
 
         BoolExp() = default;
         virtual ~BoolExp();
+
+        //@{
+        //! nodes are taken from the active BoolExpArena, if there is one
+        static void *operator new(size_t size);
+        static void operator delete(void *p);
+        //@}
+
         std::string str(void);
         const std::string &getName(void) const { return this->name; }
-        //! Apply obvious simplifications (if possible)
+        //! a new, simplified expression that is equivalent, see BoolExpSimplifier
         BoolExp *simplify();
 
         virtual int getEvaluationPriority(void) const { return -1; }
-        virtual bool equals(const BoolExp *other) const;
-        virtual void accept(BoolVisitor *visitor);
-
+        //! structural equality, compared without recursion
+        bool equals(const BoolExp *other) const;
+        /**
+         * \brief visits the DAG below this node in post-order
+         *
+         * The traversal keeps its pending nodes on a stack of the
+         * visitor (see BoolVisitor::traverse()), deep trees don't
+         * grow the call stack.
+         */
+        void accept(BoolVisitor *visitor);
+        //! calls the matching BoolVisitor::visit(), the children are visited already
+        virtual void dispatch(BoolVisitor *visitor);
+
+        //! nullptr if the string isn't a valid formula, see BoolExpStringParser
         static BoolExp *parseString(std::string);
+        //! the generated parser of BoolExpParser.y, the reference for BoolExpStringParser
+        static BoolExp *parseStringBison(std::string);
     };
 
 /************************************************************************/
@@ -83,7 +118,7 @@ namespace kconfig {
             left = el;
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 50; }
     };
 
@@ -98,7 +133,7 @@ namespace kconfig {
             left = el;
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 30; }
     };
 
@@ -114,9 +149,8 @@ namespace kconfig {
             this->name = name;
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 60; }
-        virtual bool equals(const BoolExp *other) const final override;
     };
 
 /************************************************************************/
@@ -130,7 +164,7 @@ namespace kconfig {
             left = el;
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 20; }
     };
 
@@ -145,7 +179,7 @@ namespace kconfig {
             left = el;
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 10; }
     };
 
@@ -161,9 +195,11 @@ namespace kconfig {
             this->param = param;
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 90; }
-        virtual bool equals(const BoolExp *other) const final override;
+
+    protected:
+        virtual bool equalsNode(const BoolExp *other) const final override;
     };
 
 /************************************************************************/
@@ -174,7 +210,7 @@ namespace kconfig {
     public:
         BoolExpNot(BoolExp *e) { right = e; }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 70; }
     };
 
@@ -188,11 +224,13 @@ namespace kconfig {
     public:
         bool value;
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 90; }
-        virtual bool equals(const BoolExp *other) const final override;
 
         static BoolExpConst *getInstance(bool val);
+
+    protected:
+        virtual bool equalsNode(const BoolExp *other) const final override;
     };
 
 /************************************************************************/
@@ -217,9 +255,8 @@ namespace kconfig {
             this->name = "CONFIG_" + name + TristateRelationNames[rel];
         }
 
-        virtual void accept(BoolVisitor *visitor) final override;
+        virtual void dispatch(BoolVisitor *visitor) final override;
         virtual int getEvaluationPriority(void) const final override { return 90; }
-        virtual bool equals(const BoolExp *other) const final override;
     };
 
 /************************************************************************/
@@ -231,5 +268,19 @@ namespace kconfig {
     BoolExp &operator&&(BoolExp &l, BoolExp &r);
     BoolExp &operator||(BoolExp &l, BoolExp &r);
     BoolExp &operator!(BoolExp & l);
+
+    /**
+     * \brief the conjunction of the operands, in their order
+     *
+     * Up to joinChainLength operands are chained to the left, as the
+     * parser builds "A && B && C". Longer joins are balanced trees of
+     * such chains, their depth grows with the logarithm of the number
+     * of operands. Constants aren't folded, an empty join is true.
+     */
+    BoolExp *joinAnd(const std::vector<BoolExp *> &operands);
+    //! the disjunction of the operands, see joinAnd(), an empty join is false
+    BoolExp *joinOr(const std::vector<BoolExp *> &operands);
+    //! the longest chain of a join that is built to the left
+    const size_t joinChainLength = 64;
 }
 #endif
@@ -21,6 +21,8 @@
 
 #include "PicosatCNF.h"
 #include "CNFBuilder.h"
+#include "CNFPreprocessor.h"
+#include "CNFBackbone.h"
 #include "exceptions/IOException.h"
 #include "RsfReader.h"
 #include "KconfigWhitelist.h"
@@ -34,7 +36,7 @@ using namespace kconfig;
 
 
 static void usage(void){
-    std::cerr << "rsf2cnf [-v] [-q] -m <model> [-W <file>] [-B <file>] [-r <rsf>] [-c <cnf>]" << std::endl;
+    std::cerr << "rsf2cnf [-v] [-q] -m <model> [-W <file>] [-B <file>] [-r <rsf>] [-c <cnf>] [-b <file>] [-s] [-p] [-F]" << std::endl;
     std::cerr << "  -v           increase verbosity" << std::endl;
     std::cerr << "  -q           decrease verbosity" << std::endl;
     std::cerr << "  -m <model>   file with inferences from golem, or a version 1.0 model file generated by rsf2model" << std::endl;
@@ -42,6 +44,11 @@ static void usage(void){
     std::cerr << "  -c <cnf>     (optional) merges constraints from given .cnf file" << std::endl;
     std::cerr << "  -W <file>    (optional) file with a whitelist of options that are always enabled" << std::endl;
     std::cerr << "  -B <file>    (optional) file with a blacklist of options that are always disabled" << std::endl;
+    std::cerr << "  -b <file>    (optional) additionally write the model in binary format to <file>," << std::endl;
+    std::cerr << "               it belongs to the file the text model is redirected to" << std::endl;
+    std::cerr << "  -s           (optional) simplify the dependencies before they are translated" << std::endl;
+    std::cerr << "  -p           (optional) simplify the model, only named variables are kept intact" << std::endl;
+    std::cerr << "  -F           (optional) store the options the model forces to a fixed value" << std::endl;
     exit(1);
 }
 
@@ -129,10 +136,14 @@ int main(int argc, char **argv) {
     std::string model_file;
     std::string rsf_file;
     std::string cnf_file;
+    std::string binary_file;
+    bool simplify = false;
+    bool preprocess = false;
+    bool backbone = false;
 
     int loglevel = Logging::getLogLevel();
 
-    while ((opt = getopt(argc, argv, "m:r:c:W:B:vh")) != -1) {
+    while ((opt = getopt(argc, argv, "m:r:c:W:B:b:spFvh")) != -1) {
         switch (opt) {
             int n;
         case 'm':
@@ -144,6 +155,18 @@ int main(int argc, char **argv) {
         case 'c':
             cnf_file = optarg;
             break;
+        case 'b':
+            binary_file = optarg;
+            break;
+        case 's':
+            simplify = true;
+            break;
+        case 'p':
+            preprocess = true;
+            break;
+        case 'F':
+            backbone = true;
+            break;
         case 'q':
             loglevel = loglevel + 10;
             Logging::setLogLevel(loglevel);
@@ -188,6 +211,7 @@ int main(int argc, char **argv) {
         cnf.readFromFile(cnf_file);
 
     kconfig::CNFBuilder builder(&cnf);
+    builder.setSimplify(simplify);
 
     ItemRsfReader *rsf = nullptr;
 
@@ -216,8 +240,31 @@ int main(int argc, char **argv) {
     if (model.getMetaValue(magic_inc)) {
         cnf.addMetaValue("CONFIGURATION_SPACE_INCOMPLETE", "True");
     }
+    if (simplify)
+        std::cerr << "simplified dependencies:" << std::endl
+                  << builder.getSimplifier()->getStats();
+    if (preprocess) {
+        CNFPreprocessor preprocessor(&cnf);
+        if (preprocessor.run())
+            std::cerr << "preprocessed model:" << std::endl << preprocessor.getStats();
+        else
+            Logging::warn("model is unsatisfiable, it is kept unchanged");
+    }
+    if (backbone) {
+        CNFBackbone forced(cnf);
+        if (forced.isSatisfiable()) {
+            forced.store(&cnf);
+            Logging::info("the model forces ", forced.getStats().forced, " symbols");
+        } else {
+            Logging::warn("model is unsatisfiable, no backbone stored");
+        }
+    }
     try {
         cnf.toStream(std::cout);
+        // flush first, the binary model records the size of the text model
+        std::cout.flush();
+        if (binary_file != "")
+            cnf.toBinaryFile(binary_file, "/dev/stdout");
     } catch (IOException e) {
         Logging::error(e.what());
         return 1;
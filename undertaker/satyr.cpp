@@ -24,6 +24,8 @@
 #include "SymbolTranslator.h"
 #include "KconfigSymbolSet.h"
 #include "PicosatCNF.h"
+#include "CNFPreprocessor.h"
+#include "CNFBackbone.h"
 #include "KconfigAssumptionMap.h"
 #include "Logging.h"
 #include "../version.h"
@@ -39,11 +41,15 @@ using namespace kconfig;
 
 
 void usage(std::ostream &out) {
-    out << "usage: satyr [-V] [-a <assumtion.config> | -c <out.cnf>] <model>" << std::endl;
+    out << "usage: satyr [-V] [-a <assumtion.config> | -c <out.cnf> [-b] [-p] [-F]] <model>" << std::endl;
     out << "       model:          a Kconfig file / translated cnf file" << std::endl;
     out << "       -a <assumtion>  a .config file to be validated" << std::endl;
     out << "                       (may be incomplete)" << std::endl;
     out << "       -c <out.cnf>   translates model to cnf and saves it to out.cnf" << std::endl;
+    out << "       -b             additionally saves a binary model to out.cnf.bin" << std::endl;
+    out << "       -p             simplifies the model before saving it, named variables" << std::endl;
+    out << "                      are kept, helper variables may vanish" << std::endl;
+    out << "       -F             stores the symbols the model forces to a fixed value" << std::endl;
     out << "       -V  print version information\n";
     exit(EXIT_FAILURE);
 }
@@ -77,6 +83,9 @@ int process_assumptions(PicosatCNF &cnf, const std::vector<boost::filesystem::pa
 
 int main(int argc, char **argv) {
     bool saveTranslatedModel = false;
+    bool saveBinaryModel = false;
+    bool preprocessModel = false;
+    bool storeBackbone = false;
     std::vector<boost::filesystem::path> assumptions;
     boost::filesystem::path saveFile;
     int exitstatus = 0;
@@ -84,12 +93,21 @@ int main(int argc, char **argv) {
 
     int loglevel = Logging::getLogLevel();
 
-    while ((opt = getopt(argc, argv, "Vvc:a:")) != -1) {
+    while ((opt = getopt(argc, argv, "VvbpFc:a:")) != -1) {
         switch (opt) {
         case 'c':
             saveTranslatedModel = true;
             saveFile = optarg;
             break;
+        case 'b':
+            saveBinaryModel = true;
+            break;
+        case 'p':
+            preprocessModel = true;
+            break;
+        case 'F':
+            storeBackbone = true;
+            break;
         case 'a':
             assumptions.push_back(optarg);
             break;
@@ -163,10 +181,37 @@ int main(int argc, char **argv) {
                           translator.totalStringComparisons(), " comparisons.");
         }
         Logging::info("features in model: ", symbolSet.size());
+        if (Logging::getLogLevel() <= Logging::LOG_DEBUG)
+            std::cerr << "simplified clauses:" << std::endl
+                      << translator.getSimplifier()->getStats();
+    }
+    if (preprocessModel) {
+        CNFPreprocessor preprocessor(&cnf);
+        if (preprocessor.run())
+            std::cerr << "preprocessed model:" << std::endl << preprocessor.getStats();
+        else
+            Logging::warn("model is unsatisfiable, it is kept unchanged");
+    }
+    if (storeBackbone) {
+        CNFBackbone backbone(cnf);
+        const CNFBackbone::Stats &stats = backbone.getStats();
+        if (backbone.isSatisfiable()) {
+            backbone.store(&cnf);
+            std::cerr << "backbone: " << stats.forced << " symbols forced, "
+                      << stats.toplevel << " on the top level, "
+                      << stats.probes << " probes" << std::endl;
+        } else {
+            Logging::warn("model is unsatisfiable, no backbone stored");
+        }
     }
     if (saveTranslatedModel) {
         cnf.toFile(saveFile.string());
         Logging::info(cnf.getVarCount(), " variables written to ", saveFile);
+        if (saveBinaryModel) {
+            const std::string binaryFile = PicosatCNF::binaryFileName(saveFile.string());
+            cnf.toBinaryFile(binaryFile, saveFile.string());
+            Logging::info("binary model written to ", binaryFile);
+        }
     }
     exitstatus += process_assumptions(cnf, assumptions);
     return exitstatus;
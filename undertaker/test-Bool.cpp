@@ -19,7 +19,12 @@
  */
 
 #include "bool.h"
+#include "BoolExpArena.h"
+#include "BoolExpSymbolSet.h"
+#include "CNFBuilder.h"
+#include "PicosatCNF.h"
 #include <iostream>
+#include <pthread.h>
 #include <check.h>
 
 using namespace kconfig;
@@ -192,6 +197,140 @@ START_TEST(equal) {
     equals_test("A + B");
 } END_TEST;
 
+/* counts the destroyed variables */
+static int destroyed = 0;
+class CountedVar : public BoolExpVar {
+public:
+    CountedVar(std::string name) : BoolExpVar(name, false) {}
+    ~CountedVar() { destroyed++; }
+};
+
+START_TEST(arena) {
+    BoolExpArena arena(256);
+    destroyed = 0;
+    BoolExp *heap = new CountedVar("HEAP");
+    {
+        BoolExpArena::Scope scope(&arena);
+        BoolExp *x = new CountedVar("X");
+        BoolExp *shared = new CountedVar("SHARED_VARIABLE_WITH_A_LONG_NAME");
+        BoolExp *e = &(*x && *shared);
+        for (int i = 0; i < 100; i++)
+            e = &(*e || !*shared);
+        BoolExp *parsed = BoolExp::parseString("A && (B || !C)");
+        fail_unless(parsed->str() == "A && (B || !C)");
+        fail_unless(BoolExpArena::isArenaNode(parsed));
+        fail_if(BoolExpArena::isArenaNode(heap));
+        // deleting a node leaves its children to the arena
+        delete parsed;
+        delete x;
+        ck_assert_int_eq(1, destroyed);
+        {
+            BoolExpArena::Scope nested(&arena);
+            new CountedVar("Y");
+        }
+        // the nested scope didn't release anything
+        ck_assert_int_eq(1, destroyed);
+        fail_unless(e->str().size() > 100);
+    }
+    ck_assert_int_eq(3, destroyed);
+    ck_assert_int_eq(1, arena.getStats().releases);
+    fail_unless(arena.getStats().nodes > 200);
+    fail_unless(arena.getStats().peakBytes > 256);
+
+    // the chunks are reused
+    {
+        BoolExpArena::Scope scope(&arena);
+        BoolExp *e = BoolExp::parseString("X -> Y");
+        fail_unless(BoolExpArena::isArenaNode(e));
+    }
+    fail_if(BoolExpArena::isArenaNode(heap));
+    delete heap;
+    ck_assert_int_eq(4, destroyed);
+} END_TEST;
+
+START_TEST(nestedVisitors) {
+    for (int nested = 0; nested < 2; nested++) {
+        // a visitor that is alive already owns the marks in the nodes
+        BoolExpSymbolSet *owner = nested ? new BoolExpSymbolSet(nullptr) : nullptr;
+        destroyed = 0;
+        BoolExp *shared = new CountedVar("X");
+        BoolExp *e = &(*shared && !*shared);
+        e = &(*e || *e);
+        fail_unless(e->str() == "X && !X || X && !X", "%s", e->str().c_str());
+        std::set<std::string> symbols = BoolExpSymbolSet(e).getSymbolSet();
+        ck_assert_int_eq(1, symbols.size());
+        // copies don't take the visited state along
+        BoolExpVar copy(*static_cast<BoolExpVar *>(shared));
+        fail_unless(copy.str() == "X");
+        // each shared node is destroyed only once
+        delete e;
+        ck_assert_int_eq(1, destroyed);
+        delete owner;
+    }
+    BoolExp *call = BoolExp::parseString("f(A && B, !C) || A && B");
+    fail_unless(call->str() == "f (A && B, !C) || A && B", "%s", call->str().c_str());
+    delete call;
+} END_TEST;
+
+START_TEST(joins) {
+    std::vector<BoolExp *> operands;
+    std::string expected;
+    for (int i = 0; i < 1000; i++) {
+        operands.push_back(B_VAR("X" + std::to_string(i), false));
+        expected += (i ? " || X" : "X") + std::to_string(i);
+        // short joins are chains to the left, as the parser builds them
+        if (i + 1 == 3) {
+            BoolExp *e = joinAnd(operands);
+            fail_unless(e->equals(BoolExp::parseStringBison("X0 && X1 && X2")));
+        }
+    }
+    BoolExp *e = joinOr(operands);
+    fail_unless(e->str() == expected);
+    int depth = 0;
+    for (BoolExp *node = e; node->left; node = node->left)
+        depth++;
+    // 16 chains of 64 operands are paired four times
+    ck_assert_int_eq(depth, 4 + 63);
+    fail_unless(joinAnd({})->str() == "1");
+    fail_unless(joinOr({})->str() == "0");
+} END_TEST;
+
+static const int deepTreeNodes = 100000;
+
+/* the traversals of deep trees on a small stack, recursions would overflow it */
+static void *traverseDeepTrees(void *) {
+    BoolExp *left = B_VAR("X0", false), *right = B_VAR("X0", false);
+    for (int i = 1; i < deepTreeNodes; i++) {
+        left = B_AND(left, B_VAR("X" + std::to_string(i), false));
+        right = B_OR(B_VAR("X" + std::to_string(i), false), right);
+    }
+    fail_unless(left->str().size() > 4 * (size_t) deepTreeNodes);
+    fail_unless(right->str().compare(0, 18, "X99999 || X99998 |") == 0);
+    ck_assert_int_eq(BoolExpSymbolSet(left).getSymbolSet().size(), deepTreeNodes);
+    ck_assert_int_eq(BoolExpSymbolSet(right).getSymbolSet().size(), deepTreeNodes);
+    fail_unless(left->simplify()->str() == left->str());
+    for (auto encoding : {CNFBuilder::Encoding::TSEITIN, CNFBuilder::Encoding::POLARITY}) {
+        PicosatCNF cnf;
+        CNFBuilder builder(&cnf, "", false, CNFBuilder::ConstantPolicy::BOUND, encoding);
+        builder.pushClause(left);
+        builder.pushClause(right);
+        fail_unless(cnf.getVarCount() >= deepTreeNodes);
+    }
+    fail_unless(!left->equals(right));
+    delete left;
+    delete right;
+    return nullptr;
+}
+
+START_TEST(deepTrees) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 256 * 1024);
+    pthread_t thread;
+    ck_assert_int_eq(pthread_create(&thread, &attributes, traverseDeepTrees, nullptr), 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+} END_TEST;
 
 Suite *cond_block_suite(void) {
     Suite *s  = suite_create("Suite test-Bool");
@@ -202,6 +341,10 @@ Suite *cond_block_suite(void) {
     tcase_add_test(tc, notATree);
     tcase_add_test(tc, equal);
     tcase_add_test(tc, simplify);
+    tcase_add_test(tc, arena);
+    tcase_add_test(tc, nestedVisitors);
+    tcase_add_test(tc, joins);
+    tcase_add_test(tc, deepTrees);
     suite_add_tcase(s, tc);
     return s;
 }
@@ -0,0 +1,168 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "bool.h"
+#include "BoolExpArena.h"
+#include "BoolExpBinary.h"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <check.h>
+
+using namespace kconfig;
+
+static std::string serialize(const std::vector<BoolExp *> &formulas) {
+    BoolExpWriter writer;
+    for (size_t i = 0; i < formulas.size(); i++)
+        ck_assert_int_eq(writer.add(formulas[i]), i);
+    std::stringstream out;
+    writer.write(out);
+    return out.str();
+}
+
+static std::string randomFormula(std::mt19937 &random, int depth) {
+    static const char *atoms[] = {"A", "CONFIG_B", "._.x86._.", "0", "1"};
+    static const char *ops[] = {" && ", " || ", " -> ", " <-> ", " == ", " < "};
+    if (depth == 0 || random() % 4 == 0)
+        return atoms[random() % 5];
+    switch (random() % 4) {
+    case 0:
+        return "!" + randomFormula(random, depth - 1);
+    case 1:
+        return "f(" + randomFormula(random, depth - 1) + ", " + randomFormula(random, depth - 1)
+               + ")";
+    default:
+        return "(" + randomFormula(random, depth - 1) + ops[random() % 6]
+               + randomFormula(random, depth - 1) + ")";
+    }
+}
+
+START_TEST(roundTrip) {
+    std::mt19937 random(4711);
+    BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    std::vector<BoolExp *> formulas;
+    for (int i = 0; i < 500; i++)
+        formulas.push_back(BoolExp::parseString(randomFormula(random, 6)));
+    formulas.push_back(BoolExp::parseString("g()"));
+    std::vector<BoolExp *> roots;
+    fail_unless(BoolExpReader::read(serialize(formulas), roots));
+    ck_assert_int_eq(roots.size(), formulas.size());
+    for (size_t i = 0; i < formulas.size(); i++)
+        fail_unless(roots[i]->equals(formulas[i]) && roots[i]->str() == formulas[i]->str(),
+                    "\"%s\" read as \"%s\"", formulas[i]->str().c_str(), roots[i]->str().c_str());
+} END_TEST;
+
+/* shared nodes are written once and shared again when they are read */
+START_TEST(sharing) {
+    BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    BoolExp *x = B_VAR("X", false);
+    BoolExp *both = B_AND(x, B_NOT(x));
+    BoolExp *e = B_OR(both, both);
+    BoolExpWriter writer;
+    writer.add(e);
+    ck_assert_int_eq(writer.add(both), 1);
+    ck_assert_int_eq(writer.getNodeCount(), 4);
+    std::stringstream out;
+    writer.write(out);
+
+    std::vector<BoolExp *> roots;
+    fail_unless(BoolExpReader::read(out, roots));
+    ck_assert_int_eq(roots.size(), 2);
+    fail_unless(roots[0]->str() == "X && !X || X && !X");
+    fail_unless(roots[0]->left == roots[0]->right);
+    fail_unless(roots[1] == roots[0]->left);
+    fail_unless(roots[1]->left == roots[1]->right->right);
+} END_TEST;
+
+/* each name is written once */
+START_TEST(symbols) {
+    const std::string name(100, 'S');
+    BoolExp *e = BoolExp::parseString(name);
+    for (int i = 0; i < 1000; i++)
+        e = B_AND(e, BoolExp::parseString(i % 2 ? name : "f(" + name + ") + " + name));
+    const std::string data = serialize({e});
+    fail_unless(data.size() < 200 + 4 * 4000, "%zu bytes", data.size());
+    std::vector<BoolExp *> roots;
+    fail_unless(BoolExpReader::read(data, roots));
+    fail_unless(roots[0]->equals(e));
+    delete roots[0];
+    delete e;
+} END_TEST;
+
+/* invalid input is rejected without leaving nodes behind, nothing crashes */
+START_TEST(invalid) {
+    const std::string data = serialize({BoolExp::parseString("A && f(B, !C) -> D + 1 <-> 0")});
+    std::vector<BoolExp *> roots;
+    fail_if(BoolExpReader::read(std::string(), roots));
+    fail_if(BoolExpReader::read("XTBX" + data.substr(4), roots));
+    std::string other = data;
+    other[4] = 2;  // the version
+    fail_if(BoolExpReader::read(other, roots));
+    fail_if(BoolExpReader::read(data + '\0', roots));
+    for (size_t length = 0; length < data.size(); length++) {
+        fail_if(BoolExpReader::read(data.substr(0, length), roots), "%zu bytes", length);
+        ck_assert_int_eq(roots.size(), 0);
+    }
+    std::mt19937 random(42);
+    for (int i = 0; i < 20000; i++) {
+        BoolExpArena arena;
+        BoolExpArena::Scope scope(&arena);
+        std::string broken = data;
+        broken[4 + random() % (broken.size() - 4)] = (char) random();
+        if (BoolExpReader::read(broken, roots))
+            fail_unless(!roots.empty() && !roots[0]->str().empty());
+    }
+} END_TEST;
+
+START_TEST(longChains) {
+    std::string input = "B0";
+    for (int i = 1; i < 100000; i++)
+        input += " && B" + std::to_string(i);
+    BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    BoolExp *e = BoolExp::parseStringBison(input);
+    std::vector<BoolExp *> roots;
+    fail_unless(BoolExpReader::read(serialize({e}), roots));
+    fail_unless(roots[0]->equals(e));
+    fail_unless(roots[0]->str() == input);
+} END_TEST;
+
+Suite *cond_block_suite(void) {
+    Suite *s  = suite_create("Suite: test-BoolExpBinary");
+    TCase *tc = tcase_create("BoolExpBinary");
+    tcase_add_test(tc, roundTrip);
+    tcase_add_test(tc, sharing);
+    tcase_add_test(tc, symbols);
+    tcase_add_test(tc, invalid);
+    tcase_add_test(tc, longChains);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,235 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "bool.h"
+#include "BoolExpArena.h"
+#include "BoolExpSimplifier.h"
+#include "CNFBuilder.h"
+#include "KconfigWhitelist.h"
+#include "PicosatCNF.h"
+
+#include <random>
+#include <string>
+#include <check.h>
+
+using namespace kconfig;
+
+static void simplifiesTo(BoolExpSimplifier &simplifier, const char *input, const char *expected) {
+    BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    BoolExp *e = BoolExp::parseString(input);
+    fail_unless(e != nullptr, "\"%s\" isn't parsed", input);
+    const std::string result = simplifier.simplify(e)->str();
+    fail_unless(result == expected, "\"%s\" simplified to \"%s\" instead of \"%s\"",
+                input, result.c_str(), expected);
+}
+
+static void simplifiesTo(const char *input, const char *expected) {
+    BoolExpSimplifier simplifier;
+    simplifiesTo(simplifier, input, expected);
+}
+
+START_TEST(flatten) {
+    simplifiesTo("(A && B) && C", "A && B && C");
+    simplifiesTo("(A || B) || (C || D)", "A || B || C || D");
+    simplifiesTo("B && A && B", "B && A");
+    simplifiesTo("(A && B) || (B && A)", "A && B");
+    simplifiesTo("(A || B) && (B || A) && C", "(A || B) && C");
+} END_TEST;
+
+/* the order of the operands is kept, a nested chain stays a node of its own */
+START_TEST(sharedChains) {
+    BoolExpSimplifier simplifier;
+    BoolExpArena arena;
+    BoolExpArena::Scope scope(&arena);
+    BoolExp *e = simplifier.simplify(BoolExp::parseString("(C && 1) && (B && A && B)"));
+    ck_assert_str_eq(e->str().c_str(), "C && B && A");
+    fail_unless(dynamic_cast<BoolExpVar*>(e->left) != nullptr);
+    ck_assert_str_eq(e->right->str().c_str(), "B && A");
+    // equal chains are built the same way in every call
+    BoolExp *other = simplifier.simplify(BoolExp::parseString("(A && B) || D"));
+    ck_assert_str_eq(other->str().c_str(), "A && B || D");
+    PicosatCNF cnf;
+    CNFBuilder builder(&cnf);
+    builder.pushClause(e);
+    const int clauses = cnf.getClauseCount();
+    builder.pushClause(other);
+    // a single gate for the OR, the AND is shared
+    ck_assert_int_eq(cnf.getClauseCount(), clauses + 4);
+} END_TEST;
+
+START_TEST(negationNormalForm) {
+    simplifiesTo("!(A && B)", "!A || !B");
+    simplifiesTo("!(A || !B)", "!A && B");
+    simplifiesTo("!!A", "A");
+    simplifiesTo("A -> B", "!A || B");
+    simplifiesTo("!(A -> B)", "A && !B");
+    simplifiesTo("A -> B -> C", "A && !B || C");
+    simplifiesTo("A -> (B -> C)", "!A || !B || C");
+    simplifiesTo("!(A <-> B)", "A <-> !B");
+} END_TEST;
+
+START_TEST(constants) {
+    simplifiesTo("A && 1", "A");
+    simplifiesTo("A && 0", "0");
+    simplifiesTo("A || 1", "1");
+    simplifiesTo("!(A || 0)", "!A");
+    simplifiesTo("A <-> 1", "A");
+    simplifiesTo("A <-> 0", "!A");
+    simplifiesTo("A <-> A", "1");
+    simplifiesTo("A <-> !A", "0");
+    simplifiesTo("(A <-> B) <-> (B <-> A)", "1");
+    // free constants stay unknown values
+    BoolExpSimplifier free(true);
+    simplifiesTo(free, "A && 0", "A && 0");
+    simplifiesTo(free, "0 && 0", "0 && 0");
+    // a copied constant is printed like a folded one
+    simplifiesTo(free, "!(!(0))", "0");
+    fail_if(free.isContradiction());
+    simplifiesTo(free, "A && !A", "0");
+    fail_unless(free.isContradiction());
+} END_TEST;
+
+START_TEST(complements) {
+    simplifiesTo("A && B && !A", "0");
+    simplifiesTo("A || (B && C) || !A", "1");
+    simplifiesTo("(A && B) || !(A && B)", "1");
+    simplifiesTo("A && (B && (C && !A))", "0");
+    // calls are distinct unknown values
+    simplifiesTo("f(A) && !f(A)", "f (A) && !f (A)");
+} END_TEST;
+
+START_TEST(absorption) {
+    simplifiesTo("(A <-> B) && ((A <-> B) || C)", "A <-> B");
+    simplifiesTo("(A <-> B) || ((B <-> A) && C)", "A <-> B");
+    simplifiesTo("(A || B) && (A || B || C)", "A || B");
+} END_TEST;
+
+START_TEST(assumptions) {
+    simplifiesTo("A && (A || B)", "A");
+    simplifiesTo("A && (!A || B)", "A && B");
+    simplifiesTo("A || (!A && B)", "A || B");
+    simplifiesTo("!A && (A -> B)", "!A");
+    simplifiesTo("X && (Y || (Z && (X || W)))", "X && (Y || Z)");
+    simplifiesTo("X && (Y || !X)", "X && Y");
+    // the assumption holds only within its chain
+    simplifiesTo("(A && B) || (!A && C)", "A && B || !A && C");
+} END_TEST;
+
+START_TEST(ignorelist) {
+    KconfigWhitelist::getIgnorelist().push_back("CONFIG_IGNORED");
+    BoolExpSimplifier simplifier(false, true);
+    simplifiesTo(simplifier, "CONFIG_IGNORED && !CONFIG_IGNORED",
+                 "CONFIG_IGNORED && !CONFIG_IGNORED");
+    simplifiesTo(simplifier, "CONFIG_A && !CONFIG_A", "0");
+    KconfigWhitelist::getIgnorelist().clear();
+} END_TEST;
+
+START_TEST(stats) {
+    BoolExpSimplifier simplifier;
+    simplifiesTo(simplifier, "A && (B || C) && (C || B) && (!A || D) && 1",
+                 "A && (B || C) && D");
+    const BoolExpSimplifier::Stats &stats = simplifier.getStats();
+    ck_assert_int_eq(stats.nodesBefore, 16);
+    ck_assert_int_eq(stats.nodesAfter, 7);
+    ck_assert_int_eq(stats.duplicates, 1);
+    ck_assert_int_eq(stats.assumed, 1);
+    fail_unless(stats.constants > 0);
+} END_TEST;
+
+static std::string randomFormula(std::mt19937 &random, int depth) {
+    static const char *atoms[] = {"a", "b", "c", "d", "0", "1"};
+    static const char *ops[] = {" && ", " || ", " -> ", " <-> "};
+    if (depth == 0 || random() % 5 == 0)
+        return atoms[random() % 6];
+    if (random() % 4 == 0)
+        return "!(" + randomFormula(random, depth - 1) + ")";
+    return "(" + randomFormula(random, depth - 1) + ops[random() % 4]
+           + randomFormula(random, depth - 1) + ")";
+}
+
+/* the simplified formula is equivalent, and it doesn't need more clauses */
+START_TEST(equivalence) {
+    std::mt19937 random(4711);
+    BoolExpSimplifier simplifier;
+    for (int i = 0; i < 2000; i++) {
+        BoolExpArena arena;
+        BoolExpArena::Scope scope(&arena);
+        const std::string input = randomFormula(random, 6);
+        BoolExp *e = BoolExp::parseString(input);
+        BoolExp *simplified = simplifier.simplify(e);
+        PicosatCNF cnf;
+        CNFBuilder builder(&cnf);
+        builder.pushClause(new BoolExpNot(new BoolExpEq(e, simplified)));
+        fail_unless(!cnf.checkSatisfiable(), "\"%s\" isn't equivalent to \"%s\"",
+                    input.c_str(), simplified->str().c_str());
+
+        PicosatCNF original, smaller;
+        CNFBuilder(&original).pushClause(e);
+        CNFBuilder(&smaller).pushClause(simplified);
+        fail_unless(smaller.getClauseCount() <= original.getClauseCount(),
+                    "\"%s\" needs more clauses than \"%s\"",
+                    simplified->str().c_str(), input.c_str());
+    }
+} END_TEST;
+
+/* the CNFBuilder simplifies each clause before it is translated */
+START_TEST(builder) {
+    for (const char *input : {"A && !A", "(A || B) && !A && !B", "A <-> !A"}) {
+        PicosatCNF cnf;
+        CNFBuilder builder(&cnf);
+        builder.setSimplify(true);
+        builder.pushClause(BoolExp::parseString(input));
+        fail_unless(!cnf.checkSatisfiable(), "\"%s\" is satisfiable", input);
+    }
+    PicosatCNF cnf;
+    CNFBuilder builder(&cnf, "", false, CNFBuilder::ConstantPolicy::FREE);
+    builder.setSimplify(true);
+    builder.pushClause(BoolExp::parseString("A && 0 && (A || B)"));
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(builder.getSimplifier()->getStats().absorbed
+                + builder.getSimplifier()->getStats().assumed > 0);
+} END_TEST;
+
+Suite *cond_block_suite(void) {
+    Suite *s  = suite_create("Suite: test-BoolExpSimplifier");
+    TCase *tc = tcase_create("BoolExpSimplifier");
+    tcase_add_test(tc, flatten);
+    tcase_add_test(tc, sharedChains);
+    tcase_add_test(tc, negationNormalForm);
+    tcase_add_test(tc, constants);
+    tcase_add_test(tc, complements);
+    tcase_add_test(tc, absorption);
+    tcase_add_test(tc, assumptions);
+    tcase_add_test(tc, ignorelist);
+    tcase_add_test(tc, stats);
+    tcase_add_test(tc, equivalence);
+    tcase_add_test(tc, builder);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
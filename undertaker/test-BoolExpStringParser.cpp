@@ -0,0 +1,184 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "bool.h"
+#include "BoolExpStringParser.h"
+#include "BoolExpArena.h"
+#include "BoolExpSymbolSet.h"
+
+#include <random>
+#include <set>
+#include <string>
+#include <check.h>
+
+using namespace kconfig;
+
+/* both parsers reject the input or build equal trees, the scanner finds
+   the symbols of the tree */
+static void compare(const std::string &input) {
+    BoolExp *expected = BoolExp::parseStringBison(input);
+    BoolExp *e = BoolExpStringParser::parse(input);
+    const std::set<std::string> symbols = BoolExpSymbolSet(expected).getSymbolSet();
+    fail_unless(BoolExpStringParser::symbols(input) == symbols,
+                "\"%s\" has other symbols than its tree", input.c_str());
+    if (!expected) {
+        fail_unless(e == nullptr, "\"%s\" should be rejected, parsed as \"%s\"",
+                    input.c_str(), e->str().c_str());
+    } else {
+        fail_unless(e != nullptr, "\"%s\" should be parsed as \"%s\"",
+                    input.c_str(), expected->str().c_str());
+        fail_unless(e->equals(expected) && e->str() == expected->str(),
+                    "\"%s\" parsed as \"%s\" instead of \"%s\"",
+                    input.c_str(), e->str().c_str(), expected->str().c_str());
+    }
+    delete e;
+    delete expected;
+}
+
+START_TEST(sameTrees) {
+    const char *inputs[] = {
+        // precedence and associativity
+        "A && B || C -> D <-> E", "A <-> B -> C || D && E", "A -> B -> C", "A <-> B <-> C",
+        "!A && !!B", "!(A || B) && C", "!A > B", "A + B * C == D", "A && B < C || D",
+        "(((A)))", "A && (B || (C -> (D <-> E)))",
+        // constants
+        "0", "1", "00", "0l", "0ul", "0uL", "0lu", "12ULL", "12ull", "0x0", "0x1fUL", "0X1",
+        "0xg", "0x", "'a'", "'ab'", "''", "'\n'", "1.5", "123abc", "0lll",
+        // identifiers and model markers
+        "CONFIG_A", "._.x86._.", "B00 && ._.model._.", "a.b_c9", "_", ".", "A B",
+        // function calls
+        "f()", "f(A)", "f(A, B && C)", "f(, A)", "f(A,)", "f(,)", "f(g(h(A)), !B)", "f (A) || B",
+        "defined(CONFIG_A) && defined CONFIG_B", "(f)(A)", "(A, B)", "f((A, B))", "f(A, (B, C))",
+        "f(A)(B)", "f(g(A), B) C",
+        // C operators
+        "A ? B : C", "A & B | C", "A >= B <= C", "A != B", "A >> 2 << 3 <<< 4", "A % 2 / 3 - 1",
+        "A <- B", "A < -B", "A -> -B", "A <<= B", "A = B", "A == B", "!=A", "A !== B",
+        "A &&& B", "A ||| B", "A -- B",
+        // whitespace, invalid characters and truncated input
+        " \t\r\nA\n&&\tB ", "", "   ", "A &&", "&& A", "(A", "A)", "()", "A # B", "A $", "!",
+    };
+    for (const char *input : inputs)
+        compare(input);
+} END_TEST;
+
+/* flex hands NUL bytes and bytes above 0x7f to bison as 'eof', bison
+   reads one more token after the end of an expression */
+START_TEST(endBytes) {
+    const std::string inputs[] = {
+        std::string("A\0", 2), std::string("A\0B", 3), std::string("A \0 \0 B", 7),
+        std::string("A\0\x80" "B", 4), std::string("\0", 1), std::string("f(\0)", 4),
+        std::string("'\0'", 3), "A\x80", "A\x80" "B", "A\xc3\xa4", "A\xc3", "A && \xc3\xa4",
+        "\xc3\xa4", "'\xa4'", "A\x80\n", "A\x80)",
+    };
+    for (const std::string &input : inputs)
+        compare(input);
+} END_TEST;
+
+/* random sequences of token fragments, most of them are invalid */
+START_TEST(randomTokens) {
+    static const char *fragments[] = {
+        "A", "B_1", "._.m._.", "f", "0", "1", "0x1f", "12ul", "'c'", "(", ")", ",", "!", "&&",
+        "||", "->", "<->", "<", "<<", "<<<", "<=", "==", "!=", "=", "-", "&", "|", "?", ":",
+        ">", " ", "\t", "\n", "#", "'", "0u", "l", "x", "\xc3\xa4", "\x80",
+    };
+    const int count = sizeof(fragments) / sizeof(fragments[0]);
+    std::mt19937 random(4711);
+    for (int i = 0; i < 20000; i++) {
+        std::string input;
+        const int length = 1 + random() % 12;
+        for (int j = 0; j < length; j++)
+            input += fragments[random() % count];
+        compare(input);
+    }
+} END_TEST;
+
+static std::string randomFormula(std::mt19937 &random, int depth) {
+    static const char *atoms[] = {"A", "CONFIG_B", "._.x86._.", "0", "1", "0x10", "'c'"};
+    static const char *ops[] = {" && ", " || ", " -> ", " <-> ", " == ", " < ", "+", " ? "};
+    if (depth == 0 || random() % 4 == 0)
+        return atoms[random() % 7];
+    switch (random() % 5) {
+    case 0:
+        return "!" + randomFormula(random, depth - 1);
+    case 1:
+        return "(" + randomFormula(random, depth - 1) + ")";
+    case 2:
+        return "f(" + randomFormula(random, depth - 1) + ", " + randomFormula(random, depth - 1)
+               + ")";
+    default:
+        return randomFormula(random, depth - 1) + ops[random() % 8]
+               + randomFormula(random, depth - 1);
+    }
+}
+
+/* valid formulas, they have to parse */
+START_TEST(randomFormulas) {
+    std::mt19937 random(42);
+    for (int i = 0; i < 5000; i++) {
+        const std::string input = randomFormula(random, 6);
+        BoolExp *e = BoolExpStringParser::parse(input);
+        fail_unless(e != nullptr, "\"%s\" isn't parsed", input.c_str());
+        delete e;
+        compare(input);
+    }
+} END_TEST;
+
+/* a block precondition of a large file, the chain is built without
+   recursion and joined as a balanced tree */
+START_TEST(longChains) {
+    std::string input = "B0";
+    for (int i = 1; i < 100000; i++)
+        input += " && B" + std::to_string(i);
+    BoolExp *e = BoolExpStringParser::parse(input);
+    fail_unless(e != nullptr);
+    int depth = 0;
+    for (BoolExp *node = e; node->left; node = node->left)
+        depth++;
+    // 1563 chains of 64 operands are paired 11 times
+    ck_assert_int_eq(depth, 11 + 63);
+    fail_unless(e->str() == input);
+    // the bison parser chains the operands to the left, the text is the same
+    BoolExp *expected = BoolExp::parseStringBison(input);
+    fail_unless(expected->str() == input);
+    fail_unless(!e->equals(expected));
+    delete expected;
+    delete e;
+} END_TEST;
+
+Suite *cond_block_suite(void) {
+    Suite *s  = suite_create("Suite: test-BoolExpStringParser");
+    TCase *tc = tcase_create("BoolExpStringParser");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, sameTrees);
+    tcase_add_test(tc, endBytes);
+    tcase_add_test(tc, randomTokens);
+    tcase_add_test(tc, randomFormulas);
+    tcase_add_test(tc, longChains);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,255 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "CNFBackbone.h"
+#include "BoolExpArena.h"
+#include "BoolExpPropagator.h"
+#include "PicosatCNF.h"
+#include "bool.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <check.h>
+
+using namespace kconfig;
+
+static void pushClause(PicosatCNF &cnf, std::vector<int> clause) {
+    for (int lit : clause)
+        cnf.pushVar(lit);
+    cnf.pushClause();
+}
+
+/* A is a unit, B follows from (B || C) && (B || !C), D can't be enabled
+   together with B, C and E are free */
+static void buildModel(PicosatCNF &cnf) {
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    cnf.setCNFVar("CONFIG_C", 3);
+    cnf.setCNFVar("CONFIG_D", 4);
+    cnf.setCNFVar("CONFIG_E", 5);
+    cnf.setCNFVar("CONFIG_E_MODULE", 5);
+    pushClause(cnf, {1});
+    pushClause(cnf, {2, 3});
+    pushClause(cnf, {2, -3});
+    pushClause(cnf, {-4, -2});
+    pushClause(cnf, {-5, 3, 1});
+}
+
+START_TEST(backbone) {
+    PicosatCNF cnf;
+    buildModel(cnf);
+    CNFBackbone backbone(cnf);
+    fail_unless(backbone.isSatisfiable());
+    const std::map<std::string, bool> &values = backbone.getValues();
+    ck_assert_int_eq(3, values.size());
+    fail_unless(values.at("CONFIG_A"));
+    fail_unless(values.at("CONFIG_B"));
+    fail_if(values.at("CONFIG_D"));
+    fail_unless(values.find("CONFIG_C") == values.end());
+    fail_unless(values.find("CONFIG_E") == values.end());
+    ck_assert_int_eq(3, backbone.getStats().forced);
+    fail_unless(backbone.getStats().toplevel >= 1);
+    // the model itself is unchanged
+    ck_assert_int_eq(5, cnf.getClauseCount());
+} END_TEST;
+
+START_TEST(sharedVariables) {
+    PicosatCNF cnf;
+    buildModel(cnf);
+    pushClause(cnf, {-3, 5});
+    pushClause(cnf, {3});
+    CNFBackbone backbone(cnf);
+    const std::map<std::string, bool> &values = backbone.getValues();
+    // both names of variable 5 are forced
+    fail_unless(values.at("CONFIG_E"));
+    fail_unless(values.at("CONFIG_E_MODULE"));
+    ck_assert_int_eq(6, values.size());
+} END_TEST;
+
+START_TEST(negatedNames) {
+    PicosatCNF cnf;
+    buildModel(cnf);
+    // names may stand for the negation of a variable
+    cnf.setCNFVar("CONFIG_NOT_A", -1);
+    cnf.setCNFVar("CONFIG_NOT_D", -4);
+    CNFBackbone backbone(cnf);
+    const std::map<std::string, bool> &values = backbone.getValues();
+    fail_unless(values.at("CONFIG_A"));
+    fail_if(values.at("CONFIG_NOT_A"));
+    fail_if(values.at("CONFIG_D"));
+    fail_unless(values.at("CONFIG_NOT_D"));
+} END_TEST;
+
+START_TEST(unsatisfiable) {
+    PicosatCNF cnf;
+    buildModel(cnf);
+    pushClause(cnf, {-1});
+    CNFBackbone backbone(cnf);
+    fail_if(backbone.isSatisfiable());
+    fail_unless(backbone.getValues().empty());
+} END_TEST;
+
+START_TEST(storeAndLoad) {
+    PicosatCNF cnf;
+    buildModel(cnf);
+    std::map<std::string, bool> loaded;
+    fail_if(CNFBackbone::load(cnf, loaded));
+
+    CNFBackbone backbone(cnf);
+    backbone.store(&cnf);
+    std::stringstream stream;
+    cnf.toStream(stream);
+    PicosatCNF read;
+    read.readFromStream(stream);
+    fail_unless(CNFBackbone::load(read, loaded));
+    fail_unless(loaded == backbone.getValues());
+} END_TEST;
+
+START_TEST(propagateConstants) {
+    const std::map<std::string, bool> fixed{{"CONFIG_A", true}, {"CONFIG_D", false}};
+    BoolExpPropagator propagator(fixed, nullptr);
+    std::string residual;
+    ck_assert_int_eq((int) BoolExpPropagator::Result::CONTRADICTION,
+                     (int) propagator.propagate("CONFIG_C && CONFIG_D", residual));
+    ck_assert_int_eq((int) BoolExpPropagator::Result::CONTRADICTION,
+                     (int) propagator.propagate("CONFIG_A -> CONFIG_D", residual));
+    ck_assert_int_eq((int) BoolExpPropagator::Result::TAUTOLOGY,
+                     (int) propagator.propagate("CONFIG_A && (CONFIG_C || !CONFIG_D)",
+                                                residual));
+    ck_assert_int_eq((int) BoolExpPropagator::Result::TAUTOLOGY,
+                     (int) propagator.propagate("CONFIG_A <-> !CONFIG_D", residual));
+    ck_assert_int_eq((int) BoolExpPropagator::Result::RESIDUAL,
+                     (int) propagator.propagate("CONFIG_A && (CONFIG_C || CONFIG_E)",
+                                                residual));
+    ck_assert_str_eq("(CONFIG_C || CONFIG_E)", residual.c_str());
+} END_TEST;
+
+START_TEST(propagateDerived) {
+    const std::map<std::string, bool> fixed{{"CONFIG_A", true}};
+    std::string residual;
+
+    // without a model, variables fixed by the formula are free
+    BoolExpPropagator free(fixed, nullptr);
+    ck_assert_int_eq((int) BoolExpPropagator::Result::TAUTOLOGY,
+                     (int) free.propagate("CONFIG_C && (CONFIG_C -> !CONFIG_E)", residual));
+    ck_assert_int_eq((int) BoolExpPropagator::Result::CONTRADICTION,
+                     (int) free.propagate("CONFIG_C && (CONFIG_A -> !CONFIG_C)", residual));
+
+    // variables of the model have to be checked against it
+    PicosatCNF cnf;
+    buildModel(cnf);
+    BoolExpPropagator propagator(fixed, &cnf);
+    ck_assert_int_eq((int) BoolExpPropagator::Result::RESIDUAL,
+                     (int) propagator.propagate("CONFIG_C && (CONFIG_C -> !CONFIG_E)",
+                                                residual));
+    ck_assert_str_eq("CONFIG_C\n&& !CONFIG_E", residual.c_str());
+    ck_assert_int_eq((int) BoolExpPropagator::Result::TAUTOLOGY,
+                     (int) propagator.propagate("CONFIG_X && CONFIG_A", residual));
+} END_TEST;
+
+START_TEST(propagateOpaque) {
+    const std::map<std::string, bool> fixed{{"CONFIG_A", true}, {"CONFIG_D", false}};
+    BoolExpPropagator propagator(fixed, nullptr);
+    std::string residual;
+    // the CNFBuilder turns constants into free variables, they are kept
+    ck_assert_int_eq((int) BoolExpPropagator::Result::RESIDUAL,
+                     (int) propagator.propagate("CONFIG_D || 0", residual));
+    ck_assert_str_eq("0", residual.c_str());
+    ck_assert_int_eq((int) BoolExpPropagator::Result::RESIDUAL,
+                     (int) propagator.propagate("CONFIG_A && 1", residual));
+    ck_assert_str_eq("1", residual.c_str());
+
+    // unparsable formulas are passed on
+    ck_assert_int_eq((int) BoolExpPropagator::Result::RESIDUAL,
+                     (int) propagator.propagate("CONFIG_A && (", residual));
+    ck_assert_str_eq("CONFIG_A && (", residual.c_str());
+} END_TEST;
+
+/* the residual uses the unchanged subexpressions of the formula */
+START_TEST(propagateSharesNodes) {
+    const std::map<std::string, bool> fixed{{"CONFIG_A", true}, {"CONFIG_D", false}};
+    BoolExpPropagator propagator(fixed, nullptr);
+    BoolExp *unchanged = BoolExp::parseString("CONFIG_X && (CONFIG_A -> CONFIG_Y || CONFIG_Z)");
+    BoolExp *changed = BoolExp::parseString("CONFIG_W || !(CONFIG_D || CONFIG_V)");
+    {
+        BoolExpArena arena;
+        BoolExpArena::Scope scope(&arena);
+        std::vector<BoolExp *> residual;
+        ck_assert_int_eq((int) BoolExpPropagator::Result::RESIDUAL,
+                         (int) propagator.propagate({unchanged, changed}, residual));
+        ck_assert_int_eq(3, residual.size());
+        fail_unless(residual[0] == unchanged->right->right);
+        fail_unless(residual[1] != changed && residual[1]->left == changed->left);
+        ck_assert_str_eq("CONFIG_W || !CONFIG_V", residual[1]->str().c_str());
+        ck_assert_str_eq("CONFIG_X", residual[2]->str().c_str());
+    }
+    ck_assert_str_eq("CONFIG_W || !(CONFIG_D || CONFIG_V)", changed->str().c_str());
+    delete unchanged;
+    delete changed;
+} END_TEST;
+
+/* long chains don't grow the stack, shared subexpressions are evaluated once */
+START_TEST(propagateDeepFormulas) {
+    const std::map<std::string, bool> fixed{{"CONFIG_A", true}, {"CONFIG_D", false}};
+    BoolExpPropagator propagator(fixed, nullptr);
+    std::string chain = "CONFIG_D";
+    for (int i = 0; i < 200000; i++)
+        chain += " || CONFIG_X" + std::to_string(i % 100);
+    std::string residual;
+    ck_assert_int_eq((int) BoolExpPropagator::Result::TAUTOLOGY,
+                     (int) propagator.propagate("CONFIG_A || " + chain, residual));
+
+    BoolExp *shared = BoolExp::parseString("CONFIG_C || CONFIG_A");
+    for (int i = 0; i < 64; i++)
+        shared = new BoolExpOr(shared, shared);
+    BoolExp *unit = new BoolExpVar("A");
+    std::vector<BoolExp *> conjuncts;
+    ck_assert_int_eq((int) BoolExpPropagator::Result::TAUTOLOGY,
+                     (int) propagator.propagate({shared, unit}, conjuncts));
+    delete shared;
+    delete unit;
+} END_TEST;
+
+Suite *cnf_backbone_suite(void) {
+    Suite *s  = suite_create("CNFBackbone-test");
+    TCase *tc = tcase_create("CNFBackbone");
+
+    tcase_add_test(tc, backbone);
+    tcase_add_test(tc, sharedVariables);
+    tcase_add_test(tc, negatedNames);
+    tcase_add_test(tc, unsatisfiable);
+    tcase_add_test(tc, storeAndLoad);
+    tcase_add_test(tc, propagateConstants);
+    tcase_add_test(tc, propagateDerived);
+    tcase_add_test(tc, propagateOpaque);
+    tcase_add_test(tc, propagateSharesNodes);
+    tcase_add_test(tc, propagateDeepFormulas);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cnf_backbone_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,11 +19,15 @@
  */
 
 #include "bool.h"
+#include "BoolExpArena.h"
 #include "CNFBuilder.h"
 #include "PicosatCNF.h"
 #include "exceptions/CNFBuilderError.h"
 
 #include <iostream>
+#include <random>
+#include <string>
+#include <vector>
 #include <check.h>
 
 using namespace kconfig;
@@ -336,6 +340,182 @@ START_TEST(literals) {
 //  build_and_evaluate_strategy("0x0ull", true, false);
 } END_TEST;
 
+START_TEST(sharedGates) {
+    auto shared = new PicosatCNF();
+    CNFBuilder builder(shared, "(x || y) && (y || x) && (x -> z) && (!x || z) && (x <-> z)");
+    // the second disjunction and the implication reuse the first gates
+    ck_assert_int_eq(builder.getSharedGates(), 2);
+
+    auto plain = new PicosatCNF();
+    CNFBuilder other(plain, "(x || y) && (x -> z) && (x <-> z)");
+    // only the two additional conjunctions need variables of their own
+    ck_assert_int_eq(shared->getVarCount(), plain->getVarCount() + 2);
+
+    for (const char *v : {"x", "y", "z"})
+        fail_unless(shared->getCNFVar(v) != 0);
+    shared->pushAssumption("x", true);
+    shared->pushAssumption("z", false);
+    fail_if(shared->checkSatisfiable());
+    shared->pushAssumption("x", false);
+    shared->pushAssumption("y", true);
+    shared->pushAssumption("z", false);
+    fail_unless(shared->checkSatisfiable());
+    delete shared;
+    delete plain;
+} END_TEST;
+
+/* gates that only differ in negations share their variable */
+START_TEST(negatedGates) {
+    PicosatCNF cnf;
+    CNFBuilder builder(&cnf, "(x || y) && !(!x && !y) && (x <-> z) && !(x <-> !z) && (!x <-> !z)");
+    ck_assert_int_eq(builder.getSharedGates(), 3);
+    cnf.pushAssumption("x", false);
+    cnf.pushAssumption("y", true);
+    cnf.pushAssumption("z", false);
+    fail_unless(cnf.checkSatisfiable());
+    cnf.pushAssumption("x", true);
+    cnf.pushAssumption("z", false);
+    fail_if(cnf.checkSatisfiable());
+} END_TEST;
+
+START_TEST(sharedExpression) {
+    BoolExp *e = BoolExp::parseString("(x -> y) && !(y <-> z)");
+    auto first = new PicosatCNF();
+    CNFBuilder(first).pushClause(e);
+
+    // the literals of the first cnf aren't kept in the nodes
+    auto second = new PicosatCNF();
+    second->newVar();
+    second->newVar();
+    CNFBuilder(second).pushClause(e);
+    ck_assert_int_eq(second->getVarCount(), first->getVarCount() + 2);
+
+    for (PicosatCNF *cnf : {first, second}) {
+        cnf->pushAssumption("x", true);
+        cnf->pushAssumption("z", true);
+        fail_if(cnf->checkSatisfiable());
+        cnf->pushAssumption("x", true);
+        cnf->pushAssumption("z", false);
+        fail_unless(cnf->checkSatisfiable());
+        fail_unless(cnf->deref("y"));
+    }
+    delete first;
+    delete second;
+    delete e;
+} END_TEST;
+
+static void countClauses(const char *expression, CNFBuilder::Encoding encoding,
+                         int vars, int clauses) {
+    PicosatCNF cnf;
+    CNFBuilder builder(&cnf, expression, false, CNFBuilder::ConstantPolicy::BOUND, encoding);
+    fail_unless(cnf.getVarCount() == vars && cnf.getClauseCount() == clauses,
+                "%s: %d vars and %d clauses instead of %d and %d", expression,
+                cnf.getVarCount(), cnf.getClauseCount(), vars, clauses);
+}
+
+START_TEST(polarityCounts) {
+    const auto tseitin = CNFBuilder::Encoding::TSEITIN;
+    const auto polarity = CNFBuilder::Encoding::POLARITY;
+    // top-level conjuncts and disjunctions are clauses of their own
+    countClauses("a && b && c && d", tseitin, 7, 10);
+    countClauses("a && b && c && d", polarity, 4, 4);
+    countClauses("(a || b) && (c -> d) && !(a && e)", tseitin, 10, 16);
+    countClauses("(a || b) && (c -> d) && !(a && e)", polarity, 6, 4);
+    // the chain is a single gate, the equivalence needs its positive clauses only
+    countClauses("x <-> a && b && c", tseitin, 7, 11);
+    countClauses("x <-> a && b && c", polarity, 6, 7);
+    // both polarities of a shared gate, but only once
+    countClauses("(a && b -> c) && (d -> a && b)", polarity, 5, 5);
+} END_TEST;
+
+static std::string randomFormula(std::mt19937 &random, int depth) {
+    static const char *atoms[] = {"a", "b", "c", "d", "0", "1"};
+    static const char *ops[] = {" && ", " || ", " -> ", " <-> "};
+    if (depth == 0 || random() % 5 == 0)
+        return atoms[random() % 6];
+    if (random() % 4 == 0)
+        return "!(" + randomFormula(random, depth - 1) + ")";
+    return "(" + randomFormula(random, depth - 1) + ops[random() % 4]
+           + randomFormula(random, depth - 1) + ")";
+}
+
+/* both encodings of first && e are satisfiable for the same assignments of the symbols */
+static void compareEncodings(const std::string &first, BoolExp *e) {
+    PicosatCNF tseitin, polarity;
+    for (PicosatCNF *cnf : {&tseitin, &polarity}) {
+        for (const char *symbol : {"a", "b", "c", "d"})
+            cnf->setCNFVar(symbol, cnf->newVar());
+    }
+    CNFBuilder tseitinBuilder(&tseitin, first);
+    tseitinBuilder.pushClause(e);
+    CNFBuilder polarityBuilder(&polarity, first, false,
+                               CNFBuilder::ConstantPolicy::BOUND,
+                               CNFBuilder::Encoding::POLARITY);
+    polarityBuilder.pushClause(e);
+    fail_unless(polarity.getClauseCount() <= tseitin.getClauseCount());
+
+    for (int assignment = 0; assignment < 16; assignment++) {
+        bool expected = false;
+        for (PicosatCNF *cnf : {&tseitin, &polarity}) {
+            int bit = 0;
+            for (const char *symbol : {"a", "b", "c", "d"})
+                cnf->pushAssumption(symbol, assignment & (1 << bit++));
+            if (cnf == &tseitin)
+                expected = cnf->checkSatisfiable();
+            else
+                fail_unless(cnf->checkSatisfiable() == expected,
+                            "%s && (%s) differs for assignment %d",
+                            first.c_str(), e->str().c_str(), assignment);
+        }
+    }
+}
+
+START_TEST(polarityEquisatisfiable) {
+    std::mt19937 random(4711);
+    for (int i = 0; i < 500; i++) {
+        // two formulas pushed by the same builder may share gates
+        const std::string first = randomFormula(random, 5);
+        BoolExp *e = BoolExp::parseString(randomFormula(random, 4) + " || " + first);
+        compareEncodings(first, e);
+        delete e;
+    }
+} END_TEST;
+
+/* a node with more than one parent is reached with other polarities and
+   as part of other chains */
+START_TEST(polaritySharedNodes) {
+    // y || (y -> d) is a tautology, y is flattened into the chain and is its premise
+    BoolExp *y = B_OR(B_VAR("a", false), B_VAR("c", false));
+    BoolExp *e = B_OR(y, B_IMPL(y, B_VAR("d", false)));
+    compareEncodings("1", e);
+    delete e;
+
+    std::mt19937 random(4711);
+    BoolExpArena arena;
+    for (int i = 0; i < 1000; i++) {
+        // the nodes no root reaches are freed with the arena
+        BoolExpArena::Scope scope(&arena);
+        std::vector<BoolExp *> nodes;
+        for (const char *symbol : {"a", "b", "c", "d"})
+            nodes.push_back(B_VAR(symbol, false));
+        for (int j = 0; j < 12; j++) {
+            BoolExp *l = nodes[random() % nodes.size()];
+            BoolExp *r = nodes[random() % nodes.size()];
+            switch (random() % 5) {
+            case 0:  nodes.push_back(B_AND(l, r)); break;
+            case 1:  nodes.push_back(B_OR(l, r)); break;
+            case 2:  nodes.push_back(B_IMPL(l, r)); break;
+            case 3:  nodes.push_back(new BoolExpEq(l, r)); break;
+            default: nodes.push_back(B_NOT(l)); break;
+            }
+        }
+        // the earlier nodes are shared among the last ones
+        const size_t n = nodes.size();
+        compareEncodings("1", B_OR(nodes[n - 2], nodes[n - 1]));
+        compareEncodings("1", B_AND(B_IMPL(nodes[n - 3], nodes[n - 2]), nodes[n - 1]));
+    }
+} END_TEST;
+
 Suite *cond_block_suite(void) {
     Suite *s  = suite_create("Suite: test-CNFBuilder");
     TCase *tc = tcase_create("CNFBuilder");
@@ -352,6 +532,12 @@ Suite *cond_block_suite(void) {
     tcase_add_test(tc, buildImplNull);
     tcase_add_test(tc, buildCNFVarUsedMultipleTimes);
     tcase_add_test(tc, literals);
+    tcase_add_test(tc, sharedGates);
+    tcase_add_test(tc, negatedGates);
+    tcase_add_test(tc, sharedExpression);
+    tcase_add_test(tc, polarityCounts);
+    tcase_add_test(tc, polarityEquisatisfiable);
+    tcase_add_test(tc, polaritySharedNodes);
     tcase_add_test(tc, buildCNFVarUsedMultipleTimes);
     suite_add_tcase(s, tc);
     return s;
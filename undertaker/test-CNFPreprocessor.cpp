@@ -0,0 +1,251 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "CNFPreprocessor.h"
+#include "PicosatCNF.h"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <check.h>
+
+using namespace kconfig;
+
+static void pushClause(PicosatCNF &cnf, std::vector<int> clause) {
+    for (int lit : clause)
+        cnf.pushVar(lit);
+    cnf.pushClause();
+}
+
+static bool satisfiable(PicosatCNF &cnf, const std::map<std::string, bool> &assumptions) {
+    for (const auto &entry : assumptions)
+        cnf.pushAssumption(entry.first, entry.second);
+    return cnf.checkSatisfiable();
+}
+
+START_TEST(units) {
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    pushClause(cnf, {3});
+    pushClause(cnf, {-3, 1});
+    pushClause(cnf, {-1, -2, 4});
+    pushClause(cnf, {-4, -2});
+
+    CNFPreprocessor preprocessor(&cnf);
+    fail_unless(preprocessor.run());
+    // A is forced, B can't be enabled, the helpers 3 and 4 are gone
+    ck_assert_int_eq(2, cnf.getVarCount());
+    ck_assert_int_eq(2, cnf.getClauseCount());
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref("CONFIG_A"));
+    fail_if(cnf.deref("CONFIG_B"));
+} END_TEST;
+
+START_TEST(equivalences) {
+    // A <-> 3 <-> 4 <-> B, C -> 4
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    cnf.setCNFVar("CONFIG_C", 5);
+    pushClause(cnf, {-1, 3});
+    pushClause(cnf, {-3, 1});
+    pushClause(cnf, {-3, 4});
+    pushClause(cnf, {-4, 3});
+    pushClause(cnf, {-4, 2});
+    pushClause(cnf, {-2, 4});
+    pushClause(cnf, {-5, 4});
+
+    CNFPreprocessor preprocessor(&cnf);
+    fail_unless(preprocessor.run());
+    fail_unless(preprocessor.getStats().equivalences == 3);
+    ck_assert_int_eq(3, cnf.getVarCount());
+    fail_unless(satisfiable(cnf, {{"CONFIG_C", true}}));
+    fail_unless(cnf.deref("CONFIG_A") && cnf.deref("CONFIG_B"));
+    fail_if(satisfiable(cnf, {{"CONFIG_A", true}, {"CONFIG_B", false}}));
+    fail_if(satisfiable(cnf, {{"CONFIG_C", true}, {"CONFIG_A", false}}));
+} END_TEST;
+
+START_TEST(subsumption) {
+    PicosatCNF cnf;
+    for (int v = 1; v <= 4; v++)
+        cnf.setCNFVar("CONFIG_" + std::to_string(v), v);
+    pushClause(cnf, {1, 2});
+    pushClause(cnf, {1, 2, 3});
+    pushClause(cnf, {-1, 2, 4});
+    pushClause(cnf, {1, 3, 4});
+
+    CNFPreprocessor preprocessor(&cnf);
+    fail_unless(preprocessor.run());
+    // (1 2 3) is subsumed, (-1 2 4) is strengthened to (2 4)
+    const CNFPreprocessor::Stats &stats = preprocessor.getStats();
+    fail_unless(stats.subsumed >= 1);
+    fail_unless(stats.strengthened >= 1);
+    ck_assert_int_eq(3, cnf.getClauseCount());
+    ck_assert_int_eq(7, stats.literalsAfter);
+} END_TEST;
+
+START_TEST(elimination) {
+    // tseitin encoding of 5 <-> (A && B) and 6 <-> (5 || C), asserting 6
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    cnf.setCNFVar("CONFIG_B", 2);
+    cnf.setCNFVar("CONFIG_C", 3);
+    pushClause(cnf, {-5, 1});
+    pushClause(cnf, {-5, 2});
+    pushClause(cnf, {5, -1, -2});
+    pushClause(cnf, {-6, 5, 3});
+    pushClause(cnf, {6, -5});
+    pushClause(cnf, {6, -3});
+    pushClause(cnf, {6});
+
+    CNFPreprocessor preprocessor(&cnf);
+    fail_unless(preprocessor.run());
+    fail_unless(preprocessor.getStats().eliminated >= 1);
+    ck_assert_int_eq(3, cnf.getVarCount());
+    fail_unless(cnf.getCNFVar("CONFIG_C") == 3);
+    fail_unless(satisfiable(cnf, {{"CONFIG_A", true}, {"CONFIG_B", true}, {"CONFIG_C", false}}));
+    fail_unless(satisfiable(cnf, {{"CONFIG_A", false}, {"CONFIG_C", true}}));
+    fail_if(satisfiable(cnf, {{"CONFIG_B", false}, {"CONFIG_C", false}}));
+} END_TEST;
+
+START_TEST(failedLiterals) {
+    // 1 implies both 2 and -2
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    pushClause(cnf, {-1, 2});
+    pushClause(cnf, {-1, 3});
+    pushClause(cnf, {-2, -3, 4});
+    pushClause(cnf, {-2, -3, -4});
+
+    CNFPreprocessor preprocessor(&cnf);
+    fail_unless(preprocessor.run());
+    fail_unless(cnf.checkSatisfiable());
+    fail_if(cnf.deref("CONFIG_A"));
+    fail_if(satisfiable(cnf, {{"CONFIG_A", true}}));
+} END_TEST;
+
+START_TEST(unsatisfiable) {
+    PicosatCNF cnf;
+    cnf.setCNFVar("CONFIG_A", 1);
+    pushClause(cnf, {1, 2});
+    pushClause(cnf, {1, -2});
+    pushClause(cnf, {-1, 3});
+    pushClause(cnf, {-1, -3});
+    const std::vector<int> clauses = cnf.getClauses();
+
+    CNFPreprocessor preprocessor(&cnf);
+    fail_if(preprocessor.run());
+    fail_unless(cnf.getClauses() == clauses);
+} END_TEST;
+
+START_TEST(keepsSymbols) {
+    std::stringstream in;
+    in << "c var CONFIG_A 2\n";
+    in << "c var CONFIG_A_MODULE 5\n";
+    in << "c sym A 2\n";
+    in << "c meta_value ARCH x86\n";
+    in << "p cnf 5 3\n";
+    in << "1 0\n-1 2 5 0\n-2 -5 0\n";
+
+    PicosatCNF cnf;
+    cnf.readFromStream(in);
+    CNFPreprocessor preprocessor(&cnf);
+    fail_unless(preprocessor.run());
+    ck_assert_int_eq(2, cnf.getVarCount());
+    fail_unless(cnf.getCNFVar("CONFIG_A") == 1);
+    fail_unless(cnf.getCNFVar("CONFIG_A_MODULE") == 2);
+    fail_unless(cnf.getSymbolName(2) == "CONFIG_A_MODULE");
+    fail_unless(cnf.getSymbolType("A") == K_S_TRISTATE);
+    fail_unless(cnf.getMetaValue("ARCH") != nullptr);
+
+    // the simplified model survives a round trip through the text format
+    std::stringstream out;
+    cnf.toStream(out);
+    PicosatCNF copy;
+    copy.readFromStream(out);
+    fail_unless(copy.getClauses() == cnf.getClauses());
+    fail_unless(copy.getCNFVar("CONFIG_A_MODULE") == 2);
+} END_TEST;
+
+START_TEST(randomModels) {
+    // random models with 6 named and 10 helper variables are preprocessed,
+    // every assignment of the named variables must give the same result
+    std::mt19937 random(4711);
+    const int namedVars = 6, vars = 16;
+    std::uniform_int_distribution<int> var(1, vars), sign(0, 1), width(1, 3), count(10, 30);
+    int checks = 0, simplified = 0;
+    for (int round = 0; round < 300; round++) {
+        PicosatCNF original;
+        for (int v = 1; v <= namedVars; v++)
+            original.setCNFVar("CONFIG_" + std::to_string(v), v);
+        for (int c = count(random); c > 0; c--) {
+            std::vector<int> clause;
+            for (int l = width(random); l > 0; l--)
+                clause.push_back(sign(random) ? var(random) : -var(random));
+            pushClause(original, clause);
+        }
+        PicosatCNF preprocessed(original);
+        CNFPreprocessor preprocessor(&preprocessed);
+        if (!preprocessor.run()) {
+            fail_if(original.checkSatisfiable(), "round %d", round);
+            continue;
+        }
+        if (preprocessor.getStats().clausesAfter < preprocessor.getStats().clausesBefore)
+            simplified++;
+        fail_unless(preprocessed.getVarCount() <= vars);
+        for (int assignment = 0; assignment < (1 << namedVars); assignment++) {
+            std::map<std::string, bool> assumptions;
+            for (int v = 1; v <= namedVars; v++)
+                assumptions["CONFIG_" + std::to_string(v)] = assignment & (1 << (v - 1));
+            fail_unless(satisfiable(original, assumptions)
+                        == satisfiable(preprocessed, assumptions),
+                        "round %d, assignment %d", round, assignment);
+            checks++;
+        }
+    }
+    fail_unless(checks > 3000);
+    fail_unless(simplified > 100);
+} END_TEST;
+
+Suite *cnf_preprocessor_suite(void) {
+    Suite *s  = suite_create("CNFPreprocessor-test");
+    TCase *tc = tcase_create("CNFPreprocessor");
+
+    tcase_add_test(tc, units);
+    tcase_add_test(tc, equivalences);
+    tcase_add_test(tc, subsumption);
+    tcase_add_test(tc, elimination);
+    tcase_add_test(tc, failedLiterals);
+    tcase_add_test(tc, unsatisfiable);
+    tcase_add_test(tc, keepsSymbols);
+    tcase_add_test(tc, randomModels);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cnf_preprocessor_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
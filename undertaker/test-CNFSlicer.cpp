@@ -0,0 +1,162 @@
+/*
+ *   boolean framework for undertaker and satyr
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "CNFSlicer.h"
+#include "PicosatCNF.h"
+
+#include <random>
+#include <vector>
+#include <check.h>
+
+using namespace kconfig;
+
+static void pushClause(PicosatCNF &cnf, std::vector<int> clause) {
+    for (int lit : clause)
+        cnf.pushVar(lit);
+    cnf.pushClause();
+}
+
+START_TEST(components) {
+    PicosatCNF model;
+    pushClause(model, {-2, 1});
+    pushClause(model, {-3, 1});
+    pushClause(model, {4, 5});
+    pushClause(model, {-4, -5});
+
+    CNFSlicer slicer(model);
+    fail_unless(slicer.isUsable());
+
+    // 2 and 3 can be disabled, their clauses are dropped
+    PicosatCNF query1;
+    query1.copySymbols(model);
+    pushClause(query1, {-1});
+    CNFSlicer::Stats stats = slicer.slice(&query1);
+    ck_assert_int_eq(4, stats.clauses);
+    ck_assert_int_eq(2, stats.candidates);
+    ck_assert_int_eq(0, stats.kept);
+    fail_unless(query1.checkSatisfiable());
+
+    PicosatCNF query2;
+    query2.copySymbols(model);
+    pushClause(query2, {2});
+    pushClause(query2, {-1});
+    stats = slicer.slice(&query2);
+    ck_assert_int_eq(2, stats.candidates);
+    ck_assert_int_eq(1, stats.kept);
+    fail_if(query2.checkSatisfiable());
+} END_TEST;
+
+START_TEST(keepsDependencies) {
+    // 2 is forced to false, so 1 has to be true
+    PicosatCNF model;
+    pushClause(model, {1, 2});
+    pushClause(model, {-2});
+
+    CNFSlicer slicer(model);
+    PicosatCNF query;
+    query.copySymbols(model);
+    pushClause(query, {-1});
+    slicer.slice(&query);
+    fail_if(query.checkSatisfiable());
+} END_TEST;
+
+START_TEST(symbols) {
+    PicosatCNF model;
+    model.setCNFVar("CONFIG_A", 1);
+    model.setCNFVar("CONFIG_B", 2);
+    pushClause(model, {-1, 2});
+
+    PicosatCNF query;
+    query.copySymbols(model);
+    fail_unless(query.getCNFVar("CONFIG_B") == 2);
+    fail_unless(query.getClauses().empty());
+    fail_unless(query.newVar() == 3);
+} END_TEST;
+
+START_TEST(unsatisfiableModel) {
+    PicosatCNF model;
+    pushClause(model, {1});
+    pushClause(model, {-1});
+    CNFSlicer slicer(model);
+    fail_if(slicer.isUsable());
+} END_TEST;
+
+START_TEST(randomModels) {
+    std::mt19937 random(42);
+    const int vars = 12;
+    std::uniform_int_distribution<int> var(1, vars), sign(0, 1), length(1, 3), width(2, 3);
+    auto literal = [&]() { return sign(random) ? var(random) : -var(random); };
+
+    int checks = 0;
+    for (int round = 0; round < 200; round++) {
+        PicosatCNF model;
+        for (int c = 0; c < 16; c++) {
+            std::vector<int> clause;
+            for (int l = width(random); l > 0; l--)
+                clause.push_back(literal());
+            pushClause(model, clause);
+        }
+        CNFSlicer slicer(model);
+        if (!slicer.isUsable())
+            continue;
+
+        for (int q = 0; q < 5; q++) {
+            std::vector<std::vector<int>> clauses;
+            for (int c = length(random); c > 0; c--) {
+                std::vector<int> clause;
+                for (int l = length(random); l > 0; l--)
+                    clause.push_back(literal());
+                clauses.push_back(clause);
+            }
+            PicosatCNF full(model), sliced;
+            sliced.copySymbols(model);
+            for (const std::vector<int> &clause : clauses) {
+                pushClause(full, clause);
+                pushClause(sliced, clause);
+            }
+            slicer.slice(&sliced);
+            fail_unless(full.checkSatisfiable() == sliced.checkSatisfiable(),
+                        "round %d, query %d", round, q);
+            checks++;
+        }
+    }
+    fail_unless(checks > 100);
+} END_TEST;
+
+Suite *cnf_slicer_suite(void) {
+    Suite *s  = suite_create("CNFSlicer-test");
+    TCase *tc = tcase_create("CNFSlicer");
+
+    tcase_add_test(tc, components);
+    tcase_add_test(tc, keepsDependencies);
+    tcase_add_test(tc, symbols);
+    tcase_add_test(tc, unsatisfiableModel);
+    tcase_add_test(tc, randomModels);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cnf_slicer_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
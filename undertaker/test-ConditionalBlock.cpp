@@ -83,6 +83,44 @@ START_TEST(cond_getConstraints) {
 
 } END_TEST;
 
+/* only whole symbols are rewritten, words are separated by blanks, parentheses and operators */
+START_TEST(cond_defineRewriting) {
+    std::string exp = "A && (B||!X) && A_B && X==1 && -A";
+    file->rewriteDefinedSymbols(exp);
+    ck_assert_str_eq(exp.c_str(), "A. && (B...||!X.) && A_B && X==1 && -A.");
+
+    std::vector<CppDefine *> used = file->usedDefines("defined(X) || B > A_B || XA || X");
+    ck_assert_int_eq(used.size(), 2);
+    ck_assert_str_eq(used[0]->getActualSymbol().c_str(), "B...");
+    ck_assert_str_eq(used[1]->getActualSymbol().c_str(), "X.");
+} END_TEST;
+
+/* the lines of directives belong to the enclosing block */
+START_TEST(cond_blockAtLine) {
+    ConditionalBlock *expected[] = {
+        nullptr, nullptr, nullptr, nullptr,             // 0-3: #ifndef A
+        block_a, block_a, nullptr, nullptr,             // 4-7: #endif
+        nullptr, nullptr, nullptr, block_b,             // 8-11: #ifdef B, #  if X
+        block_ifdef, block_ifdef, block_b, block_elsif, // 12-15: #  else
+        block_b, nullptr, nullptr,                      // 16-18: #  endif, #endif
+    };
+    std::vector<unsigned int> lines;
+    for (unsigned int line = 0; line < sizeof(expected) / sizeof(*expected); line++) {
+        fail_unless(file->getBlockAtLine(line) == expected[line], "line %u", line);
+        lines.push_back(line);
+    }
+    fail_unless(file->getBlockAtLine(1000) == nullptr);
+
+    std::vector<ConditionalBlock *> blocks = file->getBlocksAtLines(lines);
+    ck_assert_int_eq(blocks.size(), lines.size());
+    for (unsigned int line : lines)
+        fail_unless(blocks[line] == expected[line], "line %u", line);
+
+    fail_unless(file->getBlockAtPosition("x:13:2") == block_ifdef);
+    fail_unless(file->getBlockAtPosition("validation/conditional-block-test:5") == block_a);
+    fail_unless(file->getBlockAtPosition("x:y") == nullptr);
+} END_TEST;
+
 Suite *
 cond_block_suite(void) {
     ConditionalBlock::iterator i = file->topBlock()->begin();
@@ -100,6 +138,8 @@ cond_block_suite(void) {
     TCase *tc = tcase_create("Conditional");
     tcase_add_test(tc, cond_parse_test);
     tcase_add_test(tc, cond_getConstraints);
+    tcase_add_test(tc, cond_defineRewriting);
+    tcase_add_test(tc, cond_blockAtLine);
 
     suite_add_tcase(s, tc);
 
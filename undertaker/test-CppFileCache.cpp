@@ -0,0 +1,178 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConditionalBlock.h"
+#include "PlainConditionalBlock.h"
+#include "CppFileCache.h"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <string>
+#include <check.h>
+
+static const std::string testfile = "validation/conditional-block-test";
+
+static const std::string directory = "test-CppFileCache.cache";
+
+/* each test starts with an empty cache directory */
+static void reset() {
+    CppFile::cache = nullptr;
+    boost::filesystem::remove_all(directory);
+}
+
+static bool restored(const CppFile &file) {
+    return dynamic_cast<PlainConditionalBlock *>(file.topBlock()) != nullptr;
+}
+
+static std::string entryPath() {
+    boost::filesystem::directory_iterator entry(directory);
+    fail_if(entry == boost::filesystem::directory_iterator());
+    return entry->path().string();
+}
+
+static void checkEqualFiles(CppFile &parsed, CppFile &file) {
+    fail_unless(file.good());
+    ck_assert_int_eq(file.size(), parsed.size());
+    ck_assert_int_eq(file.topBlock()->size(), parsed.topBlock()->size());
+    ck_assert_int_eq(file.getDefines()->size(), parsed.getDefines()->size());
+    for (auto a = parsed.begin(), b = file.begin(); a != parsed.end(); ++a, ++b) {
+        ck_assert_str_eq((*b)->getName().c_str(), (*a)->getName().c_str());
+        ck_assert_int_eq((*b)->lineStart(), (*a)->lineStart());
+        ck_assert_int_eq((*b)->colStart(), (*a)->colStart());
+        ck_assert_int_eq((*b)->lineEnd(), (*a)->lineEnd());
+        ck_assert_int_eq((*b)->colEnd(), (*a)->colEnd());
+        fail_unless((*b)->isIfBlock() == (*a)->isIfBlock());
+        fail_unless((*b)->isIfndefine() == (*a)->isIfndefine());
+        fail_unless((*b)->isElseIfBlock() == (*a)->isElseIfBlock());
+        fail_unless((*b)->isElseBlock() == (*a)->isElseBlock());
+        ck_assert_str_eq((*b)->getParent()->getName().c_str(),
+                         (*a)->getParent()->getName().c_str());
+        fail_unless(((*b)->getPrev() == nullptr) == ((*a)->getPrev() == nullptr));
+        ck_assert_int_eq((*b)->size(), (*a)->size());
+        ck_assert_str_eq((*b)->ifdefExpression().c_str(), (*a)->ifdefExpression().c_str());
+        ck_assert_str_eq((*b)->getCodeConstraints().c_str(), (*a)->getCodeConstraints().c_str());
+    }
+    ck_assert_str_eq(file.topBlock()->getCodeConstraints().c_str(),
+                     parsed.topBlock()->getCodeConstraints().c_str());
+}
+
+START_TEST(restore) {
+    reset();
+    CppFileCache cache(directory, "test", {});
+    CppFile::cache = &cache;
+    CppFile parsed(testfile);
+    fail_unless(parsed.good());
+    fail_if(restored(parsed));
+
+    CppFile file(testfile);
+    fail_unless(restored(file));
+    checkEqualFiles(parsed, file);
+    ck_assert_str_eq(file.getFilename().c_str(), testfile.c_str());
+} END_TEST;
+
+/* the dummy blocks of restored files are numbered like the ones of parsed files */
+START_TEST(decisionCoverage) {
+    reset();
+    CppFileCache cache(directory, "test", {});
+    CppFile::cache = &cache;
+    CppFile parsed(testfile);
+    CppFile file(testfile);
+    fail_unless(restored(file));
+    parsed.decisionCoverage();
+    file.decisionCoverage();
+    checkEqualFiles(parsed, file);
+} END_TEST;
+
+/* entries of other versions, include paths and contents aren't used */
+START_TEST(keys) {
+    reset();
+    const std::string copy = directory + "/file.c";
+    boost::filesystem::create_directory(directory);
+    boost::filesystem::copy_file(testfile, copy);
+    {
+        CppFileCache cache(directory + "/cache", "test", {});
+        CppFile::cache = &cache;
+        CppFile parsed(copy);
+        CppFile file(copy);
+        fail_unless(restored(file));
+    }
+    {
+        CppFileCache cache(directory + "/cache", "other", {});
+        CppFile::cache = &cache;
+        CppFile file(copy);
+        fail_if(restored(file));
+    }
+    {
+        CppFileCache cache(directory + "/cache", "test", {"include"});
+        CppFile::cache = &cache;
+        CppFile file(copy);
+        fail_if(restored(file));
+    }
+    CppFileCache cache(directory + "/cache", "test", {});
+    CppFile::cache = &cache;
+    std::ofstream(copy, std::ios::app) << "#ifdef Y\n#endif\n";
+    CppFile file(copy);
+    fail_if(restored(file));
+    // the entry was replaced by the new contents
+    CppFile again(copy);
+    fail_unless(restored(again));
+    checkEqualFiles(file, again);
+} END_TEST;
+
+/* broken entries are parsed again, nothing crashes */
+START_TEST(invalid) {
+    reset();
+    CppFileCache cache(directory, "test", {});
+    CppFile::cache = &cache;
+    CppFile parsed(testfile);
+    const std::string path = entryPath();
+    std::ifstream in(path, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (size_t length = 0; length < data.size(); length++) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << data.substr(0, length);
+        CppFile file(testfile);
+        fail_if(restored(file), "%zu bytes", length);
+        checkEqualFiles(parsed, file);
+    }
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << data << '\0';
+    CppFile file(testfile);
+    fail_if(restored(file));
+} END_TEST;
+
+Suite *cond_block_suite(void) {
+    Suite *s  = suite_create("Suite: test-CppFileCache");
+    TCase *tc = tcase_create("CppFileCache");
+    tcase_add_test(tc, restore);
+    tcase_add_test(tc, decisionCoverage);
+    tcase_add_test(tc, keys);
+    tcase_add_test(tc, invalid);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    reset();
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,235 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConditionalBlock.h"
+#include "PlainConditionalBlock.h"
+#include "DirectiveScanner.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <check.h>
+
+typedef PlainConditionalBlock::Kind Kind;
+
+static const std::string testfile = "test-DirectiveScanner.c";
+
+static bool scan(const std::string &source, PlainConditionalBlockBuilder &builder) {
+    std::ofstream(testfile, std::ios::trunc) << source;
+    return DirectiveScanner(testfile, {}).scan(builder);
+}
+
+static bool refused(const std::string &source) {
+    PlainConditionalBlockBuilder builder;
+    return !scan(source, builder);
+}
+
+static void checkBlock(const PlainConditionalBlockBuilder::Block &block, Kind kind,
+                       size_t parent, size_t prev, unsigned int start, unsigned int end,
+                       const char *expression) {
+    fail_unless(block.kind == kind);
+    ck_assert_int_eq(block.parent, parent);
+    ck_assert_int_eq(block.prev, prev);
+    ck_assert_int_eq(block.start.line, start);
+    ck_assert_int_eq(block.end.line, end);
+    ck_assert_str_eq(block.expression.c_str(), expression);
+}
+
+START_TEST(blocks) {
+    PlainConditionalBlockBuilder builder;
+    fail_unless(scan("#ifdef A\n"
+                     "# if B\n"
+                     "# elif C\n"
+                     "# else\n"
+                     "# endif\n"
+                     "#elif D\n"
+                     "#endif\n"
+                     "\t#ifndef E\n"
+                     "#endif\n",
+                     builder));
+    ck_assert_int_eq(builder.blocks.size(), 6);
+    checkBlock(builder.blocks[0], Kind::IF, 0, 0, 1, 6, "A");
+    checkBlock(builder.blocks[1], Kind::IF, 1, 0, 2, 3, "B");
+    checkBlock(builder.blocks[2], Kind::ELIF, 1, 2, 3, 4, "C");
+    checkBlock(builder.blocks[3], Kind::ELSE, 1, 3, 4, 5, "");
+    checkBlock(builder.blocks[4], Kind::ELIF, 0, 1, 6, 7, "D");
+    checkBlock(builder.blocks[5], Kind::IFNDEF, 0, 0, 8, 9, "E");
+    ck_assert_int_eq(builder.blocks[0].start.column, 1);
+    ck_assert_int_eq(builder.blocks[5].start.column, 2);
+    fail_unless(builder.defines.empty());
+} END_TEST;
+
+/* directives in comments, literals and continued lines aren't directives */
+START_TEST(lexing) {
+    PlainConditionalBlockBuilder builder;
+    fail_unless(scan("/* #if COMMENT\n"
+                     "#endif */\n"
+                     "// #if LINE \\\n"
+                     "#if CONTINUED_COMMENT\n"
+                     "const char *s = \"#if STRING \\\n"
+                     "#if CONTINUED_STRING\";\n"
+                     "char c = '\"'; /* \" */\n"
+                     "#define MACRO(x) \\\n"
+                     "#if IN_MACRO\n"
+                     "#if A && \\\n"
+                     "    B /* trailing */\n"
+                     "#endif\n"
+                     "  #  ifdef C // trailing\n"
+                     "#endif\n"
+                     "foo(); # if NOT_AT_LINE_START\n",
+                     builder));
+    ck_assert_int_eq(builder.blocks.size(), 2);
+    checkBlock(builder.blocks[0], Kind::IF, 0, 0, 10, 12, "A &&     B");
+    checkBlock(builder.blocks[1], Kind::IF, 0, 0, 13, 14, "C");
+    ck_assert_int_eq(builder.blocks[1].start.column, 3);
+} END_TEST;
+
+START_TEST(normalizations) {
+    PlainConditionalBlockBuilder builder;
+    fail_unless(scan("#define X 0\n"
+                     "#define Y 1\n"
+                     "#undef Z\n"
+                     "#if IS_ENABLED(CONFIG_A) || IS_BUILTIN(CONFIG_B) && !IS_MODULE(CONFIG_C)\n"
+                     "#define F(x) x\n"
+                     "#endif\n"
+                     "#define F(x) x\n"
+                     "#define F 1\n"
+                     "#undef F\n"
+                     "#define F 2\n",
+                     builder));
+    ck_assert_int_eq(builder.blocks.size(), 1);
+    ck_assert_str_eq(builder.blocks[0].expression.c_str(),
+                     "(defined(CONFIG_A) || defined(CONFIG_A_MODULE)) || defined(CONFIG_B) "
+                     "&& !defined(CONFIG_C_MODULE)");
+
+    // the directives of the function-like macro F are skipped until it is removed
+    const char *symbols[] = {"X", "Y", "Z", "F"};
+    const bool defines[] = {false, true, false, true};
+    ck_assert_int_eq(builder.defines.size(), 4);
+    for (size_t i = 0; i < 4; i++) {
+        ck_assert_str_eq(builder.defines[i].symbol.c_str(), symbols[i]);
+        fail_unless(builder.defines[i].define == defines[i]);
+        ck_assert_int_eq(builder.defines[i].block, 0);
+    }
+    ck_assert_int_eq(builder.defines[2].blocks, 0);
+    ck_assert_int_eq(builder.defines[3].blocks, 1);
+} END_TEST;
+
+/* files that have to be parsed */
+START_TEST(refusals) {
+    fail_unless(refused("#define F(x) x\n#if F(A)\n#endif\n"));
+    fail_unless(refused("#if __LINE__ > 2\n#endif\n"));
+    fail_unless(refused("#if A /* comment */ || B\n#endif\n"));
+    fail_unless(refused("#if A /* multi\n line */\n#endif\n"));
+    fail_unless(refused("#if IS_ENABLED( A )\n#endif\n"));
+    fail_unless(refused("#if\n#endif\n"));
+    fail_unless(refused("#ifdef\n#endif\n"));
+    fail_unless(refused("#if A\n"));
+    fail_unless(refused("#endif\n"));
+    fail_unless(refused("#else\n"));
+    fail_unless(refused("#if A\n#else\n#elif B\n#endif\n"));
+    fail_unless(refused("#include \"" + testfile + "\"\n"));
+    fail_unless(refused("#include HEADER\n"));
+
+    // macros defined in blocks aren't expanded, headers that aren't found aren't pasted
+    fail_if(refused("#ifdef X\n#define F(x) x\n#endif\n#if F(A)\n#endif\n"));
+    fail_if(refused("#define F(x) x\n#undef F\n#if F(A)\n#endif\n"));
+    fail_if(refused("#include \"no-such-header.h\"\n#include <no-such-header.h>\n"));
+
+    PlainConditionalBlockBuilder builder;
+    fail_if(DirectiveScanner("no-such-file.c", {}).scan(builder));
+} END_TEST;
+
+/* CppFile scans if it is asked to, refused files are parsed */
+START_TEST(cppFile) {
+    std::ofstream(testfile, std::ios::trunc) << "#define X\n#if X || Y\n#else\n#endif\n";
+    CppFile::useScanner = true;
+    CppFile file(testfile);
+    CppFile::useScanner = false;
+    fail_unless(file.good());
+    fail_unless(dynamic_cast<PlainConditionalBlock *>(file.topBlock()) != nullptr);
+    ck_assert_int_eq(file.size(), 2);
+    ck_assert_str_eq(file.front()->getConstraintsHelper().c_str(), "( B0 <-> X. || Y )");
+    ck_assert_str_eq(file.back()->getConstraintsHelper().c_str(), "( B1 <-> ( ! (B0) ) )");
+    ck_assert_int_eq(file.getDefines()->size(), 1);
+} END_TEST;
+
+static std::string withoutBlanks(std::string str) {
+    str.erase(std::remove_if(str.begin(), str.end(), isspace), str.end());
+    return str;
+}
+
+/* scanned files of the test corpora have the blocks and formulas of
+   parsed ones (the blanks of continued conditions may differ) */
+START_TEST(equalToParser) {
+    for (const char *directory : {"validation", "coverage-tests"}) {
+        for (boost::filesystem::directory_iterator entry(directory), last; entry != last;
+             ++entry) {
+            const std::string filename = entry->path().string();
+            if (entry->path().extension() != ".c")
+                continue;
+            CppFile::useScanner = true;
+            CppFile scanned(filename);
+            CppFile::useScanner = false;
+            if (!dynamic_cast<PlainConditionalBlock *>(scanned.topBlock()))
+                continue;
+            CppFile parsed(filename);
+            // files the parser fails on aren't compared
+            if (!parsed.good())
+                continue;
+
+            ck_assert_int_eq(scanned.size(), parsed.size());
+            for (auto a = parsed.begin(), b = scanned.begin(); a != parsed.end(); ++a, ++b) {
+                ck_assert_str_eq((*b)->getName().c_str(), (*a)->getName().c_str());
+                ck_assert_int_eq((*b)->lineStart(), (*a)->lineStart());
+                ck_assert_int_eq((*b)->lineEnd(), (*a)->lineEnd());
+                fail_unless(PlainConditionalBlock::kindOf(*b) == PlainConditionalBlock::kindOf(*a),
+                            "%s: %s", filename.c_str(), (*a)->getName().c_str());
+            }
+            ck_assert_int_eq(scanned.getDefineDirectives().size(),
+                             parsed.getDefineDirectives().size());
+            ck_assert_str_eq(withoutBlanks(scanned.topBlock()->getCodeConstraints()).c_str(),
+                             withoutBlanks(parsed.topBlock()->getCodeConstraints()).c_str());
+        }
+    }
+} END_TEST;
+
+Suite *cond_block_suite(void) {
+    Suite *s  = suite_create("Suite: test-DirectiveScanner");
+    TCase *tc = tcase_create("DirectiveScanner");
+    tcase_add_test(tc, blocks);
+    tcase_add_test(tc, lexing);
+    tcase_add_test(tc, normalizations);
+    tcase_add_test(tc, refusals);
+    tcase_add_test(tc, cppFile);
+    tcase_add_test(tc, equalToParser);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = cond_block_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    std::remove(testfile.c_str());
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
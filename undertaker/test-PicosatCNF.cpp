@@ -20,10 +20,15 @@
 
 #include "bool.h"
 #include "PicosatCNF.h"
+#include "exceptions/IOException.h"
 #include <iostream>
 #include <check.h>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <thread>
+#include <atomic>
 
 using namespace kconfig;
 
@@ -183,6 +188,174 @@ START_TEST(parallelUsage) {
     fail_if(unsatisfiable.checkSatisfiable());
 } END_TEST;
 
+START_TEST(clausesAfterCheck) {
+    PicosatCNF cnf;
+    PicosatCNF other;
+
+    // v1 || v2
+    cnf.pushVar(1);
+    cnf.pushVar(2);
+    cnf.pushClause();
+    cnf.pushAssumption(-1);
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref(2) == true);
+
+    // use another solver in between, cnf must keep its clauses
+    other.pushVar(-2);
+    other.pushClause();
+    fail_unless(other.checkSatisfiable());
+    fail_unless(other.deref(2) == false);
+
+    // !v2, only this clause has to be passed to the solver
+    cnf.pushVar(-2);
+    cnf.pushClause();
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref(1) == true);
+    fail_unless(cnf.deref(2) == false);
+
+    cnf.pushAssumption(-1);
+    fail_if(cnf.checkSatisfiable());
+    fail_unless(other.deref(2) == false);
+} END_TEST;
+
+START_TEST(threadedUsage) {
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&failures, t]() {
+            PicosatCNF cnf;
+            // v1 -> v2 -> ... -> v100
+            for (int i = 1; i < 100; i++) {
+                cnf.pushVar(-i);
+                cnf.pushVar(i + 1);
+                cnf.pushClause();
+            }
+            for (int round = 0; round < 50; round++) {
+                cnf.pushAssumption(1 + (round + t) % 50);
+                if (!cnf.checkSatisfiable() || !cnf.deref(100))
+                    failures++;
+                cnf.pushAssumption(1);
+                cnf.pushAssumption(-100);
+                if (cnf.checkSatisfiable())
+                    failures++;
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+    fail_unless(failures == 0);
+} END_TEST;
+
+START_TEST(layers) {
+    PicosatCNF cnf;
+    // v1 -> v2
+    cnf.setCNFVar("v1", 1);
+    cnf.setCNFVar("v2", 2);
+    cnf.pushVar(-1);
+    cnf.pushVar(2);
+    cnf.pushClause();
+    fail_unless(cnf.checkSatisfiable());
+
+    // v1 && !v2 contradicts the model
+    cnf.pushLayer();
+    cnf.pushVar(1);
+    cnf.pushClause();
+    cnf.pushVar(-2);
+    cnf.pushClause();
+    fail_if(cnf.checkSatisfiable());
+    cnf.popLayer();
+    fail_unless(cnf.checkSatisfiable());
+
+    // variables of a layer are forgotten and reused afterwards
+    cnf.pushLayer();
+    int h = cnf.newVar();
+    cnf.setCNFVar("v3", h);
+    cnf.pushVar(h);
+    cnf.pushClause();
+    cnf.pushVar(-h);
+    cnf.pushVar(1);
+    cnf.pushClause();
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref("v1") && cnf.deref("v2") && cnf.deref("v3"));
+    int clauses = cnf.getClauseCount();
+
+    // nested layers
+    cnf.pushLayer();
+    cnf.pushVar(-2);
+    cnf.pushClause();
+    fail_if(cnf.checkSatisfiable());
+    cnf.popLayer();
+    fail_unless(cnf.getClauseCount() == clauses);
+    fail_unless(cnf.checkSatisfiable());
+    cnf.popLayer();
+
+    fail_unless(cnf.getClauseCount() == 1);
+    fail_unless(cnf.getCNFVar("v3") == 0);
+    cnf.pushLayer();
+    fail_unless(cnf.newVar() == h);
+    cnf.pushVar(-1);
+    cnf.pushClause();
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref(1) == false);
+    cnf.popLayer();
+} END_TEST;
+
+/* retired selectors are reused once the solver is rebuilt */
+START_TEST(manyLayers) {
+    PicosatCNF cnf;
+    // v1 -> v2
+    cnf.setCNFVar("v1", 1);
+    cnf.setCNFVar("v2", 2);
+    cnf.pushVar(-1);
+    cnf.pushVar(2);
+    cnf.pushClause();
+    for (int i = 0; i < 200; i++) {
+        cnf.pushLayer();
+        int h = cnf.newVar();
+        // h <-> v1, with !v2 in every other query
+        cnf.pushVar(-h);
+        cnf.pushVar(1);
+        cnf.pushClause();
+        cnf.pushVar(h);
+        cnf.pushVar(-1);
+        cnf.pushClause();
+        cnf.pushVar(h);
+        cnf.pushClause();
+        if (i % 2) {
+            cnf.pushVar(-2);
+            cnf.pushClause();
+        }
+        fail_unless(cnf.checkSatisfiable() == (i % 2 == 0), "query %d", i);
+        cnf.popLayer();
+        // two variables, h and the selectors of the queries since the last rebuild
+        fail_unless(cnf.getVarCount() <= 10, "%d variables after query %d",
+                    cnf.getVarCount(), i);
+    }
+    fail_unless(cnf.getClauseCount() == 1);
+    fail_unless(cnf.checkSatisfiable());
+} END_TEST;
+
+START_TEST(preferredLiterals) {
+    PicosatCNF cnf(Picosat::SAT_MIN);
+    // !v1 || !v2, without a preference both are false
+    cnf.setCNFVar("v1", 1);
+    cnf.setCNFVar("v2", 2);
+    cnf.pushVar(-1);
+    cnf.pushVar(-2);
+    cnf.pushClause();
+    fail_unless(cnf.checkSatisfiable());
+    fail_if(cnf.deref(1) || cnf.deref(2));
+
+    cnf.preferLiteral(2);
+    fail_unless(cnf.checkSatisfiable());
+    fail_unless(cnf.deref(2));
+    fail_if(cnf.deref(1));
+
+    // the preference only holds for one check
+    fail_unless(cnf.checkSatisfiable());
+    fail_if(cnf.deref(1) || cnf.deref(2));
+} END_TEST;
+
 START_TEST(toFile) {
     std::stringstream file;
 
@@ -288,6 +461,73 @@ START_TEST(toFileWithSymbolTable) {
                 "Expected:\n%s\n\nGot:\n%s", cmp.c_str(), file.str().c_str());
 } END_TEST;
 
+START_TEST(binaryFile) {
+    std::stringstream file;
+    file << "c meta_value ALWAYS_ON v4 v5\n";
+    file << "c sym v1 1\n";
+    file << "c sym v2 2\n";
+    file << "c var v1 1\n";
+    file << "c var v2 2\n";
+    file << "c var v3 3\n";
+    file << "p cnf 4 3\n";
+    file << "-2 1 0\n";
+    file << "-3 1 0\n";
+    file << "-4 2 3 0\n";
+
+    PicosatCNF cnf;
+    cnf.readFromStream(file);
+    const std::string binary = PicosatCNF::binaryFileName("test-PicosatCNF.cnf");
+    cnf.toBinaryFile(binary);
+
+    PicosatCNF copy;
+    copy.readFromBinaryFile(binary);
+    std::stringstream expected, got;
+    cnf.toStream(expected);
+    copy.toStream(got);
+    fail_unless(expected.str() == got.str(),
+                "Expected:\n%s\n\nGot:\n%s", expected.str().c_str(), got.str().c_str());
+    fail_unless(copy.getSymbolType("v2") == K_S_TRISTATE);
+    fail_unless(copy.getAssociatedSymbol("CONFIG_v2_MODULE") != nullptr);
+
+    copy.pushAssumption(4);
+    copy.pushAssumption(-3);
+    fail_unless(copy.checkSatisfiable());
+    fail_unless(copy.deref("v1") && copy.deref("v2"));
+
+    // a damaged file has to be rejected
+    std::fstream damaged(binary, std::ios::in | std::ios::out | std::ios::binary);
+    damaged.seekp(-1, std::ios::end);
+    damaged.put('X');
+    damaged.close();
+    PicosatCNF broken;
+    bool rejected = false;
+    try {
+        broken.readFromBinaryFile(binary);
+    } catch (IOException &e) {
+        rejected = true;
+    }
+    fail_unless(rejected);
+
+    // a binary model belongs to the text model it was written with
+    const std::string text = "test-PicosatCNF.cnf";
+    cnf.toFile(text);
+    cnf.toBinaryFile(binary, text);
+    PicosatCNF current;
+    current.readFromBinaryFile(binary, text);
+    fail_unless(current.getVarCount() == cnf.getVarCount());
+    std::ofstream(text, std::ios::app) << "-1 0\n";
+    PicosatCNF stale;
+    rejected = false;
+    try {
+        stale.readFromBinaryFile(binary, text);
+    } catch (IOException &e) {
+        rejected = true;
+    }
+    fail_unless(rejected);
+    std::remove(text.c_str());
+    std::remove(binary.c_str());
+} END_TEST;
+
 START_TEST(readCnfFileWithInts) {
     std::stringstream file;
 
@@ -425,8 +665,14 @@ Suite *cond_block_suite(void) {
     tcase_add_test(tc, moreComplexModel);
     tcase_add_test(tc, sequentialUsage);
     tcase_add_test(tc, parallelUsage);
+    tcase_add_test(tc, clausesAfterCheck);
+    tcase_add_test(tc, threadedUsage);
+    tcase_add_test(tc, layers);
+    tcase_add_test(tc, manyLayers);
+    tcase_add_test(tc, preferredLiterals);
     tcase_add_test(tc, toFile);
     tcase_add_test(tc, toFileWithSymbolTable);
+    tcase_add_test(tc, binaryFile);
     tcase_add_test(tc, readCnfFileWithInts);
     tcase_add_test(tc, readCnfFileWithStrings);
     tcase_add_test(tc, addClausesToCnfFromFile);
@@ -0,0 +1,168 @@
+/*
+ *   undertaker - analyze preprocessor blocks in code
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SatCache.h"
+#include "PicosatCNF.h"
+
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <check.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+START_TEST(normalize) {
+    const std::string got = SatCache::normalize("B7\n&&\n( B7 <-> CONFIG_B3 )\n&&\n( B12 -> B7 )");
+    const std::string expected = "B0 && ( B0 <-> CONFIG_B3 ) && ( B1 -> B0 )";
+    fail_unless(got == expected, "Expected: '%s', Got: '%s'", expected.c_str(), got.c_str());
+
+    // B00 and B0 are different blocks
+    fail_unless(SatCache::normalize("B00 && !B0") == "B0 && !B1");
+} END_TEST;
+
+START_TEST(keys) {
+    SatCache cache(16);
+    fail_unless(cache.key("B3 && (B3 <-> CONFIG_FOO)")
+                == cache.key("B9\n&&\n(B9 <-> CONFIG_FOO)"));
+    fail_if(cache.key("B3 && (B3 <-> CONFIG_FOO)") == cache.key("B3 && (B3 <-> CONFIG_BAR)"));
+    fail_if(cache.key("B3 && B4") == cache.key("B3 && B3"));
+    fail_if(cache.key("B3", 1) == cache.key("B3", 2));
+
+    // the block variables of a formula are numbered across its constraints
+    Formula first, second, third;
+    first.push_back("B3 && B4");
+    first.push_back("B4 -> CONFIG_FOO");
+    second.push_back("B8 && B2");
+    second.push_back("B2 -> CONFIG_FOO");
+    third.push_back("B8 && B2");
+    third.push_back("B8 -> CONFIG_FOO");
+    fail_unless(cache.key(first) == cache.key(second));
+    fail_if(cache.key(first) == cache.key(third));
+    fail_unless(cache.key(Formula("B1 && B1")) == cache.key("B5 && B5"));
+
+    // results depend on the ignorelist, but not on its order
+    const SatCache::Key plain = cache.key("CONFIG_FOO");
+    cache.setContext("1.0", {"CONFIG_FOO", "CONFIG_BAR"});
+    const SatCache::Key ignored = cache.key("CONFIG_FOO");
+    fail_if(ignored == plain);
+    cache.setContext("1.0", {"CONFIG_BAR", "CONFIG_FOO"});
+    fail_unless(cache.key("CONFIG_FOO") == ignored);
+    cache.setContext("1.1", {"CONFIG_BAR", "CONFIG_FOO"});
+    fail_if(cache.key("CONFIG_FOO") == ignored);
+} END_TEST;
+
+START_TEST(identity) {
+    std::stringstream file, same, renamed;
+    file << "c var A 1\n";
+    file << "c var B 2\n";
+    file << "p cnf 2 1\n";
+    file << "-2 1 0\n";
+    same << file.str();
+    renamed << "c var A 1\nc var C 2\np cnf 2 1\n-2 1 0\n";
+
+    kconfig::PicosatCNF cnf, copy, other;
+    cnf.readFromStream(file);
+    copy.readFromStream(same);
+    other.readFromStream(renamed);
+    fail_unless(SatCache::identity(cnf) == SatCache::identity(copy));
+    fail_if(SatCache::identity(cnf) == SatCache::identity(other));
+} END_TEST;
+
+START_TEST(lookup) {
+    SatCache cache(16);
+    SatCache::Key sat = cache.key("A"), unsat = cache.key("A && !A");
+
+    fail_unless(cache.lookup(sat) == SatCache::Result::UNKNOWN);
+    cache.insert(sat, true);
+    cache.insert(unsat, false);
+    cache.insert(sat, true);
+    fail_unless(cache.lookup(sat) == SatCache::Result::SAT);
+    fail_unless(cache.lookup(unsat) == SatCache::Result::UNSAT);
+
+    SatCache::Stats stats = cache.getStats();
+    fail_unless(stats.hits == 2);
+    fail_unless(stats.misses == 1);
+    fail_unless(stats.entries == 2);
+    fail_unless(stats.capacity == 64);
+} END_TEST;
+
+START_TEST(sharedWithChildren) {
+    SatCache cache;
+    pid_t pid = fork();
+    if (pid == 0) {
+        cache.insert(cache.key("CHILD"), true);
+        _exit(cache.lookup(cache.key("CHILD")) == SatCache::Result::SAT ? 0 : 1);
+    }
+    int status = 0;
+    fail_unless(waitpid(pid, &status, 0) == pid);
+    fail_unless(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    fail_unless(cache.lookup(cache.key("CHILD")) == SatCache::Result::SAT);
+    fail_unless(cache.getStats().hits == 2);
+} END_TEST;
+
+START_TEST(persistent) {
+    const char *filename = "test-SatCache.cache";
+    remove(filename);
+    {
+        SatCache cache(filename, 128);
+        cache.insert(cache.key("B1 && B2"), true);
+        cache.insert(cache.key("B1 && !B1"), false);
+    }
+    {
+        SatCache cache(filename);
+        fail_unless(cache.lookup(cache.key("B5 && B6")) == SatCache::Result::SAT);
+        fail_unless(cache.lookup(cache.key("B5 && !B5")) == SatCache::Result::UNSAT);
+        SatCache::Stats stats = cache.getStats();
+        fail_unless(stats.hits == 2);
+        fail_unless(stats.entries == 2);
+        fail_unless(stats.capacity == 128);
+    }
+    // files of other formats are overwritten
+    FILE *f = fopen(filename, "w");
+    fputs("garbage", f);
+    fclose(f);
+    {
+        SatCache cache(filename);
+        fail_unless(cache.lookup(cache.key("B5 && B6")) == SatCache::Result::UNKNOWN);
+        fail_unless(cache.getStats().entries == 0);
+    }
+    remove(filename);
+} END_TEST;
+
+Suite *sat_cache_suite(void) {
+    Suite *s  = suite_create("SatCache-test");
+    TCase *tc = tcase_create("SatCache");
+
+    tcase_add_test(tc, normalize);
+    tcase_add_test(tc, keys);
+    tcase_add_test(tc, identity);
+    tcase_add_test(tc, lookup);
+    tcase_add_test(tc, sharedWithChildren);
+    tcase_add_test(tc, persistent);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main() {
+    Suite *s = sat_cache_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
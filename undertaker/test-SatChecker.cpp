@@ -22,12 +22,17 @@
  */
 
 #include "SatChecker.h"
+#include "PicosatCNF.h"
+#include "ModelContainer.h"
+#include "exceptions/CNFBuilderError.h"
 
 #include <assert.h>
 #include <typeinfo>
 #include <string>
 #include <sstream>
 #include <set>
+#include <fstream>
+#include <cstdio>
 #include <check.h>
 
 
@@ -109,6 +114,204 @@ START_TEST(test_base_expression) {
     fail_if(sat(a1));
 } END_TEST
 
+START_TEST(assignment_view) {
+    SatChecker sat("X && !Y && (Z || W)");
+    fail_unless(sat());
+
+    const SatChecker::AssignmentView &assignment = sat.getAssignment();
+    fail_unless(assignment["X"]);
+    fail_if(assignment["Y"]);
+    fail_unless(assignment["Z"] || assignment["W"]);
+    fail_unless(assignment.contains("W"));
+    fail_if(assignment.contains("UNKNOWN"));
+    fail_if(assignment["UNKNOWN"]);
+
+    // helper variables of the tseitin transformation are not visible
+    int named = 0;
+    assignment.forEach([&named](kconfig::StringRef, bool) { named++; });
+    ck_assert_int_eq(4, named);
+
+    SatChecker::AssignmentMap m = assignment.materialize(std::set<std::string>{"X", "Y", "FOO"});
+    ck_assert_int_eq(2, m.size());
+    fail_unless(m["X"] == true && m["Y"] == false);
+    fail_unless(assignment.materialize().size() == 4);
+} END_TEST
+
+/* simplified formulas keep the free constants of ConstantPolicy::FREE */
+START_TEST(simplified_checks) {
+    const std::vector<std::vector<std::string>> formulas{
+        {"!(!(0))", "!(0)"}, {"X2", "0"}, {"0 && (X || 1)"}, {"(X || !X) <-> 0"},
+        {"X && !X"}, {"(X -> Y) && X && !Y"}, {"B1 && (B1 <-> 0) && !B1"},
+    };
+    using Encoding = kconfig::CNFBuilder::Encoding;
+    for (auto encoding : {Encoding::TSEITIN, Encoding::POLARITY}) {
+        SatChecker::encoding = encoding;
+        for (const std::vector<std::string> &constraints : formulas) {
+            Formula formula;
+            for (const std::string &constraint : constraints)
+                formula.push_back(constraint);
+            SatChecker::simplifyFormulas = false;
+            const bool expected = SatChecker(formula)();
+            SatChecker::simplifyFormulas = true;
+            fail_unless(SatChecker(formula)() == expected, "%s changed by simplification",
+                        formula.str().c_str());
+        }
+    }
+    SatChecker::simplifyFormulas = false;
+    SatChecker::encoding = Encoding::POLARITY;
+} END_TEST
+
+START_TEST(cached_checks) {
+    SatCache cache;
+    SatChecker::cache = &cache;
+
+    SatChecker first("B1 && (B1 <-> X) && !Y");
+    fail_unless(first());
+    SatChecker second("B7 && (B7 <-> X) && !Y");
+    fail_unless(second());
+    ck_assert_int_eq(1, cache.getStats().hits);
+    // the solution of a cached result is computed when it is asked for
+    fail_unless(second.getAssignment()["B7"]);
+    fail_unless(second.getAssignment()["X"]);
+
+    SatChecker unsat("B3 && (B3 <-> X) && !X");
+    fail_if(unsat());
+    fail_if(unsat());
+    fail_unless(unsat.getCNF() != nullptr);
+    ck_assert_int_eq(2, cache.getStats().hits);
+
+    SatChecker::cache = nullptr;
+} END_TEST
+
+START_TEST(sliced_checks) {
+    // CONFIG_C is unrelated to the other items
+    std::ofstream model("slicetest.cnf");
+    model << "c var CONFIG_A 1\nc var CONFIG_B 2\nc var CONFIG_C 3\n";
+    model << "p cnf 3 2\n-1 2 0\n-3 0\n";
+    model.close();
+    fail_unless(ModelContainer::loadModels("slicetest.cnf") != nullptr);
+    remove("slicetest.cnf");
+
+    SatChecker::modelSlicing = SatChecker::Slicing::VALIDATE;
+    SatChecker unsat("B1 && (B1 <-> CONFIG_A) && !CONFIG_B && ._.slicetest._.");
+    fail_if(unsat());
+
+    SatChecker::modelSlicing = SatChecker::Slicing::SLICE;
+    SatChecker sat("B1 && (B1 <-> CONFIG_A) && ._.slicetest._.");
+    fail_unless(sat());
+    // the solution is computed on the whole model
+    fail_unless(sat.getAssignment()["CONFIG_B"]);
+    fail_if(sat.getAssignment()["CONFIG_C"]);
+
+    SatChecker::modelSlicing = SatChecker::Slicing::NONE;
+} END_TEST
+
+START_TEST(backbone_checks) {
+    // CONFIG_A is forced by the model, CONFIG_C can't be enabled
+    std::ofstream model("backbonetest.cnf");
+    model << "c var CONFIG_A 1\nc var CONFIG_B 2\nc var CONFIG_C 3\n";
+    model << "c meta_value BACKBONE CONFIG_A !CONFIG_C\n";
+    model << "p cnf 3 3\n1 0\n-3 0\n-2 1 0\n";
+    model.close();
+    fail_unless(ModelContainer::loadModels("backbonetest.cnf") != nullptr);
+    remove("backbonetest.cnf");
+
+    SatChecker dead("B1 && (B1 <-> CONFIG_C) && ._.backbonetest._.");
+    fail_if(dead());
+    SatChecker undead("B1 && (B1 <-> !CONFIG_A) && ._.backbonetest._.");
+    fail_if(undead());
+    // the solution is still computed on the model
+    SatChecker alive("B1 && (B1 <-> CONFIG_A) && ._.backbonetest._.");
+    fail_unless(alive());
+    fail_unless(alive.getAssignment()["B1"]);
+    fail_if(alive.getAssignment()["CONFIG_C"]);
+    SatChecker residual("B1 && (B1 <-> CONFIG_B) && ._.backbonetest._.");
+    fail_unless(residual());
+    fail_unless(residual.getAssignment()["CONFIG_B"]);
+
+    // the residual keeps parts of the constraints, the sliced check validates it
+    SatChecker::modelSlicing = SatChecker::Slicing::VALIDATE;
+    SatChecker partial("B1 && (B1 <-> (CONFIG_B || CONFIG_C || B2)) && !B2"
+                       " && ._.backbonetest._.");
+    fail_unless(partial());
+    fail_unless(partial.getAssignment()["CONFIG_B"]);
+    SatChecker::modelSlicing = SatChecker::Slicing::NONE;
+} END_TEST
+
+START_TEST(formula_checks) {
+    std::ofstream model("formulatest.cnf");
+    model << "c var CONFIG_A 1\nc var CONFIG_B 2\n";
+    model << "p cnf 2 1\n-1 2 0\n";
+    model.close();
+    fail_unless(ModelContainer::loadModels("formulatest.cnf") != nullptr);
+    remove("formulatest.cnf");
+
+    // the constraints are shared by several formulas and translated into several cnfs
+    auto block = std::make_shared<Constraint>("( B1 <-> CONFIG_A )");
+    Formula formula;
+    formula.push_back("B1");
+    formula.push_back(block);
+    formula.push_back("!CONFIG_B");
+    Formula code(formula);
+    formula.push_back("._.formulatest._.");
+    ck_assert_str_eq(formula.str().c_str(),
+                     "B1\n&& ( B1 <-> CONFIG_A )\n&& !CONFIG_B\n&& ._.formulatest._.");
+
+    SatChecker withModel(formula);
+    fail_if(withModel());
+    fail_if(SatChecker(formula.str())());
+    SatChecker withoutModel(code);
+    fail_unless(withoutModel());
+    fail_unless(withoutModel.getAssignment()["CONFIG_A"]);
+    fail_if(withoutModel.getAssignment().contains("._.formulatest._."));
+
+    Formula alive;
+    alive.push_back("B1");
+    alive.push_back(block);
+    alive.push_back("._.formulatest._.");
+    SatChecker aliveChecker(alive);
+    fail_unless(aliveChecker());
+    fail_unless(aliveChecker.getAssignment()["CONFIG_B"]);
+
+    // a model reference within a longer constraint is found as well
+    Formula embedded;
+    embedded.push_back("B1 && ( B1 <-> CONFIG_A ) && ._.formulatest._.");
+    embedded.push_back("!CONFIG_B");
+    fail_if(SatChecker(embedded)());
+
+    Formula invalid;
+    invalid.push_back(block);
+    invalid.push_back("B1 &&");
+    SatChecker invalidChecker(invalid);
+    bool thrown = false;
+    try {
+        invalidChecker();
+    } catch (CNFBuilderError &) {
+        thrown = true;
+    }
+    fail_unless(thrown);
+} END_TEST
+
+/* the checks are retracted from the shared cnf, each one sees its own formula only */
+START_TEST(shared_checks) {
+    kconfig::PicosatCNF shared;
+    SatChecker file("FILE_a && (FILE_a -> CONFIG_A) && !CONFIG_C");
+    file.setSharedCNF(&shared);
+    fail_unless(file());
+    fail_unless(file.getAssignment()["CONFIG_A"]);
+    fail_unless(file.getCNF() == nullptr);
+
+    // more variables than before, picosat grows while it knows binary clauses
+    SatChecker block("B0 && (B0 <-> CONFIG_A) && B00 && (B00 <-> FILE_a) && !CONFIG_A");
+    block.setSharedCNF(&shared);
+    fail_if(block());
+    SatChecker other("B1 && (B1 <-> !CONFIG_A) && (CONFIG_B -> CONFIG_D) && CONFIG_C");
+    other.setSharedCNF(&shared);
+    fail_unless(other());
+    fail_if(other.getAssignment()["CONFIG_A"]);
+    fail_unless(other.getAssignment()["CONFIG_C"]);
+} END_TEST
+
 Suite * satchecker_suite(void) {
     Suite *s  = suite_create("SatChecker");
     TCase *tc = tcase_create("SatChecker");
@@ -116,6 +319,13 @@ Suite * satchecker_suite(void) {
     tcase_add_test(tc, format_config_items_module);
     tcase_add_test(tc, format_config_items_module_not_valid_in_kconfig);
     tcase_add_test(tc, test_base_expression);
+    tcase_add_test(tc, assignment_view);
+    tcase_add_test(tc, simplified_checks);
+    tcase_add_test(tc, cached_checks);
+    tcase_add_test(tc, sliced_checks);
+    tcase_add_test(tc, backbone_checks);
+    tcase_add_test(tc, formula_checks);
+    tcase_add_test(tc, shared_checks);
 
     suite_add_tcase(s, tc);
 
@@ -24,18 +24,28 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "StringJoiner.h"
+#include "BoolExpArena.h"
+#include "BoolExpBinary.h"
 #include "KconfigWhitelist.h"
 #include "ModelContainer.h"
 #include "RsfConfigurationModel.h"
+#include "CnfConfigurationModel.h"
+#include "PicosatCNF.h"
 #include "PumaConditionalBlock.h"
 #include "ConditionalBlock.h"
 #include "BlockDefectAnalyzer.h"
 #include "SatChecker.h"
+#include "SatCache.h"
+#include "CppFileCache.h"
 #include "CoverageAnalyzer.h"
 #include "Logging.h"
 #include "Tools.h"
+#include "cpp14.h"
+#include "exceptions/IOException.h"
 #include "../version.h"
 
+#include <algorithm>
+#include <climits>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -68,6 +78,8 @@ static const char *coverage_exec_cmd = "cat";
 static bool skip_non_configuration_based_defects = false;
 static bool decision_coverage = false;
 static bool do_mus_analysis = false;
+static bool use_block_witnesses = false;
+static bool cpppc_binary = false;
 
 void usage(std::ostream &out, const char *error) {
     if (error)
@@ -89,6 +101,26 @@ void usage(std::ostream &out, const char *error) {
     out << "  -I  add an include path for #include directives\n";
     out << "  -s  skip non-configuration based defect reports\n";
     out << "  -u  report a 'minimal unsatisfiable subset' of the defect-formula\n";
+    out << "  -w  skip dead/undead checks of blocks that solutions of previous\n";
+    out << "      checks of the same file already settle\n";
+    out << "  -r  load cnf models into the sat solver only once and check\n";
+    out << "      all formulas incrementally on top of them\n";
+    out << "  -K  cache the sat results of the run in memory, shared by all\n";
+    out << "      workers (24 MiB of address space for 2^20 results)\n";
+    out << "  -k  keep the sat results in the given cache file across runs\n";
+    out << "  -P  keep the parsed blocks of files in the given cache directory\n";
+    out << "      across runs, unchanged files aren't parsed again\n";
+    out << "  -p  how the blocks of files are read\n";
+    out << "      - puma: parse the files with the puma preprocessor (default)\n";
+    out << "      - scan: scan the directives only, files that need macro expansion\n";
+    out << "              or include other files are parsed with puma\n";
+    out << "  -S  check formulas only on the part of cnf models they depend on\n";
+    out << "      - slice: check on the slice only\n";
+    out << "      - validate: check both ways and report differing results\n";
+    out << "  -E  encoding of the formulas in the sat solver\n";
+    out << "      - polarity: only the implications the formula needs (default)\n";
+    out << "      - tseitin: an equivalent variable for each subexpression\n";
+    out << "  -e  simplify formulas before they are handed to the sat solver\n";
     out << "  -j  specify the jobs which should be done\n";
     out << "      - dead: dead/undead file analysis (default)\n";
     out << "      - coverage: coverage file analysis\n";
@@ -111,6 +143,8 @@ void usage(std::ostream &out, const char *error) {
     out << "      - model:    print all options which are in the configuration space\n";
     out << "      - all:      dump every assigned symbol (both items and code blocks)\n";
     out << "      - combined: create files for both configuration and pre-commended sources\n";
+    out << "      - binary:   (cpppc) write the precondition of each file to <file>.cpppc\n";
+    out << "                  in the binary format of BoolExpBinary.h instead of printing it\n";
     out << "  -C: specify coverage algorithm\n";
     out << "      simple           - relative simple and fast algorithm (default)\n";
     out << "      min              - slow but generates less configuration sets\n";
@@ -135,23 +169,41 @@ int rm_pattern(const char *pattern) {
     return nr;
 }
 
-bool process_blockconf_helper(StringJoiner &sj, std::map<std::string, bool> &filesolvable,
-                              const std::string &locationname) {
-    // used by process_blockconf and process_mergedblockconf
+//! a location ("file:line") for the blockconf jobs, with the constraints it adds
+struct BlockLocation {
+    std::string name, file;
+    unsigned int line;
+    std::vector<std::string> constraints;
+};
 
-    boost::regex regex("(.*):[0-9]+");
+static bool parseBlockLocation(const std::string &name, BlockLocation &location) {
+    static const boost::regex regex("(.*):([0-9]+)");
     boost::smatch results;
-    if (!boost::regex_match(locationname, results, regex)) {
+    if (!boost::regex_match(name, results, regex)) {
         Logging::error("invalid format for block precondition");
         return false;
     }
+    location.name = name;
+    location.file = results[1];
+    const unsigned long line = std::strtoul(results.str(2).c_str(), nullptr, 10);
+    location.line = std::min<unsigned long>(line, UINT_MAX);
+    return true;
+}
 
-    std::string file = results[1];
-
+/* Adds the constraints of the blocks at locations, which are in file, to
+   the locations. The file is parsed once, its condition is checked only
+   the first time its file variable is seen and added to the first of the
+   locations. The block preconditions are checked as layers of one solver:
+   the query solver of a CNF model or the one that is passed. */
+static void process_blockconf_file(const std::string &file,
+                                   const std::vector<BlockLocation *> &locations,
+                                   std::map<std::string, bool> &filesolvable,
+                                   kconfig::PicosatCNF *solver) {
+    // used by process_blockconf and process_mergeblockconf
     CppFile cpp(file);
     if (!cpp.good()) {
         Logging::error("failed to open file: `", file, "'");
-        return false;
+        return;
     }
     // if the current file is arch specific, use only the matching model for analyses
     ConfigurationModel *main_model;
@@ -167,10 +219,11 @@ bool process_blockconf_helper(StringJoiner &sj, std::map<std::string, bool> &fil
         // and conflicts with user defined lists, don't add it to formula
         if (!filesolvable[fileVar]) {
             Logging::warn("File ", file, " not included - conflict with white-/blacklist");
-            return false;
+            return;
         }
     } else {
         // ...otherwise test it and remember the result
+        std::vector<std::string> &constraints = locations.front()->constraints;
         if (main_model) {
             std::string fileCondition = fileVar;
             std::set<std::string> missing;
@@ -184,45 +237,65 @@ bool process_blockconf_helper(StringJoiner &sj, std::map<std::string, bool> &fil
             }
 
             SatChecker fileChecker(fileCondition);
+            fileChecker.setSharedCNF(solver);
             if (!fileChecker()) {
                 filesolvable[fileVar] = false;
-                Logging::warn("File condition for location ", locationname,
+                Logging::warn("File condition for location ", locations.front()->name,
                               " conflicting with black-/whitelist - not added");
-                return false;
-            } else {
-                filesolvable[fileVar] = true;
-                sj.push_back(intersected);
+                return;
             }
+            if (!intersected.empty())
+                constraints.push_back(intersected);
         }
-        sj.push_back(fileVar);
+        filesolvable[fileVar] = true;
+        constraints.push_back(fileVar);
     }
 
-    ConditionalBlock *block = cpp.getBlockAtPosition(locationname);
-    if (block == nullptr) {
-        Logging::info("No block found at ", locationname);
-        return false;
-    }
+    std::vector<unsigned int> lines;
+    for (const BlockLocation *location : locations)
+        lines.push_back(location->line);
+    const std::vector<ConditionalBlock *> blocks = cpp.getBlocksAtLines(lines);
+
+    // blocks that many locations point into are checked and added only once
+    std::set<ConditionalBlock *> processed;
+    for (size_t i = 0; i < locations.size(); i++) {
+        ConditionalBlock *block = blocks[i];
+        if (block == nullptr) {
+            Logging::info("No block found at ", locations[i]->name);
+            continue;
+        }
+        if (!processed.insert(block).second)
+            continue;
 
-    // Get the precondition for current block
-    std::string precondition = BlockDefectAnalyzer::getBlockPrecondition(block, main_model);
+        // Get the precondition for current block
+        Formula precondition = BlockDefectAnalyzer::getBlockPrecondition(block, main_model);
 
-    Logging::info("Processing block ", block->getName());
+        Logging::info("Processing block ", block->getName());
 
-    // check for satisfiability of block precondition before joining it
-    try {
-        SatChecker constraintChecker(precondition);
-        if (!constraintChecker()) {
-            Logging::warn("Code constraints for ", block->getName(),
-                          " not satisfiable - override by black-/whitelist");
-            return false;
-        } else {
-            sj.push_back(precondition);
+        // check for satisfiability of block precondition before joining it
+        try {
+            SatChecker constraintChecker(precondition);
+            constraintChecker.setIncremental(true);
+            constraintChecker.setSharedCNF(solver);
+            if (!constraintChecker()) {
+                Logging::warn("Code constraints for ", block->getName(),
+                              " not satisfiable - override by black-/whitelist");
+            } else {
+                locations[i]->constraints.push_back(precondition.str());
+            }
+        } catch (std::runtime_error &e) {
+            Logging::error("failed: ", e.what());
         }
-    } catch (std::runtime_error &e) {
-        Logging::error("failed: ", e.what());
-        return false;
     }
-    return true;
+}
+
+//! \return the constraints of the locations, in their order
+static StringJoiner joinBlockLocations(const std::vector<BlockLocation> &locations) {
+    StringJoiner sj;
+    for (const BlockLocation &location : locations)
+        for (const std::string &constraint : location.constraints)
+            sj.push_back(constraint);
+    return sj;
 }
 
 void process_mergeblockconf(const std::string &filename) {
@@ -237,11 +310,30 @@ void process_mergeblockconf(const std::string &filename) {
     ConditionalBlock::setBlocknameWithFilename(true);
 
     std::string line;
-    StringJoiner sj;
+    std::vector<BlockLocation> locations;
+    while (std::getline(workfile, line)) {
+        BlockLocation location;
+        if (parseBlockLocation(line, location))
+            locations.push_back(location);
+    }
+
+    // the locations of each file, the files in the order of the worklist
+    std::vector<std::string> files;
+    std::map<std::string, std::vector<BlockLocation *>> fileLocations;
+    for (BlockLocation &location : locations) {
+        std::vector<BlockLocation *> &inFile = fileLocations[location.file];
+        if (inFile.empty())
+            files.push_back(location.file);
+        inFile.push_back(&location);
+    }
+
+    // the solver all files and blocks are checked on, without a CNF model
+    kconfig::PicosatCNF solver;
     std::map<std::string, bool> filesolvable;
-    while (std::getline(workfile, line))
-        process_blockconf_helper(sj, filesolvable, line);
+    for (const std::string &file : files)
+        process_blockconf_file(file, fileLocations[file], filesolvable, &solver);
 
+    StringJoiner sj = joinBlockLocations(locations);
     for (const std::string &str : KconfigWhitelist::getWhitelist())
         sj.push_back(str);
 
@@ -259,12 +351,16 @@ void process_mergeblockconf(const std::string &filename) {
 }
 
 void process_blockconf(const std::string &locationname) {
-    StringJoiner sj;
+    std::vector<BlockLocation> locations(1);
+    if (!parseBlockLocation(locationname, locations.front()))
+        std::exit(EXIT_FAILURE);
+
     std::map<std::string, bool> filesolvable;
-    if(!process_blockconf_helper(sj, filesolvable, locationname) && sj.size() == 0)
+    process_blockconf_file(locations.front().file, {&locations.front()}, filesolvable, nullptr);
+    if (locations.front().constraints.empty())
         std::exit(EXIT_FAILURE);
 
-    SatChecker sc(sj.join("\n&&\n"));
+    SatChecker sc(joinBlockLocations(locations).join("\n&&\n"));
 
     if (sc(Picosat::SAT_MIN))
         sc.getAssignment().formatKconfig(std::cout, {});
@@ -412,6 +508,22 @@ void process_file_coverage(const std::string &filename) {
     }
 }
 
+/* the precondition as a single formula, read it with BoolExpReader */
+static void write_cpppc_binary(const std::string &outfile, const std::string &formula) {
+    kconfig::BoolExpArena arena;
+    kconfig::BoolExpArena::Scope scope(&arena);
+    kconfig::BoolExp *e = kconfig::BoolExp::parseString(formula);
+    if (!e)
+        throw std::runtime_error("precondition isn't a valid formula");
+    kconfig::BoolExpWriter writer;
+    writer.add(e);
+    std::ofstream out(outfile, std::ios::binary);
+    writer.write(out);
+    if (!out.good())
+        throw std::runtime_error("couldn't write " + outfile);
+    Logging::info("wrote ", writer.getNodeCount(), " nodes to ", outfile);
+}
+
 void process_file_cpppc(const std::string &filename) {
     CppFile file(filename);
 
@@ -441,7 +553,10 @@ void process_file_cpppc(const std::string &filename) {
             main_model->doIntersect(code_formula, nullptr, missingSet, code_formula);
             sj.push_back(code_formula);
         }
-        std::cout << sj.join("\n&& ") << std::endl;
+        if (cpppc_binary)
+            write_cpppc_binary(filename + ".cpppc", sj.join("\n&& "));
+        else
+            std::cout << sj.join("\n&& ") << std::endl;
     } catch (std::runtime_error &e) {
         Logging::error("failed: ", e.what());
         return;
@@ -589,7 +704,7 @@ void process_file_blockpc(const std::string &filename) {
                   (defect != nullptr ? defect->isGlobal() : 0));
 
     /* Get and print the Precondition */
-    std::cout << BlockDefectAnalyzer::getBlockPrecondition(block, main_model) << std::endl;
+    std::cout << BlockDefectAnalyzer::getBlockPrecondition(block, main_model).str() << std::endl;
 }
 
 void process_file_dead_helper(const std::string &filename) {
@@ -610,8 +725,14 @@ void process_file_dead_helper(const std::string &filename) {
     else
         main_model = ModelContainer::lookupMainModel();
 
-    static auto processBlock = [](ConditionalBlock *block, ConfigurationModel *main_model) {
-        const BlockDefect *defect = BlockDefectAnalyzer::analyzeBlock(block, main_model);
+    std::unique_ptr<BlockWitnesses> witnesses;
+    if (use_block_witnesses)
+        witnesses.reset(new BlockWitnesses(&file, main_model));
+
+    static auto processBlock = [](ConditionalBlock *block, ConfigurationModel *main_model,
+                                  BlockWitnesses *witnesses) {
+        const BlockDefect *defect
+            = BlockDefectAnalyzer::analyzeBlock(block, main_model, witnesses);
         if (defect) {
             defect->writeReportToFile(skip_non_configuration_based_defects);
             if (do_mus_analysis)
@@ -621,10 +742,16 @@ void process_file_dead_helper(const std::string &filename) {
     };
 
     /* process File (B00 Block) */
-    processBlock(file.topBlock(), main_model);
+    processBlock(file.topBlock(), main_model, witnesses.get());
     /* Iterate over all Blocks */
     for (const auto &block : file)  // ConditionalBlock *
-        processBlock(block, main_model);
+        processBlock(block, main_model, witnesses.get());
+
+    if (witnesses) {
+        const BlockWitnesses::Stats &stats = witnesses->getStats();
+        Logging::debug(filename, ": ", stats.queries, " witness checks settled ", stats.alive,
+                       " alive and ", stats.deselectable, " deselectable blocks");
+    }
 }
 
 void process_file_dead(const std::string &filename) {
@@ -632,7 +759,8 @@ void process_file_dead(const std::string &filename) {
     static unsigned int timeout = 120;  // default timeout in seconds
 
     ConfigurationModel *main_model = ModelContainer::lookupMainModel();
-    if (main_model && "cnf" == main_model->getModelVersionIdentifier()) {
+    if (main_model && "cnf" == main_model->getModelVersionIdentifier()
+        && !SatChecker::useIncrementalModels) {
         Logging::debug("Increasing timeout for dead analysis to 3600 seconds");
         timeout = 3600;
     }
@@ -807,9 +935,22 @@ int wait_for_forked_child(pid_t new_pid, int threads = 1, const char *argument =
     return EXIT_SUCCESS;
 }
 
+void print_cache_stats() {
+    if (!SatChecker::cache)
+        return;
+    SatCache::Stats stats = SatChecker::cache->getStats();
+    const uint64_t lookups = stats.hits + stats.misses;
+    Logging::debug("SAT cache: ", stats.hits, " of ", lookups, " checks answered (",
+                   lookups ? 100 * stats.hits / lookups : 0, "%), ", stats.entries, " of ",
+                   stats.capacity, " entries used");
+}
+
 int main(int argc, char **argv) {
     int opt;
     std::string worklist;
+    std::string cache_file;
+    bool memory_cache = false;
+    std::string parse_cache_dir;
     int threads = 1;
     std::vector<std::string> models_from_parameters;
     /* Default main model will be x86 or the first one in model container if x86 is not loaded */
@@ -832,7 +973,7 @@ int main(int argc, char **argv) {
     coverageOutputMode = CoverageOutput::KCONFIG;
     coverageMode = CoverageMode::SIMPLE;
 
-    while ((opt = getopt(argc, argv, "ucb:M:m:t:i:B:W:sj:O:C:I:Vhvq")) != -1) {
+    while ((opt = getopt(argc, argv, "ucrweKk:P:p:S:E:b:M:m:t:i:B:W:sj:O:C:I:Vhvq")) != -1) {
         switch (opt) {
             int n;
         case 'i':
@@ -875,6 +1016,51 @@ int main(int argc, char **argv) {
         case 'c':
             process_file = process_file_coverage;
             break;
+        case 'r':
+            SatChecker::useIncrementalModels = true;
+            break;
+        case 'w':
+            use_block_witnesses = true;
+            break;
+        case 'K':
+            memory_cache = true;
+            break;
+        case 'k':
+            cache_file = optarg;
+            break;
+        case 'P':
+            parse_cache_dir = optarg;
+            break;
+        case 'p':
+            if (0 == strcmp(optarg, "scan")) {
+                CppFile::useScanner = true;
+            } else if (0 == strcmp(optarg, "puma")) {
+                CppFile::useScanner = false;
+            } else {
+                Logging::warn("block reader ", optarg, " is unknown, using puma");
+            }
+            break;
+        case 'S':
+            if (0 == strcmp(optarg, "slice")) {
+                SatChecker::modelSlicing = SatChecker::Slicing::SLICE;
+            } else if (0 == strcmp(optarg, "validate")) {
+                SatChecker::modelSlicing = SatChecker::Slicing::VALIDATE;
+            } else {
+                Logging::warn("slicing mode ", optarg, " is unknown, not slicing");
+            }
+            break;
+        case 'e':
+            SatChecker::simplifyFormulas = true;
+            break;
+        case 'E':
+            if (0 == strcmp(optarg, "polarity")) {
+                SatChecker::encoding = kconfig::CNFBuilder::Encoding::POLARITY;
+            } else if (0 == strcmp(optarg, "tseitin")) {
+                SatChecker::encoding = kconfig::CNFBuilder::Encoding::TSEITIN;
+            } else {
+                Logging::warn("encoding ", optarg, " is unknown, using polarity");
+            }
+            break;
         case 'O':
             if (0 == strcmp(optarg, "kconfig")) {
                 coverageOutputMode = CoverageOutput::KCONFIG;
@@ -890,6 +1076,8 @@ int main(int argc, char **argv) {
                 coverageOutputMode = CoverageOutput::COMMENTED;
             } else if (0 == strcmp(optarg, "combined")) {
                 coverageOutputMode = CoverageOutput::COMBINED;
+            } else if (0 == strcmp(optarg, "binary")) {
+                cpppc_binary = true;
             } else if (0 == strncmp(optarg, "exec", 4)) {
                 coverageOutputMode = CoverageOutput::EXEC;
                 if (optarg[4] == ':')
@@ -994,6 +1182,69 @@ int main(int argc, char **argv) {
             model->addFeatureToWhitelist(str);
     }
 
+    /* Hand the model clauses to the solvers before forking, so all
+       children share the loaded solvers instead of building their own */
+    if (SatChecker::useIncrementalModels) {
+        for (const auto &entry : model_container) {  // pair<string, ConfigurationModel *>
+            CnfConfigurationModel *cm = dynamic_cast<CnfConfigurationModel *>(entry.second);
+            if (cm)
+                cm->getQueryCNF()->checkSatisfiable();
+        }
+    }
+
+    /* The cache is shared with all children, so equal formulas in
+       different files are only solved once */
+    std::unique_ptr<SatCache> sat_cache;
+    try {
+        if (!cache_file.empty())
+            sat_cache = make_unique<SatCache>(cache_file);
+        else if (memory_cache)
+            sat_cache = make_unique<SatCache>();
+    } catch (kconfig::IOException &e) {
+        Logging::warn(e.what(), ", continuing without SAT cache");
+    }
+    if (sat_cache)
+        sat_cache->setContext(version, KconfigWhitelist::getIgnorelist());
+    SatChecker::cache = sat_cache.get();
+
+    /* Commented sources are printed from the tokens of the parser, the
+       blocks of cached and scanned files don't have any */
+    if (process_file == process_file_coverage
+        && (coverageOutputMode == CoverageOutput::EXEC
+            || coverageOutputMode == CoverageOutput::COMBINED
+            || coverageOutputMode == CoverageOutput::COMMENTED)) {
+        if (!parse_cache_dir.empty())
+            Logging::info("commented sources need parsed files, not using the parse cache");
+        if (CppFile::useScanner)
+            Logging::info("commented sources need parsed files, not scanning them");
+        parse_cache_dir.clear();
+        CppFile::useScanner = false;
+    }
+    std::unique_ptr<CppFileCache> parse_cache;
+    if (!parse_cache_dir.empty()) {
+        // scanned files get the blocks of parsed ones, but the expressions may differ in blanks
+        const std::string cache_version =
+            std::string(version) + (CppFile::useScanner ? " (scan)" : "");
+        try {
+            parse_cache = make_unique<CppFileCache>(
+                parse_cache_dir, cache_version, PumaConditionalBlockBuilder::getIncludePaths());
+        } catch (kconfig::IOException &e) {
+            Logging::warn(e.what(), ", continuing without parse cache");
+        }
+    }
+    CppFile::cache = parse_cache.get();
+
+    /* Compute everything the children need of the models only once */
+    for (const auto &entry : model_container) {  // pair<string, ConfigurationModel *>
+        CnfConfigurationModel *cm = dynamic_cast<CnfConfigurationModel *>(entry.second);
+        if (!cm)
+            continue;
+        if (SatChecker::cache)
+            cm->getIdentity();
+        if (SatChecker::modelSlicing != SatChecker::Slicing::NONE)
+            cm->getSlicer();
+    }
+
     std::vector<std::string> workfiles;
     if (worklist == "") {
         /* Use files from command line */
@@ -1094,9 +1345,12 @@ int main(int argc, char **argv) {
             }
         }
         /* Wait until fork count reaches zero */
-        return wait_for_forked_child(0, 0, nullptr, threads > 1);
+        int ret = wait_for_forked_child(0, 0, nullptr, threads > 1);
+        print_cache_stats();
+        return ret;
     } else if (workfiles.size() == 1) {
         process_file(workfiles[0]);
     }
+    print_cache_stats();
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,2 @@
+/* This is a autogenerated file, do not edit */
+const char * version = "993142a95c866c17c182e5a3250f15cb3c45810e-dirty";